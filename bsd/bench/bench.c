@@ -0,0 +1,647 @@
+/*
+ * bench.c - Run the benchmarks in this tree as a suite
+ *
+ * The sieves, the Dhrystones and the assembler sieve each print results
+ * their own way.  bench runs each one for a fixed duration, after warmup
+ * runs that are thrown away, several times over, and turns what it
+ * printed into one line per repetition and a summary per benchmark:
+ *
+ *   RESULT name=sieve host=pdp1144 params=-l,100000 rep=1 passes=52
+ *          elapsed=5.02 score=10.36 unit=passes/s validated=yes
+ *   SUMMARY name=sieve host=pdp1144 params=-l,100000 reps=3 median=10.36
+ *          stddev=0.04 min=10.30 max=10.40 unit=passes/s validated=yes
+ *
+ * (each on one line).  Save the output of a run per host with -o, then
+ * "bench -c file..." tabulates the medians side by side, and with -b a
+ * run is checked against an earlier one from the same host: a median
+ * more than -t percent below its baseline is reported as a regression
+ * and bench exits with status 1, as it does if a result fails to
+ * validate.
+ *
+ * The sieves and Dhrystones time themselves; bench asks the sieves to
+ * run for the duration and sizes the Dhrystone run count from a warmup
+ * run, to four seconds at least since Dhrystone retries shorter runs
+ * with ten times the count.  The assembler sieve runs once per exec, so
+ * it is timed here, by running it again until the duration is up.
+ * Programs are found relative to the bsd directory, so run bench from
+ * bsd/bench; ones not built are skipped.
+ *
+ * Usage:
+ *   bench [-d secs] [-r reps] [-w warmups] [-H host] [-o file]
+ *         [-b baseline] [-t percent] [name...]
+ *   bench -c file...
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_SECS 5
+#define DEFAULT_REPS 3
+#define DEFAULT_WARMUPS 1
+#define DEFAULT_THRESHOLD 10    /* Percent slower that counts as regressed */
+#define DHRY_SECS 4              /* Dhrystone wants 3 at least */
+#define MAX_REPS 32
+#define OUT_SIZE 8192           /* Output kept from one run */
+#define LINE_SIZE 512
+#define MAX_FILES 8
+#define MAX_ROWS 64
+
+/* How a benchmark is run and read */
+#define K_SIEVE 1               /* -s secs; prints passes, time, validator */
+#define K_DHRY 2                /* Run count argument; prints Dhrystones/s */
+#define K_ONCE 3                /* One run per exec; prints the primes */
+
+struct bench {
+    char *b_name;
+    char *b_prog;               /* Relative to the bsd directory */
+    int b_kind;
+    char *b_args[4];            /* Fixed arguments */
+    long b_expect;              /* K_ONCE: primes it should print */
+};
+
+/*
+ * Parameters are the same on every host so results compare: limits the
+ * PDP-11 can hold, and the K&R sieves' 16-bit int limit.
+ */
+struct bench benches[] = {
+    { "sieve", "../sieve/sieve", K_SIEVE, { "-l", "100000", NULL } },
+    { "sieve-seg", "../sieve/sieve", K_SIEVE, { "-S", "-l", "100000", NULL } },
+    { "krsieve", "../sieve/krsieve", K_SIEVE, { "-l", "10000", NULL } },
+    { "krsieve29", "../29bsd/krsieve/krsieve", K_SIEVE,
+      { "-l", "10000", NULL } },
+    { "dry", "../dry/dry", K_DHRY, { "-r", "1", NULL } },
+    { "dry29", "../dry/dry29", K_DHRY, { NULL } },
+    { "asmsieve", "../asmsieve/sieve", K_ONCE, { NULL }, 168L },
+};
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static char output[OUT_SIZE];
+static char hostname[64];
+static FILE *outfp;
+static int secs = DEFAULT_SECS;
+
+/* Seconds since the epoch, to the microsecond */
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, (struct timezone *)0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double square_root(x)
+double x;
+{
+    double r;
+    int i;
+
+    if (x <= 0)
+        return 0;
+    r = x > 1 ? x : 1;
+    for (i = 0; i < 60; i++)
+        r = (r + x / r) / 2;
+    return r;
+}
+
+/* Write a line to stdout and the -o file */
+static void emit(line)
+char *line;
+{
+    fputs(line, stdout);
+    fflush(stdout);
+    if (outfp) {
+        fputs(line, outfp);
+        fflush(outfp);
+    }
+}
+
+/*
+ * Run argv with stdout and stderr in output[].  Returns the exit status,
+ * or -1 if it couldn't be run.
+ */
+static int run(argv)
+char **argv;
+{
+    int fds[2], pid, n, len, status;
+    char discard[512];
+
+    if (pipe(fds) < 0)
+        return -1;
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(fds[1], 1);
+        dup2(fds[1], 2);
+        close(fds[0]);
+        close(fds[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    len = 0;
+    for (;;) {
+        if (len < OUT_SIZE - 1)
+            n = read(fds[0], output + len, OUT_SIZE - 1 - len);
+        else
+            n = read(fds[0], discard, sizeof(discard));
+        if (n <= 0)
+            break;
+        if (len < OUT_SIZE - 1)
+            len += n;
+    }
+    output[len] = '\0';
+    close(fds[0]);
+    while (wait(&status) != pid)
+        ;
+    return status;
+}
+
+/* The text after "label ... :" in output[], or NULL */
+static char *field(label)
+char *label;
+{
+    char *p;
+
+    p = strstr(output, label);
+    if (!p)
+        return NULL;
+    p = strchr(p, ':');
+    return p ? p + 1 : NULL;
+}
+
+/*
+ * Dhrystone prints each variable followed by "should be:" and the value
+ * it should have; check every one that has a definite value.  Arr_2_Glob
+ * should be the run count plus 10, but it counts every run it tried, in
+ * an int.
+ */
+static int dhry_valid(runs)
+long runs;
+{
+    char *p, *q, *got, *want, expect[32];
+    int glen, wlen, checked;
+
+    checked = 0;
+    for (p = output; (q = strstr(p, "should be:")) != NULL; p = q + 1) {
+        /* The value on the line before */
+        got = q;
+        while (got > output && got[-1] != '\n')
+            got--;
+        if (got == output)
+            continue;
+        for (got -= 2; got > output && got[-1] != '\n'; got--)
+            ;
+        got = strchr(got, ':');
+        if (!got || got > q)
+            continue;
+        for (got++; *got == ' '; got++)
+            ;
+        glen = strcspn(got, "\r\n");
+        for (want = q + 10; *want == ' '; want++)
+            ;
+        wlen = strcspn(want, "\r\n");
+        if (*want == '(')
+            continue;
+        if (strncmp(want, "Number_Of_Runs + 10", 19) == 0) {
+            sprintf(expect, "%d", (int)(runs + 10));
+            want = expect;
+            wlen = strlen(expect);
+        }
+        while (glen > 0 && got[glen - 1] == ' ')
+            glen--;
+        while (wlen > 0 && want[wlen - 1] == ' ')
+            wlen--;
+        if (glen != wlen || strncmp(got, want, glen) != 0)
+            return 0;
+        checked++;
+    }
+    return checked > 0;
+}
+
+/* Does the assembler sieve's output list the expected number of primes? */
+static int once_valid(expect)
+long expect;
+{
+    char *p;
+    long n;
+
+    p = strstr(output, "found:");
+    if (!p)
+        return 0;
+    n = 0;
+    for (p += 6; *p; p++)
+        if (*p >= '0' && *p <= '9' && (p[1] < '0' || p[1] > '9'))
+            n++;
+    return n == expect;
+}
+
+/*
+ * One timed run of b.  Fills in passes, elapsed seconds and score, and
+ * returns whether the result validated, or -1 if it couldn't be run.
+ * For Dhrystone, *runs is the run count to use, and is set from the run.
+ */
+static int run_once(b, dur, runs, passes, elapsed, score)
+struct bench *b;
+int dur;
+long *runs, *passes;
+double *elapsed, *score;
+{
+    char *argv[12], secbuf[16], runbuf[16], *p;
+    double t0;
+    long tried;
+    int i, n, status, valid;
+
+    n = 0;
+    argv[n++] = b->b_prog;
+    if (b->b_kind == K_SIEVE) {
+        sprintf(secbuf, "%d", dur);
+        argv[n++] = "-s";
+        argv[n++] = secbuf;
+    }
+    for (i = 0; b->b_args[i]; i++)
+        argv[n++] = b->b_args[i];
+    if (b->b_kind == K_DHRY) {
+        sprintf(runbuf, "%ld", *runs);
+        argv[n++] = runbuf;
+    }
+    argv[n] = NULL;
+
+    switch (b->b_kind) {
+    case K_SIEVE:
+        status = run(argv);
+        p = field("Number of passes");
+        *passes = p ? atol(p) : 0;
+        p = field("Total time taken");
+        *elapsed = p ? atof(p) : 0;
+        p = field("Prime validator");
+        valid = p && strncmp(p + strspn(p, " "), "PASS", 4) == 0;
+        break;
+    case K_DHRY:
+        status = run(argv);
+        /* It multiplies the count by 10 until the run is long enough */
+        tried = 0;
+        for (p = output; (p = strstr(p, "Trying ")) != NULL; p++) {
+            *runs = atol(p + 7);
+            tried += *runs;
+        }
+        *passes = *runs;
+        p = field("Dhrystones per Second");
+        *score = p ? atof(p) : 0;
+        *elapsed = *score > 0 ? *runs / *score : 0;
+        valid = dhry_valid(tried);
+        break;
+    default:
+        /* Exec it until the duration is up */
+        *passes = 0;
+        valid = 1;
+        t0 = now();
+        do {
+            status = run(argv);
+            if (status != 0)
+                break;
+            valid = valid && once_valid(b->b_expect);
+            ++*passes;
+            *elapsed = now() - t0;
+        } while (*elapsed < dur);
+        break;
+    }
+    if (status == -1 || (WIFEXITED(status) && WEXITSTATUS(status) == 127))
+        return -1;
+    if (b->b_kind != K_DHRY)
+        *score = *elapsed > 0 ? *passes / *elapsed : 0;
+    return valid;
+}
+
+static char *unit_of(b)
+struct bench *b;
+{
+    return b->b_kind == K_DHRY ? "dhrystones/s" :
+           b->b_kind == K_ONCE ? "runs/s" : "passes/s";
+}
+
+/* Arguments as one word for the result lines */
+static char *params_of(b)
+struct bench *b;
+{
+    static char buf[64];
+    int i;
+
+    buf[0] = '\0';
+    for (i = 0; b->b_args[i]; i++) {
+        if (i)
+            strcat(buf, ",");
+        strcat(buf, b->b_args[i]);
+    }
+    return buf[0] ? buf : "-";
+}
+
+/* Value of key= in a result line, copied to val; returns 0 if absent */
+static int get_key(line, key, val, size)
+char *line, *key, *val;
+int size;
+{
+    char *p;
+    int n, klen;
+
+    klen = strlen(key);
+    for (p = line; (p = strstr(p, key)) != NULL; p++)
+        if ((p == line || p[-1] == ' ') && p[klen] == '=') {
+            p += klen + 1;
+            n = strcspn(p, " \t\r\n");
+            if (n >= size)
+                n = size - 1;
+            strncpy(val, p, n);
+            val[n] = '\0';
+            return 1;
+        }
+    return 0;
+}
+
+/* Median of a baseline file's SUMMARY for name, params and host, or -1 */
+static double baseline_median(file, name, params)
+char *file, *name, *params;
+{
+    FILE *fp;
+    char line[LINE_SIZE], val[64];
+    double median;
+
+    fp = fopen(file, "r");
+    if (!fp)
+        return -1;
+    median = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "SUMMARY ", 8) != 0)
+            continue;
+        if (!get_key(line, "name", val, sizeof(val)) || strcmp(val, name))
+            continue;
+        if (!get_key(line, "params", val, sizeof(val)) || strcmp(val, params))
+            continue;
+        if (!get_key(line, "host", val, sizeof(val)) || strcmp(val, hostname))
+            continue;
+        if (get_key(line, "median", val, sizeof(val)))
+            median = atof(val);
+    }
+    fclose(fp);
+    return median;
+}
+
+static void sort_doubles(v, n)
+double *v;
+int n;
+{
+    double t;
+    int i, j;
+
+    for (i = 1; i < n; i++)
+        for (j = i; j > 0 && v[j - 1] > v[j]; j--) {
+            t = v[j];
+            v[j] = v[j - 1];
+            v[j - 1] = t;
+        }
+}
+
+/*
+ * Warm up, run and summarise one benchmark.  Returns 1 if it failed to
+ * validate or regressed against the baseline, 0 if not, -1 if skipped.
+ */
+static int run_bench(b, reps, warmups, baseline, threshold)
+struct bench *b;
+int reps, warmups;
+char *baseline;
+int threshold;
+{
+    char line[LINE_SIZE];
+    double scores[MAX_REPS], elapsed, score, sum, mean, var, median, base;
+    long runs, passes;
+    int i, r, allvalid, bad;
+
+    if (access(b->b_prog, 1) != 0) {
+        printf("SKIP name=%s prog=%s not built\n", b->b_name, b->b_prog);
+        return -1;
+    }
+
+    /* Warm up; for Dhrystone this also sizes the run count */
+    runs = 1000;
+    for (i = 0; i < warmups || (b->b_kind == K_DHRY && i == 0); i++) {
+        r = run_once(b, 1, &runs, &passes, &elapsed, &score);
+        if (r < 0) {
+            printf("SKIP name=%s prog=%s would not run\n", b->b_name,
+                   b->b_prog);
+            return -1;
+        }
+    }
+    /* Long enough that it doesn't decide the run was too short */
+    if (b->b_kind == K_DHRY && score > 0)
+        runs = (long)(score * (secs < DHRY_SECS ? DHRY_SECS : secs));
+
+    allvalid = 1;
+    sum = 0;
+    for (i = 0; i < reps; i++) {
+        r = run_once(b, secs, &runs, &passes, &elapsed, &score);
+        if (r <= 0)
+            allvalid = 0;
+        scores[i] = score;
+        sum += score;
+        sprintf(line, "RESULT name=%s host=%s params=%s rep=%d passes=%ld "
+                "elapsed=%.2f score=%.2f unit=%s validated=%s\n",
+                b->b_name, hostname, params_of(b), i + 1, passes, elapsed,
+                score, unit_of(b), r > 0 ? "yes" : "no");
+        emit(line);
+    }
+
+    mean = sum / reps;
+    var = 0;
+    for (i = 0; i < reps; i++)
+        var += (scores[i] - mean) * (scores[i] - mean);
+    var = reps > 1 ? var / (reps - 1) : 0;
+    sort_doubles(scores, reps);
+    median = reps % 2 ? scores[reps / 2] :
+             (scores[reps / 2 - 1] + scores[reps / 2]) / 2;
+    sprintf(line, "SUMMARY name=%s host=%s params=%s reps=%d median=%.2f "
+            "stddev=%.2f min=%.2f max=%.2f unit=%s validated=%s\n",
+            b->b_name, hostname, params_of(b), reps, median,
+            square_root(var), scores[0], scores[reps - 1], unit_of(b),
+            allvalid ? "yes" : "no");
+    emit(line);
+
+    bad = !allvalid;
+    if (baseline) {
+        base = baseline_median(baseline, b->b_name, params_of(b));
+        if (base > 0 && median < base * (100 - threshold) / 100) {
+            printf("REGRESSION name=%s median=%.2f baseline=%.2f "
+                   "change=%.1f%%\n",
+                   b->b_name, median, base, (median - base) * 100 / base);
+            bad = 1;
+        } else if (base > 0)
+            printf("OK name=%s median=%.2f baseline=%.2f change=%+.1f%%\n",
+                   b->b_name, median, base, (median - base) * 100 / base);
+        else
+            printf("NOBASELINE name=%s host=%s\n", b->b_name, hostname);
+    }
+    return bad;
+}
+
+/* Tabulate the SUMMARY medians of several result files, one host each */
+static int compare(files, nfiles)
+char **files;
+int nfiles;
+{
+    static char rows[MAX_ROWS][2][64];
+    static double medians[MAX_ROWS][MAX_FILES];
+    char hosts[MAX_FILES][24], line[LINE_SIZE], name[64], params[64];
+    char val[64];
+    FILE *fp;
+    int nrows, f, i;
+
+    if (nfiles > MAX_FILES)
+        nfiles = MAX_FILES;
+    nrows = 0;
+    for (f = 0; f < nfiles; f++) {
+        strncpy(hosts[f], files[f], sizeof(hosts[f]) - 1);
+        hosts[f][sizeof(hosts[f]) - 1] = '\0';
+        for (i = 0; i < MAX_ROWS; i++)
+            medians[i][f] = -1;
+        fp = fopen(files[f], "r");
+        if (!fp) {
+            perror(files[f]);
+            return 1;
+        }
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "SUMMARY ", 8) != 0 ||
+                !get_key(line, "name", name, sizeof(name)) ||
+                !get_key(line, "params", params, sizeof(params)) ||
+                !get_key(line, "median", val, sizeof(val)))
+                continue;
+            get_key(line, "host", hosts[f], sizeof(hosts[f]));
+            for (i = 0; i < nrows; i++)
+                if (!strcmp(rows[i][0], name) && !strcmp(rows[i][1], params))
+                    break;
+            if (i == nrows) {
+                if (nrows == MAX_ROWS)
+                    continue;
+                strcpy(rows[i][0], name);
+                strcpy(rows[i][1], params);
+                nrows++;
+            }
+            medians[i][f] = atof(val);
+        }
+        fclose(fp);
+    }
+
+    printf("%-12s %-16s", "benchmark", "params");
+    for (f = 0; f < nfiles; f++)
+        printf(" %14s", hosts[f]);
+    printf("\n");
+    for (i = 0; i < nrows; i++) {
+        printf("%-12s %-16s", rows[i][0], rows[i][1]);
+        for (f = 0; f < nfiles; f++)
+            if (medians[i][f] >= 0)
+                printf(" %14.2f", medians[i][f]);
+            else
+                printf(" %14s", "-");
+        printf("\n");
+    }
+    return 0;
+}
+
+static void usage(prog)
+char *prog;
+{
+    fprintf(stderr,
+            "Usage: %s [-d secs] [-r reps] [-w warmups] [-H host] [-o file]\n",
+            prog);
+    fprintf(stderr, "       %*s [-b baseline] [-t percent] [name...]\n",
+            (int)strlen(prog), "");
+    fprintf(stderr, "       %s -c file...\n", prog);
+    exit(2);
+}
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+    char *baseline, *outfile;
+    int reps, warmups, threshold, comparing, opt, i, j, r, status, found;
+    extern char *optarg;
+    extern int optind;
+
+    reps = DEFAULT_REPS;
+    warmups = DEFAULT_WARMUPS;
+    threshold = DEFAULT_THRESHOLD;
+    baseline = outfile = NULL;
+    comparing = 0;
+    gethostname(hostname, sizeof(hostname));
+    hostname[sizeof(hostname) - 1] = '\0';
+    hostname[strcspn(hostname, ". \t")] = '\0';
+
+    while ((opt = getopt(argc, argv, "d:r:w:H:o:b:t:c")) != EOF) {
+        switch (opt) {
+        case 'd':
+            secs = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'w':
+            warmups = atoi(optarg);
+            break;
+        case 'H':
+            strncpy(hostname, optarg, sizeof(hostname) - 1);
+            hostname[strcspn(hostname, " \t")] = '\0';
+            break;
+        case 'o':
+            outfile = optarg;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 't':
+            threshold = atoi(optarg);
+            break;
+        case 'c':
+            comparing = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (comparing) {
+        if (optind == argc)
+            usage(argv[0]);
+        return compare(argv + optind, argc - optind);
+    }
+    if (secs < 1 || reps < 1 || reps > MAX_REPS || warmups < 0 ||
+        threshold < 0 || threshold > 100)
+        usage(argv[0]);
+    if (outfile && (outfp = fopen(outfile, "w")) == NULL) {
+        perror(outfile);
+        return 2;
+    }
+
+    status = 0;
+    for (i = 0; i < NBENCHES; i++) {
+        if (optind < argc) {
+            found = 0;
+            for (j = optind; j < argc; j++)
+                if (!strcmp(argv[j], benches[i].b_name))
+                    found = 1;
+            if (!found)
+                continue;
+        }
+        r = run_bench(&benches[i], reps, warmups, baseline, threshold);
+        if (r > 0)
+            status = 1;
+    }
+    if (outfp)
+        fclose(outfp);
+    return status;
+}
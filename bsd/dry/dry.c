@@ -26,7 +26,10 @@
  * 
  * Key Modifications for Cross-Platform Support:
  *   - Fixed 16-bit integer overflow on PDP-11 systems
- *   - Portable timing using times() system call
+ *   - Portable timing: clock_gettime(CLOCK_MONOTONIC) where available,
+ *     otherwise the times() system call and clock ticks
+ *   - Run count calibrated to a target duration, repeated runs, and the
+ *     min/median/max Dhrystones per second and DMIPS
  *   - K&R C compatible variable declarations
  *   - Conditional compilation for different BSD variants
  *   - Simplified build process (single compilation unit)
@@ -37,7 +40,12 @@
  *   Make:        make
  * 
  * Usage:
- *   ./dry [iterations]
+ *   ./dry [-r repeats] [-t seconds] [iterations]
+ *
+ *   Without an iteration count, a calibration run sizes each run to take
+ *   about the given seconds (default 2); the run is then repeated
+ *   (default 5 times).  With a count, runs of that many iterations are
+ *   repeated, each multiplied by 10 until it takes long enough to time.
  * 
  * License:      Public Domain (following original Dhrystone tradition)
  * 
@@ -63,6 +71,7 @@ extern int strcmp();
 #include <stdlib.h>  /* for malloc, exit, atoi */
 #include <unistd.h>   /* for sysconf on modern systems */
 #include <string.h>  /* for strcpy, strcmp */
+#include <time.h>    /* for clock_gettime */
 #endif
 
 /* Define HZ based on system */
@@ -77,9 +86,21 @@ extern int strcmp();
 #endif
 #endif
 
-/* Use times(2) for timing */
+/*
+ * Time with clock_gettime(2) and a monotonic clock where there is one, in
+ * microseconds; otherwise with times(2), in clock ticks of user time.
+ */
+#if defined(CLOCK_MONOTONIC) && !defined(BSD211) && !defined(__pdp11__)
+#define CLOCK_GETTIME
+#define CLOCK_TYPE "clock_gettime(CLOCK_MONOTONIC)"
+#define CLOCK_RATE 1000000L
+#define Too_Small_Time (CLOCK_RATE / 10)
+#else
 #define TIMES
 #define CLOCK_TYPE "times()"
+#define CLOCK_RATE ((long)HZ)
+#define Too_Small_Time (2*HZ)
+#endif
 
 /* Type definitions */
 #ifdef NOENUM
@@ -162,13 +183,19 @@ Boolean Reg = false;
 Boolean Reg = true;
 #endif
 
-Boolean Done;
 long Begin_Time, End_Time, User_Time;
 float Microseconds, Dhrystones_Per_Second;
+float Rates[50];  /* Dhrystones per second of each timed run */
 
 #define Mic_secs_Per_Second 1000000.0
 #define NUMBER_OF_RUNS 5000  /* More reasonable for PDP-11/83 */
-#define Too_Small_Time (2*HZ)
+#define NUMBER_OF_REPEATS 5
+#define MAX_REPEATS (sizeof(Rates) / sizeof(Rates[0]))
+#define TARGET_SECONDS 2
+#define VAX_DHRYSTONES 1757.0  /* Dhrystones per second of a 1 MIPS VAX 11/780 */
+
+long Clock(void);
+void Sort_Rates(int n);
 
 int main(int argc, char *argv[])
 {
@@ -181,20 +208,44 @@ int main(int argc, char *argv[])
     Str_30 Str_2_Loc;
     REG long Run_Index;  /* Use long to match Number_Of_Runs */
     REG long Number_Of_Runs;  /* Use long to avoid 16-bit int overflow on PDP-11 */
-    struct tms time_buffer;
+    long Total_Runs;          /* Every run, calibration too, for Arr_2_Glob */
+    long Target_Time;
+    int Number_Of_Repeats, Target_Seconds, Repeat, Arg;
+    Boolean Calibrating;
+    float Median;
 
     /* Arguments */
-    if (argc > 2) {
-        printf("Usage: %s [number of loops]\n", argv[0]);
+    Number_Of_Runs = 0;
+    Number_Of_Repeats = NUMBER_OF_REPEATS;
+    Target_Seconds = TARGET_SECONDS;
+    for (Arg = 1; Arg < argc; Arg++) {
+        if (strcmp(argv[Arg], "-r") == 0 && Arg + 1 < argc) {
+            Number_Of_Repeats = atoi(argv[++Arg]);
+        } else if (strcmp(argv[Arg], "-t") == 0 && Arg + 1 < argc) {
+            Target_Seconds = atoi(argv[++Arg]);
+        } else if (argv[Arg][0] != '-' && Number_Of_Runs == 0) {
+            Number_Of_Runs = atol(argv[Arg]);
+            if (Number_Of_Runs <= 0) {
+                Number_Of_Runs = NUMBER_OF_RUNS;
+            }
+        } else {
+            printf("Usage: %s [-r repeats] [-t seconds] [number of loops]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (Number_Of_Repeats < 1 || Number_Of_Repeats > MAX_REPEATS || Target_Seconds < 1) {
+        printf("Repeats must be 1 to %d, and seconds at least 1\n", (int)MAX_REPEATS);
         exit(1);
     }
-    if (argc == 2) {
-        Number_Of_Runs = atol(argv[1]);
-    } else {
+    /* Without a count, calibrate one to the target */
+    Calibrating = Number_Of_Runs == 0;
+    if (Calibrating) {
         Number_Of_Runs = NUMBER_OF_RUNS;
     }
-    if (Number_Of_Runs <= 0) {
-        Number_Of_Runs = NUMBER_OF_RUNS;
+    /* Far enough past the shortest time that a calibrated run makes it */
+    Target_Time = (long)Target_Seconds * CLOCK_RATE;
+    if (Target_Time < Too_Small_Time + Too_Small_Time / 2) {
+        Target_Time = Too_Small_Time + Too_Small_Time / 2;
     }
 
     /* Initializations */
@@ -213,16 +264,20 @@ int main(int argc, char *argv[])
     printf("\n");
     printf("Dhrystone Benchmark, Version %s\n", Version);
     printf("Program compiled %s 'register' attribute\n", Reg ? "with" : "without");
+#ifdef CLOCK_GETTIME
+    printf("Using %s\n", CLOCK_TYPE);
+#else
     printf("Using %s, HZ=%ld\n", CLOCK_TYPE, (long)HZ);
+#endif
     printf("\n");
 
-    Done = false;
-    while (!Done) {
+    Total_Runs = 0;
+    Repeat = 0;
+    while (Repeat < Number_Of_Repeats) {
         printf("Trying %ld runs through Dhrystone:\n", Number_Of_Runs);
 
         /* Start timer */
-        times(&time_buffer);
-        Begin_Time = (long)time_buffer.tms_utime;
+        Begin_Time = Clock();
 
         for (Run_Index = 1; Run_Index <= Number_Of_Runs; ++Run_Index) {
             Proc_5();
@@ -254,17 +309,27 @@ int main(int argc, char *argv[])
         }
 
         /* Stop timer */
-        times(&time_buffer);
-        End_Time = (long)time_buffer.tms_utime;
+        End_Time = Clock();
 
         User_Time = End_Time - Begin_Time;
+        Total_Runs += Number_Of_Runs;
 
         if (User_Time < Too_Small_Time) {
             printf("Measured time too small to obtain meaningful results\n");
             Number_Of_Runs *= 10;
             printf("\n");
+        } else if (Calibrating) {
+            /* Scale the count to the target time */
+            Number_Of_Runs = (long)((float)Number_Of_Runs * (float)Target_Time / (float)User_Time);
+            printf("Calibrated to %ld runs for %d seconds\n", Number_Of_Runs, Target_Seconds);
+            printf("\n");
+            Calibrating = false;
         } else {
-            Done = true;
+            Rates[Repeat] = (float)CLOCK_RATE * (float)Number_Of_Runs / (float)User_Time;
+            printf("Run %d: %.3f seconds, %.0f per second\n", Repeat + 1,
+                   (float)User_Time / (float)CLOCK_RATE, Rates[Repeat]);
+            printf("\n");
+            Repeat++;
         }
     }
 
@@ -281,7 +346,7 @@ int main(int argc, char *argv[])
     fprintf(stderr, "Arr_1_Glob[8]:       %d\n", Arr_1_Glob[8]);
     fprintf(stderr, "        should be:   %d\n", 7);
     fprintf(stderr, "Arr_2_Glob[8][7]:    %d\n", Arr_2_Glob[8][7]);
-    fprintf(stderr, "        should be:   Number_Of_Runs + 10\n");
+    fprintf(stderr, "        should be:   %d\n", (int)(Total_Runs + 10));
     fprintf(stderr, "Ptr_Glob->\n");
     fprintf(stderr, "  Ptr_Comp:          %ld\n", (long)Ptr_Glob->Ptr_Comp);
     fprintf(stderr, "        should be:   (implementation-dependent)\n");
@@ -318,16 +383,63 @@ int main(int argc, char *argv[])
     fprintf(stderr, "        should be:   DHRYSTONE PROGRAM, 2'ND STRING\n");
     fprintf(stderr, "\n");
 
-    Microseconds = (float)User_Time * Mic_secs_Per_Second / ((float)HZ * (float)Number_Of_Runs);
-    Dhrystones_Per_Second = ((float)HZ * (float)Number_Of_Runs) / (float)User_Time;
+    /* Report the median run, and the spread */
+    Sort_Rates(Number_Of_Repeats);
+    if (Number_Of_Repeats % 2) {
+        Median = Rates[Number_Of_Repeats / 2];
+    } else {
+        Median = (Rates[Number_Of_Repeats / 2 - 1] + Rates[Number_Of_Repeats / 2]) / 2;
+    }
+    Dhrystones_Per_Second = Median;
+    Microseconds = Mic_secs_Per_Second / Dhrystones_Per_Second;
 
-    printf("Microseconds for one run through Dhrystone: %10.1f \n", Microseconds);
+    printf("Microseconds for one run through Dhrystone: %10.3f \n", Microseconds);
     printf("Dhrystones per Second:                      %10.0f \n", Dhrystones_Per_Second);
+    printf("  median of %d runs, min %.0f, max %.0f\n", Number_Of_Repeats,
+           Rates[0], Rates[Number_Of_Repeats - 1]);
+    printf("DMIPS:                                      %10.2f \n", Dhrystones_Per_Second / VAX_DHRYSTONES);
+    printf("  min %.2f, max %.2f\n", Rates[0] / VAX_DHRYSTONES,
+           Rates[Number_Of_Repeats - 1] / VAX_DHRYSTONES);
     printf("\n");
 
     return 0;
 }
 
+/* Time now in CLOCK_RATE units */
+long Clock(void)
+{
+#ifdef CLOCK_GETTIME
+    static time_t Start_Sec;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (Start_Sec == 0) {
+        Start_Sec = ts.tv_sec;
+    }
+    return (long)(ts.tv_sec - Start_Sec) * CLOCK_RATE + ts.tv_nsec / 1000;
+#else
+    struct tms time_buffer;
+
+    times(&time_buffer);
+    return (long)time_buffer.tms_utime;
+#endif
+}
+
+/* Sort the first n rates, fastest last */
+void Sort_Rates(int n)
+{
+    float Rate;
+    int i, j;
+
+    for (i = 1; i < n; i++) {
+        Rate = Rates[i];
+        for (j = i; j > 0 && Rates[j - 1] > Rate; j--) {
+            Rates[j] = Rates[j - 1];
+        }
+        Rates[j] = Rate;
+    }
+}
+
 void Proc_1(REG Rec_Pointer Ptr_Val_Par)
 {
     REG Rec_Pointer Next_Record = Ptr_Val_Par->Ptr_Comp;
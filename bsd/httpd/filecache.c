@@ -0,0 +1,157 @@
+/*
+ * filecache.c - Open files and their response headers for standalone httpd
+ *
+ * A file that has been served stays open, with its size, mtime and the
+ * Content-Type, Content-Length, Last-Modified and ETag headers already
+ * formatted, so a repeat request costs the stat() check_path() makes
+ * and nothing else before the body goes out.  An entry is used only
+ * while the file's mtime and size still match that stat(); otherwise it
+ * is retired and the file opened again.  Entries being sent from are
+ * counted and never reused, and there are more slots than connections,
+ * so a slot can always be found.  Bodies are read at an offset, not
+ * through the descriptor's own position, since any number of
+ * connections can be sending the same file.  Included by standalone.c.
+ */
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#define HAVE_SENDFILE
+#endif
+
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__linux__) || defined(__APPLE__)
+#define FC_SLOTS (MAX_CONNS + 32)
+#else
+#define FC_SLOTS (MAX_CONNS + 2)    /* Descriptors are scarce */
+#endif
+
+#define HTTP_304 "HTTP/1.1 304 Not Modified"
+
+struct fentry {
+    char fe_path[PATH_LEN];     /* "" if free or retired */
+    int fe_fd;                  /* -1 if the slot is free */
+    int fe_refs;                /* Connections sending from it */
+    long fe_used;               /* fc_clock when last served */
+    long fe_size;
+    long fe_mtime;
+    char fe_etag[24];           /* Quoted, as sent */
+    char fe_date[32];           /* Last-Modified value, as sent */
+    char fe_head[160];          /* Headers after the status line */
+};
+
+static struct fentry fcache[FC_SLOTS];
+static long fc_clock;
+static long fc_hits, fc_misses;
+
+static char *wdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+/* Format t as an HTTP date, "Sun, 06 Nov 1994 08:49:37 GMT" */
+static void http_date(buf, t)
+char *buf;
+long t;
+{
+    time_t secs;
+    struct tm *tm;
+
+    secs = t;
+    tm = gmtime(&secs);
+    sprintf(buf, "%s, %02d %s %d %02d:%02d:%02d GMT", wdays[tm->tm_wday],
+            tm->tm_mday, months[tm->tm_mon], tm->tm_year + 1900,
+            tm->tm_hour, tm->tm_min, tm->tm_sec);
+}
+
+void fc_init()
+{
+    int i;
+
+    for (i = 0; i < FC_SLOTS; i++)
+        fcache[i].fe_fd = -1;
+}
+
+/* Stop handing out fe; its descriptor goes once nobody is sending it */
+static void fc_retire(fe)
+struct fentry *fe;
+{
+    fe->fe_path[0] = '\0';
+    if (fe->fe_refs == 0 && fe->fe_fd >= 0) {
+        close(fe->fe_fd);
+        fe->fe_fd = -1;
+    }
+}
+
+/* A connection has finished sending fe */
+void fc_release(fe)
+struct fentry *fe;
+{
+    if (--fe->fe_refs == 0 && fe->fe_path[0] == '\0')
+        fc_retire(fe);
+}
+
+/*
+ * The entry for path, whose stat() is st, with a reference taken for
+ * the caller.  Returns NULL after logging a 500 if it can't be opened.
+ */
+struct fentry *fc_get(path, st)
+char *path;
+struct stat *st;
+{
+    struct fentry *fe, *victim;
+    int i, fd;
+
+    fc_clock++;
+    victim = NULL;
+    for (i = 0; i < FC_SLOTS; i++) {
+        fe = &fcache[i];
+        if (fe->fe_path[0] && !strcmp(fe->fe_path, path)) {
+            if (fe->fe_mtime == (long)st->st_mtime &&
+                fe->fe_size == (long)st->st_size) {
+                fc_hits++;
+                fe->fe_used = fc_clock;
+                fe->fe_refs++;
+                return fe;
+            }
+            fc_retire(fe);
+        }
+        /* Least recently used of the slots nobody is sending from */
+        if (fe->fe_refs == 0 &&
+            (!victim || (victim->fe_fd >= 0 &&
+                         (fe->fe_fd < 0 || fe->fe_used < victim->fe_used))))
+            victim = fe;
+    }
+
+    fc_misses++;
+    if (victim->fe_fd >= 0)
+        fc_retire(victim);
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        fprintf(htlog, "500 %s\n", strerror(errno));
+        return NULL;
+    }
+    fcntl(fd, F_SETFD, 1);
+
+    fe = victim;
+    strcpy(fe->fe_path, path);
+    fe->fe_fd = fd;
+    fe->fe_refs = 1;
+    fe->fe_used = fc_clock;
+    fe->fe_size = st->st_size;
+    fe->fe_mtime = st->st_mtime;
+    sprintf(fe->fe_etag, "\"%lx-%lx\"", fe->fe_mtime, fe->fe_size);
+    http_date(fe->fe_date, fe->fe_mtime);
+    sprintf(fe->fe_head,
+            "Content-Type: %s\r\nContent-Length: %ld\r\nLast-Modified: %s\r\nETag: %s\r\n",
+            content_type(path), fe->fe_size, fe->fe_date, fe->fe_etag);
+    return fe;
+}
+
+/* Read up to len bytes of fe's body from off */
+int fc_read(fe, off, buf, len)
+struct fentry *fe;
+long off;
+char *buf;
+int len;
+{
+    if (lseek(fe->fe_fd, (off_t)off, 0) < 0)
+        return -1;
+    return read(fe->fe_fd, buf, len);
+}
@@ -32,7 +32,7 @@
 #include <unistd.h>
 
 #define CGI_BIN
-#define BUF_SIZE 256
+#define BUF_SIZE 1024
 #define PATH_LEN 512
 #define WWW_ROOT "/var/www/"
 #define LOGFILE "/usr/adm/httpd.log"
@@ -43,30 +43,102 @@
 #define HTTP_500 "HTTP/1.1 500 Internal Server Error"
 
 FILE *htlog;
+char *www_root = WWW_ROOT;
 
-/* Get path information and handle errors */
-void chk_path(path, st)
+/* Log why stat() failed and return the status line to answer with */
+char *stat_status()
+{
+    if (errno & (ENOENT | ENOTDIR | EINVAL | ENAMETOOLONG)) {
+        fprintf(htlog, "404 %s\n", strerror(errno));
+        return HTTP_404;
+    } else if (errno & EACCES) {
+        fprintf(htlog, "403 %s\n", strerror(errno));
+        return HTTP_403;
+    } else {
+        fprintf(htlog, "500 %s\n", strerror(errno));
+        return HTTP_500;
+    }
+}
+
+/*
+ * Check a requested path the way every request is checked: no parent
+ * directories, it must exist, a directory means its index.html, and
+ * only regular files are served.  Returns NULL with st filled in, or
+ * the status line to answer with after logging why.
+ */
+char *check_path(path, size, st)
 char *path;
+int size;
 struct stat *st;
 {
-    /* stat the path. If there's an error, log it and terminate. */
-    if (stat(path, st) != 0) {
-        if (errno & (ENOENT | ENOTDIR | EINVAL | ENAMETOOLONG)) {
-            fprintf(htlog, "404 %s\n", strerror(errno));
-            printf("%s\r\n", HTTP_404);
-        } else if (errno & EACCES) {
-            fprintf(htlog, "403 %s\n", strerror(errno));
-            printf("%s\r\n", HTTP_403);
-        } else {
-            fprintf(htlog, "500 %s\n", strerror(errno));
-            printf("%s\r\n", HTTP_500);
-        }
+    /* Check for parent directories in path */
+    if (strstr(path, "/..")) {
+        fprintf(htlog, "403 Request contains \"..\"\n");
+        return HTTP_403;
+    }
 
-        fclose(htlog);
-        exit(1);
+    /* stat the path and handle errors */
+    if (stat(path, st) != 0)
+        return stat_status();
+
+    /* If a directory is requested, default page is index.html */
+    if (st->st_mode & S_IFDIR) {
+        strncat(path, "index.html", size-strlen(path)-1);
+        /* stat and handle errors again */
+        if (stat(path, st) != 0)
+            return stat_status();
+    }
+
+    /* Only serve regular files */
+    if (!(st->st_mode & S_IFREG)) {
+        fprintf(htlog, "403 Not a regular file\n");
+        return HTTP_403;
     }
+    return NULL;
+}
+
+#ifdef CGI_BIN
+/* Is path a CGI program?  Returns 0, 1, or -1 after logging a 403 */
+int cgi_path(path, st)
+char *path;
+struct stat *st;
+{
+    if (!strstr(path, "/cgi-bin/"))
+        return 0;
+
+    /* CGI program must be executable and not setuid/setgid */
+    if (!(st->st_mode & S_IEXEC) ||
+            (st->st_mode & (S_ISUID | S_ISGID))) {
+        fprintf(htlog,
+                "403 File not executable and/or is setuid/setgid\n");
+        return -1;
+    }
+    return 1;
+}
+#endif /* CGI_BIN */
+
+/* Content-Type for a file, from its extension */
+char *content_type(path)
+char *path;
+{
+    char *ext;
+
+    ext = rindex(path, '.');
+    if (!ext)
+        ext = "";
+
+    if (!strcmp(ext, ".html"))
+        return "text/html";
+    else if (!strcmp(ext, ".jpg"))
+        return "image/jpeg";
+    else if (!strcmp(ext, ".ico"))
+        return "image/x-icon";
+    else
+        return "text/plain";
 }
 
+#include "standalone.c"
+
 int main(argc, argv)
 int argc;
 char *argv[];
@@ -74,9 +146,36 @@ char *argv[];
     char path[PATH_LEN];
     struct stat st;
     struct itimerval timeout;
-    
+    char *logfile = LOGFILE;
+    char *reply;
+    int port = 0;
+    int cgi;
+    int opt;
+    extern char *optarg;
+
+    /* No options when run from inetd; -p runs a standalone server */
+    while ((opt = getopt(argc, argv, "p:d:l:")) != EOF) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'd':
+            www_root = optarg;
+            break;
+        case 'l':
+            logfile = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p port] [-d root] [-l logfile]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+    if (port > 0)
+        return standalone(port, logfile);
+
     /* Open log file, quit with HTTP 500 if there's an error */
-    htlog = fopen(LOGFILE, "a");
+    htlog = fopen(logfile, "a");
     if (!htlog) {
         printf("%s\r\n", HTTP_500);
         exit(1);
@@ -118,7 +217,7 @@ char *argv[];
     }
 
     /* Path starts with WWW_ROOT */
-    strncpy(path, WWW_ROOT, sizeof(path));
+    strncpy(path, www_root, sizeof(path));
 
     /* Set a timeout to terminate the process if the client is holding the
      * socket open and not completing the http request */
@@ -165,35 +264,25 @@ char *argv[];
     timerclear(&timeout.it_value);
     setitimer(ITIMER_REAL, &timeout, 0);
 
-    /* Check for parent directories in path */
-    if (strstr(path, "/..")) {
-        printf("%s\r\n", HTTP_403);
-        fprintf(htlog, "403 Request contains \"..\"\n");
+    /* Check the path and handle errors */
+    reply = check_path(path, sizeof(path), &st);
+    if (reply) {
+        printf("%s\r\n", reply);
         fclose(htlog);
         exit(1);
     }
-    
-    /* stat the path and handle errors */
-    chk_path(path, &st);
-
-    /* If a directory is requested, default page is index.html */
-    if (st.st_mode & S_IFDIR) {
-        strncat(path, "index.html", sizeof(path)-strlen(path)-1);
-        /* stat and handle errors again */
-        chk_path(path, &st);
-    }
 
-    /* Only serve regular files */
-    if (!(st.st_mode & S_IFREG)) {
+#ifdef CGI_BIN
+    /* CGI program must be executable and not setuid/setgid */
+    cgi = cgi_path(path, &st);
+    if (cgi < 0) {
         printf("%s\r\n", HTTP_403);
-        fprintf(htlog, "403 Not a regular file\n");
         fclose(htlog);
         exit(1);
     }
 
-#ifdef CGI_BIN
     /* Check if a CGI program has been requested */
-    if (strstr(path, "/cgi-bin/")) {
+    if (cgi) {
 
         int pid;
 #if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__linux__) || defined(__APPLE__)
@@ -202,16 +291,6 @@ char *argv[];
         union wait status;
 #endif
         
-        /* CGI program must be executable and not setuid/setgid */
-        if (!(st.st_mode & S_IEXEC) ||
-                (st.st_mode & (S_ISUID | S_ISGID))) {
-            printf("%s\r\n", HTTP_403);
-            fprintf(htlog,
-                    "403 File not executable and/or is setuid/setgid\n");
-            fclose(htlog);
-            exit(1);
-        }
-        
         /* Execute CGI program */
         if (!(pid = vfork())) {
             /* Child process */
@@ -247,15 +326,14 @@ char *argv[];
 
     /* Serve the file */
     {
-        FILE *fd;
-        char *ext;
+        int fd;
 
         char buf[BUF_SIZE];
         int pos;
 
         /* Open file */
-        fd = fopen(path, "r");
-        if (!fd) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
             /* Earlier stat should have caught any errors, so we shouldn't
              * get here unless the file changed after the call */
             fprintf(htlog, "500 %s\n", strerror(errno));
@@ -267,27 +345,18 @@ char *argv[];
         printf("%s\r\n", HTTP_200);
         fprintf(htlog, "200 %ld\n", st.st_size);
 
-        /* Extract file type and output content-type header */
-        ext = rindex(path, '.');
-        if (!ext)
-            ext = "";
-
-        if (!strcmp(ext, ".html"))
-            printf("Content-Type: text/html\r\n");
-        else if (!strcmp(ext, ".jpg"))
-            printf("Content-Type: image/jpeg\r\n");
-        else if (!strcmp(ext, ".ico"))
-            printf("Content-Type: image/x-icon\r\n");
-        else
-            printf("Content-Type: text/plain\r\n");
+        /* Output content-type header from the file type */
+        printf("Content-Type: %s\r\n", content_type(path));
 
         printf("Content-Length: %ld\r\n\r\n", st.st_size);
-        
-        while (!feof(fd) &&
-                (pos = fread(buf, sizeof(*buf), sizeof(buf), fd)) > 0)
-            fwrite(buf, sizeof(*buf), pos, stdout);
-        
-        fclose(fd);
+        fflush(stdout);
+
+        /* Copy the body in large pieces, bypassing stdio */
+        while ((pos = read(fd, buf, sizeof(buf))) > 0)
+            if (write(1, buf, pos) != pos)
+                break;
+
+        close(fd);
     }
 
     fclose(htlog);
@@ -0,0 +1,610 @@
+/*
+ * standalone.c - httpd as a long running server instead of from inetd
+ *
+ * "httpd -p port" accepts connections itself and multiplexes them with
+ * select(), so a page and its images cost no fork, exec or reverse DNS
+ * lookup each.  HTTP/1.1 connections are kept alive unless the client
+ * says "Connection: close" (HTTP/1.0 ones only if it asks), and
+ * pipelined requests are answered in order: the next one is parsed once
+ * the previous response is written.  Files come from filecache.c and
+ * are read into the connection's buffer, the first piece behind the
+ * headers, and the rest is sent with sendfile() on Linux or written from
+ * the buffer as the socket drains.  A request whose If-None-Match or
+ * If-Modified-Since matches the file gets a 304 and no body, and a HEAD
+ * request gets the headers a GET would.  A CGI program still runs in a
+ * child with the connection as its stdin and stdout, and the connection
+ * is then the child's.  Requests get the same check_path() and
+ * cgi_path() rules as under inetd.  The log stays open, buffered by
+ * stdio, and is flushed once a second.  Included by httpd.c.
+ */
+
+#include <fcntl.h>
+#include <ctype.h>
+#include <time.h>
+#include <netinet/tcp.h>
+
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__linux__) || defined(__APPLE__)
+#define MAX_CONNS 64
+#define REQ_SIZE 4096           /* Request line and headers */
+#define OUT_SIZE 16384          /* Response headers and file data */
+#else
+#define MAX_CONNS 8             /* 2.11BSD allows 30 open files */
+#define REQ_SIZE 1024
+#define OUT_SIZE 1024
+#endif
+#ifdef SOMAXCONN
+#define LISTEN_BACKLOG SOMAXCONN
+#else
+#define LISTEN_BACKLOG 5
+#endif
+#define IDLE_SECS 60            /* As long as inetd mode waits for a request */
+
+#ifndef O_NONBLOCK
+#define O_NONBLOCK FNDELAY
+#endif
+#ifndef EWOULDBLOCK
+#define EWOULDBLOCK EAGAIN
+#endif
+
+#define HTTP_400 "HTTP/1.1 400 Bad Request"
+
+#include "filecache.c"
+
+struct conn {
+    int c_fd;                   /* -1 if the slot is free */
+    char c_host[16];            /* Peer address for the log */
+    long c_last;                /* time() of the last activity */
+    int c_close;                /* Close once the response is written */
+    int c_inlen;                /* Bytes in c_in */
+    long c_skip;                /* Request body bytes still to discard */
+    int c_outpos, c_outlen;     /* Unwritten part of c_out */
+    struct fentry *c_fe;        /* File being sent, or NULL */
+    long c_off;                 /* Offset of the file's next unsent byte */
+    long c_left;                /* File bytes from c_off on */
+    char c_in[REQ_SIZE];
+    char c_out[OUT_SIZE];
+};
+
+static struct conn conns[MAX_CONNS];
+static int stopping;
+
+static void on_stop(sig)
+int sig;
+{
+    stopping = 1;
+}
+
+static void set_flag(fd, cmd, get, flag)
+int fd, cmd, get, flag;
+{
+    fcntl(fd, cmd, fcntl(fd, get, 0) | flag);
+}
+
+/* ctime() of now without the newline, made once a second */
+static char *log_time()
+{
+    static char buf[32];
+    static time_t last;
+    time_t secs;
+
+    time(&secs);
+    if (secs != last) {
+        last = secs;
+        strncpy(buf, ctime(&secs), sizeof(buf) - 1);
+        buf[strcspn(buf, "\r\n")] = '\0';
+    }
+    return buf;
+}
+
+static void conn_close(c)
+struct conn *c;
+{
+    close(c->c_fd);
+    if (c->c_fe)
+        fc_release(c->c_fe);
+    c->c_fd = -1;
+    c->c_fe = NULL;
+}
+
+static int sending(c)
+struct conn *c;
+{
+    return c->c_outpos < c->c_outlen || c->c_left > 0;
+}
+
+/* Does [p, end) start with s, ignoring case? */
+static int prefix_ci(p, end, s)
+char *p, *end, *s;
+{
+    for (; *s; p++, s++)
+        if (p >= end || tolower(*p) != tolower(*s))
+            return 0;
+    return 1;
+}
+
+/* Find header name in the request; returns its value or NULL */
+static char *header(c, end, name)
+struct conn *c;
+char *end, *name;
+{
+    char *p;
+
+    for (p = c->c_in; p < end; p++)
+        if (*p == '\n' && prefix_ci(p + 1, end, name)) {
+            p += 1 + strlen(name);
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            return p;
+        }
+    return NULL;
+}
+
+/* Does the value at v, up to the end of its line, contain token? */
+static int value_has(v, end, token)
+char *v, *end, *token;
+{
+    for (; v && v < end && *v != '\r' && *v != '\n'; v++)
+        if (prefix_ci(v, end, token))
+            return 1;
+    return 0;
+}
+
+/* Queue a response with no body */
+static void reply_empty(c, status)
+struct conn *c;
+char *status;
+{
+    sprintf(c->c_out, "%s\r\nContent-Length: 0\r\n%s\r\n", status,
+            c->c_close ? "Connection: close\r\n" : "");
+    c->c_outpos = 0;
+    c->c_outlen = strlen(c->c_out);
+}
+
+#ifdef CGI_BIN
+/*
+ * Run a CGI program on the connection, as inetd mode does: its stdin
+ * and stdout are the socket.  The connection is the child's from here
+ * on; reap() logs how it exited.
+ */
+static void run_cgi(c, path)
+struct conn *c;
+char *path;
+{
+    int pid, fl;
+
+    fl = fcntl(c->c_fd, F_GETFL, 0);
+    fcntl(c->c_fd, F_SETFL, fl & ~O_NONBLOCK);
+    if (!(pid = vfork())) {
+        /* Child process */
+        dup2(c->c_fd, 0);
+        dup2(c->c_fd, 1);
+        execve(path, NULL, NULL);
+        write(1, HTTP_500, strlen(HTTP_500));
+        write(1, "\r\n", 2);
+        _exit(1);
+    }
+    if (pid < 0) {
+        fcntl(c->c_fd, F_SETFL, fl);
+        fprintf(htlog, "500 %s\n", strerror(errno));
+        c->c_close = 1;
+        reply_empty(c, HTTP_500);
+        return;
+    }
+    fprintf(htlog, "CGI pid %d\n", pid);
+    conn_close(c);
+}
+
+/* Log how finished CGI programs exited */
+static void reap()
+{
+    int pid;
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__linux__) || defined(__APPLE__)
+    int status;
+#else
+    union wait status;
+#endif
+
+    while ((pid = wait3(&status, WNOHANG, NULL)) > 0) {
+        if (WIFEXITED(status))
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__linux__) || defined(__APPLE__)
+            fprintf(htlog, "CGI pid %d exited with status %d\n", pid,
+                    WEXITSTATUS(status));
+#else
+            fprintf(htlog, "CGI pid %d exited with status %d\n", pid,
+                    status.w_retcode);
+#endif
+        else if (WIFSIGNALED(status))
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__linux__) || defined(__APPLE__)
+            fprintf(htlog, "CGI pid %d terminated with signal %d\n", pid,
+                    WTERMSIG(status));
+#else
+            fprintf(htlog, "CGI pid %d terminated with signal %d\n", pid,
+                    status.w_termsig);
+#endif
+    }
+}
+#endif /* CGI_BIN */
+
+/*
+ * Fill the rest of c_out behind the headers from the file, so a small
+ * file goes out with its headers in one write
+ */
+static void prefill(c)
+struct conn *c;
+{
+    int n;
+
+    if (c->c_left <= 0 || c->c_outlen >= OUT_SIZE)
+        return;
+    n = OUT_SIZE - c->c_outlen;
+    if (n > c->c_left)
+        n = c->c_left;
+    n = fc_read(c->c_fe, c->c_off, c->c_out + c->c_outlen, n);
+    if (n > 0) {
+        c->c_outlen += n;
+        c->c_off += n;
+        c->c_left -= n;
+    }
+}
+
+/*
+ * Answer the request whose headers end at c_in + len: log it, check the
+ * path and queue the response.
+ */
+static void handle_request(c, len)
+struct conn *c;
+int len;
+{
+    char line[PATH_LEN], path[PATH_LEN];
+    char *end, *method, *uri, *version, *v, *status, *keep;
+    struct fentry *fe;
+    struct stat st;
+    int n, head;
+
+    end = c->c_in + len;
+    n = strcspn(c->c_in, "\r\n");
+    if (n >= sizeof(line))
+        n = sizeof(line) - 1;
+    strncpy(line, c->c_in, n);
+    line[n] = '\0';
+    fprintf(htlog, "%s [%s] \"%s\" ", c->c_host, log_time(), line);
+
+    method = strtok(line, " ");
+    uri = strtok(NULL, " ");
+    version = strtok(NULL, " ");
+
+    /* Keep-alive is the default from HTTP/1.1 on */
+    v = header(c, end, "connection:");
+    if (version && strcmp(version, "HTTP/1.0") != 0 && version[0] != '\0')
+        c->c_close = value_has(v, end, "close");
+    else
+        c->c_close = !value_has(v, end, "keep-alive");
+
+    /* A body is not read, but must not be taken for the next request */
+    v = header(c, end, "content-length:");
+    c->c_skip = v ? atol(v) : 0;
+
+    if (!method || !uri || (strcmp(method, "GET") && strcmp(method, "POST") &&
+                            strcmp(method, "HEAD"))) {
+        fprintf(htlog, "400 Bad request\n");
+        c->c_close = 1;
+        reply_empty(c, HTTP_400);
+        return;
+    }
+    head = !strcmp(method, "HEAD");
+
+    /* Path starts with the web root */
+    strncpy(path, www_root, sizeof(path));
+    path[sizeof(path) - 1] = '\0';
+    strncat(path, uri, sizeof(path)-strlen(path)-1);
+    status = check_path(path, sizeof(path), &st);
+    if (status) {
+        reply_empty(c, status);
+        return;
+    }
+
+#ifdef CGI_BIN
+    switch (cgi_path(path, &st)) {
+    case -1:
+        reply_empty(c, HTTP_403);
+        return;
+    case 1:
+        run_cgi(c, path);
+        return;
+    }
+#endif
+
+    fe = fc_get(path, &st);
+    if (!fe) {
+        reply_empty(c, HTTP_500);
+        return;
+    }
+    keep = c->c_close ? "Connection: close\r\n" :
+           version && !strcmp(version, "HTTP/1.0") ?
+           "Connection: keep-alive\r\n" : "";
+
+    /* If-None-Match wins over If-Modified-Since when both are sent */
+    v = header(c, end, "if-none-match:");
+    if (v ? value_has(v, end, fe->fe_etag) :
+        (v = header(c, end, "if-modified-since:")) &&
+        prefix_ci(v, end, fe->fe_date)) {
+        fprintf(htlog, "304\n");
+        sprintf(c->c_out, "%s\r\nETag: %s\r\n%s\r\n", HTTP_304,
+                fe->fe_etag, keep);
+        c->c_outpos = 0;
+        c->c_outlen = strlen(c->c_out);
+        fc_release(fe);
+        return;
+    }
+
+    fprintf(htlog, "200 %ld\n", fe->fe_size);
+    sprintf(c->c_out, "%s\r\n%s%s\r\n", HTTP_200, fe->fe_head, keep);
+    c->c_outpos = 0;
+    c->c_outlen = strlen(c->c_out);
+    c->c_fe = fe;
+    c->c_off = 0;
+    c->c_left = head ? 0 : fe->fe_size;    /* HEAD: headers only */
+    prefill(c);
+}
+
+/* Handle whole requests in c_in while no response is being written */
+static void process(c)
+struct conn *c;
+{
+    int i, end;
+
+    while (c->c_fd >= 0 && !sending(c)) {
+        if (c->c_fe) {
+            fc_release(c->c_fe);
+            c->c_fe = NULL;
+        }
+        if (c->c_close) {
+            conn_close(c);
+            return;
+        }
+
+        /* Drop the body of the request just answered */
+        i = c->c_skip < c->c_inlen ? c->c_skip : c->c_inlen;
+        c->c_skip -= i;
+        c->c_inlen -= i;
+        bcopy(c->c_in + i, c->c_in, c->c_inlen);
+        if (c->c_skip > 0)
+            return;
+
+        /* Headers end with an empty line */
+        end = 0;
+        for (i = 0; i < c->c_inlen && !end; i++)
+            if (c->c_in[i] == '\n') {
+                if (i + 1 < c->c_inlen && c->c_in[i + 1] == '\n')
+                    end = i + 2;
+                else if (i + 2 < c->c_inlen && c->c_in[i + 1] == '\r' &&
+                         c->c_in[i + 2] == '\n')
+                    end = i + 3;
+            }
+        if (!end) {
+            if (c->c_inlen == sizeof(c->c_in)) {
+                fprintf(htlog, "%s [%s] 400 Request too long\n", c->c_host,
+                        log_time());
+                c->c_close = 1;
+                reply_empty(c, HTTP_400);
+            }
+            return;
+        }
+        handle_request(c, end);
+        c->c_inlen -= end;
+        bcopy(c->c_in + end, c->c_in, c->c_inlen);
+    }
+}
+
+/*
+ * Write what the socket will take of the response: the headers in c_out,
+ * then the file, straight from the cache's descriptor with sendfile() or
+ * by refilling c_out from it.
+ */
+static void pump(c)
+struct conn *c;
+{
+#ifdef HAVE_SENDFILE
+    off_t off;
+#endif
+    long n;
+
+    while (sending(c)) {
+        if (c->c_outpos < c->c_outlen)
+            n = write(c->c_fd, c->c_out + c->c_outpos,
+                      c->c_outlen - c->c_outpos);
+        else {
+#ifdef HAVE_SENDFILE
+            off = c->c_off;
+            n = sendfile(c->c_fd, c->c_fe->fe_fd, &off, c->c_left);
+            if (n > 0) {
+                c->c_off += n;
+                c->c_left -= n;
+                continue;
+            }
+#else
+            n = fc_read(c->c_fe, c->c_off, c->c_out,
+                        c->c_left < OUT_SIZE ? (int)c->c_left : OUT_SIZE);
+            if (n > 0) {
+                c->c_outpos = 0;
+                c->c_outlen = n;
+                c->c_off += n;
+                c->c_left -= n;
+                continue;
+            }
+#endif
+            if (n == 0) {
+                /* File shrank; the length sent can't be honoured */
+                conn_close(c);
+                return;
+            }
+        }
+        if (n < 0) {
+            if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)
+                conn_close(c);
+            return;
+        }
+        c->c_outpos += n;
+    }
+    process(c);
+}
+
+/* Take one waiting connection; returns 0 when there are none */
+static int accept_conn(lsock)
+int lsock;
+{
+    struct sockaddr_in sin;
+    struct conn *c;
+    int fd, len, i;
+
+    len = sizeof(sin);
+    fd = accept(lsock, (struct sockaddr *)&sin, &len);
+    if (fd < 0)
+        return 0;
+    for (i = 0; i < MAX_CONNS && conns[i].c_fd >= 0; i++)
+        ;
+    if (i == MAX_CONNS || fd >= FD_SETSIZE) {
+        close(fd);
+        return 0;
+    }
+    c = &conns[i];
+    /* Everything but the two buffers at the end */
+    bzero((char *)c, sizeof(*c) - sizeof(c->c_in) - sizeof(c->c_out));
+    c->c_fd = fd;
+    c->c_last = time((time_t *)0);
+    strncpy(c->c_host, inet_ntoa(sin.sin_addr), sizeof(c->c_host) - 1);
+    set_flag(fd, F_SETFL, F_GETFL, O_NONBLOCK);
+    set_flag(fd, F_SETFD, F_GETFD, 1);
+#ifdef TCP_NODELAY
+    /* The last piece of a response mustn't wait for the previous ACK */
+    i = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&i, sizeof(i));
+#endif
+    return 1;
+}
+
+int standalone(port, logfile)
+int port;
+char *logfile;
+{
+    struct sockaddr_in sin;
+    struct timeval tv;
+    struct conn *c;
+    fd_set rfds, wfds;
+    long now, flushed;
+    int lsock, maxfd, nfree, i, n, r, on;
+
+    htlog = fopen(logfile, "a");
+    if (!htlog) {
+        perror(logfile);
+        return 1;
+    }
+    set_flag(fileno(htlog), F_SETFD, F_GETFD, 1);
+
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    if (lsock < 0) {
+        perror("socket");
+        return 1;
+    }
+    on = 1;
+    setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+    bzero((char *)&sin, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = INADDR_ANY;
+    sin.sin_port = htons(port);
+    if (bind(lsock, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+        listen(lsock, LISTEN_BACKLOG) < 0) {
+        perror("bind");
+        return 1;
+    }
+    set_flag(lsock, F_SETFL, F_GETFL, O_NONBLOCK);
+    set_flag(lsock, F_SETFD, F_GETFD, 1);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, on_stop);
+    signal(SIGINT, on_stop);
+    for (i = 0; i < MAX_CONNS; i++)
+        conns[i].c_fd = -1;
+    fc_init();
+    flushed = time((time_t *)0);
+
+    while (!stopping) {
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        maxfd = lsock;
+        nfree = 0;
+        for (i = 0; i < MAX_CONNS; i++) {
+            c = &conns[i];
+            if (c->c_fd < 0) {
+                nfree++;
+                continue;
+            }
+            if (sending(c))
+                FD_SET(c->c_fd, &wfds);
+            else
+                FD_SET(c->c_fd, &rfds);
+            if (c->c_fd > maxfd)
+                maxfd = c->c_fd;
+        }
+        if (nfree > 0)
+            FD_SET(lsock, &rfds);
+
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        n = select(maxfd + 1, &rfds, &wfds, NULL, &tv);
+        if (n < 0 && errno != EINTR) {
+            perror("select");
+            break;
+        }
+        now = time((time_t *)0);
+
+        if (n > 0 && FD_ISSET(lsock, &rfds))
+            while (accept_conn(lsock))
+                ;
+        for (i = 0; n > 0 && i < MAX_CONNS; i++) {
+            c = &conns[i];
+            if (c->c_fd < 0)
+                continue;
+            if (FD_ISSET(c->c_fd, &rfds)) {
+                r = read(c->c_fd, c->c_in + c->c_inlen,
+                         sizeof(c->c_in) - c->c_inlen);
+                if (r == 0 || (r < 0 && errno != EWOULDBLOCK &&
+                               errno != EAGAIN && errno != EINTR)) {
+                    conn_close(c);
+                } else if (r > 0) {
+                    c->c_inlen += r;
+                    c->c_last = now;
+                    process(c);
+                    if (c->c_fd >= 0 && sending(c))
+                        pump(c);
+                }
+            } else if (FD_ISSET(c->c_fd, &wfds)) {
+                c->c_last = now;
+                pump(c);
+            }
+        }
+
+        for (i = 0; i < MAX_CONNS; i++)
+            if (conns[i].c_fd >= 0 && now - conns[i].c_last > IDLE_SECS)
+                conn_close(&conns[i]);
+#ifdef CGI_BIN
+        reap();
+#endif
+        if (now != flushed) {
+            fflush(htlog);
+            flushed = now;
+        }
+    }
+
+    for (i = 0; i < MAX_CONNS; i++)
+        if (conns[i].c_fd >= 0)
+            conn_close(&conns[i]);
+    close(lsock);
+    fprintf(htlog, "File cache: %ld hits, %ld misses\n", fc_hits, fc_misses);
+    fclose(htlog);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * brokerstub.c - Just enough of an MQTT broker to test mqtt against
+ *
+ * Accepts one client at a time, answers CONNECT with CONNACK and PINGREQ
+ * with PINGRESP, and prints every PUBLISH.  When a connection ends it
+ * reports how many packets came in how many reads, which shows whether
+ * the client is coalescing its writes.  With -c it drops each connection
+ * after that many PUBLISH packets, to exercise reconnecting.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DEFAULT_PORT 1883
+#define STUB_BUFSIZE 8192
+
+static char *packet_names[16] = {
+    "reserved", "CONNECT", "CONNACK", "PUBLISH", "PUBACK", "PUBREC",
+    "PUBREL", "PUBCOMP", "SUBSCRIBE", "SUBACK", "UNSUBSCRIBE", "UNSUBACK",
+    "PINGREQ", "PINGRESP", "DISCONNECT", "reserved"
+};
+
+/*
+ * Function to decode the fixed header at p.  Returns the header length
+ * and sets *remaining, or 0 if more bytes are needed.
+ */
+int decode_header(unsigned char *p, int n, long *remaining) {
+    long mult = 1;
+    int i;
+
+    *remaining = 0;
+    for (i = 1; i < n && i <= 4; i++) {
+        *remaining += (p[i] & 127) * mult;
+        mult *= 128;
+        if (!(p[i] & 128)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Function to handle one packet.  Returns 1 to keep the connection, 0
+ * to close it.
+ */
+int handle_packet(int sock, unsigned char *p, int hdr, long len,
+                  long *publishes, long limit) {
+    static unsigned char connack[4] = { 0x20, 0x02, 0x00, 0x00 };
+    static unsigned char pingresp[2] = { 0xD0, 0x00 };
+    unsigned char *body = p + hdr;
+    int type = p[0] >> 4;
+    int tlen;
+
+    switch (type) {
+        case 1:     /* CONNECT: protocol name, level, flags, keep alive, id */
+            if (len >= 12) {
+                tlen = body[10] << 8 | body[11];
+                printf("CONNECT keepalive %d client %.*s\n",
+                       body[8] << 8 | body[9], tlen <= len - 12 ? tlen : 0,
+                       (char *)body + 12);
+            }
+            send(sock, connack, sizeof(connack), 0);
+            return 1;
+        case 3:
+            tlen = len >= 2 ? body[0] << 8 | body[1] : 0;
+            if (tlen + 2 > len) {
+                printf("PUBLISH malformed\n");
+                return 0;
+            }
+            printf("PUBLISH %.*s = %.*s\n", tlen, (char *)body + 2,
+                   (int)(len - 2 - tlen), (char *)body + 2 + tlen);
+            (*publishes)++;
+            if (limit > 0 && *publishes % limit == 0) {
+                printf("Dropping the connection after %ld PUBLISH\n", limit);
+                return 0;
+            }
+            return 1;
+        case 12:
+            printf("PINGREQ\n");
+            send(sock, pingresp, sizeof(pingresp), 0);
+            return 1;
+        case 14:
+            printf("DISCONNECT\n");
+            return 0;
+        default:
+            printf("%s ignored\n", packet_names[type]);
+            return 1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static unsigned char buffer[STUB_BUFSIZE];
+    struct sockaddr_in addr;
+    int port = DEFAULT_PORT;
+    long limit = 0;
+    long publishes = 0;
+    long reads, packets, remaining;
+    int listener, sock, opt, n, have, hdr, open;
+    extern char *optarg;
+
+    while ((opt = getopt(argc, argv, "P:c:")) != EOF) {
+        switch (opt) {
+            case 'P':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                limit = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-P port] [-c publishes]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    opt = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (char *)&opt, sizeof(opt));
+    memset((char *)&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listener, 5) < 0) {
+        perror("ERROR binding");
+        exit(1);
+    }
+    printf("Broker stub listening on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+
+    for (;;) {
+        sock = accept(listener, NULL, NULL);
+        if (sock < 0) {
+            perror("ERROR accepting");
+            continue;
+        }
+        reads = packets = 0;
+        have = 0;
+        open = 1;
+        while (open && (n = recv(sock, buffer + have, sizeof(buffer) - have, 0)) > 0) {
+            reads++;
+            have += n;
+            /* Handle every complete packet, keep any partial one */
+            while (open && (hdr = decode_header(buffer, have, &remaining)) > 0 &&
+                   hdr + remaining <= have) {
+                packets++;
+                open = handle_packet(sock, buffer, hdr, remaining,
+                                     &publishes, limit);
+                have -= hdr + remaining;
+                memmove(buffer, buffer + hdr + remaining, have);
+            }
+            if (have == sizeof(buffer)) {
+                printf("Packet too large\n");
+                open = 0;
+            }
+            fflush(stdout);
+        }
+        close(sock);
+        printf("Connection closed: %ld packets in %ld reads\n", packets, reads);
+        fflush(stdout);
+    }
+}
@@ -4,6 +4,12 @@
  * Implements MQTT CONNECT with Username and Password Authentication
  * Parses command-line options using getopt()
  * Parses command-line options using getopt()
+ *
+ * With -d seconds it runs as a daemon instead of publishing one value:
+ * one broker connection is kept open, the statistics system.sh used to
+ * collect with vmstat, awk and bc are read in-process (sysmetrics.c),
+ * and each tick's topics, under the -t prefix, go out in a single write.
+ * brokerstub.c is a local broker to try it against.
  */
 
 #include <stdio.h>
@@ -21,13 +27,20 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>  /* For inet_addr */
+#include <sys/time.h>   /* For select() in daemon mode */
+#include <signal.h>
 
 /* Define default MQTT broker details */
 #define DEFAULT_HOSTNAME "localhost"
 #define DEFAULT_PORT     1883
 #define DEFAULT_TOPIC    "pdp11/cpu_usage"
 #define DEFAULT_VALUE    "42.5%"
+#define DEFAULT_PREFIX   "pdp11"
 #define CLIENT_ID        "pdp11"
+#define DAEMON_BUFSIZE   2048   /* One tick's PUBLISH packets */
+
+/* Keep Alive sent in CONNECT; the daemon pings when idle this long / 2 */
+int keep_alive = 60;
 
 /* Function prototypes */
 int connect_to_broker(char *broker_ip, int port);
@@ -35,12 +48,19 @@ int send_mqtt_connect(int sock, char *username, char *password);
 int send_mqtt_connect(int sock, char *username, char *password);
 int receive_connack(int sock);
 int publish_message(int sock, char *topic, char *message);
+int build_publish(uint8_t *buffer, char *topic, char *message);
+int run_daemon(char *hostname, int port, char *username, char *password,
+               char *prefix, int interval);
 int send_disconnect(int sock);
 int encode_remaining_length(int length, unsigned char *buffer);
 int send_all(int sock, unsigned char *buffer, int length);
 int NumberOfUsers(void);
 int CPUUsage(void);
 
+#include "sysmetrics.c"
+
+#define USAGE "Usage: %s [-h hostname] [-P port] [-u username] [-p password] [-t topic] [-v value] [-d seconds] [-k seconds]\n"
+
 /* Custom memmove implementation if bcopy is unavailable */
 #ifndef HAVE_BCOPY
 #ifndef HAVE_BCOPY
@@ -64,8 +84,10 @@ int main(int argc, char *argv[]) {
     char *hostname;
     char *username = "";
     char *password = "";
-    char *topic = DEFAULT_TOPIC;
+    char *topic = NULL;
     char *value = DEFAULT_VALUE;
+    int port = DEFAULT_PORT;
+    int interval = 0;
     int rc;
     int opt;
     extern char *optarg;
@@ -73,7 +95,7 @@ int main(int argc, char *argv[]) {
 
     /* Check if no arguments are provided */
     if (argc == 1) {
-        fprintf(stderr, "Usage: %s [-h hostname] [-u username] [-p password] [-t topic] [-v value]\n", argv[0]);
+        fprintf(stderr, USAGE, argv[0]);
         exit(1);
     }
 
@@ -81,11 +103,14 @@ int main(int argc, char *argv[]) {
     hostname = DEFAULT_HOSTNAME;
 
     /* Parse command-line options */
-    while ((opt = getopt(argc, argv, "h:u:p:t:v:")) != EOF) {
+    while ((opt = getopt(argc, argv, "h:P:u:p:t:v:d:k:")) != EOF) {
         switch (opt) {
             case 'h':
                 hostname = optarg;
                 break;
+            case 'P':
+                port = atoi(optarg);
+                break;
             case 'u':
                 username = optarg;
                 break;
@@ -98,8 +123,14 @@ int main(int argc, char *argv[]) {
             case 'v':
                 value = optarg;
                 break;
+            case 'd':
+                interval = atoi(optarg);
+                break;
+            case 'k':
+                keep_alive = atoi(optarg);
+                break;
             default:
-                fprintf(stderr, "Usage: %s [-h hostname] [-u username] [-p password] [-t topic] [-v value]\n", argv[0]);
+                fprintf(stderr, USAGE, argv[0]);
                 exit(1);
         }
     }
@@ -107,13 +138,25 @@ int main(int argc, char *argv[]) {
     /* Ensure mandatory arguments are provided */
     if (username[0] == '\0' || password[0] == '\0') {
         fprintf(stderr, "Error: Username and password are required.\n");
-        fprintf(stderr, "Usage: %s [-h hostname] [-u username] [-p password] [-t topic] [-v value]\n", argv[0]);
+        fprintf(stderr, USAGE, argv[0]);
         exit(1);
     }
+    if (interval < 0 || keep_alive < 2) {
+        fprintf(stderr, USAGE, argv[0]);
+        exit(1);
+    }
+
+    /* Daemon mode: -t is the topic prefix, metrics are gathered here */
+    if (interval > 0) {
+        return run_daemon(hostname, port, username, password,
+                          topic != NULL ? topic : DEFAULT_PREFIX, interval);
+    }
+    if (topic == NULL) {
+        topic = DEFAULT_TOPIC;
+    }
 
     /* Connect to MQTT broker */
-    sock = connect_to_broker(hostname, DEFAULT_PORT);
-    sock = connect_to_broker(hostname, DEFAULT_PORT);
+    sock = connect_to_broker(hostname, port);
     if (sock < 0) {
         fprintf(stderr, "Failed to connect to MQTT broker.\n");
         exit(1);
@@ -182,9 +225,14 @@ int connect_to_broker(char *broker_ip, int port) {
     /* Convert IP address from string to binary */
     serv_addr.sin_addr.s_addr = inet_addr(broker_ip);
     if (serv_addr.sin_addr.s_addr == INADDR_NONE) {
-        fprintf(stderr, "ERROR, invalid IP address: %s\n", broker_ip);
-        close(sockfd);
-        return -1;
+        /* Try to resolve hostname */
+        server = gethostbyname(broker_ip);
+        if (server == NULL) {
+            fprintf(stderr, "ERROR, invalid IP address: %s\n", broker_ip);
+            close(sockfd);
+            return -1;
+        }
+        memcpy(&serv_addr.sin_addr, server->h_addr, server->h_length);
     }
 
     /* Connect to the broker */
@@ -288,9 +336,8 @@ int send_mqtt_connect(int sock, char * USERNAME, char * PASSWORD) {
         connect_packet[index++] = connect_flags;
     }
 
-    /* Keep Alive */
+    /* Keep Alive, in seconds */
     {
-        uint16_t keep_alive = 60; /* seconds */
         connect_packet[index++] = (keep_alive >> 8) & 0xFF;
         connect_packet[index++] = keep_alive & 0xFF;
     }
@@ -393,57 +440,50 @@ int receive_connack(int sock) {
 }
 
 /*
- * Function to publish a message to a specified MQTT topic.
+ * Function to build a QoS 0 PUBLISH packet in buffer.
+ * Returns its length; buffer must hold the topic and message plus 7.
  */
-int publish_message(int sock, char *topic, char *message) {
-    uint8_t publish_packet[512];
+int build_publish(uint8_t *buffer, char *topic, char *message) {
     int index;
+    int topic_length = strlen(topic);
+    int payload_length = strlen(message);
     int remaining_length;
-    uint8_t remaining_length_encoded[4];
-    int rl_len;
 
-    /* Initialize index */
-    index = 0;
+    /* Fixed Header: PUBLISH with QoS 0, then the Remaining Length */
+    buffer[0] = 0x30;
+    remaining_length = 2 + topic_length + payload_length;
+    index = 1 + encode_remaining_length(remaining_length, &buffer[1]);
 
-    /* Fixed Header: PUBLISH packet type and flags */
-    publish_packet[index++] = 0x30; /* PUBLISH with QoS 0 */
+    /* Variable Header: Topic Name */
+    buffer[index++] = (topic_length >> 8) & 0xFF;
+    buffer[index++] = topic_length & 0xFF;
+    memcpy(&buffer[index], topic, topic_length);
+    index += topic_length;
 
-    /* Variable Header and Payload preparation */
+    /* Payload */
+    memcpy(&buffer[index], message, payload_length);
+    index += payload_length;
 
-    /* Topic Name */
-    {
-        int topic_length = strlen(topic);
-        publish_packet[index++] = (topic_length >> 8) & 0xFF;
-        publish_packet[index++] = topic_length & 0xFF;
-        memcpy(&publish_packet[index], topic, topic_length);
-        index += topic_length;
-    }
+    return index;
+}
 
-    /* Payload */
-    {
-        char *payload = message;
-        int payload_length = strlen(payload);
-        memcpy(&publish_packet[index], payload, payload_length);
-        index += payload_length;
-    }
+/*
+ * Function to publish a message to a specified MQTT topic.
+ */
+int publish_message(int sock, char *topic, char *message) {
+    uint8_t publish_packet[512];
+    int total_length;
 
-    /* Calculate Remaining Length */
-    remaining_length = (strlen(topic) + strlen(message));
-    rl_len = encode_remaining_length(remaining_length, remaining_length_encoded);
+    if (strlen(topic) + strlen(message) + 7 > sizeof(publish_packet)) {
+        fprintf(stderr, "Topic and message too long.\n");
+        return -1;
+    }
+    total_length = build_publish(publish_packet, topic, message);
 
-    /* Shift the variable header and payload to make room for the remaining length */
-    /* Use bcopy instead of memmove */
-    bcopy(&publish_packet[1], &publish_packet[1 + rl_len], remaining_length);
-    /* Insert the encoded Remaining Length */
-    bcopy(remaining_length_encoded, &publish_packet[1], rl_len);
-    /* Update the total length */
-    {
-        int total_length = 1 + rl_len + remaining_length;
-        /* Send the PUBLISH packet */
-        if (send_all(sock, publish_packet, total_length) != 0) {
-            fprintf(stderr, "Failed to send MQTT PUBLISH packet.\n");
-            return -1;
-        }
+    /* Send the PUBLISH packet */
+    if (send_all(sock, publish_packet, total_length) != 0) {
+        fprintf(stderr, "Failed to send MQTT PUBLISH packet.\n");
+        return -1;
     }
 
     printf("Sent MQTT PUBLISH packet.\n");
@@ -469,6 +509,170 @@ int send_disconnect(int sock) {
     return 0;
 }
 
+/* Daemon mode: one tick's PUBLISH packets, sent with a single write */
+static uint8_t daemon_buf[DAEMON_BUFSIZE];
+static int daemon_len;
+static char *daemon_prefix;
+
+/*
+ * metrics_each() callback: append a PUBLISH of value to prefix/name.
+ */
+int queue_publish(char *name, char *value) {
+    char topic[128];
+
+    if (strlen(daemon_prefix) + strlen(name) + 2 > sizeof(topic)) {
+        return -1;
+    }
+    sprintf(topic, "%s/%s", daemon_prefix, name);
+    if (daemon_len + strlen(topic) + strlen(value) + 7 > DAEMON_BUFSIZE) {
+        fprintf(stderr, "No room for %s this tick.\n", topic);
+        return -1;
+    }
+    daemon_len += build_publish(&daemon_buf[daemon_len], topic, value);
+    return 0;
+}
+
+/*
+ * Function to read what the broker sent.  At QoS 0 only PINGRESP is
+ * expected; *pong is set if one arrived.  Returns -1 if the connection
+ * was closed.
+ */
+int read_broker(int sock, int *pong) {
+    uint8_t buffer[256];
+    int n;
+    int i;
+
+    n = recv(sock, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+        return -1;
+    }
+    for (i = 0; i + 1 < n; i += 2 + buffer[i + 1]) {
+        if (buffer[i] == 0xD0) {
+            *pong = 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Function to open a connection and log in.  Returns the socket or -1.
+ */
+int daemon_connect(char *hostname, int port, char *username, char *password) {
+    int sock;
+
+    sock = connect_to_broker(hostname, port);
+    if (sock < 0) {
+        return -1;
+    }
+    if (send_mqtt_connect(sock, username, password) != 0 ||
+        receive_connack(sock) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/*
+ * Function to publish system metrics every interval seconds over one
+ * connection.  Every metric of a tick goes out in a single write.  If
+ * nothing has been sent for half the Keep Alive a PINGREQ is sent; if
+ * its PINGRESP doesn't come within another half, or the connection
+ * fails, the daemon reconnects.  Runs until killed.
+ */
+int run_daemon(char *hostname, int port, char *username, char *password,
+               char *prefix, int interval) {
+    uint8_t pingreq[2];
+    struct timeval tv;
+    fd_set fds;
+    long now, next, last_send, ping_sent, wait;
+    int sock = -1;
+    int announced = 0;
+    int pong;
+    int n;
+
+    signal(SIGPIPE, SIG_IGN);
+    pingreq[0] = 0xC0; /* PINGREQ packet type */
+    pingreq[1] = 0x00; /* Remaining Length */
+    daemon_prefix = prefix;
+    metrics_open();
+    metrics_sample();
+    next = time((long *)0) + interval;
+    last_send = ping_sent = 0;
+
+    for (;;) {
+        if (sock < 0) {
+            sock = daemon_connect(hostname, port, username, password);
+            if (sock < 0) {
+                sleep(interval);
+                continue;
+            }
+            last_send = time((long *)0);
+            ping_sent = 0;
+        }
+
+        now = time((long *)0);
+        if (now >= next) {
+            metrics_sample();
+            daemon_len = 0;
+            n = metrics_each(queue_publish);
+            if (send_all(sock, daemon_buf, daemon_len) != 0) {
+                close(sock);
+                sock = -1;
+                continue;
+            }
+            if (!announced) {
+                announced = 1;
+                printf("Publishing %d topics under %s/ every %d seconds.\n",
+                       n, prefix, interval);
+                fflush(stdout);
+            }
+            last_send = now;
+            next += interval;
+            if (next <= now) {
+                next = now + interval;  /* Fell behind; don't catch up */
+            }
+            continue;
+        }
+        if (ping_sent != 0 && now - ping_sent >= keep_alive / 2) {
+            fprintf(stderr, "No PINGRESP from broker, reconnecting.\n");
+            close(sock);
+            sock = -1;
+            continue;
+        }
+        if (ping_sent == 0 && now - last_send >= keep_alive / 2) {
+            if (send_all(sock, pingreq, 2) != 0) {
+                close(sock);
+                sock = -1;
+                continue;
+            }
+            ping_sent = last_send = now;
+        }
+
+        /* Sleep until the next tick or ping, or until the broker speaks */
+        wait = next - now;
+        if (ping_sent != 0 && ping_sent + keep_alive / 2 - now < wait) {
+            wait = ping_sent + keep_alive / 2 - now;
+        }
+        if (ping_sent == 0 && last_send + keep_alive / 2 - now < wait) {
+            wait = last_send + keep_alive / 2 - now;
+        }
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        tv.tv_sec = wait > 0 ? wait : 0;
+        tv.tv_usec = 0;
+        if (select(sock + 1, &fds, NULL, NULL, &tv) > 0) {
+            pong = 0;
+            if (read_broker(sock, &pong) < 0) {
+                fprintf(stderr, "Broker closed the connection.\n");
+                close(sock);
+                sock = -1;
+            } else if (pong) {
+                ping_sent = 0;
+            }
+        }
+    }
+}
+
 /*
  * Dummy function to retrieve CPU usage.
  * This should be implemented to fetch actual CPU usage.
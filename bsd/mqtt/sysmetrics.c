@@ -0,0 +1,236 @@
+/*
+ * sysmetrics.c - System statistics gathered in-process for "mqtt -d"
+ *
+ * On 2.11BSD the counters vmstat prints are read straight from
+ * /dev/kmem: cp_time for CPU ticks by state, dk_xfer for disk transfers
+ * and total for memory, located once through ksym.c.  Logged in users
+ * are counted from utmp.  Elsewhere CPU ticks come from /proc/stat if it
+ * exists, so the daemon can be tried against brokerstub on any Unix.
+ * Rates cover the interval since the previous sample rather than the
+ * time since boot that "vmstat | tail -1" reported.
+ * Included by mqtt.c.
+ */
+
+#ifndef SYSMETRICS_C
+#define SYSMETRICS_C
+
+#include <fcntl.h>
+#include <time.h>
+#include <utmp.h>
+
+#include "../socket/arch/211BSD/ksym.c"
+
+#ifdef __pdp11__
+#include <sys/param.h>
+#include <sys/dk.h>
+#include <sys/vmmeter.h>
+#else
+#define CPUSTATES 4
+#define CP_USER 0
+#define CP_NICE 1
+#define CP_SYS 2
+#define CP_IDLE 3
+#endif
+
+#ifndef _PATH_UTMP
+#define _PATH_UTMP "/etc/utmp"
+#endif
+
+#define MAX_DISKS 4             /* Drives published, r0 to r3 */
+
+struct sample {
+    long sa_time;               /* time() when taken */
+    long sa_cpu[CPUSTATES];     /* Ticks in each CPU state */
+    long sa_xfer[MAX_DISKS];    /* Transfers per drive */
+    long sa_avm;                /* Active virtual memory, KB */
+    long sa_free;               /* Free memory, KB */
+};
+
+static struct sample sample_prev, sample_cur;
+static int have_cpu, ndisks, have_mem;
+static int kmem = -1;
+static long nl_cp_time = -1, nl_dk_xfer = -1, nl_total = -1;
+
+static int kread(addr, buf, len)
+long addr;
+char *buf;
+int len;
+{
+    if (kmem < 0 || addr < 0) {
+        return -1;
+    }
+    if (lseek(kmem, (off_t)addr, 0) < 0 || read(kmem, buf, len) != len) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Look up the kernel counters once and keep /dev/kmem open.  Missing
+ * counters are simply not published.
+ */
+void metrics_open()
+{
+    kmem = open("/dev/kmem", O_RDONLY);
+    if (kmem >= 0) {
+        nl_cp_time = ksym_lookup("cp_time");
+        nl_dk_xfer = ksym_lookup("dk_xfer");
+        nl_total = ksym_lookup("total");
+    }
+    have_cpu = nl_cp_time >= 0;
+#ifdef DK_NDRIVE
+    if (nl_dk_xfer >= 0) {
+        ndisks = DK_NDRIVE < MAX_DISKS ? DK_NDRIVE : MAX_DISKS;
+    }
+#endif
+    have_mem = nl_total >= 0;
+#ifndef __pdp11__
+    if (!have_cpu) {
+        have_cpu = access("/proc/stat", 0) == 0;
+    }
+#endif
+}
+
+/* Read the counters into s; anything that can't be read is left alone */
+static void take_sample(s)
+struct sample *s;
+{
+#ifdef __pdp11__
+    struct vmtotal total;
+#else
+    FILE *fp;
+    long v[5];
+#endif
+
+    s->sa_time = time((long *)0);
+    kread(nl_cp_time, (char *)s->sa_cpu, sizeof(s->sa_cpu));
+    if (ndisks > 0) {
+        kread(nl_dk_xfer, (char *)s->sa_xfer, ndisks * sizeof(long));
+    }
+#ifdef __pdp11__
+    if (kread(nl_total, (char *)&total, sizeof(total)) == 0) {
+        s->sa_avm = ctob((long)total.t_avm) / 1024;
+        s->sa_free = ctob((long)total.t_free) / 1024;
+    }
+#else
+    if (nl_cp_time < 0 && (fp = fopen("/proc/stat", "r")) != NULL) {
+        if (fscanf(fp, "cpu %ld %ld %ld %ld %ld",
+                   &v[0], &v[1], &v[2], &v[3], &v[4]) == 5) {
+            s->sa_cpu[CP_USER] = v[0];
+            s->sa_cpu[CP_NICE] = v[1];
+            s->sa_cpu[CP_SYS] = v[2];
+            s->sa_cpu[CP_IDLE] = v[3] + v[4];   /* iowait counts as idle */
+        }
+        fclose(fp);
+    }
+#endif
+}
+
+/* Take a new sample; the previous one becomes the base for rates */
+void metrics_sample()
+{
+    sample_prev = sample_cur;
+    take_sample(&sample_cur);
+}
+
+/* Tenths of a percent of CPU ticks spent in state since the last sample */
+static long cpu_permille(state)
+int state;
+{
+    long d, all;
+    int i;
+
+    all = 0;
+    for (i = 0; i < CPUSTATES; i++) {
+        all += sample_cur.sa_cpu[i] - sample_prev.sa_cpu[i];
+    }
+    if (all <= 0) {
+        return 0;
+    }
+    if (state < 0) {
+        d = all - (sample_cur.sa_cpu[CP_IDLE] - sample_prev.sa_cpu[CP_IDLE]);
+    } else {
+        d = sample_cur.sa_cpu[state] - sample_prev.sa_cpu[state];
+    }
+    return (d * 1000L + all / 2) / all;
+}
+
+/* Percent of the CPU busy between the last two samples */
+int CPUUsage()
+{
+    return (int)((cpu_permille(-1) + 5) / 10);
+}
+
+/* Number of users logged in, from utmp */
+int NumberOfUsers()
+{
+    struct utmp ut;
+    FILE *fp;
+    int n;
+
+    if ((fp = fopen(_PATH_UTMP, "r")) == NULL) {
+        return 0;
+    }
+    n = 0;
+    while (fread((char *)&ut, sizeof(ut), 1, fp) == 1) {
+#ifdef USER_PROCESS
+        if (ut.ut_type != USER_PROCESS) {
+            continue;
+        }
+#endif
+        if (ut.ut_name[0] != '\0') {
+            n++;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+/* Format tenths as "12.3" */
+static char *tenths(buf, v)
+char *buf;
+long v;
+{
+    sprintf(buf, "%s%ld.%ld", v < 0 ? "-" : "", (v < 0 ? -v : v) / 10,
+            (v < 0 ? -v : v) % 10);
+    return buf;
+}
+
+/*
+ * Call fn(name, value) for each statistic of the latest sample, with the
+ * topic names system.sh used.  Returns the number reported.
+ */
+int metrics_each(fn)
+int (*fn)();
+{
+    char name[32], value[32];
+    long secs;
+    int i, n;
+
+    n = 0;
+    if (have_cpu) {
+        fn("cpu_usage", tenths(value, cpu_permille(-1)));
+        fn("cpu_usage_user",
+           tenths(value, cpu_permille(CP_USER) + cpu_permille(CP_NICE)));
+        fn("cpu_usage_system", tenths(value, cpu_permille(CP_SYS)));
+        fn("cpu_usage_idle", tenths(value, cpu_permille(CP_IDLE)));
+        n += 4;
+    }
+    if (have_mem) {
+        fn("virtual_memory", tenths(value, sample_cur.sa_avm * 10));
+        fn("free_memory", tenths(value, sample_cur.sa_free * 10));
+        n += 2;
+    }
+    secs = sample_cur.sa_time - sample_prev.sa_time;
+    for (i = 0; i < ndisks && secs > 0; i++) {
+        sprintf(name, "disk_activity_r%d", i);
+        fn(name, tenths(value, (sample_cur.sa_xfer[i] -
+                                sample_prev.sa_xfer[i]) * 10 / secs));
+        n++;
+    }
+    sprintf(value, "%d", NumberOfUsers());
+    fn("users", value);
+    return n + 1;
+}
+
+#endif /* SYSMETRICS_C */
@@ -9,11 +9,18 @@
 #include "pdp11_compat.h"
 #include "buffer.h"
 #include "terminal.h"
+#include "undo.h"
 
 #define MAXNAME 255
 #define MAXCOLS 160
 #define CTRL(c) ((c) & 037)
 
+#define EDIT_OTHER  0
+#define EDIT_TYPE   1
+#define EDIT_RUBOUT 2
+#define EDIT_DELETE 3
+#define EDIT_CUT    4
+
 struct editor {
 	struct buffer text;
 	char name[MAXNAME + 1];
@@ -25,6 +32,8 @@ struct editor {
 	int cutfd;
 	int cutappend;
 	int overwrite;
+	struct undo undo;
+	int lastkind;
 	char message[MAXCOLS + 1];
 };
 
@@ -53,6 +62,7 @@ die(int sig)
 	buf_close(&E.text);
 	if (E.cutfd >= 0)
 		(void)close(E.cutfd);
+	undo_close(&E.undo);
 	if (sig)
 		_exit(1);
 }
@@ -286,9 +296,9 @@ refresh(void)
 	put_padded(E.message, 1);
 	if (E.rows > 6) {
 		term_move(body + 2, 0);
-		put_padded("^G Help  ^O Write Out  ^W Where Is  ^K Cut  ^U Uncut", 0);
+		put_padded("^G Help  ^O Write Out  ^W Where Is  ^K Cut  ^U Uncut  ^Z Undo", 0);
 		term_move(body + 3, 0);
-		put_padded("^X Exit  ^R Read  ^Y PgUp  ^V PgDn  ^A Home  ^E End  Ins Mode", 0);
+		put_padded("^X Exit  ^R Read  ^Y PgUp  ^V PgDn  ^A Home  ^E End  Ins Mode  ^T Redo", 0);
 	}
 	ccol = visual_col(&E.text, cur) - E.hscroll;
 	if (ccol < 0)
@@ -381,6 +391,46 @@ page_move(int down)
 	E.top = p;
 }
 
+/*
+ * All changes to the text go through these so that each one is also
+ * recorded in the undo journal.
+ */
+static int
+edit_insert(int ch)
+{
+	off_t p;
+
+	p = buf_pos(&E.text);
+	if (buf_insert(&E.text, ch) < 0)
+		return -1;
+	(void)undo_record(&E.undo, UNDO_INSERT, p, ch);
+	return 0;
+}
+
+static int
+edit_delete(void)
+{
+	off_t p;
+	int ch;
+
+	p = buf_pos(&E.text);
+	ch = buf_delete(&E.text);
+	if (ch >= 0)
+		(void)undo_record(&E.undo, UNDO_DELETE, p, ch);
+	return ch;
+}
+
+static int
+edit_backspace(void)
+{
+	int ch;
+
+	ch = buf_backspace(&E.text);
+	if (ch >= 0)
+		(void)undo_record(&E.undo, UNDO_RUBOUT, buf_pos(&E.text), ch);
+	return ch;
+}
+
 static void
 type_character(int ch)
 {
@@ -390,8 +440,8 @@ type_character(int ch)
 	p = buf_pos(&E.text);
 	replace = E.overwrite && p < buf_size(&E.text) &&
 	    buf_get(&E.text, p) != '\n';
-	if (buf_insert(&E.text, ch) == 0 && replace)
-		(void)buf_delete(&E.text);
+	if (edit_insert(ch) == 0 && replace)
+		(void)edit_delete();
 }
 
 static void
@@ -433,7 +483,7 @@ do_read(void)
 	}
 	while ((n = read(fd, block, sizeof block)) > 0) {
 		for (i = 0; i < n; ++i) {
-			if (buf_insert(&E.text, (unsigned char)block[i]) < 0)
+			if (edit_insert((unsigned char)block[i]) < 0)
 				break;
 		}
 		if (i != n)
@@ -514,7 +564,7 @@ do_cut(void)
 	} else
 		(void)lseek(E.cutfd, (off_t)0, L_XTND);
 	any = 0;
-	while ((ch = buf_delete(&E.text)) >= 0) {
+	while ((ch = edit_delete()) >= 0) {
 		c = (unsigned char)ch;
 		(void)write(E.cutfd, (char *)&c, 1);
 		any = 1;
@@ -535,11 +585,27 @@ do_uncut(void)
 	(void)lseek(E.cutfd, (off_t)0, L_SET);
 	while ((n = read(E.cutfd, block, sizeof block)) > 0) {
 		for (i = 0; i < n; ++i)
-			(void)buf_insert(&E.text, (unsigned char)block[i]);
+			(void)edit_insert((unsigned char)block[i]);
 	}
 	message("Uncut text");
 }
 
+static void
+do_undo(int redo)
+{
+	int n;
+
+	n = redo ? undo_redo(&E.undo, &E.text) :
+	    undo_undo(&E.undo, &E.text);
+	if (n < 0)
+		message("Undo journal error; history discarded");
+	else if (n == 0)
+		message(redo ? "Nothing to redo" : "Nothing to undo");
+	else
+		message(redo ? "Redid edit" : "Undid edit");
+	E.wanted = -1;
+}
+
 static void
 help(void)
 {
@@ -553,10 +619,10 @@ help(void)
 	lines[3] = "Ins toggles insert/overwrite mode    ^D/Del delete";
 	lines[4] = "^A/^E home/end     ^R insert file   ^W search";
 	lines[5] = "^O write file      ^K cut line      ^U uncut";
-	lines[6] = "^C position        ^X exit";
-	lines[7] = "Files are edited through disk scratch space, not held in RAM.";
-	lines[8] = "Press any key to return.";
-	lines[9] = "";
+	lines[6] = "^Z undo            ^T redo";
+	lines[7] = "^C position        ^X exit";
+	lines[8] = "Files are edited through disk scratch space, not held in RAM.";
+	lines[9] = "Press any key to return.";
 	lines[10] = "";
 	lines[11] = "";
 	body = E.rows < 12 ? E.rows : 12;
@@ -589,10 +655,30 @@ confirm_exit(void)
 	return 0;
 }
 
+/*
+ * Consecutive keys of the same kind form one undo group, so a run of
+ * typing or a series of ^K cuts is undone in one step.
+ */
+static int
+edit_kind(int key)
+{
+	if (key == '\r' || key == '\n' || key == '\t' ||
+	    (key >= 32 && key < 256 && key != 127))
+		return EDIT_TYPE;
+	if (key == 127 || key == CTRL('H'))
+		return EDIT_RUBOUT;
+	if (key == KEY_DELETE || key == CTRL('D'))
+		return EDIT_DELETE;
+	if (key == CTRL('K'))
+		return EDIT_CUT;
+	return EDIT_OTHER;
+}
+
 static void
 edit_loop(void)
 {
 	int key;
+	int kind;
 
 	for (;;) {
 		refresh();
@@ -601,6 +687,10 @@ edit_loop(void)
 			return;
 		if (key != CTRL('K'))
 			E.cutappend = 0;
+		kind = edit_kind(key);
+		if (kind == EDIT_OTHER || kind != E.lastkind)
+			undo_mark(&E.undo);
+		E.lastkind = kind;
 		if (key == CTRL('X')) {
 			if (confirm_exit())
 				return;
@@ -618,6 +708,10 @@ edit_loop(void)
 			do_cut();
 		} else if (key == CTRL('U')) {
 			do_uncut();
+		} else if (key == CTRL('Z')) {
+			do_undo(0);
+		} else if (key == CTRL('T')) {
+			do_undo(1);
 		} else if (key == KEY_LEFT || key == CTRL('B')) {
 			(void)buf_left(&E.text);
 			E.wanted = -1;
@@ -642,13 +736,13 @@ edit_loop(void)
 			E.overwrite = !E.overwrite;
 			message(E.overwrite ? "Overwrite mode" : "Insert mode");
 		} else if (key == KEY_DELETE || key == CTRL('D')) {
-			(void)buf_delete(&E.text);
+			(void)edit_delete();
 			E.wanted = -1;
 		} else if (key == 127 || key == CTRL('H')) {
-			(void)buf_backspace(&E.text);
+			(void)edit_backspace();
 			E.wanted = -1;
 		} else if (key == '\r' || key == '\n') {
-			(void)buf_insert(&E.text, '\n');
+			(void)edit_insert('\n');
 			E.wanted = -1;
 		} else if (key == '\t' || (key >= 32 && key < 256)) {
 			type_character(key);
@@ -679,6 +773,7 @@ main(int argc, char **argv)
 	(void)memset((char *)&E, 0, sizeof E);
 	E.text.left = E.text.right = -1;
 	E.cutfd = -1;
+	E.undo.fd = -1;
 	E.wanted = -1;
 	if (strlen(name) > MAXNAME) {
 		(void)fprintf(stderr, "novi: file name too long\n");
@@ -692,7 +787,7 @@ main(int argc, char **argv)
 		return 1;
 	}
 	E.cutfd = make_cutfile();
-	if (E.cutfd < 0 || term_open() < 0) {
+	if (E.cutfd < 0 || undo_open(&E.undo) < 0 || term_open() < 0) {
 		(void)fprintf(stderr, "novi: cannot initialize terminal or scratch file\n");
 		die(0);
 		return 1;
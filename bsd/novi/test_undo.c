@@ -0,0 +1,153 @@
+#include <sys/types.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pdp11_compat.h"
+#include "buffer.h"
+#include "undo.h"
+
+#define RUN_SIZE 1000L
+
+static struct buffer b;
+static struct undo u;
+
+static void
+fail(char *s)
+{
+	(void)fprintf(stderr, "test_undo: %s\n", s);
+	exit(1);
+}
+
+static void
+expect(char *want, char *what)
+{
+	off_t i;
+	off_t n;
+
+	n = strlen(want);
+	if (buf_size(&b) != n)
+		fail(what);
+	for (i = 0; i < n; ++i) {
+		if (buf_get(&b, i) != (unsigned char)want[i])
+			fail(what);
+	}
+}
+
+static void
+type(char *s)
+{
+	while (*s) {
+		if (undo_record(&u, UNDO_INSERT, buf_pos(&b), *s) < 0 ||
+		    buf_insert(&b, *s) < 0)
+			fail("type");
+		++s;
+	}
+}
+
+static void
+rubout(int n)
+{
+	int ch;
+
+	while (n-- > 0) {
+		ch = buf_backspace(&b);
+		if (ch < 0 || undo_record(&u, UNDO_RUBOUT, buf_pos(&b), ch) < 0)
+			fail("rubout");
+	}
+}
+
+static void
+delete(int n)
+{
+	off_t p;
+	int ch;
+
+	while (n-- > 0) {
+		p = buf_pos(&b);
+		ch = buf_delete(&b);
+		if (ch < 0 || undo_record(&u, UNDO_DELETE, p, ch) < 0)
+			fail("delete");
+	}
+}
+
+int
+main(void)
+{
+	off_t journal;
+	long i;
+
+	b.left = b.right = -1;
+	if (buf_open(&b, "") < 0 || undo_open(&u) < 0)
+		fail("open");
+	if (undo_undo(&u, &b) != 0 || undo_redo(&u, &b) != 0)
+		fail("empty journal");
+
+	undo_mark(&u);
+	type("hello world");
+	journal = u.len;
+	undo_mark(&u);
+	rubout(5);
+	expect("hello ", "rubout");
+	undo_mark(&u);
+	type("there");
+	expect("hello there", "retype");
+	if (u.len - journal != 4 * sizeof(struct undo_rec) + 10)
+		fail("typed runs were not coalesced");
+
+	if (buf_seek(&b, (off_t)0) < 0)
+		fail("seek");
+	undo_mark(&u);
+	delete(6);
+	expect("there", "delete");
+
+	if (undo_undo(&u, &b) != 1)
+		fail("undo delete");
+	expect("hello there", "undo delete");
+	if (buf_pos(&b) != 0)
+		fail("cursor after undo delete");
+	if (undo_undo(&u, &b) != 1)
+		fail("undo retype");
+	expect("hello ", "undo retype");
+	if (undo_undo(&u, &b) != 1)
+		fail("undo rubout");
+	expect("hello world", "undo rubout");
+	if (buf_pos(&b) != 11)
+		fail("cursor after undo rubout");
+	if (undo_redo(&u, &b) != 1)
+		fail("redo rubout");
+	expect("hello ", "redo rubout");
+	if (undo_redo(&u, &b) != 1 || undo_redo(&u, &b) != 1)
+		fail("redo");
+	expect("there", "redo all");
+	if (undo_redo(&u, &b) != 0)
+		fail("redo past end");
+
+	if (undo_undo(&u, &b) != 1)
+		fail("undo before new edit");
+	if (buf_seek(&b, buf_size(&b)) < 0)
+		fail("seek end");
+	undo_mark(&u);
+	type("!");
+	if (undo_redo(&u, &b) != 0)
+		fail("new edit kept redo history");
+	expect("hello there!", "new edit");
+
+	undo_mark(&u);
+	for (i = 0; i < RUN_SIZE; ++i) {
+		if (undo_record(&u, UNDO_INSERT, buf_pos(&b), 'a' + i % 26) < 0 ||
+		    buf_insert(&b, 'a' + i % 26) < 0)
+			fail("long run");
+	}
+	if (undo_undo(&u, &b) != 1)
+		fail("undo long run");
+	expect("hello there!", "undo long run");
+	while (undo_undo(&u, &b) == 1)
+		;
+	expect("", "undo everything");
+	undo_close(&u);
+	buf_close(&b);
+	(void)printf("undo tests passed\n");
+	return 0;
+}
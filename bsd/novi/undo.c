@@ -0,0 +1,275 @@
+#include <sys/types.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pdp11_compat.h"
+#include "buffer.h"
+#include "undo.h"
+
+/*
+ * The journal lives in an unlinked scratch file and only ever grows at
+ * its end, except that recording a new edit discards the redo records
+ * beyond the current undo point.  Only the top record is kept in memory,
+ * so undo depth is limited by disk space rather than by RAM.
+ */
+
+#define HDR ((off_t)sizeof(struct undo_rec))
+
+static int
+scratch(void)
+{
+	char path[32];
+	int fd;
+
+	(void)strcpy(path, "/tmp/noviundoXXXXXX");
+	fd = mkstemp(path);
+	if (fd >= 0)
+		(void)unlink(path);
+	return fd;
+}
+
+static int
+getrec(int fd, off_t at, struct undo_rec *r)
+{
+	if (lseek(fd, at, L_SET) < 0)
+		return -1;
+	return read(fd, (char *)r, sizeof *r) == sizeof *r ? 0 : -1;
+}
+
+static int
+putat(int fd, off_t at, char *s, int n)
+{
+	if (lseek(fd, at, L_SET) < 0)
+		return -1;
+	return write(fd, s, n) == n ? 0 : -1;
+}
+
+/*
+ * A journal that failed to record an edit no longer matches the text,
+ * so drop the whole history rather than undo to the wrong place.
+ */
+static int
+forget(struct undo *u)
+{
+	(void)ftruncate(u->fd, (off_t)0);
+	u->end = u->len = 0;
+	u->open = 0;
+	return -1;
+}
+
+int
+undo_open(struct undo *u)
+{
+	u->fd = scratch();
+	u->end = u->len = 0;
+	u->group = 0;
+	u->open = 0;
+	u->topoff = 0;
+	return u->fd < 0 ? -1 : 0;
+}
+
+void
+undo_close(struct undo *u)
+{
+	if (u->fd >= 0)
+		(void)close(u->fd);
+	u->fd = -1;
+}
+
+void
+undo_mark(struct undo *u)
+{
+	++u->group;
+	u->open = 0;
+}
+
+static int
+extends(struct undo *u, int op, off_t pos)
+{
+	struct undo_rec *r;
+
+	r = &u->top;
+	if (!u->open || r->group != u->group || r->op != op)
+		return 0;
+	if (op == UNDO_INSERT)
+		return pos == r->pos + r->len;
+	if (op == UNDO_DELETE)
+		return pos == r->pos;
+	return pos == r->pos - 1;
+}
+
+/*
+ * Record one byte inserted at pos, deleted at pos, or rubbed out so that
+ * the cursor is now at pos.  A byte that continues the top record in the
+ * same group is folded into it instead of starting a new record.
+ */
+int
+undo_record(struct undo *u, int op, off_t pos, int ch)
+{
+	char rec[2 * sizeof(struct undo_rec) + 1];
+	struct undo_rec *r;
+	off_t at;
+
+	if (u->fd < 0)
+		return -1;
+	if (u->end != u->len) {
+		if (ftruncate(u->fd, u->end) < 0)
+			return forget(u);
+		u->len = u->end;
+		u->open = 0;
+	}
+	r = &u->top;
+	if (extends(u, op, pos)) {
+		if (op == UNDO_RUBOUT)
+			r->pos = pos;
+		++r->len;
+		at = u->len - HDR;
+		rec[0] = (char)ch;
+		(void)memcpy(rec + 1, (char *)r, sizeof *r);
+		if (putat(u->fd, at, rec, 1 + (int)HDR) < 0 ||
+		    putat(u->fd, u->topoff, (char *)r, (int)HDR) < 0)
+			return forget(u);
+		u->len = u->end = at + 1 + HDR;
+		return 0;
+	}
+	r->pos = pos;
+	r->len = 1;
+	r->group = u->group;
+	r->op = op;
+	(void)memcpy(rec, (char *)r, sizeof *r);
+	rec[HDR] = (char)ch;
+	(void)memcpy(rec + HDR + 1, (char *)r, sizeof *r);
+	if (putat(u->fd, u->len, rec, (int)sizeof rec) < 0)
+		return forget(u);
+	u->topoff = u->len;
+	u->len = u->end = u->len + sizeof rec;
+	u->open = 1;
+	return 0;
+}
+
+static int
+replay(int fd, off_t data, off_t len, int reverse, struct buffer *b)
+{
+	unsigned char block[BUF_CACHE];
+	off_t done;
+	int n;
+	int i;
+
+	done = 0;
+	while (done < len) {
+		n = len - done > BUF_CACHE ? BUF_CACHE : (int)(len - done);
+		if (lseek(fd, reverse ? data + len - done - n : data + done,
+		    L_SET) < 0 || read(fd, (char *)block, n) != n)
+			return -1;
+		for (i = 0; i < n; ++i) {
+			if (buf_insert(b, block[reverse ? n - 1 - i : i]) < 0)
+				return -1;
+		}
+		done += n;
+	}
+	return 0;
+}
+
+static int
+discard(struct buffer *b, off_t len, int back)
+{
+	while (len-- > 0) {
+		if ((back ? buf_backspace(b) : buf_delete(b)) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int
+revert(struct undo *u, struct undo_rec *r, off_t data, struct buffer *b)
+{
+	if (buf_seek(b, r->pos) < 0)
+		return -1;
+	if (r->op == UNDO_INSERT)
+		return discard(b, r->len, 0);
+	if (r->op == UNDO_RUBOUT)
+		return replay(u->fd, data, r->len, 1, b);
+	if (replay(u->fd, data, r->len, 0, b) < 0)
+		return -1;
+	return buf_seek(b, r->pos);
+}
+
+static int
+apply(struct undo *u, struct undo_rec *r, off_t data, struct buffer *b)
+{
+	if (r->op == UNDO_RUBOUT) {
+		if (buf_seek(b, r->pos + r->len) < 0)
+			return -1;
+		return discard(b, r->len, 1);
+	}
+	if (buf_seek(b, r->pos) < 0)
+		return -1;
+	if (r->op == UNDO_DELETE)
+		return discard(b, r->len, 0);
+	return replay(u->fd, data, r->len, 0, b);
+}
+
+/*
+ * Undo the most recent group of records.  Returns 1 if anything was
+ * undone, 0 if the journal is exhausted, and -1 on error.
+ */
+int
+undo_undo(struct undo *u, struct buffer *b)
+{
+	struct undo_rec r;
+	off_t data;
+	long group;
+	int any;
+
+	if (u->fd < 0)
+		return -1;
+	undo_mark(u);
+	group = 0;
+	any = 0;
+	while (u->end > 0) {
+		if (getrec(u->fd, u->end - HDR, &r) < 0)
+			return forget(u);
+		if (any && r.group != group)
+			break;
+		group = r.group;
+		data = u->end - HDR - r.len;
+		if (revert(u, &r, data, b) < 0)
+			return forget(u);
+		u->end = data - HDR;
+		any = 1;
+	}
+	return any;
+}
+
+/*
+ * Redo the group that follows the current undo point.
+ */
+int
+undo_redo(struct undo *u, struct buffer *b)
+{
+	struct undo_rec r;
+	off_t data;
+	long group;
+	int any;
+
+	if (u->fd < 0)
+		return -1;
+	undo_mark(u);
+	group = 0;
+	any = 0;
+	while (u->end < u->len) {
+		if (getrec(u->fd, u->end, &r) < 0)
+			return forget(u);
+		if (any && r.group != group)
+			break;
+		group = r.group;
+		data = u->end + HDR;
+		if (apply(u, &r, data, b) < 0)
+			return forget(u);
+		u->end = data + r.len + HDR;
+		any = 1;
+	}
+	return any;
+}
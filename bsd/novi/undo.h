@@ -0,0 +1,39 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <sys/types.h>
+#include "buffer.h"
+
+#define UNDO_INSERT 1
+#define UNDO_DELETE 2
+#define UNDO_RUBOUT 3
+
+/*
+ * Each journal record is a header, the affected bytes, and a copy of the
+ * header as a trailer so the journal can be walked in either direction.
+ */
+struct undo_rec {
+	off_t pos;
+	off_t len;
+	long group;
+	int op;
+};
+
+struct undo {
+	int fd;
+	off_t end;
+	off_t len;
+	long group;
+	int open;
+	off_t topoff;
+	struct undo_rec top;
+};
+
+int undo_open(struct undo *u);
+void undo_close(struct undo *u);
+void undo_mark(struct undo *u);
+int undo_record(struct undo *u, int op, off_t pos, int ch);
+int undo_undo(struct undo *u, struct buffer *b);
+int undo_redo(struct undo *u, struct buffer *b);
+
+#endif
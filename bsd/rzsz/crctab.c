@@ -137,4 +137,107 @@ unsigned long c;
 #define UPDC32(b, c) (cr3tab[((int)c ^ b) & 0xff] ^ ((c >> 8) & 0x00FFFFFF))
 #endif
 
+/*
+ * Block CRC entry points: updcrcblk() and updc32blk() fold len bytes
+ *  of buf into crc exactly as len calls of updcrc() or UPDC32() would.
+ *
+ *  On machines with room for them, eight derived tables per CRC let
+ *  the loop consume eight bytes per step ("slicing by 8").  For the
+ *  16 bit CRC, which feeds data into the low byte, slice16[k][v] is
+ *  v * x^(8*(k+2)) mod P; for the reflected 32 bit CRC, slice32[k][v]
+ *  is the CRC of v followed by k zero bytes.  The 12K or more of tables
+ *  would not fit a PDP-11's data space, so there we keep the classic
+ *  one byte at a time loop.  Define NOSLICE to force it elsewhere.
+ */
+#ifndef pdp11
+#ifndef NOSLICE
+#define SLICE8
+#endif
+#endif
+
+#ifdef SLICE8
+static unsigned short slice16[8][256];
+static unsigned long slice32[8][256];
+static int slicedone = 0;
+
+static void
+sliceinit()
+{
+	register int k, v;
+	register unsigned long c;
+
+	for (v = 0; v < 256; ++v) {
+		slice16[0][v] = crctab[v];
+		slice32[0][v] = cr3tab[v];
+	}
+	for (k = 1; k < 8; ++k) {
+		for (v = 0; v < 256; ++v) {
+			c = slice16[k-1][v];
+			slice16[k][v] = crctab[(c >> 8) & 255] ^ ((c << 8) & 0xFFFF);
+			c = slice32[k-1][v];
+			slice32[k][v] = cr3tab[c & 0xff] ^ ((c >> 8) & 0x00FFFFFF);
+		}
+	}
+	slicedone = 1;
+}
+#endif
+
+unsigned short
+updcrcblk(buf, len, crc)
+char *buf;
+register int len;
+unsigned short crc;
+{
+	register unsigned char *p;
+	register unsigned c;
+
+	p = (unsigned char *)buf;  c = crc;
+#ifdef SLICE8
+	if (!slicedone)
+		sliceinit();
+	for (; len >= 8; len -= 8, p += 8) {
+		c = slice16[7][(c >> 8) & 255] ^ slice16[6][c & 255]
+		  ^ slice16[5][p[0]] ^ slice16[4][p[1]] ^ slice16[3][p[2]]
+		  ^ slice16[2][p[3]] ^ slice16[1][p[4]] ^ slice16[0][p[5]]
+		  ^ (p[6] << 8) ^ p[7];
+	}
+#endif
+	while (--len >= 0) {
+		c = updcrc(*p, c) & 0xFFFF;  ++p;
+	}
+	return c;
+}
+
+unsigned long
+updc32blk(buf, len, crc)
+char *buf;
+register int len;
+register unsigned long crc;
+{
+	register unsigned char *p;
+#ifdef SLICE8
+	register unsigned long lo, hi;
+#endif
+
+	p = (unsigned char *)buf;
+#ifdef SLICE8
+	if (!slicedone)
+		sliceinit();
+	for (; len >= 8; len -= 8, p += 8) {
+		lo = (crc ^ (p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16)
+		  | ((unsigned long)p[3] << 24))) & 0xFFFFFFFFL;
+		hi = p[4] | (p[5] << 8) | ((unsigned long)p[6] << 16)
+		  | ((unsigned long)p[7] << 24);
+		crc = slice32[7][lo & 0xff] ^ slice32[6][(lo >> 8) & 0xff]
+		  ^ slice32[5][(lo >> 16) & 0xff] ^ slice32[4][lo >> 24]
+		  ^ slice32[3][hi & 0xff] ^ slice32[2][(hi >> 8) & 0xff]
+		  ^ slice32[1][(hi >> 16) & 0xff] ^ slice32[0][hi >> 24];
+	}
+#endif
+	while (--len >= 0) {
+		crc = UPDC32(*p, crc);  ++p;
+	}
+	return crc;
+}
+
 /* End of crctab.c */
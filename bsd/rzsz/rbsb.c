@@ -44,9 +44,11 @@ long Locbit = LLITOUT;	/* Bit SUPPOSED to disable output translations */
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 #define STAT
 #include <termios.h>
 #define OS "POSIX"
+#define SELREAD		/* readline() times out with select(), not alarm() */
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -86,15 +88,19 @@ Howmany must be 255 or less
 char *Nametty;
 FILE *Ttystream;
 int Tty;
-char linbuf[HOWMANY];
+#ifndef LINBUFSIZE
+#define LINBUFSIZE HOWMANY
+#endif
+char linbuf[LINBUFSIZE];
 char xXbuf[BUFSIZ];
 int Lleft=0;		/* number of characters in linbuf */
+char *cdq;		/* pointer for removing chars from linbuf */
 jmp_buf tohere;		/* For the interrupt on RX timeout */
 #ifdef ONEREAD
 /* Sorry, Regulus and some others don't work right in raw mode! */
 int Readnum = 1;	/* Number of bytes to ask for in read() from modem */
 #else
-int Readnum = HOWMANY;	/* Number of bytes to ask for in read() from modem */
+int Readnum = LINBUFSIZE;	/* Number of bytes to ask for in read() from modem */
 #endif
 int Verbose=0;
 
@@ -427,6 +433,43 @@ flushmo()
 	fflush(Ttystream);
 }
 
+/*
+ * How many characters to ask read(2) for.  ONEREAD systems get more
+ *  than one only when FIONREAD says they are already queued.
+ */
+rdcount()
+{
+#ifdef ONEREAD
+#ifdef FIONREAD
+	int queued = 0;
+
+	if (Readnum == 1 && ioctl(Tty, FIONREAD, &queued) == 0 && queued > 1)
+		return (queued > LINBUFSIZE ? LINBUFSIZE : queued);
+#endif
+#endif
+	return Readnum;
+}
+
+#ifdef SELREAD
+/*
+ * Wait up to secs seconds for input from the modem.  Returns non 0
+ *  if there is something to read.
+ */
+rdwait(secs)
+{
+	fd_set rfds;
+	struct timeval tv;
+	int n;
+
+	do {
+		FD_ZERO(&rfds);  FD_SET(Tty, &rfds);
+		tv.tv_sec = secs;  tv.tv_usec = 0;
+		n = select(Tty+1, &rfds, (fd_set *)0, (fd_set *)0, &tv);
+	} while (n < 0 && errno == EINTR);
+	return (n > 0);
+}
+#endif
+
 /*
  * This version of readline is reasoably well suited for
  * reading many characters.
@@ -442,7 +485,6 @@ readline(timeout)
 int timeout;
 {
 	register n;
-	static char *cdq;	/* pointer for removing chars from linbuf */
 
 	if (--Lleft >= 0) {
 		if (Verbose > 8) {
@@ -456,6 +498,17 @@ int timeout;
 	if (Verbose > 5)
 		fprintf(stderr, "Calling read: alarm=%d  Readnum=%d ",
 		  n, Readnum);
+#ifdef SELREAD
+	/* Two system calls a read instead of five with setjmp and alarm */
+	if ( !rdwait(n)) {
+		Lleft = 0;
+		if (Verbose>1)
+			fprintf(stderr, "Readline:TIMEOUT\n");
+		return TIMEOUT;
+	}
+	errno = 0;
+	Lleft=read(Tty, cdq=linbuf, rdcount());
+#else
 	if (setjmp(tohere)) {
 #ifdef TIOCFLUSH
 /*		ioctl(Tty, TIOCFLUSH, 0); */
@@ -467,8 +520,9 @@ int timeout;
 	}
 	signal(SIGALRM, alrm); alarm(n);
 	errno = 0;
-	Lleft=read(Tty, cdq=linbuf, Readnum);
+	Lleft=read(Tty, cdq=linbuf, rdcount());
 	alarm(0);
+#endif
 	if (Verbose > 5) {
 		fprintf(stderr, "Read returned %d bytes errno=%d\n",
 		  Lleft, errno);
@@ -91,6 +91,20 @@ extern int errno;
 #define HOWMANY 96
 #endif
 
+/*
+ * Where memory allows, let one read(2) take up to LINBUFSIZE characters
+ *  (HOWMANY only sets VMIN then) and give file data to stdio in
+ *  FOUTBUFSIZE blocks.
+ */
+#ifdef POSIX
+#ifndef pdp11
+#ifndef LINBUFSIZE
+#define LINBUFSIZE 16384
+#endif
+#define FOUTBUFSIZE 32768
+#endif
+#endif
+
 /* Ward Christensen / CP/M parameters - Don't change these! */
 #define ENQ 005
 #define CAN ('X'&037)
@@ -157,11 +171,57 @@ int Rxbinary=FALSE;	/* receive all files in bin mode */
 int Rxascii=FALSE;	/* receive files in ascii (translate) mode */
 int Blklen;		/* record length of received packets */
 
+/*
+ * Longest data subpacket accepted.  Above 1024 (ZMAXSP8K) we say so
+ *  with CANSP8K in ZRINIT; only sz -F makes use of it.
+ */
 #ifdef SEGMENTS
+#define RXSPLEN 1024
 int chinseg = 0;	/* Number of characters received in this data seg */
 char secbuf[1+(SEGMENTS+1)*1024];
 #else
-char secbuf[1025];
+#ifdef POSIX
+#ifndef pdp11
+#define RXSPLEN 8192
+#endif
+#endif
+#ifndef RXSPLEN
+#define RXSPLEN 1024
+#endif
+char secbuf[RXSPLEN+1];
+#endif
+
+/*
+ * Checkpoint journal.  While a binary file comes in, "file.rzj" holds
+ *  an offset the file is known to be on disk up to, the CRC-32 of those
+ *  bytes, and the length and date the sender gave for the file.  If the
+ *  transfer dies, the next offer of the same file starts at that offset
+ *  once the prefix on disk is found to match the CRC.
+ */
+#ifdef POSIX
+#define CKPOINT
+#endif
+#ifdef pdp11
+#define CKPOINT
+#endif
+#ifdef SEGMENTS
+#undef CKPOINT
+#endif
+
+#ifdef CKPOINT
+#ifdef pdp11
+#define CKPTLEN 32768L	/* Bytes between checkpoints */
+#else
+#define CKPTLEN 1048576L
+#endif
+#define CKSUFFIX ".rzj"
+char Ckname[PATHLEN+sizeof CKSUFFIX];
+int Ckon;		/* Journaling the current file */
+int Ckfd = -1;		/* Open journal, created at the first checkpoint */
+long Ckpos;		/* Offset of last checkpoint */
+unsigned long Ckcrc;	/* Running CRC-32 of the file so far */
+long Cklen;		/* File length from the sender */
+long Ckmtime;		/* File date from the sender */
 #endif
 
 
@@ -680,6 +740,16 @@ char *name;
 		if (zmanag==ZMPROT)
 			goto skipfile;
 		vfile("Current %s is %ld %lo", name, f.st_size, f.st_mtime);
+#ifdef CKPOINT
+		if (Thisbinary) {
+			switch (ckresume(name, f.st_size)) {
+			case OK:
+				return 0;
+			case ZFERR:		/* Our own partial copy is bad */
+				goto doopen;
+			}
+		}
+#endif
 		if (Thisbinary && zconv==ZCRESUM) {
 			rxbytes = f.st_size & ~511;
 			if (Bytesleft < rxbytes) {
@@ -688,7 +758,11 @@ char *name;
 				openit(name, "r+");
 			if ( !fout)
 				return ZFERR;
+#ifdef CKPOINT
+			if (ckscan(rxbytes) || fseek(fout, rxbytes, 0)) {
+#else
 			if (fseek(fout, rxbytes, 0)) {
+#endif
 				closeit();
 				return ZFERR;
 			}
@@ -723,18 +797,30 @@ doopen:
 #endif
 	if ( !fout)
 		return ZFERR;
+#ifdef CKPOINT
+	if (Thisbinary && fout != stdout && *openmode == 'w')
+		ckopen(name, 0L, 0xFFFFFFFFL);
+#endif
 	return 0;
 }
 
 openit(name, openmode)
 char *name, *openmode;
 {
+#ifdef FOUTBUFSIZE
+	static char foutbuf[FOUTBUFSIZE];
+#endif
+
 	if (strcmp(name, "-"))
 		fout = fopen(name, openmode);
 	else if (isatty(1))
 		fout = fopen("stdout", "a");
 	else
 		fout = stdout;
+#ifdef FOUTBUFSIZE
+	if (fout && fout != stdout)
+		setvbuf(fout, foutbuf, _IOFBF, FOUTBUFSIZE);
+#endif
 }
 
 #ifdef MD
@@ -845,24 +931,27 @@ putsec(buf, n)
 char *buf;
 register n;
 {
-	register char *p;
+	register char *p, *end;
+	char *run;
 
 	if (n == 0)
 		return OK;
 	if (Thisbinary) {
-		for (p=buf; --n>=0; )
-			putc( *p++, fout);
+		fwrite(buf, 1, n, fout);
 	}
 	else {
 		if (Eofseen)
 			return OK;
-		for (p=buf; --n>=0; ++p ) {
-			if ( *p == '\r')
-				continue;
-			if (*p == CPMEOF) {
+		/* Hand stdio each run between CRs in one call */
+		end = buf + n;
+		for (p = buf; p < end; ) {
+			for (run = p; p < end && *p != '\r' && *p != CPMEOF; ++p)
+				;
+			if (p > run)
+				fwrite(run, 1, p - run, fout);
+			if (p < end && *p++ == CPMEOF) {
 				Eofseen=TRUE; return OK;
 			}
-			putc(*p ,fout);
 		}
 	}
 	return OK;
@@ -998,6 +1087,9 @@ tryz()
 			Txhdr[ZF0] |= TESCCTL;
 		Txhdr[ZF0] |= CANRLE;
 		Txhdr[ZF1] = CANVHDR;
+#if RXSPLEN > ZMAXSPLEN
+		Txhdr[ZF1] |= CANSP8K;
+#endif
 		/* tryzhdrtype may == ZRINIT */
 		zshhdr(4,tryzhdrtype, Txhdr);
 		if (tryzhdrtype == ZSKIP)	/* Don't skip too far */
@@ -1227,7 +1319,7 @@ moredata:
 			}
 			switch (c = zrdata(secbuf+chinseg, 1024))
 #else
-			switch (c = zrdata(secbuf, 1024))
+			switch (c = zrdata(secbuf, RXSPLEN))
 #endif
 			{
 			case ZCAN:
@@ -1268,6 +1360,9 @@ moredata:
 				putsec(secbuf, Rxcount);
 #endif
 				rxbytes += Rxcount;
+#ifdef CKPOINT
+				ckdata(secbuf, Rxcount);
+#endif
 				stohdr(rxbytes);
 				sendline(XON);
 				zshhdr(4,ZACK, Txhdr);
@@ -1280,6 +1375,9 @@ moredata:
 				putsec(secbuf, Rxcount);
 #endif
 				rxbytes += Rxcount;
+#ifdef CKPOINT
+				ckdata(secbuf, Rxcount);
+#endif
 				stohdr(rxbytes);
 				zshhdr(4,ZACK, Txhdr);
 				goto moredata;
@@ -1291,6 +1389,9 @@ moredata:
 				putsec(secbuf, Rxcount);
 #endif
 				rxbytes += Rxcount;
+#ifdef CKPOINT
+				ckdata(secbuf, Rxcount);
+#endif
 				goto moredata;
 			case GOTCRCE:
 				n = 20;
@@ -1300,6 +1401,9 @@ moredata:
 				putsec(secbuf, Rxcount);
 #endif
 				rxbytes += Rxcount;
+#ifdef CKPOINT
+				ckdata(secbuf, Rxcount);
+#endif
 				goto nxthdr;
 			}
 		}
@@ -1321,6 +1425,9 @@ closeit()
 		fprintf(stderr, "File close ERROR\n");
 		return ERROR;
 	}
+#ifdef CKPOINT
+	ckclose();
+#endif
 	if (Modtime) {
 		timep[0] = time(NULL);
 		timep[1] = Modtime;
@@ -1337,6 +1444,137 @@ closeit()
 	return OK;
 }
 
+#ifdef CKPOINT
+/*
+ * Start journaling the file just opened on fout, rxbytes == pos
+ *  and crc the running CRC-32 of the bytes before it.
+ */
+ckopen(name, pos, crc)
+char *name;
+long pos;
+unsigned long crc;
+{
+	ckclose();
+	if (strlen(name) >= PATHLEN)
+		return;
+	sprintf(Ckname, "%s%s", name, CKSUFFIX);
+	Ckpos = pos;  Ckcrc = crc;
+	Cklen = Bytesleft;  Ckmtime = Modtime;
+	Ckon = TRUE;
+}
+
+/* Stop journaling; the file was closed through the protocol */
+ckclose()
+{
+	if ( !Ckon)
+		return;
+	if (Ckfd >= 0)
+		close(Ckfd);
+	Ckfd = -1;  Ckon = FALSE;
+	unlink(Ckname);
+}
+
+/*
+ * Account for n bytes of buf just passed to putsec(), rxbytes having
+ *  been advanced past them.  Every CKPTLEN bytes the file is forced to
+ *  disk and only then is the journal brought up to date.
+ */
+ckdata(buf, n)
+char *buf;
+{
+	char line[64];
+
+	if ( !Ckon || !Thisbinary || fout == stdout)
+		return;
+	Ckcrc = updc32blk(buf, n, Ckcrc);
+	if (rxbytes - Ckpos < CKPTLEN)
+		return;
+	if (fflush(fout) || fsync(fileno(fout)))
+		return;
+	if (Ckfd < 0 && (Ckfd = creat(Ckname, 0600)) < 0) {
+		vfile("Can't create %s errno=%d", Ckname, errno);
+		Ckon = FALSE;
+		return;
+	}
+	Ckpos = rxbytes;
+	sprintf(line, "%10ld %08lx %10ld %11lo\n", Ckpos, Ckcrc & 0xFFFFFFFFL,
+	  Cklen, Ckmtime);
+	if (lseek(Ckfd, 0L, 0) < 0 || write(Ckfd, line, strlen(line)) < 0)
+		vfile("Can't write %s errno=%d", Ckname, errno);
+}
+
+/*
+ * Run the CRC over the first pos bytes of fout, leaving it positioned
+ *  at pos and journaling from there.  Returns non 0 on a short read.
+ */
+ckscan(pos)
+long pos;
+{
+	char blk[1024];
+	unsigned long crc;
+	long left;
+	int n;
+
+	crc = 0xFFFFFFFFL;
+	rewind(fout);
+	for (left = pos; left > 0; left -= n) {
+		n = left < (long)sizeof blk ? (int)left : sizeof blk;
+		if (fread(blk, 1, n, fout) != n)
+			return ERROR;
+		crc = updc32blk(blk, n, crc);
+	}
+	if (fseek(fout, pos, 0))
+		return ERROR;
+	ckopen(Pathname, pos, crc);
+	return OK;
+}
+
+/*
+ * Offered a file we already have some of: if its journal is for the
+ *  same length and date and the checkpointed prefix still has the CRC
+ *  the journal recorded, reopen the file there.  rzfile() then answers
+ *  with a ZRPOS for that offset.  Returns OK if resuming, ZFERR if the
+ *  journal is ours but the prefix is not, ERROR if there's no journal.
+ */
+ckresume(name, size)
+char *name;
+long size;
+{
+	FILE *jf;
+	long pos, len, mtime;
+	unsigned long crc;
+	int n;
+
+	ckclose();
+	if (strlen(name) >= PATHLEN)
+		return ERROR;
+	sprintf(Ckname, "%s%s", name, CKSUFFIX);
+	if ((jf = fopen(Ckname, "r")) == NULL)
+		return ERROR;
+	n = fscanf(jf, "%ld %lx %ld %lo", &pos, &crc, &len, &mtime);
+	fclose(jf);
+	if (n != 4 || len != Bytesleft || mtime != Modtime
+	 || pos <= 0 || pos > size || pos > len) {
+		vfile("Stale journal %s", Ckname);
+		unlink(Ckname);
+		return ERROR;
+	}
+	openit(name, "r+");
+	if ( !fout)
+		return ERROR;
+	if (ckscan(pos) || Ckcrc != crc) {
+		vfile("Journal %s does not match the file", Ckname);
+		Ckon = FALSE;  unlink(Ckname);
+		fclose(fout);  fout = NULL;
+		return ZFERR;
+	}
+	fflush(fout);
+	ftruncate(fileno(fout), pos);	/* Drop bytes after the checkpoint */
+	rxbytes = pos;
+	vfile("Resuming %s at %ld", name, pos);
+	return OK;
+}
+#endif
 
 /*
  * Strip leading ! if present, do shell escape. 
@@ -116,6 +116,20 @@ char Zsendmask[33];	/* Additional control chars to mask */
 
 #include "crctab.c"
 
+/*
+ * -F high throughput mode: 8K subpackets when the receiver offers them,
+ *  streaming with a large window, file data read straight from an mmap
+ *  of the file and each subpacket handed to write(2) in one piece.
+ */
+#ifdef POSIX
+#ifndef pdp11
+#ifndef NOZFAST
+#define ZFAST
+#include <sys/mman.h>
+#endif
+#endif
+#endif
+
 STATIC int Filesleft;
 STATIC long Totalleft;
 
@@ -145,8 +159,20 @@ STATIC int Canseek = 1;	/* 1: Can seek 0: only rewind -1: neither (pipe) */
 STATIC char Txb[TXBSIZE + 1024];	/* Circular buffer for file reads */
 STATIC char *txbuf = Txb;		/* Pointer to current file segment */
 #else
+#ifdef ZFAST
+char txbuf[8192+1];		/* ZMAXSP8K for files that can't be mapped, +1 for zsdar32 */
+#else
 char txbuf[1024];
 #endif
+#endif
+STATIC char *Txp;		/* Data for the current subpacket */
+
+#ifdef ZFAST
+#define FASTWINDOW 262144	/* Default -F window */
+STATIC int Fastmode;		/* -F given */
+STATIC char *Fmap;		/* Current file when mapped for -F */
+STATIC long Fmaplen;
+#endif
 
 
 STATIC long vpos = 0;		/* Number of bytes read from file */
@@ -304,6 +330,10 @@ char *argv[];
 					/* **** FALL THROUGH TO **** */
 				case 'f':
 					Fullname=TRUE; break;
+#ifdef ZFAST
+				case 'F':
+					Fastmode = TRUE; break;
+#endif
 		                case 'g' :
 					Ksendstr = TRUE; break;
 				case 'e':
@@ -589,7 +619,15 @@ char *oname;
 	}
 
 	++Filcnt;
+#ifdef ZFAST
+	if (Fastmode)
+		zmapin(&f);
+	c = wctxpn(name);
+	zunmapin();
+	switch (c) {
+#else
 	switch (wctxpn(name)) {
+#endif
 	case ZSKIP:
 	case ZFERR:
 		return OK;
@@ -861,32 +899,91 @@ register char *buf;
 	return count;
 }
 
-/* Fill buffer with blklen chars */
-zfilbuf()
+#ifdef ZFAST
+/*
+ * Map the file just opened on in, if it is a plain file with something
+ *  in it.  zfilbuf() serves subpackets from the mapping when it exists.
+ */
+zmapin(f)
+struct stat *f;
 {
-	int n;
+	char *p;
 
+	if ( !S_ISREG(f->st_mode) || f->st_size <= 0)
+		return;
+	p = mmap((char *)0, (size_t)f->st_size, PROT_READ, MAP_SHARED,
+	  fileno(in), (off_t)0);
+	if (p == (char *)MAP_FAILED) {
+		vfile("mmap failed errno=%d, using stdio", errno);
+		return;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(p, (size_t)f->st_size, MADV_SEQUENTIAL);
+#endif
+	Fmap = p;  Fmaplen = f->st_size;
+}
+
+zunmapin()
+{
+	if (Fmap)
+		munmap(Fmap, (size_t)Fmaplen);
+	Fmap = NULL;
+}
+#endif
+
+/* Fill buffer with blklen chars, leaving Txp pointing at them */
+zfilbuf()
+{
+	int n, len;
+
+#ifdef ZFAST
+	if (Fmap) {
+		n = blklen;
+		if (bytcnt >= Fmaplen)
+			n = 0;
+		else if (Fmaplen - bytcnt < n)
+			n = Fmaplen - bytcnt;
+		Txp = Fmap + bytcnt;
+		if (Crc32t == 2) {
+			/* zsdar32() peeks one byte past the data */
+#ifdef TXBSIZE
+			txbuf = Txb;	/* Not in use while mapped */
+#endif
+			memcpy(txbuf, Txp, n);  Txp = txbuf;
+		}
+		if (n < blklen)
+			Eofseen = 1;
+		return n;
+	}
+#endif
+	len = blklen;
 #ifdef TXBSIZE
-	vfile("zfilbuf: bytcnt =%lu vpos=%lu blklen=%d", bytcnt, vpos, blklen);
+#ifdef ZFAST
+	/* Txb only has room past its end for a ZMAXSPLEN subpacket */
+	if (len > ZMAXSPLEN)
+		len = ZMAXSPLEN;
+#endif
+	vfile("zfilbuf: bytcnt =%lu vpos=%lu blklen=%d", bytcnt, vpos, len);
 	/* We assume request is within buffer, or just beyond */
-	txbuf = Txb + (bytcnt & TXBMASK);
+	Txp = txbuf = Txb + (bytcnt & TXBMASK);
 	if (vpos <= bytcnt) {
-		n = fread(txbuf, 1, blklen, in);
+		n = fread(txbuf, 1, len, in);
 
 		vpos += n;
-		if (n < blklen)
+		if (n < len)
 			Eofseen = 1;
 		vfile("zfilbuf: n=%d vpos=%lu Eofseen=%d", n, vpos, Eofseen);
 		return n;
 	}
-	if (vpos >= (bytcnt+blklen))
-		return blklen;
+	if (vpos >= (bytcnt+len))
+		return len;
 	/* May be a short block if crash recovery etc. */
 	Eofseen = BEofseen;
 	return (vpos - bytcnt);
 #else
-	n = fread(txbuf, 1, blklen, in);
-	if (n < blklen) {
+	Txp = txbuf;
+	n = fread(txbuf, 1, len, in);
+	if (n < len) {
 		Eofseen = 1;
 		vfile("zfilbuf: n=%d vpos=%lu Eofseen=%d", n, vpos, Eofseen);
 	}
@@ -984,7 +1081,11 @@ register char *s,*t;
 
 char *usinfo[] = {
 	"Send Files and Commands with ZMODEM/YMODEM/XMODEM Protocol\n",
+#ifdef ZFAST
+	"Usage:	sz [-+abcdefFgklLnNuvwxyYZ] [-] file ...",
+#else
 	"Usage:	sz [-+abcdefgklLnNuvwxyYZ] [-] file ...",
+#endif
 	"\t	zcommand [-egv] COMMAND",
 	"\t	zcommandi [-egv] COMMAND",
 	"\t	sb [-adfkuv] [-] file ...",
@@ -1112,6 +1213,21 @@ getzrxinit()
 				blklen = Rxbuflen;
 			if (blkopt && blklen > blkopt)
 				blklen = blkopt;
+#ifdef ZFAST
+			if (Fastmode) {
+				blklen = (Rxhdr[ZF1] & CANSP8K) ?
+				  ZMAXSP8K : ZMAXSPLEN;
+				if (Rxbuflen && blklen > Rxbuflen)
+					blklen = Rxbuflen;
+				if (blkopt && blklen > blkopt)
+					blklen = blkopt;
+				if ( !Txwindow && (Rxflags & CANFDX)) {
+					Txwindow = FASTWINDOW;
+					Txwspac = FASTWINDOW/4;
+				}
+				Zframeio = TRUE;
+			}
+#endif
 			vfile("Rxbuflen=%d blklen=%d", Rxbuflen, blklen);
 			vfile("Txwindow = %u Txwspac = %d", Txwindow, Txwspac);
 
@@ -1232,7 +1348,7 @@ again:
 						bytcnt += m = n = zfilbuf();
 						if (bytcnt > maxbytcnt)
 							maxbytcnt = bytcnt;
-						for (p = txbuf; --m >= 0; ++p) {
+						for (p = Txp; --m >= 0; ++p) {
 							c = *p & 0377;
 							crc = UPDC32(c, crc);
 						}
@@ -1390,7 +1506,7 @@ gotack:
 		if (Verbose>1)
 			fprintf(stderr, "%7ld ZMODEM%s\n",
 			  Txpos, Crc32t?" CRC-32":"");
-		zsdata(txbuf, n, e);
+		zsdata(Txp, n, e);
 		bytcnt = Txpos += n;
 		if (bytcnt > maxbytcnt)
 			maxbytcnt = bytcnt;
@@ -1697,6 +1813,7 @@ register char *p;
 			vfile("Escaping %02o", c);
 		}
 	}
+	Zescfor = -1;	/* zsendblk() must rebuild its table */
 }
 
 
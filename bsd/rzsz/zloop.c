@@ -0,0 +1,275 @@
+/*
+ * zloop.c - drive sz into rz over a pair of pseudo terminals
+ *
+ *  zloop [-s sz] [-r rz] [-d dir] [-a "sz options"] file ...
+ *
+ * rz and sz talk to the tty named by their standard error, so each is
+ * started with stderr on the slave side of its own pty.  zloop copies
+ * bytes between the two masters, reports elapsed time and throughput
+ * once both programs exit, along with the CPU time each of them used,
+ * and compares every received file with the
+ * original.  The receiver runs in dir (default: a fresh directory under
+ * /tmp).  This is a test harness for POSIX hosts; it is not built for
+ * the PDP-11.
+ */
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+
+#define RELAYBUF 65536
+#define MAXARGS 64
+
+struct pipe {
+	int from, to;
+	char buf[RELAYBUF];
+	int head, tail;
+	long total;
+};
+
+static char *Szprog = "./sz";
+static char *Rzprog = "./rz";
+static char *Szopts = NULL;
+
+static void
+die(s)
+char *s;
+{
+	perror(s);
+	exit(2);
+}
+
+static int
+openmaster(slave)
+char **slave;
+{
+	int fd;
+	char *name;
+
+	if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
+		die("posix_openpt");
+	if (grantpt(fd) < 0 || unlockpt(fd) < 0)
+		die("grantpt");
+	if ((name = ptsname(fd)) == NULL)
+		die("ptsname");
+	*slave = strdup(name);
+	return fd;
+}
+
+static pid_t
+spawn(slave, dir, argv)
+char *slave, *dir, **argv;
+{
+	struct termios t;
+	pid_t pid;
+	int fd;
+
+	if ((pid = fork()) < 0)
+		die("fork");
+	if (pid)
+		return pid;
+	setsid();
+	if ((fd = open(slave, O_RDWR)) < 0)
+		die(slave);
+	if (tcgetattr(fd, &t) == 0) {
+		cfmakeraw(&t);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+	dup2(fd, 0);  dup2(fd, 1);  dup2(fd, 2);
+	if (fd > 2)
+		close(fd);
+	if (dir && chdir(dir) < 0)
+		_exit(126);
+	execv(argv[0], argv);
+	_exit(127);
+}
+
+/* Move what we can from one master to the other; -1 once the source is gone */
+static int
+relay(p, rd, wr)
+struct pipe *p;
+fd_set *rd, *wr;
+{
+	int n;
+
+	if (p->from >= 0 && FD_ISSET(p->from, rd) && p->tail < RELAYBUF) {
+		n = read(p->from, p->buf + p->tail, RELAYBUF - p->tail);
+		if (n > 0)
+			p->tail += n;
+		else if (n == 0 || errno != EAGAIN)
+			p->from = -1;
+	}
+	if (p->head < p->tail && FD_ISSET(p->to, wr)) {
+		n = write(p->to, p->buf + p->head, p->tail - p->head);
+		if (n > 0) {
+			p->head += n;
+			p->total += n;
+		}
+	}
+	if (p->head == p->tail)
+		p->head = p->tail = 0;
+	return p->from;
+}
+
+static int
+samefile(a, b)
+char *a, *b;
+{
+	char x[8192], y[8192];
+	FILE *fa, *fb;
+	size_t n, m;
+	int same;
+
+	if ((fa = fopen(a, "r")) == NULL)
+		return 0;
+	if ((fb = fopen(b, "r")) == NULL) {
+		fclose(fa);
+		return 0;
+	}
+	same = 1;
+	do {
+		n = fread(x, 1, sizeof x, fa);
+		m = fread(y, 1, sizeof y, fb);
+		if (n != m || memcmp(x, y, n))
+			same = 0;
+	} while (same && n > 0);
+	fclose(fa);  fclose(fb);
+	return same;
+}
+
+int
+main(argc, argv)
+char **argv;
+{
+	static struct pipe up, down;
+	char *sargv[MAXARGS], *rargv[4];
+	char *sslave, *rslave, *dir, *base, *opt;
+	char tmpl[64], path[1024];
+	struct timeval t0, t1;
+	struct rusage ru;
+	double scpu, rcpu;
+	struct stat st;
+	fd_set rd, wr;
+	pid_t spid, rpid;
+	int smaster, rmaster, status, live, bad, n, i;
+	long bytes;
+	double secs;
+
+	dir = NULL;
+	scpu = rcpu = 0;
+	while ((n = getopt(argc, argv, "s:r:d:a:")) != -1) {
+		switch (n) {
+		case 's': Szprog = optarg; break;
+		case 'r': Rzprog = optarg; break;
+		case 'd': dir = optarg; break;
+		case 'a': Szopts = optarg; break;
+		default:
+			fprintf(stderr,
+			  "Usage: zloop [-s sz] [-r rz] [-d dir] [-a opts] file ...\n");
+			exit(2);
+		}
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "zloop: no files\n");
+		exit(2);
+	}
+	if (dir == NULL) {
+		strcpy(tmpl, "/tmp/zloopXXXXXX");
+		if ((dir = mkdtemp(tmpl)) == NULL)
+			die("mkdtemp");
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	n = 0;
+	sargv[n++] = Szprog;
+	if (Szopts) {
+		opt = strdup(Szopts);
+		for (opt = strtok(opt, " "); opt && n < MAXARGS-2;
+		  opt = strtok(NULL, " "))
+			sargv[n++] = opt;
+	}
+	for (bytes = 0, i = optind; i < argc && n < MAXARGS-1; ++i) {
+		if (stat(argv[i], &st) < 0)
+			die(argv[i]);
+		bytes += st.st_size;
+		sargv[n++] = argv[i];
+	}
+	sargv[n] = NULL;
+	rargv[0] = Rzprog;  rargv[1] = NULL;
+	if (Rzprog[0] != '/' && getcwd(path, sizeof path - 8) != NULL) {
+		strcat(path, "/");
+		rargv[0] = malloc(strlen(path) + strlen(Rzprog) + 1);
+		strcpy(rargv[0], path);
+		strcat(rargv[0], Rzprog);
+	}
+
+	smaster = openmaster(&sslave);
+	rmaster = openmaster(&rslave);
+	gettimeofday(&t0, NULL);
+	rpid = spawn(rslave, dir, rargv);
+	spid = spawn(sslave, (char *)NULL, sargv);
+	fcntl(smaster, F_SETFL, O_NONBLOCK);
+	fcntl(rmaster, F_SETFL, O_NONBLOCK);
+	up.from = smaster;  up.to = rmaster;
+	down.from = rmaster;  down.to = smaster;
+
+	for (live = 2; live > 0; ) {
+		FD_ZERO(&rd);  FD_ZERO(&wr);
+		if (up.from >= 0 && up.tail < RELAYBUF)
+			FD_SET(up.from, &rd);
+		if (down.from >= 0 && down.tail < RELAYBUF)
+			FD_SET(down.from, &rd);
+		if (up.head < up.tail)
+			FD_SET(up.to, &wr);
+		if (down.head < down.tail)
+			FD_SET(down.to, &wr);
+		t1.tv_sec = 0;  t1.tv_usec = 100000;
+		if (select((smaster > rmaster ? smaster : rmaster) + 1,
+		  &rd, &wr, NULL, &t1) < 0 && errno != EINTR)
+			die("select");
+		relay(&up, &rd, &wr);
+		relay(&down, &rd, &wr);
+		while ((n = wait4(-1, &status, WNOHANG, &ru)) > 0) {
+			--live;
+			secs = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+			  (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+			if (n == spid)
+				scpu = secs;
+			else
+				rcpu = secs;
+			if (!WIFEXITED(status) || WEXITSTATUS(status))
+				fprintf(stderr, "zloop: %s exited with status %d\n",
+				  n == spid ? "sz" : "rz", status);
+		}
+	}
+	gettimeofday(&t1, NULL);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+
+	for (bad = 0, i = optind; i < argc; ++i) {
+		base = strrchr(argv[i], '/');
+		base = base ? base + 1 : argv[i];
+		sprintf(path, "%.900s/%.100s", dir, base);
+		if (!samefile(argv[i], path)) {
+			fprintf(stderr, "zloop: %s differs or is missing\n", path);
+			++bad;
+		}
+	}
+	printf("zloop: %ld file bytes, %ld line bytes sz->rz, %ld rz->sz\n",
+	  bytes, up.total, down.total);
+	printf("zloop: %.3f seconds, %.0f bytes/sec%s\n", secs,
+	  secs > 0 ? bytes / secs : 0.0, bad ? ", FAILED" : ", files match");
+	printf("zloop: cpu seconds sz %.3f rz %.3f\n", scpu, rcpu);
+	return bad != 0;
+}
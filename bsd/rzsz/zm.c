@@ -73,6 +73,12 @@ char Attn[ZATTNLEN+1];	/* Attention string rx sends to tx on err */
 char *Altcan;		/* Alternate canit string */
 
 static lastsent;	/* Last char we sent */
+static char Zesc[256];	/* Nonzero for bytes zsendline() would escape */
+static int Zescfor = -1;	/* Zctlesc value Zesc[] was built for */
+#ifdef ZFAST
+int Zframeio;		/* Send each data subpacket with one write(2) */
+static char Zframe[2*ZMAXSP8K+16];	/* Subpacket being assembled */
+#endif
 
 static char *frametypes[] = {
 	"No Response to Error Correction Request",	/* -4 */
@@ -226,6 +232,12 @@ register char *buf;
 
 #ifndef DSZ
 	vfile("zsdata: %d %s", length, Zendnames[frameend-ZCRCE&3]);
+#endif
+#ifdef ZFAST
+	if (Zframeio && Crc32t != 2 && length <= ZMAXSP8K) {
+		zsframe(buf, length, frameend);
+		return;
+	}
 #endif
 	switch (Crc32t) {
 	case 1:
@@ -233,10 +245,8 @@ register char *buf;
 	case 2:
 		zsdar32(buf, length, frameend);  break;
 	default:
-		crc = 0;
-		for (;--length >= 0; ++buf) {
-			zsendline(*buf); crc = updcrc((0377 & *buf), crc);
-		}
+		crc = updcrcblk(buf, length, 0);
+		zsendblk(buf, length);
 		xsendline(ZDLE); xsendline(frameend);
 		crc = updcrc(frameend, crc);
 
@@ -255,12 +265,8 @@ register char *buf;
 	register int c;
 	register unsigned long crc;
 
-	crc = 0xFFFFFFFFL;
-	for (;--length >= 0; ++buf) {
-		c = *buf & 0377;
-		zsendline(c);
-		crc = UPDC32(c, crc);
-	}
+	crc = updc32blk(buf, length, 0xFFFFFFFFL);
+	zsendblk(buf, length);
 	xsendline(ZDLE); xsendline(frameend);
 	crc = UPDC32(frameend, crc);
 
@@ -292,6 +298,10 @@ register char *buf;
 
 	crc = Rxcount = 0;  end = buf + length;
 	while (buf <= end) {
+		if ((d = zrdrun(buf, end)) > 0) {
+			crc = updcrcblk(buf, d, crc);
+			buf += d;  continue;
+		}
 		if ((c = zdlread()) & ~0377) {
 crcfoo:
 			switch (c) {
@@ -347,6 +357,10 @@ register char *buf;
 
 	crc = 0xFFFFFFFFL;  Rxcount = 0;  end = buf + length;
 	while (buf <= end) {
+		if ((d = zrdrun(buf, end)) > 0) {
+			crc = updc32blk(buf, d, crc);
+			buf += d;  continue;
+		}
 		if ((c = zdlread()) & ~0377) {
 crcfoo:
 			switch (c) {
@@ -725,6 +739,154 @@ register c;
 	}
 }
 
+/*
+ * Build Zesc[] to match the escaping decisions zsendline() makes.
+ */
+zescinit()
+{
+	register int c;
+
+	for (c = 0; c < 256; ++c) {
+		switch (c) {
+		case 0377:
+			Zesc[c] = (Zctlesc || Zsendmask[32]);  break;
+		case ZDLE:
+		case 021: case 023:
+		case 0221: case 0223:
+			Zesc[c] = 1;  break;
+		default:
+			Zesc[c] = ((c & 0140) == 0) &&
+			  (Zctlesc || Zsendmask[c & 037]);
+		}
+	}
+	Zescfor = Zctlesc;
+}
+
+/*
+ * Send length bytes of buf with ZMODEM escape encoding.  Runs of bytes
+ *  that need no escape are handed to stdio in one call.
+ */
+zsendblk(buf, length)
+register char *buf;
+{
+	register char *p, *end;
+	register int c;
+
+	if (Zescfor != Zctlesc)
+		zescinit();
+	end = buf + length;
+	while (buf < end) {
+		for (p = buf; p < end && !Zesc[*p & 0377]; ++p)
+			;
+		if (p > buf) {
+			fwrite(buf, 1, p - buf, Ttystream);
+			lastsent = p[-1] & 0377;
+		}
+		if (p == end)
+			break;
+		c = *p++ & 0377;
+		xsendline(ZDLE);
+		xsendline(lastsent = (c == 0377 ? ZRUB1 : c ^ 0100));
+		buf = p;
+	}
+}
+
+#ifdef ZFAST
+/*
+ * Store length bytes of buf at to with ZMODEM escape encoding, as
+ *  zsendblk() would send them.  Returns the number of bytes stored,
+ *  at most 2*length.
+ */
+zescape(to, buf, length)
+char *to;
+register char *buf;
+{
+	register char *p, *end;
+	register int c;
+
+	if (Zescfor != Zctlesc)
+		zescinit();
+	p = to;
+	for (end = buf + length; buf < end; ) {
+		c = *buf++ & 0377;
+		if (Zesc[c]) {
+			*p++ = ZDLE;
+			c = (c == 0377) ? ZRUB1 : c ^ 0100;
+		}
+		*p++ = c;
+	}
+	if (p > to)
+		lastsent = p[-1] & 0377;
+	return p - to;
+}
+
+/*
+ * zsdata() for -F: build the escaped data, frame end and CRC of one
+ *  subpacket in Zframe[] and give it to the tty with a single write.
+ *  Anything stdio still holds (the ZDATA header) goes out first.
+ */
+zsframe(buf, length, frameend)
+char *buf;
+{
+	register char *p;
+	register int c, n;
+	char crcb[4];
+	unsigned long crc;
+	unsigned short crc16;
+
+	p = Zframe + zescape(Zframe, buf, length);
+	*p++ = ZDLE;  *p++ = frameend;
+	if (Crc32t) {
+		crc = updc32blk(buf, length, 0xFFFFFFFFL);
+		crc = ~UPDC32(frameend, crc);
+		for (c = 0; c < 4; ++c) {
+			crcb[c] = crc;  crc >>= 8;
+		}
+		p += zescape(p, crcb, 4);
+	} else {
+		crc16 = updcrcblk(buf, length, 0);
+		crc16 = updcrc(frameend, crc16);
+		crc16 = updcrc(0,updcrc(0,crc16));
+		crcb[0] = crc16 >> 8;  crcb[1] = crc16;
+		p += zescape(p, crcb, 2);
+	}
+	if (frameend == ZCRCW)
+		*p++ = XON;
+	fflush(Ttystream);
+	for (buf = Zframe; buf < p; buf += n) {
+		if ((n = write(Tty, buf, p - buf)) < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				n = 0;  continue;
+			}
+			vfile("zsframe: write errno=%d", errno);
+			return;
+		}
+	}
+}
+#endif
+
+/*
+ * Copy to buf the run of characters already waiting in linbuf that
+ *  zdlread() would return unchanged, stopping before end or at the
+ *  first control character.  Returns the number of bytes copied.
+ */
+zrdrun(buf, end)
+register char *buf;
+char *end;
+{
+	register char *p;
+	register int n;
+
+	n = end - buf;
+	if (n > Lleft)
+		n = Lleft;
+	for (p = cdq; --n >= 0 && (*p & 0140); )
+		*buf++ = *p++;
+	n = p - cdq;
+	cdq = p;  Lleft -= n;
+	return n;
+}
+
 /* Decode two lower case hex digits into an 8 bit byte value */
 zgethex()
 {
@@ -17,6 +17,7 @@
 #define ZRESC	0176	/* RLE flag/escape character */
 #define ZMAXHLEN 16	/* Max header information length  NEVER CHANGE */
 #define ZMAXSPLEN 1024	/* Max subpacket length  NEVER CHANGE */
+#define ZMAXSP8K 8192	/* Max subpacket length if rx sets CANSP8K */
 
 /* Frame types (see array "frametypes" in zm.c) */
 #define ZRQINIT	0	/* Request receive init */
@@ -84,6 +85,7 @@
 #define CANVHDR	01	/* Variable headers OK */
 #define ZRRQWN	8	/* Receiver specified window size in ZRPXWN */
 #define ZRRQQQ	16	/* Additional control chars to quote in ZRPXQQ	*/
+#define CANSP8K	040	/* Rx takes ZMAXSP8K subpackets (local extension) */
 #define ZRQNVH	(ZRRQWN|ZRRQQQ)	/* Variable len hdr reqd to access info */
 
 /* Parameters for ZSINIT frame */
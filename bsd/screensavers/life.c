@@ -6,12 +6,24 @@
  *  Compile example (on 2.11BSD, might need -lm for math library):
  *    cc -o game_of_life game_of_life.c -lm
  *
+ *  Usage:
+ *    life [t] [-g generations/sec]       screensaver (t: test pattern)
+ *    life -b [-s WxH] [-d secs] [-n gens] benchmark on a torus, no display
+ *
+ *  The grid is kept a bit per cell, a machine word of cells at a time
+ *  (64 on most modern machines, 16 on the PDP-11), and a generation is
+ *  computed a word at a time with bitwise adders: each row's cells are
+ *  summed with their left and right neighbours, then three rows of those
+ *  sums are added to give every cell's 3x3 total at once.  Only the cells
+ *  that changed are drawn, through screen.c, which also paces the
+ *  generations.
+ *
  *  Press Ctrl-C to exit (SIGINT), which restores the cursor and
  *  resets the scrolling region.
- * 
+ *
  *  Author: Davepl 2025
  *  License: GPL 2.0
- * 
+ *
  */
 
 #include <stdio.h>
@@ -19,278 +31,385 @@
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
 #include <sys/ioctl.h>
 
-/* Global variables for dynamic screen dimensions */
-int SCREEN_WIDTH = 80;   /* Default fallback */
-int SCREEN_HEIGHT = 24;  /* Default fallback */
+#include "screen.c"
 
 #define ALIVE_CHAR 'O'
 #define DEAD_CHAR ' '
 
-static void restore_on_exit();
-
-/* Function to get terminal dimensions */
-void get_terminal_size()
-{
-#ifdef TIOCGWINSZ
-    struct winsize ws;
-    if (ioctl(0, TIOCGWINSZ, &ws) == 0) {
-        if (ws.ws_col > 0) SCREEN_WIDTH = ws.ws_col;
-        if (ws.ws_row > 0) SCREEN_HEIGHT = ws.ws_row;
-    }
+#define GENERATIONS_PER_SEC 10  /* Screensaver pace */
+#define BENCH_SECONDS 5
+
+/* A word of cells; bit n is column n of the word's span */
+#ifdef __pdp11__
+typedef unsigned int cell_word;
+#define BENCH_WIDTH 256
+#define BENCH_HEIGHT 128
+#else
+typedef unsigned long cell_word;
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 1024
 #endif
-}
+#define WORD_BITS ((int)(sizeof(cell_word) * 8))
+
+struct life {
+    int height, width;      /* In cells; the edges wrap */
+    int words;              /* Words per row */
+    cell_word tail;         /* Bits of a row's last word that are cells */
+    cell_word *cells;       /* This generation */
+    cell_word *next;
+    cell_word *sum0, *sum1; /* Bits of each cell's left + self + right */
+};
+
+#define CELL(g, row, col) \
+    ((g)->cells[(row) * (g)->words + (col) / WORD_BITS] >> ((col) % WORD_BITS) & 1)
+#define SET_CELL(g, row, col) \
+    ((g)->cells[(row) * (g)->words + (col) / WORD_BITS] |= (cell_word)1 << ((col) % WORD_BITS))
+
+static void restore_on_exit();
 
 /* Function prototypes */
-void initialize_grid(int *current, int height, int width);
-void initialize_test_pattern(int *current, int height, int width);
-void copy_grid(int *source, int *dest, int height, int width);
-int count_neighbors(int *grid, int row, int col, int height, int width);
-void render_grid(int *grid, int height, int width);
+struct life *new_life(int height, int width);
+void initialize_grid(struct life *g);
+void initialize_test_pattern(struct life *g);
+void next_generation(struct life *g);
+long count_alive(struct life *g);
+void render_changes(struct life *g, cell_word *shown, int rows);
+double elapsed_since(struct timeval *start);
+int benchmark(int width, int height, int seconds, long generations);
 
 int main(argc, argv)
 int argc;
 char *argv[];
 {
-    int *current_grid;
-    int *next_grid;
-    int row, col;
-
-    /* Get terminal dimensions */
-    get_terminal_size();
-
-    /* Allocate memory for grids */
-    current_grid = (int*)malloc(SCREEN_HEIGHT * SCREEN_WIDTH * sizeof(int));
-    next_grid = (int*)malloc(SCREEN_HEIGHT * SCREEN_WIDTH * sizeof(int));
-    
-    if (!current_grid || !next_grid) {
+    struct life *g;
+    cell_word *shown;
+    int i, test_pattern, bench, width, height, seconds, rate;
+    long generations;
+
+    test_pattern = 0;
+    bench = 0;
+    width = BENCH_WIDTH;
+    height = BENCH_HEIGHT;
+    seconds = BENCH_SECONDS;
+    generations = 0;
+    rate = GENERATIONS_PER_SEC;
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] == 't') {
+            test_pattern = 1;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%dx%d", &width, &height) == 2) {
+            i++;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            generations = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            rate = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [t] [-g generations/sec]\n", argv[0]);
+            fprintf(stderr, "       %s -b [-s WIDTHxHEIGHT] [-d seconds] [-n generations]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (bench)
+        return benchmark(width, height, seconds, generations);
+    if (rate < 1)
+        rate = 1;
+
+    /* Get the terminal size, hide the cursor and clear the screen */
+    scr_init(1000000L / rate);
+
+    /* Allocate the grid, and a copy of what is on the screen */
+    g = new_life(SCREEN_HEIGHT, SCREEN_WIDTH);
+    shown = g ? (cell_word *)calloc(g->height * g->words, sizeof(cell_word)) : NULL;
+    if (!g || !shown) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(1);
     }
 
     /* Initialize the current grid */
-    if (argc > 1 && argv[1][0] == 't') {
+    if (test_pattern) {
         /* Use test pattern if 't' argument is provided */
-        initialize_test_pattern(current_grid, SCREEN_HEIGHT, SCREEN_WIDTH);
+        initialize_test_pattern(g);
     } else {
         /* Use random initialization by default */
-        initialize_grid(current_grid, SCREEN_HEIGHT, SCREEN_WIDTH);
+        srand((unsigned int)time(NULL));
+        initialize_grid(g);
     }
 
     /* Install signal handler for Ctrl-C (SIGINT) and SIGTERM. */
     (void) signal(SIGINT,  restore_on_exit);
     (void) signal(SIGTERM, restore_on_exit);
 
-    /* Hide the cursor */
-    printf("\033[?25l");
-
-    /* Set scrolling region to full screen height */
-    printf("\033[1;%dr", SCREEN_HEIGHT);
-
-    /* Clear screen once at the beginning */
-    printf("\033[2J");
-
-    fflush(stdout);
-
-    /* Main loop: compute next generation and render */
+    /* Main loop: draw what changed, then compute the next generation */
     while (1) {
-        /* Compute next generation */
-        for (row = 0; row < SCREEN_HEIGHT; row++) {
-            for (col = 0; col < SCREEN_WIDTH; col++) {
-                int alive = current_grid[row * SCREEN_WIDTH + col];
-                int neighbors = count_neighbors(current_grid, row, col, SCREEN_HEIGHT, SCREEN_WIDTH);
-
-                if (alive) {
-                    if (neighbors < 2 || neighbors > 3)
-                        next_grid[row * SCREEN_WIDTH + col] = 0;  /* Cell dies */
-                    else
-                        next_grid[row * SCREEN_WIDTH + col] = 1;  /* Cell lives */
-                } else {
-                    if (neighbors == 3)
-                        next_grid[row * SCREEN_WIDTH + col] = 1;  /* Cell becomes alive */
-                    else
-                        next_grid[row * SCREEN_WIDTH + col] = 0;  /* Cell remains dead */
-                }
-            }
-        }
-
-        /* Render the next generation */
-        render_grid(next_grid, SCREEN_HEIGHT, SCREEN_WIDTH);
-
-        /* Swap grids */
-        copy_grid(next_grid, current_grid, SCREEN_HEIGHT, SCREEN_WIDTH);
-
-        /* Small delay: Adjust to taste. */
-        {
-            volatile int i;
-            for (i = 0; i < 100000; i++) ;  /* Busy loop delay */
-        }
+        render_changes(g, shown, SCREEN_HEIGHT - 1);  /* Leave last row for status */
+        scr_refresh();
+        next_generation(g);
     }
 
     /* Normally never reached, but just in case */
-    free(current_grid);
-    free(next_grid);
     restore_on_exit(0);
 
     return 0;
 }
 
+/* Allocate an empty height x width torus */
+struct life *new_life(int height, int width)
+{
+    struct life *g;
+    long size;
+
+    g = (struct life *)malloc(sizeof(struct life));
+    if (!g)
+        return NULL;
+    g->height = height;
+    g->width = width;
+    g->words = (width + WORD_BITS - 1) / WORD_BITS;
+    g->tail = ~(cell_word)0;
+    if (width % WORD_BITS)
+        g->tail = ((cell_word)1 << (width % WORD_BITS)) - 1;
+    size = (long)height * g->words;
+    g->cells = (cell_word *)calloc(size, sizeof(cell_word));
+    g->next = (cell_word *)calloc(size, sizeof(cell_word));
+    g->sum0 = (cell_word *)calloc(size, sizeof(cell_word));
+    g->sum1 = (cell_word *)calloc(size, sizeof(cell_word));
+    if (!g->cells || !g->next || !g->sum0 || !g->sum1)
+        return NULL;
+    return g;
+}
+
 /* Initialize the grid with random alive (1) or dead (0) cells */
-void initialize_grid(int *current, int height, int width)
+void initialize_grid(struct life *g)
 {
     int row, col;
     int random_val;
-    
-    /* Seed random number generator with current time for variety */
-    srand((unsigned int)time(NULL));
-
-    /* First, clear the entire grid */
-    for (row = 0; row < height; row++) {
-        for (col = 0; col < width; col++) {
-            current[row * width + col] = 0;
-        }
-    }
 
-    /* Now add some random live cells with a lower density */
-    for (row = 0; row < height; row++) {
-        for (col = 0; col < width; col++) {
+    /* Add some random live cells with a lower density */
+    for (row = 0; row < g->height; row++) {
+        for (col = 0; col < g->width; col++) {
             random_val = rand() % 100;  /* Get value 0-99 */
             /* Only make about 15% of cells alive for more stable patterns */
             if (random_val < 15) {
-                current[row * width + col] = 1;
+                SET_CELL(g, row, col);
             }
         }
     }
 }
 
 /* Initialize with a known test pattern for debugging */
-void initialize_test_pattern(int *current, int height, int width)
+void initialize_test_pattern(struct life *g)
 {
-    int row, col;
-    
-    /* Clear the entire grid first */
-    for (row = 0; row < height; row++) {
-        for (col = 0; col < width; col++) {
-            current[row * width + col] = 0;
-        }
-    }
-    
+    int height = g->height;
+    int width = g->width;
+
     /* Add some known stable and oscillating patterns */
-    
+
     /* Block (stable) at position (5,5) */
     if (height > 6 && width > 6) {
-        current[5 * width + 5] = 1;
-        current[5 * width + 6] = 1;
-        current[6 * width + 5] = 1;
-        current[6 * width + 6] = 1;
+        SET_CELL(g, 5, 5);
+        SET_CELL(g, 5, 6);
+        SET_CELL(g, 6, 5);
+        SET_CELL(g, 6, 6);
     }
-    
+
     /* Blinker (oscillator) at position (10,10) */
     if (height > 10 && width > 11) {
-        current[10 * width + 9] = 1;
-        current[10 * width + 10] = 1;
-        current[10 * width + 11] = 1;
+        SET_CELL(g, 10, 9);
+        SET_CELL(g, 10, 10);
+        SET_CELL(g, 10, 11);
     }
-    
+
     /* Glider at position (15,15) */
     if (height > 17 && width > 17) {
-        current[15 * width + 16] = 1;
-        current[16 * width + 17] = 1;
-        current[17 * width + 15] = 1;
-        current[17 * width + 16] = 1;
-        current[17 * width + 17] = 1;
+        SET_CELL(g, 15, 16);
+        SET_CELL(g, 16, 17);
+        SET_CELL(g, 17, 15);
+        SET_CELL(g, 17, 16);
+        SET_CELL(g, 17, 17);
     }
-    
+
     /* Toad (oscillator) at position (5,20) */
     if (height > 6 && width > 22) {
-        current[5 * width + 20] = 1;
-        current[5 * width + 21] = 1;
-        current[5 * width + 22] = 1;
-        current[6 * width + 19] = 1;
-        current[6 * width + 20] = 1;
-        current[6 * width + 21] = 1;
+        SET_CELL(g, 5, 20);
+        SET_CELL(g, 5, 21);
+        SET_CELL(g, 5, 22);
+        SET_CELL(g, 6, 19);
+        SET_CELL(g, 6, 20);
+        SET_CELL(g, 6, 21);
     }
 }
 
-/* Copy source grid to destination grid */
-void copy_grid(int *source, int *dest, int height, int width)
+/*
+ * Compute the next generation, a word of cells at a time.
+ *
+ * First each row is added to itself shifted a cell left and a cell right,
+ * giving every cell's count of itself and its two row neighbours, 0 to 3,
+ * as two bit planes.  Adding the planes of the rows above, at and below
+ * gives the 3x3 total, 0 to 9, including the cell itself.  A cell lives
+ * if that total is 3, or if it is 4 and the cell was alive.
+ */
+void next_generation(struct life *g)
 {
-    memcpy(dest, source, sizeof(int) * height * width);
-}
+    int row, k, up, down, last, last_bit;
+    cell_word *cells, *s0, *s1, *u0, *u1, *d0, *d1, *out;
+    cell_word left, self, right, x, first, end;
+    cell_word lo, carry, p, q, pa, qa, one, two;
+    cell_word *swap;
+
+    last = g->words - 1;
+    last_bit = (g->width - 1) % WORD_BITS;
+
+    /* Sum each row's cells with their left and right neighbours */
+    for (row = 0; row < g->height; row++) {
+        cells = g->cells + row * g->words;
+        s0 = g->sum0 + row * g->words;
+        s1 = g->sum1 + row * g->words;
+        first = cells[0] & 1;
+        end = cells[last] >> last_bit & 1;
+        for (k = 0; k <= last; k++) {
+            self = cells[k];
+            left = self << 1 | (k > 0 ? cells[k - 1] >> (WORD_BITS - 1) : end);
+            right = self >> 1 | (k < last ? cells[k + 1] << (WORD_BITS - 1) : 0);
+            if (k == last)
+                right |= first << last_bit;
+            x = left ^ self;
+            s0[k] = x ^ right;
+            s1[k] = (left & self) | (x & right);
+        }
+    }
 
-/* Count the number of alive neighbors for a cell at (row, col) */
-int count_neighbors(int *grid, int row, int col, int height, int width)
-{
-    int count = 0;
-    int dr, dc;
-    int r, c;
-
-    for (dr = -1; dr <= 1; dr++) {
-        for (dc = -1; dc <= 1; dc++) {
-            if (dr == 0 && dc == 0)
-                continue;  /* Skip the cell itself */
-
-            r = row + dr;
-            c = col + dc;
-
-            /* Wrap around the edges (toroidal array) */
-            if (r < 0)
-                r = height - 1;
-            else if (r >= height)
-                r = 0;
-
-            if (c < 0)
-                c = width - 1;
-            else if (c >= width)
-                c = 0;
-
-            count += grid[r * width + c];
+    /* Add the sums of the rows above and below, and apply the rules */
+    for (row = 0; row < g->height; row++) {
+        up = (row == 0 ? g->height - 1 : row - 1) * g->words;
+        down = (row == g->height - 1 ? 0 : row + 1) * g->words;
+        cells = g->cells + row * g->words;
+        out = g->next + row * g->words;
+        s0 = g->sum0 + row * g->words;
+        s1 = g->sum1 + row * g->words;
+        u0 = g->sum0 + up;
+        u1 = g->sum1 + up;
+        d0 = g->sum0 + down;
+        d1 = g->sum1 + down;
+        for (k = 0; k <= last; k++) {
+            /* Ones: three bits into a sum and a carry of weight 2 */
+            x = u0[k] ^ s0[k];
+            lo = x ^ d0[k];
+            carry = (u0[k] & s0[k]) | (x & d0[k]);
+            /* Twos: four bits, counted in two pairs */
+            p = u1[k] ^ s1[k];
+            pa = u1[k] & s1[k];
+            q = d1[k] ^ carry;
+            qa = d1[k] & carry;
+            one = (p ^ q) & ~(pa | qa);                             /* 2 or 3 */
+            two = (p & q) | (pa & ~(q | qa)) | (qa & ~(p | pa));    /* 4 or 5 */
+            out[k] = (lo & one) | (~lo & two & cells[k]);
         }
+        out[last] &= g->tail;
     }
 
-    return count;
+    swap = g->cells;
+    g->cells = g->next;
+    g->next = swap;
 }
 
-/* Render the grid to the terminal */
-void render_grid(int *grid, int height, int width)
+long count_alive(struct life *g)
 {
-    int row, col;
-
-    /* Move cursor to top-left */
-    printf("\033[1;1H");
+    long n, i;
+    cell_word w;
+
+    n = 0;
+    for (i = 0; i < (long)g->height * g->words; i++)
+        for (w = g->cells[i]; w; w &= w - 1)
+            n++;
+    return n;
+}
 
-    /* Iterate through the grid and print characters */
-    for (row = 0; row < height - 1; row++) {  /* Leave last row for status */
-        for (col = 0; col < width; col++) {
-            if (grid[row * width + col])
-                putchar(ALIVE_CHAR);
-            else
-                putchar(DEAD_CHAR);
+/* Put the cells of the first rows that differ from shown, and update shown */
+void render_changes(struct life *g, cell_word *shown, int rows)
+{
+    int row, k, bit;
+    cell_word diff, *cells, *was;
+
+    for (row = 0; row < rows && row < g->height; row++) {
+        cells = g->cells + row * g->words;
+        was = shown + row * g->words;
+        for (k = 0; k < g->words; k++) {
+            diff = cells[k] ^ was[k];
+            for (bit = 0; diff; bit++, diff >>= 1)
+                if (diff & 1)
+                    scr_put(row, k * WORD_BITS + bit,
+                            cells[k] >> bit & 1 ? ALIVE_CHAR : DEAD_CHAR);
+            was[k] = cells[k];
         }
-        if (row < height - 2)  /* Don't print newline on last row */
-            putchar('\n');
     }
+}
+
+double elapsed_since(struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, (struct timezone *)0);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
 
-    /* Flush output to ensure it appears on the screen */
-    fflush(stdout);
+/*
+ * Run generations on a width x height torus with no display, for the
+ * given seconds or number of generations, and report the rate.  The
+ * start is random but the same every time, so the live cell count at
+ * the end checks a fixed number of generations.
+ */
+int benchmark(int width, int height, int seconds, long generations)
+{
+    struct life *g;
+    struct timeval start;
+    double secs;
+    long gens;
+
+    if (width < 1 || height < 1) {
+        fprintf(stderr, "Bad torus size\n");
+        return 1;
+    }
+    g = new_life(height, width);
+    if (!g) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    srand(1);
+    initialize_grid(g);
+
+    gettimeofday(&start, (struct timezone *)0);
+    gens = 0;
+    do {
+        next_generation(g);
+        gens++;
+        secs = generations || gens % 16 ? 0 : elapsed_since(&start);
+    } while (generations ? gens < generations : secs < seconds);
+    secs = elapsed_since(&start);
+
+    printf("Torus:                   %dx%d, %d bit words\n", width, height, WORD_BITS);
+    printf("Generations:             %ld in %.2f seconds\n", gens, secs);
+    printf("Generations per second:  %.1f\n", secs > 0 ? gens / secs : 0.0);
+    printf("Cells per second:        %.0f\n",
+           secs > 0 ? (double)width * height * gens / secs : 0.0);
+    printf("Live cells:              %ld\n", count_alive(g));
+    return 0;
 }
 
 /* Signal handler to restore the terminal when exiting */
 static void restore_on_exit(signum)
 int signum;
 {
-    /* Show the cursor again */
-    printf("\033[?25h");
-
-    /* Reset scrolling region */
-    printf("\033[r");
-
-    /* Move cursor to bottom-left */
-    printf("\033[%d;1H", SCREEN_HEIGHT);
+    (void)signum;
 
-    /* Flush out any pending output */
-    fflush(stdout);
+    /* Show the cursor, reset the scrolling region, go to bottom-left */
+    scr_end(0);
 
     /* Exit gracefully */
     exit(0);
@@ -20,55 +20,9 @@
 #include <time.h>
 #include <sys/ioctl.h>
 
-#if defined(__NetBSD__) || defined(__APPLE__) || defined(__linux__)
-#define USE_DELAY 1
-#include <unistd.h>
-#else
-#define USE_DELAY 0
-#endif
-
-/* Default fallback values if terminal size detection fails */
-#define DEFAULT_WIDTH 80
-#define DEFAULT_HEIGHT 24
-
 #define MAX_TRAILS 16
 
-/* Global variables for screen dimensions */
-int SCREEN_WIDTH = DEFAULT_WIDTH;
-int SCREEN_HEIGHT = DEFAULT_HEIGHT;
-
-/* Function to get terminal size */
-void get_terminal_size()
-{
-#ifdef TIOCGWINSZ
-    struct winsize ws;
-    
-    /* Try to get window size using ioctl */
-    if (ioctl(0, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
-        SCREEN_WIDTH = ws.ws_col;
-        SCREEN_HEIGHT = ws.ws_row;
-        return;
-    }
-#endif
-    
-    /* Fallback: try environment variables */
-    {
-        char *cols_env = getenv("COLUMNS");
-        char *lines_env = getenv("LINES");
-        
-        if (cols_env != NULL) {
-            int cols = atoi(cols_env);
-            if (cols > 0) SCREEN_WIDTH = cols;
-        }
-        
-        if (lines_env != NULL) {
-            int lines = atoi(lines_env);
-            if (lines > 0) SCREEN_HEIGHT = lines;
-        }
-    }
-    
-    /* If all else fails, use the defaults already set */
-}
+#include "screen.c"
 
 
 /*
@@ -98,14 +52,8 @@ int trail_timer = 0;
 void restore_on_exit(signum)
 int signum;
 {
-    /* Show the cursor again */
-    puts("\033[?25h");
-    /* Reset scrolling region to the entire screen */
-    puts("\033[r");
-    /* Move cursor to bottom of screen */
-    printf("\033[%d;1H", SCREEN_HEIGHT);
-    /* Optionally clear screen or any other cleanup */
-    fflush(stdout);
+    /* Show the cursor, reset the scrolling region, go to the bottom */
+    scr_end(0);
 
     /* Exit gracefully */
     exit(0);
@@ -146,14 +94,11 @@ void update_trails()
             /* Draw only in the first row if the trail is active */
             if (trails[i].rows_drawn < trails[i].length) 
             {
-                printf("\033[1;%dH", trails[i].column + 1);
                 c = (rand() % (46));
                 {
                     // Mirrored Katakana character
                     c = c + '!';
-                    printf(SELECT_MATRIX_SOFTFONT);
-                    putchar(c);
-                    printf(UNSELECT_SOFTFONT);
+                    scr_put_attr(0, trails[i].column, c, A_ALT);
                 }
                 
                 /* Increment the number of rows drawn */
@@ -167,7 +112,7 @@ void update_trails()
     }
 
     /* Scroll the screen down by one row */
-    printf("\033M");
+    scr_scroll_down();
 }
 
 int main()
@@ -175,13 +120,11 @@ int main()
     int trail_length = 8; /* Configurable length of the trail */
     int spawn_rate = 1;   /* Configurable spawn rate */
 
-    puts("Starting!");
-
     /* Seed the random generator */
     srand(time((time_t *)0));
 
-    /* Get the terminal size first */
-    get_terminal_size();
+    /* Get the terminal size, hide the cursor and clear the screen; 50ms frames */
+    scr_init(50000L);
 
     if (SCREEN_HEIGHT - 10 > trail_length)
         trail_length = SCREEN_HEIGHT - 10;
@@ -190,24 +133,13 @@ int main()
     signal(SIGINT, restore_on_exit);
     signal(SIGTERM, restore_on_exit);
 
-    /* Hide the cursor */
-    puts("\033[?25l");
-
-    /* Set scrolling region to full screen using detected size */
-    printf("\033[1;%dr", SCREEN_HEIGHT);
-
     /* Load Matrix softfont */
-    puts(LOAD_MATRIX_SOFTFONT);
-
-    /* Clear screen */
-    puts("\033[2J");
+    scr_raw(LOAD_MATRIX_SOFTFONT);
+    scr_altset(SELECT_MATRIX_SOFTFONT, UNSELECT_SOFTFONT);
 
     /* Initialize trails */
     initialize_trails();
 
-    /* Get the terminal size */
-    get_terminal_size();
-
     for (;;) {
         /* Start a new trail periodically */
         if (trail_timer % spawn_rate == 0) {
@@ -217,16 +149,8 @@ int main()
         /* Update and draw trails */
         update_trails();
 
-        /* Reset cursor to top-left (optional) */
-        puts("\033[1;1H");
-
-        /* Flush output */
-        fflush(stdout);
-
-        /* Small delay */
-#if USE_DELAY
-        usleep(50000); /* 50ms delay on NetBSD */
-#endif
+        /* Send the changes and wait for the next frame */
+        scr_refresh();
 
         trail_timer++;
     }
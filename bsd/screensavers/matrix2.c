@@ -20,55 +20,9 @@
 #include <time.h>
 #include <sys/ioctl.h>
 
-#if defined(__NetBSD__) || defined(__APPLE__) || defined(__linux__)
-#define USE_DELAY 1
-#include <unistd.h>
-#else
-#define USE_DELAY 0
-#endif
-
-/* Default fallback values if terminal size detection fails */
-#define DEFAULT_WIDTH 80
-#define DEFAULT_HEIGHT 24
-
 #define MAX_TRAILS 20
 
-/* Global variables for screen dimensions */
-int SCREEN_WIDTH = DEFAULT_WIDTH;
-int SCREEN_HEIGHT = DEFAULT_HEIGHT;
-
-/* Function to get terminal size */
-void get_terminal_size()
-{
-#ifdef TIOCGWINSZ
-    struct winsize ws;
-    
-    /* Try to get window size using ioctl */
-    if (ioctl(0, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
-        SCREEN_WIDTH = ws.ws_col;
-        SCREEN_HEIGHT = ws.ws_row;
-        return;
-    }
-#endif
-    
-    /* Fallback: try environment variables */
-    {
-        char *cols_env = getenv("COLUMNS");
-        char *lines_env = getenv("LINES");
-        
-        if (cols_env != NULL) {
-            int cols = atoi(cols_env);
-            if (cols > 0) SCREEN_WIDTH = cols;
-        }
-        
-        if (lines_env != NULL) {
-            int lines = atoi(lines_env);
-            if (lines > 0) SCREEN_HEIGHT = lines;
-        }
-    }
-    
-    /* If all else fails, use the defaults already set */
-}
+#include "screen.c"
 
 /* Structure to represent a trail */
 struct Trail {
@@ -85,14 +39,8 @@ int trail_timer = 0;
 void restore_on_exit(signum)
 int signum;
 {
-    /* Show the cursor again */
-    printf("\033[?25h");
-    /* Reset scrolling region to the entire screen */
-    printf("\033[r");
-    /* Move cursor to bottom of screen */
-    printf("\033[%d;1H", SCREEN_HEIGHT);
-    /* Optionally clear screen or any other cleanup */
-    fflush(stdout);
+    /* Show the cursor, reset the scrolling region, go to the bottom */
+    scr_end(0);
 
     /* Exit gracefully */
     exit(0);
@@ -134,14 +82,13 @@ void update_trails()
             
             /* Draw the new head of the trail */
             if (trails[i].head < SCREEN_HEIGHT) {
-                printf("\033[%d;%dH", trails[i].head + 1, trails[i].column + 1);
                 c = '!' + (rand() % 94);
-                putchar(c);
+                scr_put(trails[i].head, trails[i].column, c);
             }
 
             /* Erase the tail of the trail */
             if (erase_pos >= 0 && erase_pos < SCREEN_HEIGHT) {
-                printf("\033[%d;%dH ", erase_pos + 1, trails[i].column + 1);
+                scr_put(erase_pos, trails[i].column, ' ');
             }
 
             /* Move the trail downward */
@@ -163,25 +110,16 @@ int main()
     /* Seed the random generator */
     srand(time((time_t *)0));
 
+    /* Get the terminal size, hide the cursor and clear the screen; 20ms frames */
+    scr_init(20000L);
+
     /* Install signal handlers */
     signal(SIGINT, restore_on_exit);
     signal(SIGTERM, restore_on_exit);
 
-    /* Hide the cursor */
-    printf("\033[?25l");
-
-    /* Get the terminal size first */
-    get_terminal_size();
-
     if (SCREEN_HEIGHT - 10 > trail_length)
         trail_length = SCREEN_HEIGHT - 10; /* Ensure trail length fits on screen */
 
-    /* Set scrolling region to full screen using detected size */
-    printf("\033[1;%dr", SCREEN_HEIGHT);
-
-    /* Clear screen */
-    printf("\033[2J");
-
     /* Initialize trails */
     initialize_trails();
 
@@ -194,13 +132,8 @@ int main()
         /* Update and draw trails */
         update_trails();
 
-        /* Flush output */
-        fflush(stdout);
-
-        /* Small delay */
-#if USE_DELAY
-        usleep(20000);
-#endif
+        /* Send the changes and wait for the next frame */
+        scr_refresh();
 
         trail_timer++;
     }
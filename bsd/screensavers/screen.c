@@ -0,0 +1,520 @@
+/*
+ * screen.c - Frame-diff terminal output for the screensavers
+ *
+ *  The screensavers draw into an off-screen buffer of character cells
+ *  with scr_put(), and scr_refresh() sends the terminal only the cells
+ *  that differ from what it is showing.  For each cursor movement it
+ *  takes the shortest of an absolute move (CUP), relative moves, and
+ *  typing over the characters in between, and the frame goes out in one
+ *  write().  At 9600 baud every byte is about a millisecond, so the
+ *  bytes saved are frame rate.
+ *
+ *  scr_refresh() then waits out the frame time, or the time the line
+ *  needs to send the frame if that is longer, so frames are not drawn
+ *  faster than the terminal can show them.  The line speed comes from
+ *  the tty; BAUD in the environment overrides it (0 for no limit).  With
+ *  SCREEN_STATS set, bytes per frame are reported on exit.
+ *
+ *  Included by the screensavers.  Rows and columns count from 0.
+ *
+ *  License: GPL 2.0
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+
+#if defined(__NetBSD__) || defined(__APPLE__) || defined(__linux__)
+#define USE_TERMIOS 1
+#include <termios.h>
+#include <unistd.h>
+#include <string.h>
+#else
+#define USE_TERMIOS 0
+#include <sgtty.h>
+#endif
+
+/* Default fallback values if terminal size detection fails */
+#define DEFAULT_WIDTH 80
+#define DEFAULT_HEIGHT 24
+
+/* Cell attributes */
+#define A_NORMAL 0
+#define A_ALT 1                 /* Alternate character set; see scr_altset() */
+
+#define SCR_RAW_MAX 256         /* Room kept for raw sequences in a frame */
+#define SCR_CELL_MAX 32         /* Most a cell can take: move, set switch */
+#ifdef __pdp11__
+#define SCR_OUT_MAX 16384L      /* Frame buffer; larger frames go in pieces */
+#else
+#define SCR_OUT_MAX 1048576L
+#endif
+
+/* Global variables for screen dimensions */
+int SCREEN_WIDTH = DEFAULT_WIDTH;
+int SCREEN_HEIGHT = DEFAULT_HEIGHT;
+
+static char *scr_back, *scr_front;          /* Drawn, and on the terminal */
+static char *scr_back_attr, *scr_front_attr;
+static char *scr_dirty;                     /* Rows drawn on since the last frame */
+static char *scr_out;                       /* The frame being sent */
+static int scr_len, scr_size;
+static int scr_row, scr_col;                /* Cursor; row -1 if not known */
+static int scr_attr;                        /* Character set selected */
+static int scr_scrolls;                     /* Reverse scrolls to send */
+static char *scr_alt_on = "", *scr_alt_off = "";
+static long scr_baud;                       /* Bits per second; 0 if no limit */
+static long scr_frame_usec;
+static struct timeval scr_deadline;         /* Start of the next frame */
+static long scr_frames, scr_bytes;
+static long scr_sent;                       /* scr_bytes at the last frame */
+
+/* Function to get terminal size */
+void get_terminal_size()
+{
+#ifdef TIOCGWINSZ
+    struct winsize ws;
+
+    /* Try to get window size using ioctl */
+    if (ioctl(0, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
+        SCREEN_WIDTH = ws.ws_col;
+        SCREEN_HEIGHT = ws.ws_row;
+        return;
+    }
+#endif
+
+    /* Fallback: try environment variables */
+    {
+        char *cols_env = getenv("COLUMNS");
+        char *lines_env = getenv("LINES");
+
+        if (cols_env != NULL) {
+            int cols = atoi(cols_env);
+            if (cols > 0) SCREEN_WIDTH = cols;
+        }
+
+        if (lines_env != NULL) {
+            int lines = atoi(lines_env);
+            if (lines > 0) SCREEN_HEIGHT = lines;
+        }
+    }
+
+    /* If all else fails, use the defaults already set */
+}
+
+/* Output line speed in bits per second, or 0 if unknown */
+static long scr_line_speed()
+{
+    char *env;
+#if USE_TERMIOS
+    static struct { speed_t code; long bps; } speeds[] = {
+        { B50, 50 }, { B75, 75 }, { B110, 110 }, { B134, 134 },
+        { B150, 150 }, { B200, 200 }, { B300, 300 }, { B600, 600 },
+        { B1200, 1200 }, { B1800, 1800 }, { B2400, 2400 },
+        { B4800, 4800 }, { B9600, 9600 }, { B19200, 19200 },
+        { B38400, 38400 }
+    };
+    struct termios t;
+    speed_t code;
+    int i;
+#else
+    static long v7_speeds[] = {
+        0, 50, 75, 110, 134, 150, 200, 300, 600, 1200,
+        1800, 2400, 4800, 9600, 19200, 38400
+    };
+    struct sgttyb t;
+#endif
+
+    env = getenv("BAUD");
+    if (env != NULL)
+        return atol(env);
+#if USE_TERMIOS
+    if (tcgetattr(1, &t) < 0)
+        return 0;
+    code = cfgetospeed(&t);
+    for (i = 0; i < (int)(sizeof(speeds) / sizeof(speeds[0])); i++)
+        if (speeds[i].code == code)
+            return speeds[i].bps;
+    return 0;   /* Faster than a terminal line */
+#else
+    if (ioctl(1, TIOCGETP, &t) < 0 || t.sg_ospeed >= 16)
+        return 0;
+    return v7_speeds[t.sg_ospeed];
+#endif
+}
+
+/* Send the frame built so far */
+static void scr_flush()
+{
+    int done, n;
+
+    for (done = 0; done < scr_len; done += n) {
+        n = write(1, scr_out + done, scr_len - done);
+        if (n <= 0)
+            break;
+    }
+    scr_bytes += scr_len;
+    scr_len = 0;
+}
+
+static void scr_emit(s)
+char *s;
+{
+    while (*s)
+        scr_out[scr_len++] = *s++;
+}
+
+/* Queue a control sequence; the cursor and character set are assumed unmoved */
+void scr_raw(s)
+char *s;
+{
+    if ((int)strlen(s) > scr_size - scr_len - SCR_RAW_MAX) {
+        scr_flush();
+        write(1, s, strlen(s));
+        scr_bytes += strlen(s);
+        return;
+    }
+    scr_emit(s);
+}
+
+/* Digits in n */
+static int scr_digits(n)
+int n;
+{
+    return n < 10 ? 1 : n < 100 ? 2 : 3;
+}
+
+/* Bytes for ESC [ n x, with n left out when it is 1 */
+static int scr_csi_cost(n)
+int n;
+{
+    return n == 1 ? 3 : 3 + scr_digits(n);
+}
+
+static void scr_csi(n, final)
+int n, final;
+{
+    char buf[16];
+
+    if (n == 1)
+        sprintf(buf, "\033[%c", final);
+    else
+        sprintf(buf, "\033[%d%c", n, final);
+    scr_emit(buf);
+}
+
+/* Can the cells from col up to end on row be typed over as they are? */
+static int scr_can_retype(row, col, end)
+int row, col, end;
+{
+    char *b, *f, *ba, *fa;
+    int i;
+
+    i = row * SCREEN_WIDTH + col;
+    b = scr_back + i;
+    f = scr_front + i;
+    ba = scr_back_attr + i;
+    fa = scr_front_attr + i;
+    for (i = end - col; i > 0; i--)
+        if (*b++ != *f++ || *ba != *fa++ || *ba++ != scr_attr)
+            return 0;
+    return 1;
+}
+
+/* Bytes to move the cursor along its row from col to end */
+static int scr_across_cost(row, col, end, retype)
+int row, col, end, *retype;
+{
+    int cost;
+
+    *retype = 0;
+    if (end == col)
+        return 0;
+    if (end < col)                                  /* Backspaces or CUB */
+        return col - end < 4 ? col - end : scr_csi_cost(col - end);
+    cost = scr_csi_cost(end - col);                 /* CUF */
+    if (end - col < cost && scr_can_retype(row, col, end)) {
+        *retype = 1;
+        cost = end - col;
+    }
+    return cost;
+}
+
+/* Move the cursor to row, col by the shortest means */
+static void scr_move(row, col)
+int row, col;
+{
+    char buf[32];
+    int up, cup, rel, cr, retype, cr_retype;
+    int i;
+
+    if (scr_row == row && scr_col == col)
+        return;
+
+    if (row == 0 && col == 0)
+        cup = 3;
+    else if (col == 0)
+        cup = 3 + scr_digits(row + 1);
+    else
+        cup = 4 + scr_digits(row + 1) + scr_digits(col + 1);
+
+    rel = cr = cup + 1;
+    if (scr_row >= 0) {
+        /* Up a line with RI, down with IND; further with CUU, CUD */
+        up = scr_row - row;
+        if (up < 0)
+            up = -up;
+        i = up == 0 ? 0 : up == 1 ? 2 : scr_csi_cost(up);
+        rel = i + scr_across_cost(row, scr_col, col, &retype);
+        cr = i + 1 + scr_across_cost(row, 0, col, &cr_retype);
+    }
+
+    if (cup <= rel && cup <= cr) {
+        if (row == 0 && col == 0)
+            strcpy(buf, "\033[H");
+        else if (col == 0)
+            sprintf(buf, "\033[%dH", row + 1);
+        else
+            sprintf(buf, "\033[%d;%dH", row + 1, col + 1);
+        scr_emit(buf);
+    } else {
+        if (row == scr_row - 1)
+            scr_emit("\033M");
+        else if (row < scr_row)
+            scr_csi(scr_row - row, 'A');
+        else if (row == scr_row + 1)
+            scr_emit("\033D");
+        else if (row > scr_row)
+            scr_csi(row - scr_row, 'B');
+        if (cr < rel) {
+            scr_out[scr_len++] = '\r';
+            scr_col = 0;
+            retype = cr_retype;
+        }
+        if (col < scr_col) {
+            if (scr_col - col < 4)
+                for (i = scr_col - col; i > 0; i--)
+                    scr_out[scr_len++] = '\b';
+            else
+                scr_csi(scr_col - col, 'D');
+        } else if (col > scr_col) {
+            if (retype)
+                for (i = scr_col; i < col; i++)
+                    scr_out[scr_len++] = scr_back[row * SCREEN_WIDTH + i];
+            else
+                scr_csi(col - scr_col, 'C');
+        }
+    }
+    scr_row = row;
+    scr_col = col;
+}
+
+/* Allocate the buffers, note the line speed, and clear the screen */
+void scr_init(frame_usec)
+long frame_usec;
+{
+    char buf[32];
+    int cells;
+    long size;
+
+    get_terminal_size();
+    cells = SCREEN_WIDTH * SCREEN_HEIGHT;
+    scr_back = (char *)malloc(cells);
+    scr_front = (char *)malloc(cells);
+    scr_back_attr = (char *)calloc(cells, 1);
+    scr_front_attr = (char *)calloc(cells, 1);
+    scr_dirty = (char *)calloc(SCREEN_HEIGHT, 1);
+    /*
+     * A cell can take a character set switch each way, and a move.  The
+     * sum overflows a 16 bit int on large screens, so it is worked out in
+     * a long and kept to SCR_OUT_MAX; scr_refresh() sends a frame that
+     * does not fit in pieces.
+     */
+    size = (long)cells * 8 + SCREEN_HEIGHT * 8L + SCR_RAW_MAX * 2;
+    scr_size = (int)(size < SCR_OUT_MAX ? size : SCR_OUT_MAX);
+    scr_out = (char *)malloc(scr_size);
+    if (!scr_back || !scr_front || !scr_back_attr || !scr_front_attr ||
+        !scr_dirty || !scr_out) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memset(scr_back, ' ', cells);
+    memset(scr_front, ' ', cells);
+
+    scr_baud = scr_line_speed();
+    scr_frame_usec = frame_usec;
+    gettimeofday(&scr_deadline, (struct timezone *)0);
+
+    /* Hide the cursor, scroll the whole screen, and clear it */
+    sprintf(buf, "\033[?25l\033[1;%dr\033[2J\033[H", SCREEN_HEIGHT);
+    scr_emit(buf);
+    scr_row = scr_col = 0;
+    scr_attr = A_NORMAL;
+}
+
+/* Strings that select and deselect the A_ALT character set */
+void scr_altset(on, off)
+char *on, *off;
+{
+    scr_alt_on = on;
+    scr_alt_off = off;
+}
+
+void scr_put_attr(row, col, ch, attr)
+int row, col, ch, attr;
+{
+    int i;
+
+    if (row < 0 || row >= SCREEN_HEIGHT || col < 0 || col >= SCREEN_WIDTH)
+        return;
+    i = row * SCREEN_WIDTH + col;
+    scr_back[i] = ch;
+    scr_back_attr[i] = attr;
+    scr_dirty[row] = 1;
+}
+
+void scr_put(row, col, ch)
+int row, col, ch;
+{
+    scr_put_attr(row, col, ch, A_NORMAL);
+}
+
+void scr_puts(row, col, s)
+int row, col;
+char *s;
+{
+    while (*s)
+        scr_put_attr(row, col++, *s++, A_NORMAL);
+}
+
+/* Blank the whole buffer */
+void scr_clear()
+{
+    memset(scr_back, ' ', SCREEN_WIDTH * SCREEN_HEIGHT);
+    memset(scr_back_attr, A_NORMAL, SCREEN_WIDTH * SCREEN_HEIGHT);
+    memset(scr_dirty, 1, SCREEN_HEIGHT);
+}
+
+/* Move the buffer down a row, as Reverse Index at the top does */
+static void scr_shift_down(cells, attrs)
+char *cells, *attrs;
+{
+    int i;
+
+    for (i = SCREEN_WIDTH * (SCREEN_HEIGHT - 1) - 1; i >= 0; i--) {
+        cells[i + SCREEN_WIDTH] = cells[i];
+        attrs[i + SCREEN_WIDTH] = attrs[i];
+    }
+    memset(cells, ' ', SCREEN_WIDTH);
+    memset(attrs, A_NORMAL, SCREEN_WIDTH);
+}
+
+/* Scroll the picture down a row; the terminal does it with one RI */
+void scr_scroll_down()
+{
+    scr_shift_down(scr_back, scr_back_attr);
+    memset(scr_dirty, 1, SCREEN_HEIGHT);
+    scr_scrolls++;
+}
+
+/* Wait for the next frame: the frame time, or as long as the line takes */
+static void scr_pace(bytes)
+long bytes;
+{
+    struct timeval now, wait;
+    long usec, line;
+
+    usec = scr_frame_usec;
+    if (scr_baud > 0) {
+        /* Ten bits a character, in milliseconds to keep it in a long */
+        line = bytes * 10000L / scr_baud * 1000L;
+        if (line > usec)
+            usec = line;
+    }
+    scr_deadline.tv_usec += usec % 1000000L;
+    scr_deadline.tv_sec += usec / 1000000L + scr_deadline.tv_usec / 1000000L;
+    scr_deadline.tv_usec %= 1000000L;
+
+    gettimeofday(&now, (struct timezone *)0);
+    wait.tv_sec = scr_deadline.tv_sec - now.tv_sec;
+    wait.tv_usec = scr_deadline.tv_usec - now.tv_usec;
+    if (wait.tv_usec < 0) {
+        wait.tv_usec += 1000000L;
+        wait.tv_sec--;
+    }
+    if (wait.tv_sec < 0) {
+        /* Running behind: start again from now rather than catch up */
+        scr_deadline = now;
+        return;
+    }
+    select(0, (fd_set *)0, (fd_set *)0, (fd_set *)0, &wait);
+}
+
+/* Send what changed since the last frame, then wait for the next */
+void scr_refresh()
+{
+    char *b, *f, *ba, *fa;
+    int row, col;
+    long bytes;
+
+    /* Scrolls first, so the rest is drawn on the scrolled screen */
+    for (; scr_scrolls > 0; scr_scrolls--) {
+        if (scr_len > scr_size - SCR_RAW_MAX - SCR_CELL_MAX)
+            scr_flush();
+        scr_move(0, scr_row < 0 ? 0 : scr_col);
+        scr_emit("\033M");
+        scr_shift_down(scr_front, scr_front_attr);
+    }
+
+    for (row = 0; row < SCREEN_HEIGHT; row++) {
+        if (!scr_dirty[row])
+            continue;
+        scr_dirty[row] = 0;
+        b = scr_back + row * SCREEN_WIDTH;
+        f = scr_front + row * SCREEN_WIDTH;
+        ba = scr_back_attr + row * SCREEN_WIDTH;
+        fa = scr_front_attr + row * SCREEN_WIDTH;
+        for (col = 0; col < SCREEN_WIDTH; col++) {
+            if (b[col] == f[col] && ba[col] == fa[col])
+                continue;
+            if (scr_len > scr_size - SCR_RAW_MAX - SCR_CELL_MAX)
+                scr_flush();
+            scr_move(row, col);
+            if (ba[col] != scr_attr) {
+                scr_emit(ba[col] == A_ALT ? scr_alt_on : scr_alt_off);
+                scr_attr = ba[col];
+            }
+            scr_out[scr_len++] = b[col];
+            f[col] = b[col];
+            fa[col] = ba[col];
+            /* In the last column the cursor waits to wrap; don't guess */
+            if (++scr_col == SCREEN_WIDTH)
+                scr_row = -1;
+        }
+    }
+
+    scr_flush();
+    bytes = scr_bytes - scr_sent;
+    scr_sent = scr_bytes;
+    scr_frames++;
+    scr_pace(bytes);
+}
+
+/* Put the terminal back: cursor shown, bottom left, or cleared and home */
+void scr_end(clear)
+int clear;
+{
+    char buf[32];
+
+    if (scr_attr != A_NORMAL)
+        scr_emit(scr_alt_off);
+    if (clear)
+        sprintf(buf, "\033[r\033[2J\033[H\033[?25h");
+    else
+        sprintf(buf, "\033[r\033[%d;1H\033[?25h", SCREEN_HEIGHT);
+    scr_emit(buf);
+    scr_flush();
+    if (getenv("SCREEN_STATS") != NULL && scr_frames > 0)
+        fprintf(stderr, "%ld frames, %ld bytes, %ld bytes per frame\n",
+                scr_frames, scr_bytes, scr_bytes / scr_frames);
+}
@@ -20,58 +20,12 @@
 #include <math.h>
 #include <sys/ioctl.h>
 
-#if defined(__NetBSD__) || defined(__APPLE__) || defined(__linux__)
-#define USE_DELAY 1
-#include <unistd.h>
-#else
-#define USE_DELAY 0
-#endif
-
-/* Default fallback values if terminal size detection fails */
-#define DEFAULT_WIDTH 80
-#define DEFAULT_HEIGHT 24
-
 #define NUMSINES 3  /* Number of sine waves */
 #ifndef M_PI
 #define M_PI 3.14159265358979323846  /* Define pi if not defined */
 #endif
 
-/* Global variables for screen dimensions */
-int SCREEN_WIDTH = DEFAULT_WIDTH;
-int SCREEN_HEIGHT = DEFAULT_HEIGHT;
-
-/* Function to get terminal size */
-void get_terminal_size()
-{
-#ifdef TIOCGWINSZ
-    struct winsize ws;
-    
-    /* Try to get window size using ioctl */
-    if (ioctl(0, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
-        SCREEN_WIDTH = ws.ws_col;
-        SCREEN_HEIGHT = ws.ws_row;
-        return;
-    }
-#endif
-    
-    /* Fallback: try environment variables */
-    {
-        char *cols_env = getenv("COLUMNS");
-        char *lines_env = getenv("LINES");
-        
-        if (cols_env != NULL) {
-            int cols = atoi(cols_env);
-            if (cols > 0) SCREEN_WIDTH = cols;
-        }
-        
-        if (lines_env != NULL) {
-            int lines = atoi(lines_env);
-            if (lines > 0) SCREEN_HEIGHT = lines;
-        }
-    }
-    
-    /* If all else fails, use the defaults already set */
-}
+#include "screen.c"
 
 static void restore_on_exit();
 
@@ -82,8 +36,8 @@ int main()
     int col, i;
     int center_col, amplitude;
 
-    /* Get the terminal size */
-    get_terminal_size();
+    /* Get the terminal size, hide the cursor and clear the screen; 50ms frames */
+    scr_init(50000L);
     
     /* Calculate dynamic center and amplitude based on screen width */
     center_col = SCREEN_WIDTH / 2;
@@ -99,17 +53,6 @@ int main()
     (void) signal(SIGINT,  restore_on_exit);
     (void) signal(SIGTERM, restore_on_exit);
 
-    /* Hide the cursor */
-    printf("\033[?25l");
-
-    /* Set scrolling region to full screen using detected size */
-    printf("\033[1;%dr", SCREEN_HEIGHT);
-
-    /* Clear screen once at the beginning (optional) */
-    printf("\033[2J");
-
-    fflush(stdout);
-
     /* Main loop: increment angles and draw sine waves */
     while (1) {
         for (i = 0; i < NUMSINES; i++) {
@@ -118,30 +61,18 @@ int main()
             if (col < 1)   col = 1;
             if (col > SCREEN_WIDTH)  col = SCREEN_WIDTH;
 
-            /* Move cursor to top row, (col) in 1-based indexing */
-            printf("\033[1;%dH", col);
-
-            /* Print the '*' for this sine wave */
-            putchar('*');
+            /* Put the '*' for this sine wave in the top row, (col) in 1-based indexing */
+            scr_put(0, col - 1, '*');
 
             /* Increment angle for wave motion */
             angles[i] += angle_steps[i];
         }
 
-        /* Move cursor back to top-left (just to be sure) */
-        printf("\033[1;1H");
-
-        /* Issue Reverse Index to scroll entire screen down by 1 line */
-        printf("\033M");
-
-        /* Flush output so it shows up now */
-        fflush(stdout);
-
-        /* Small delay */
-#if USE_DELAY
-        usleep(50000); /* 50ms delay on NetBSD */
-#endif
+        /* Scroll entire screen down by 1 line (a Reverse Index) */
+        scr_scroll_down();
 
+        /* Send the changes and wait for the next frame */
+        scr_refresh();
     }
 
     /* Normally never reached, but just in case */
@@ -154,17 +85,8 @@ int main()
 static void restore_on_exit(signum)
 int signum;
 {
-    /* Show the cursor again */
-    printf("\033[?25h");
-
-    /* Reset scrolling region */
-    printf("\033[r");
-
-    /* Move cursor to bottom of screen */
-    printf("\033[%d;1H", SCREEN_HEIGHT);
-
-    /* Flush out any pending output */
-    fflush(stdout);
+    /* Show the cursor, reset the scrolling region, go to the bottom */
+    scr_end(0);
 
     /* Exit gracefully */
     exit(0);
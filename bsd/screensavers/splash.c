@@ -18,7 +18,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
-#include <sgtty.h>
 #include <sys/ioctl.h>
 
 
@@ -33,6 +32,8 @@
 #define BORDER_CHAR_LRCORNER '+'
 #define TITLE_TEXT "DEC PDP-11/83"
 
+#include "screen.c"
+
 /* Function Prototypes */
 void cleanup();
 void handle_signal();
@@ -42,21 +43,20 @@ void set_terminal_raw();
 void reset_terminal();
 
 /* Global variable to store original terminal settings */
+#if USE_TERMIOS
+struct termios orig_tty;
+#else
 struct sgttyb orig_tty;
+#endif
 
 /* Cleanup function to reset terminal before exiting */
 void cleanup()
 {
-    /* Clear screen and reset cursor */
-    printf("\033[2J\033[H");
+    /* Clear screen, reset cursor and show it */
+    scr_end(1);
 
     /* Reset terminal to original settings */
     reset_terminal();
-
-    /* Show cursor */
-    printf("\033[?25h");
-
-    fflush(stdout);
 }
 
 /* Signal handler to ensure cleanup on termination */
@@ -70,6 +70,22 @@ int sig;
 /* Set terminal to raw mode to capture key press */
 void set_terminal_raw()
 {
+#if USE_TERMIOS
+    struct termios new_tty;
+
+    /* Get current terminal settings */
+    tcgetattr(1, &orig_tty);        /* Using file descriptor 1 for stdout */
+    new_tty = orig_tty;
+
+    /* Disable echo, line editing, signals and CR mapping, as RAW does */
+    new_tty.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+    new_tty.c_iflag &= ~(ICRNL | IXON);
+    new_tty.c_cc[VMIN] = 1;
+    new_tty.c_cc[VTIME] = 0;
+
+    /* Apply new terminal settings */
+    tcsetattr(1, TCSANOW, &new_tty);
+#else
     struct sgttyb new_tty;
 
     /* Get current terminal settings */
@@ -82,12 +98,17 @@ void set_terminal_raw()
 
     /* Apply new terminal settings */
     ioctl(1, TIOCSETP, &new_tty);
+#endif
 }
 
 /* Reset terminal to original settings */
 void reset_terminal()
 {
+#if USE_TERMIOS
+    tcsetattr(1, TCSANOW, &orig_tty);
+#else
     ioctl(1, TIOCSETP, &orig_tty);  /* Using file descriptor 1 for stdout */
+#endif
 }
 
 /* Function to draw an 80x24 border around the screen */
@@ -95,31 +116,25 @@ void draw_border()
 {
     int row, col;
 
-    /* Move cursor to home position */
-    printf("\033[H");
-
     /* Draw top border */
-    printf("%c", BORDER_CHAR_ULCORNER);
+    scr_put(0, 0, BORDER_CHAR_ULCORNER);
     for (col = 1; col < SCREEN_COLS - 1; col++) {
-        printf("%c", BORDER_CHAR_H);
+        scr_put(0, col, BORDER_CHAR_H);
     }
-    printf("%c\n", BORDER_CHAR_URCORNER);
+    scr_put(0, SCREEN_COLS - 1, BORDER_CHAR_URCORNER);
 
-    /* Draw side borders */
-    for (row = 2; row < SCREEN_ROWS; row++) {
-        printf("%c", BORDER_CHAR_V);
-        for (col = 1; col < SCREEN_COLS - 1; col++) {
-            printf(" ");
-        }
-        printf("%c\n", BORDER_CHAR_V);
+    /* Draw side borders; the inside is already blank */
+    for (row = 1; row < SCREEN_ROWS - 1; row++) {
+        scr_put(row, 0, BORDER_CHAR_V);
+        scr_put(row, SCREEN_COLS - 1, BORDER_CHAR_V);
     }
 
     /* Draw bottom border */
-    printf("%c", BORDER_CHAR_LLCORNER);
+    scr_put(SCREEN_ROWS - 1, 0, BORDER_CHAR_LLCORNER);
     for (col = 1; col < SCREEN_COLS - 1; col++) {
-        printf("%c", BORDER_CHAR_H);
+        scr_put(SCREEN_ROWS - 1, col, BORDER_CHAR_H);
     }
-    printf("%c\n", BORDER_CHAR_LRCORNER);
+    scr_put(SCREEN_ROWS - 1, SCREEN_COLS - 1, BORDER_CHAR_LRCORNER);
 }
 
 /* Function to display the title in double-height characters */
@@ -132,40 +147,30 @@ void display_title()
     pos_row = SCREEN_ROWS / 2 - 1; /* Approximate center row */
     pos_col = (SCREEN_COLS - title_length) / 2;
 
-    /* Move cursor to the title row */
-    printf("\033[%d;%dH", pos_row, pos_col);
-
-    /* Enable double-height characters (top half) */
-    printf("\033#3");
-
-    /* Print the title */
-    printf("%s", TITLE_TEXT);
-
-    /* Disable double-height characters (return to normal) */
-    printf("\033#5");
-
-    fflush(stdout);
+    /* Put the title on its row (1-based position) */
+    scr_puts(pos_row - 1, pos_col - 1, TITLE_TEXT);
 }
 
 int main()
 {
     int c;
 
+    /* Clear the screen and hide cursor */
+    scr_init(0L);
+
     /* Setup signal handlers */
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
-    /* Clear the screen and hide cursor */
-    printf("\033[2J");        /* Clear entire screen */
-    printf("\033[?25l");      /* Hide cursor */
-    fflush(stdout);
-
     /* Draw the border */
     draw_border();
 
     /* Display the title */
     display_title();
 
+    /* Send it */
+    scr_refresh();
+
     /* Set terminal to raw mode to capture key press */
     set_terminal_raw();
 
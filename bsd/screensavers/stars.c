@@ -20,25 +20,11 @@
 #include <time.h>
 #include <sys/ioctl.h>
 
-#if defined(__NetBSD__) || defined(__APPLE__) || defined(__linux__)
-#define USE_DELAY 1
-#include <unistd.h>
-#else
-#define USE_DELAY 0
-#endif
-
-/* Default fallback values if terminal size detection fails */
-#define DEFAULT_WIDTH 80
-#define DEFAULT_HEIGHT 24
-
 #define NUM_STARS 20
 #define STAR_CHAR '*'
 #define SPACE_CHAR ' '
-#define DELAY_COUNT 20000 /* Approximate delay loop count */
 
-/* Global variables for screen dimensions */
-int SCREEN_ROWS = DEFAULT_HEIGHT;
-int SCREEN_COLS = DEFAULT_WIDTH;
+#include "screen.c"
 
 struct Star {
     int row;
@@ -53,13 +39,10 @@ void cleanup();
 void handle_signal();
 int random_coord();
 void draw_star();
-void delay();
-void get_terminal_size();
 
 /* Cleanup function to reset terminal before exiting */
 void cleanup() {
-    printf("\033[2J\033[H"); /* Clear screen and reset cursor */
-    printf("\033[?25h");     /* Show cursor */
+    scr_end(1);               /* Clear screen, reset cursor, show cursor */
     printf("Exiting...\n");
     fflush(stdout);
 }
@@ -84,50 +67,7 @@ void draw_star(row, col, ch)
 int row, col;
 char ch;
 {
-    printf("\033[%d;%dH%c", row, col, ch); /* Position cursor and draw character */
-    fflush(stdout);
-}
-
-/* Delay function (busy loop) */
-void delay()
-{
-    int i;
-    for (i = 0; i < DELAY_COUNT; i++) {
-        /* Empty loop to create delay */
-    }
-}
-
-/* Function to get terminal size */
-void get_terminal_size()
-{
-#ifdef TIOCGWINSZ
-    struct winsize ws;
-    
-    /* Try to get window size using ioctl */
-    if (ioctl(0, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
-        SCREEN_COLS = ws.ws_col;
-        SCREEN_ROWS = ws.ws_row;
-        return;
-    }
-#endif
-    
-    /* Fallback: try environment variables */
-    {
-        char *cols_env = getenv("COLUMNS");
-        char *lines_env = getenv("LINES");
-        
-        if (cols_env != NULL) {
-            int cols = atoi(cols_env);
-            if (cols > 0) SCREEN_COLS = cols;
-        }
-        
-        if (lines_env != NULL) {
-            int lines = atoi(lines_env);
-            if (lines > 0) SCREEN_ROWS = lines;
-        }
-    }
-    
-    /* If all else fails, use the defaults already set */
+    scr_put(row - 1, col - 1, ch); /* Draw the character at the 1-based position */
 }
 
 /* Main function */
@@ -135,30 +75,23 @@ int main()
 {
     int i;
 
-    /* Get terminal dimensions */
-    get_terminal_size();
+    /* Get the terminal size, clear the screen and hide the cursor; 30ms frames */
+    scr_init(30000L);
 
     /* Setup signal handlers */
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
-    /* Clear the screen and hide the cursor */
-    printf("\033[2J");
-    printf("\033[?25l");
-    fflush(stdout);
-
     /* Seed the random number generator */
     srand(time(0));
 
-    /* Get the terminal size */
-    get_terminal_size();
-
     /* Initialize stars with random positions and draw them */
     for (i = 0; i < NUM_STARS; i++) {
-        stars[i].row = random_coord(SCREEN_ROWS);
-        stars[i].col = random_coord(SCREEN_COLS);
+        stars[i].row = random_coord(SCREEN_HEIGHT);
+        stars[i].col = random_coord(SCREEN_WIDTH);
         draw_star(stars[i].row, stars[i].col, STAR_CHAR);
     }
+    scr_refresh();
 
     /* Main animation loop */
     while (1) {
@@ -167,16 +100,14 @@ int main()
             draw_star(stars[i].row, stars[i].col, SPACE_CHAR);
 
             /* Generate a new position */
-            stars[i].row = random_coord(SCREEN_ROWS);
-            stars[i].col = random_coord(SCREEN_COLS);
+            stars[i].row = random_coord(SCREEN_HEIGHT);
+            stars[i].col = random_coord(SCREEN_WIDTH);
 
             /* Draw the star at the new position */
             draw_star(stars[i].row, stars[i].col, STAR_CHAR);
 
-            /* Delay after moving each star */
-#if USE_DELAY
-            usleep(30000); /* 30ms delay on NetBSD */
-#endif
+            /* Show the move, and wait before the next */
+            scr_refresh();
         }
     }
 
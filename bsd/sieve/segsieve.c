@@ -0,0 +1,315 @@
+/* Segmented Sieve of Eratosthenes
+
+   The classic sieve in sieve.c needs the whole odd-only bit array at once,
+   which is what limits it to 500K on the PDP-11 and spills out of cache
+   long before 10^9 on a modern machine.  This one sieves the same odd-only
+   bits a segment at a time, each segment sized to fit the L1 data cache,
+   so memory is a segment per thread plus the primes up to sqrt(limit).
+
+   Every odd number is one bit, which is the 2 of the wheel.  The 3, 5 and
+   7 of it, and the rest of the primes below the word size, are stamped
+   rather than crossed off: for a prime p the bits of its odd multiples
+   repeat every p words, so p precomputed words are ORed over the segment a
+   word at a time.  Larger primes are crossed off one bit at a time from
+   where each left off in the previous segment.
+
+   With threads, each thread takes a contiguous run of segments and counts
+   them with a population count; the counts are added at the end.
+   Printing is done from a single thread so the primes come out in order.
+
+   Included by sieve.c.
+*/
+
+#ifdef SIEVE_THREADS
+#include <pthread.h>
+#define MAX_THREADS 64
+#else
+#define MAX_THREADS 1
+#endif
+
+#ifdef __pdp11__
+#define SEG_BYTES 2048L         /* Leaves room in a 64K data space */
+#else
+#define SEG_BYTES 32768L        /* A typical L1 data cache */
+#endif
+
+typedef unsigned long sieve_word;
+
+#define WORD_BITS ((int)(sizeof(sieve_word) * BITSPERBYTE))
+#define WORD_SHIFT (sizeof(sieve_word) == 8 ? 6 : 5)
+#define WORD_MASK (WORD_BITS - 1)
+#define SEG_WORDS (SEG_BYTES / (long)sizeof(sieve_word))
+#define SEG_BITS (SEG_WORDS * WORD_BITS)
+
+/* Sieving primes: the odd primes up to sqrt(limit) */
+static long *seg_primes;
+static int seg_nprimes;
+
+/* For stamped primes, one period of their pattern; the rest are crossed */
+static sieve_word *stamp_words;
+static int stamp_nprimes;       /* seg_primes[0 .. stamp_nprimes-1] */
+static long *stamp_offset;      /* Start of each prime's period */
+
+/* Bit i of the odd-only array is the number 2i+1 */
+#define BIT_NUMBER(i) (2 * (i) + 1)
+
+struct seg_job {
+    long first_seg, end_seg;    /* Segments [first_seg, end_seg) */
+    long nbits;                 /* Bits in the whole array */
+    int print_primes;
+    long count;                 /* Primes found, not counting 2 */
+    sieve_word *seg;
+    long *next;                 /* Next bit to cross for each crossed prime */
+};
+
+/* Find the sieving primes with the classic sieve, and build the stamps */
+static int seg_setup(long limit) {
+    long root, i, j, n, w, total;
+    char *small;
+    size_t size;
+
+    root = 1;
+    while ((root + 1) * (root + 1) <= limit) {
+        root++;
+    }
+
+    size = (root + 1) / 2 / BITSPERBYTE + 1;
+    small = (char *) calloc(size, 1);
+    seg_primes = (long *) malloc(sizeof(long) * (root / 2 + 1));
+    if (small == NULL || seg_primes == NULL) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    seg_nprimes = 0;
+    for (i = 3; i <= root; i += 2) {
+        if (!GET_BIT(small, i / 2)) {
+            seg_primes[seg_nprimes++] = i;
+            for (j = i * i; j <= root; j += 2 * i) {
+                SET_BIT(small, j / 2);
+            }
+        }
+    }
+    free(small);
+
+    /* Primes below the word size are stamped; each period is p words */
+    total = 0;
+    for (stamp_nprimes = 0; stamp_nprimes < seg_nprimes &&
+         seg_primes[stamp_nprimes] < WORD_BITS; stamp_nprimes++) {
+        total += seg_primes[stamp_nprimes];
+    }
+    stamp_words = (sieve_word *) calloc(total + 1, sizeof(sieve_word));
+    stamp_offset = (long *) malloc(sizeof(long) * (stamp_nprimes + 1));
+    if (stamp_words == NULL || stamp_offset == NULL) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    total = 0;
+    for (i = 0; i < stamp_nprimes; i++) {
+        n = seg_primes[i];
+        stamp_offset[i] = total;
+        /* Odd multiples of p are the bits congruent to (p-1)/2 mod p */
+        for (j = (n - 1) / 2; j < n * WORD_BITS; j += n) {
+            w = j / WORD_BITS;
+            stamp_words[total + w] |= (sieve_word) 1 << (j % WORD_BITS);
+        }
+        total += n;
+    }
+    return 1;
+}
+
+static void seg_cleanup(void) {
+    free(seg_primes);
+    free(stamp_words);
+    free(stamp_offset);
+    seg_primes = NULL;
+    stamp_words = NULL;
+    stamp_offset = NULL;
+}
+
+/* First bit at or after start that is an odd multiple of p, from p*p */
+static long seg_first(long p, long start) {
+    long j, sq;
+
+    sq = (p * p - 1) / 2;
+    if (sq >= start) {
+        return sq;
+    }
+    j = start + ((p - 1) / 2 - start % p + p) % p;
+    return j;
+}
+
+/* Sieve the job's segments, counting (and printing) what is left */
+static void seg_run(struct seg_job *job) {
+    sieve_word *seg = job->seg;
+    sieve_word *pat, word;
+    long s, base, nwords, w, k, i, j, p, bits;
+
+    for (i = stamp_nprimes; i < seg_nprimes; i++) {
+        job->next[i] = seg_first(seg_primes[i], job->first_seg * SEG_BITS);
+    }
+
+    for (s = job->first_seg; s < job->end_seg; s++) {
+        base = s * SEG_BITS;
+        bits = job->nbits - base < SEG_BITS ? job->nbits - base : SEG_BITS;
+        nwords = (bits + WORD_BITS - 1) / WORD_BITS;
+        memset(seg, 0, nwords * sizeof(sieve_word));
+
+        /* Stamp the small primes a word at a time */
+        for (i = 0; i < stamp_nprimes; i++) {
+            p = seg_primes[i];
+            pat = stamp_words + stamp_offset[i];
+            k = (base / WORD_BITS) % p;
+            for (w = 0; w < nwords; w++) {
+                seg[w] |= pat[k];
+                if (++k == p) {
+                    k = 0;
+                }
+            }
+        }
+
+        /* Cross off the larger primes from where they left off */
+        for (i = stamp_nprimes; i < seg_nprimes; i++) {
+            p = seg_primes[i];
+            for (j = job->next[i] - base; j < bits; j += p) {
+                seg[j >> WORD_SHIFT] |= (sieve_word) 1 << (j & WORD_MASK);
+            }
+            job->next[i] = base + j;
+        }
+
+        /* The stamps crossed off the stamped primes themselves, and 1 */
+        if (s == 0) {
+            seg[0] |= 1;
+            for (i = 0; i < stamp_nprimes; i++) {
+                j = seg_primes[i] / 2;
+                seg[j / WORD_BITS] &= ~((sieve_word) 1 << (j % WORD_BITS));
+            }
+        }
+
+        /* Bits past the limit in the last word are not candidates */
+        if (bits % WORD_BITS) {
+            seg[nwords - 1] |= ~(sieve_word) 0 << (bits % WORD_BITS);
+        }
+
+        for (w = 0; w < nwords; w++) {
+            job->count += WORD_BITS - POPCOUNT(seg[w]);
+        }
+        if (job->print_primes) {
+            for (w = 0; w < nwords; w++) {
+                for (word = ~seg[w]; word; word &= word - 1) {
+                    out_number(BIT_NUMBER(base + w * WORD_BITS +
+                                          LOWEST_BIT(word)));
+                }
+            }
+        }
+    }
+}
+
+static struct seg_job *seg_job_new(long nbits, int print_primes) {
+    struct seg_job *job;
+
+    job = (struct seg_job *) calloc(1, sizeof(struct seg_job));
+    if (job == NULL) {
+        return NULL;
+    }
+    job->nbits = nbits;
+    job->print_primes = print_primes;
+    job->seg = (sieve_word *) malloc(SEG_BYTES);
+    job->next = (long *) malloc(sizeof(long) * (seg_nprimes + 1));
+    if (job->seg == NULL || job->next == NULL) {
+        free(job->seg);
+        free(job->next);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+static void seg_job_free(struct seg_job *job) {
+    free(job->seg);
+    free(job->next);
+    free(job);
+}
+
+#ifdef SIEVE_THREADS
+static void *seg_thread(void *arg) {
+    seg_run((struct seg_job *) arg);
+    return NULL;
+}
+#endif
+
+void segmented_sieve(long limit, int print_primes, int threads, long *count_ptr) {
+    struct seg_job *jobs[MAX_THREADS];
+    long nbits, nsegs, count;
+    int t;
+#ifdef SIEVE_THREADS
+    pthread_t tids[MAX_THREADS];
+    int running[MAX_THREADS];
+#endif
+
+    *count_ptr = 0;
+    if (limit < 2) {
+        return;
+    }
+    if (!seg_setup(limit)) {
+        seg_cleanup();
+        return;
+    }
+
+    nbits = (limit + 1) / 2;
+    nsegs = (nbits + SEG_BITS - 1) / SEG_BITS;
+    if (print_primes || threads < 1) {
+        threads = 1;
+    }
+    if (threads > nsegs) {
+        threads = (int) nsegs;
+    }
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    for (t = 0; t < threads; t++) {
+        jobs[t] = seg_job_new(nbits, print_primes);
+        if (jobs[t] == NULL) {
+            printf("Memory allocation failed\n");
+            while (--t >= 0) {
+                seg_job_free(jobs[t]);
+            }
+            seg_cleanup();
+            return;
+        }
+        jobs[t]->first_seg = nsegs * t / threads;
+        jobs[t]->end_seg = nsegs * (t + 1) / threads;
+    }
+
+    if (print_primes) {
+        out_begin();
+        out_number(2);
+    }
+#ifdef SIEVE_THREADS
+    for (t = 1; t < threads; t++) {
+        running[t] = pthread_create(&tids[t], NULL, seg_thread, jobs[t]) == 0;
+        if (!running[t]) {
+            /* Do it on this thread instead */
+            seg_run(jobs[t]);
+        }
+    }
+#endif
+    seg_run(jobs[0]);
+    count = 1;  /* 2 is a prime number */
+    for (t = 0; t < threads; t++) {
+#ifdef SIEVE_THREADS
+        if (t > 0 && running[t]) {
+            pthread_join(tids[t], NULL);
+        }
+#endif
+        count += jobs[t]->count;
+        seg_job_free(jobs[t]);
+    }
+    if (print_primes) {
+        out_char('\n');
+        out_flush();
+    }
+
+    seg_cleanup();
+    *count_ptr = count;
+}
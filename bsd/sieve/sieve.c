@@ -7,12 +7,17 @@
    algorithm.  It follows the basic rules of the Primes competition in 
    Dave's Garage, but it is limited to a 500K limit due to available ram.
 
+   With -S it runs the segmented sieve in segsieve.c instead, which needs
+   only a cache-sized segment at a time and so reaches 10^9 and beyond;
+   built with SIEVE_THREADS, -t spreads its segments over threads.
+
 */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/time.h>
 /* getopt is in stdlib.h on 2.11BSD, but in getopt.h on modern systems */
 #ifdef __pdp11__
@@ -29,10 +34,13 @@
 #define GET_BIT(array, n) ((array[(n) / BITSPERBYTE] >> ((n) % BITSPERBYTE)) & 1)
 #define SET_BIT(array, n) (array[(n) / BITSPERBYTE] |= (1 << ((n) % BITSPERBYTE)))
 
+#include "sieveio.c"
+#include "segsieve.c"
+
 /* Structure to hold the expected results for a given limit */
 struct Result {
     long limit;
-    int count;
+    long count;
 };
 
 struct Result resultsDictionary[] = {
@@ -41,19 +49,29 @@ struct Result resultsDictionary[] = {
     {1000L, 168},
     {10000L, 1229},
     {100000L, 9592},
-    {500000L, 41538},
-    {1000000L, 78498},
+    {500000L, 41538L},
+    {1000000L, 78498L},
+    {10000000L, 664579L},
+    {100000000L, 5761455L},
+    {1000000000L, 50847534L},
+#if LONG_MAX > 2147483647L
+    {10000000000L, 455052511L},
+#endif
 };
 
 /* Program Help */
 void print_help(char *progname) {
-    printf("Usage: %s [-l limit] [-s seconds] [-1] [-p] [-q] [-h|-?]\n", progname);
+    printf("Usage: %s [-l limit] [-s seconds] [-1] [-p] [-q] [-S] [-t threads] [-h|-?]\n", progname);
     printf("Options:\n");
     printf("  -l limit    Specify the upper limit for prime calculation (default: 1000)\n");
     printf("  -s seconds  Specify the duration to run the sieve (default: 5 seconds)\n");
     printf("  -1          Run the sieve only once (oneshot mode)\n");
     printf("  -p          Print the primes as they are found\n");
     printf("  -q          Suppress banners and extraneous output\n");
+    printf("  -S          Use the segmented sieve\n");
+#ifdef SIEVE_THREADS
+    printf("  -t threads  Threads for the segmented sieve (default: 1)\n");
+#endif
     printf("  -h, -?      Print this help message and exit\n");
 }
 
@@ -69,12 +87,12 @@ int validate_results(long limit, long count) {
 }
 
 void sieve_of_eratosthenes(long limit, int print_primes, long *count_ptr) {
-    long i, j, count;
+    long i, j, last, count;
+    unsigned long bits;
     size_t size;
     char *sieve;
 
     size = (limit + 1) / 2 / BITSPERBYTE + 1;
-    count = 1;  /* 2 is a prime number */
     sieve = (char *) calloc(size, 1);
 
     if (sieve == NULL) {
@@ -90,21 +108,29 @@ void sieve_of_eratosthenes(long limit, int print_primes, long *count_ptr) {
         }
     }
 
-    if (print_primes) {
-        printf("2 ");
-    }
+    /* Bits 1 to last are the odd numbers 3 to limit; the clear ones are prime */
+    last = (limit - 1) / 2;
+    count = 1 + last - count_bits(sieve, last + 1);  /* 2 is a prime number */
 
-    for (i = 3; i <= limit; i += 2) {
-        if (!GET_BIT(sieve, i / 2)) {
-            count++;
-            if (print_primes) {
-                printf("%ld ", i);
+    if (print_primes) {
+        out_begin();
+        out_number(2);
+        for (i = 0; i <= last / BITSPERBYTE; i++) {
+            bits = ~sieve[i] & 0xff;
+            if (i == 0) {
+                bits &= ~1UL;   /* 1 is not prime */
+            }
+            while (bits) {
+                j = i * BITSPERBYTE + LOWEST_BIT(bits);
+                bits &= bits - 1;
+                if (j > last) {
+                    break;
+                }
+                out_number(2 * j + 1);
             }
         }
-    }
-
-    if (print_primes) {
-        printf("\n");
+        out_char('\n');
+        out_flush();
     }
 
     free(sieve);
@@ -118,6 +144,8 @@ int main(int argc, char *argv[]) {
     int oneshot;
     int print_primes;
     int quiet;
+    int segmented;
+    int threads;
     int seconds;
     int opt;
     int passes;
@@ -129,12 +157,15 @@ int main(int argc, char *argv[]) {
     oneshot = 0;
     print_primes = 0;
     quiet = 0;
+    segmented = 0;
+    threads = 1;
     seconds = DEFAULT_SECONDS;
     passes = 0;
     total_time = 0;
+    bits_init();
     prime_count = 0;
 
-    while ((opt = getopt(argc, argv, "l:s:1pq?h")) != -1) {
+    while ((opt = getopt(argc, argv, "l:s:1pqSt:?h")) != -1) {
         switch (opt) {
             case 'l':
                 limit = atol(optarg);
@@ -151,6 +182,12 @@ int main(int argc, char *argv[]) {
             case 'q':
                 quiet = 1;
                 break;
+            case 'S':
+                segmented = 1;
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
             case 'h':
             case '?':
                 print_help(argv[0]);
@@ -170,12 +207,21 @@ int main(int argc, char *argv[]) {
 
     if (!quiet) {
         printf("Solving primes up to %ld\n", limit);
+        if (segmented) {
+            printf("Segmented, %ld byte segments, %d thread%s\n", SEG_BYTES,
+                   threads > MAX_THREADS ? MAX_THREADS : threads,
+                   threads == 1 ? "" : "s");
+        }
         printf("------------------------------------\n");
     }
 
     do {
         gettimeofday(&start_time, NULL);
-        sieve_of_eratosthenes(limit, print_primes, &prime_count);
+        if (segmented) {
+            segmented_sieve(limit, print_primes, threads, &prime_count);
+        } else {
+            sieve_of_eratosthenes(limit, print_primes, &prime_count);
+        }
         passes++;
         gettimeofday(&current_time, NULL);
         elapsed_time = (current_time.tv_sec - start_time.tv_sec) + 
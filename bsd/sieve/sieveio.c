@@ -0,0 +1,146 @@
+/* Counting and printing for the sieves
+
+   Counting the primes is a matter of counting the bits the sieve left
+   clear, so it is done a word at a time with a population count: the
+   compiler's builtin (one instruction on most modern CPUs) where there is
+   one, and a 256-entry table of byte counts on the PDP-11.
+
+   Printing with printf("%ld ") per prime costs far more than finding
+   them.  Here each number is formatted by hand, two digits at a time from
+   a table, into a large buffer that goes out with write() when it fills,
+   so a run with -p still mostly measures the sieve.
+
+   Included by sieve.c.
+*/
+
+#include <unistd.h>
+
+#ifdef __pdp11__
+#define OUT_BYTES 1024
+#else
+#define OUT_BYTES 65536
+#endif
+
+/* Bits set in each byte value */
+static unsigned char byte_bits[256];
+
+static char out_buf[OUT_BYTES];
+static int out_len;
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void bits_init(void) {
+    int i;
+
+    for (i = 1; i < 256; i++) {
+        byte_bits[i] = (unsigned char) ((i & 1) + byte_bits[i / 2]);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__pdp11__)
+#define POPCOUNT(w) __builtin_popcountl(w)
+#define LOWEST_BIT(w) __builtin_ctzl(w)
+#else
+#define POPCOUNT(w) popcount_long(w)
+#define LOWEST_BIT(w) lowest_bit(w)
+
+static int popcount_long(unsigned long w) {
+    int n;
+
+    for (n = 0; w; w >>= 8) {
+        n += byte_bits[w & 0xff];
+    }
+    return n;
+}
+
+static int lowest_bit(unsigned long w) {
+    int b;
+
+    for (b = 0; !(w & 0xff); b += 8) {
+        w >>= 8;
+    }
+    while (!(w & 1)) {
+        w >>= 1;
+        b++;
+    }
+    return b;
+}
+#endif
+
+/* Number of bits set in the first nbits bits of a byte array */
+long count_bits(const char *array, long nbits) {
+    unsigned long w;
+    long i, n, whole;
+
+    n = 0;
+    whole = nbits / BITSPERBYTE;
+    for (i = 0; i + (long) sizeof(w) <= whole; i += sizeof(w)) {
+        memcpy(&w, array + i, sizeof(w));
+        n += POPCOUNT(w);
+    }
+    for (; i < whole; i++) {
+        n += byte_bits[(unsigned char) array[i]];
+    }
+    if (nbits % BITSPERBYTE) {
+        n += byte_bits[(unsigned char) array[whole] &
+                       ((1 << (nbits % BITSPERBYTE)) - 1)];
+    }
+    return n;
+}
+
+void out_flush(void) {
+    int done, n;
+
+    for (done = 0; done < out_len; done += n) {
+        n = write(1, out_buf + done, out_len - done);
+        if (n <= 0) {
+            break;
+        }
+    }
+    out_len = 0;
+}
+
+/* Start bulk output; anything stdio holds has to go first */
+void out_begin(void) {
+    fflush(stdout);
+    out_len = 0;
+}
+
+void out_char(int c) {
+    if (out_len == OUT_BYTES) {
+        out_flush();
+    }
+    out_buf[out_len++] = (char) c;
+}
+
+/* Append n and a space */
+void out_number(long n) {
+    char digits[24];
+    char *p;
+    int i;
+
+    if (out_len > OUT_BYTES - (int) sizeof(digits)) {
+        out_flush();
+    }
+    p = digits + sizeof(digits);
+    while (n >= 100) {
+        i = (int) (n % 100) * 2;
+        n /= 100;
+        *--p = digit_pairs[i + 1];
+        *--p = digit_pairs[i];
+    }
+    if (n >= 10) {
+        i = (int) n * 2;
+        *--p = digit_pairs[i + 1];
+        *--p = digit_pairs[i];
+    } else {
+        *--p = (char) ('0' + n);
+    }
+    i = (int) (digits + sizeof(digits) - p);
+    memcpy(out_buf + out_len, p, i);
+    out_len += i;
+    out_buf[out_len++] = ' ';
+}
@@ -32,36 +32,16 @@ extern int memcmp();
 #define SEEK_END 2
 #endif
 
+#include "ksym.c"
+
 int find_symbol(name, addr)
 char *name;
 void **addr;
 {
-    FILE *fp;
-    char line[256];
-    char symbol[64];
-    uintptr_t sym_addr;
-    char type;
-    
-    fp = popen("nm /unix 2>/dev/null", "r");
-    if (fp == NULL) {
-        fp = popen("nm /vmunix 2>/dev/null", "r");
-        if (fp == NULL) {
-            return -1;
-        }
-    }
-    
-    *addr = NULL;
-    while (fgets(line, sizeof(line), fp)) {
-        if (sscanf(line, "%lo %c %s", &sym_addr, &type, symbol) == 3 ||
-            sscanf(line, "%lx %c %s", &sym_addr, &type, symbol) == 3) {
-            if (strcmp(symbol, name) == 0) {
-                *addr = (void*)sym_addr;
-                break;
-            }
-        }
-    }
-    pclose(fp);
+    long sym_addr;
     
+    sym_addr = ksym_lookup(name);
+    *addr = sym_addr < 0 ? NULL : (void*)(uintptr_t)sym_addr;
     return (*addr != NULL) ? 0 : -1;
 }
 
@@ -1,6 +1,7 @@
 /*
  * client.c - Socket client for PDP-11 2.11BSD load testing
- * Sends panel data frames to server 30 times per second
+ * Sends panel data frames to server FRAMES_PER_SECOND times per second,
+ * or with -e only when the kernel reports a change (see send_changes())
  * PDP-11 specific implementation
  */
 
@@ -17,7 +18,7 @@
 #include <errno.h>
 #include <fcntl.h>
 
-wait_for_panel();
+int wait_for_panel();
 
 /* Don't include unistd.h on 211BSD - it may reference stdint.h */
 #ifndef __pdp11__
@@ -59,10 +60,18 @@ extern int optind;
 /* Fallback for systems without uintptr_t */
 typedef unsigned long uintptr_t; /* Fallback definition */
 
+#include "ksym.c"
+
 /* Function prototypes */
 int open_kmem_and_find_panel(void **panel_addr);
 int read_panel_from_kmem(int kmem_fd, void *panel_addr, struct pdp_panel_state *panel);
 void send_frames(int sockfd, struct sockaddr_in *server_addr);
+void send_changes(int sockfd, struct sockaddr_in *server_addr, int kmem_fd, void *panel_addr);
+
+/* Event-driven mode (-e) settings */
+int event_mode = 0;
+int max_rate = FRAMES_PER_SECOND;   /* -m: most frames per second */
+int heartbeat = 1;                  /* -b: seconds between idle frames */
 
 int main(int argc, char *argv[])
 {
@@ -74,18 +83,42 @@ int main(int argc, char *argv[])
     int kmem_fd;
     
     /* Parse command line arguments */
-    while ((c = getopt(argc, argv, "s:h")) != -1) {
+    while ((c = getopt(argc, argv, "s:h12em:b:")) != -1) {
         switch (c) {
         case 's':
             server_ip = optarg;
             break;
+        case '1':
+            panel_protocol = 1;
+            break;
+        case '2':
+            panel_protocol = 2;
+            break;
+        case 'e':
+            event_mode = 1;
+            break;
+        case 'm':
+            max_rate = atoi(optarg);
+            break;
+        case 'b':
+            heartbeat = atoi(optarg);
+            break;
         case 'h':
         case '?':
             usage(argv[0]);
+            printf("  -e             Send only when the panel changes\n");
+            printf("  -m hz          With -e, send at most hz frames a second (default: %d)\n",
+                   FRAMES_PER_SECOND);
+            printf("  -b seconds     With -e, resend an unchanged panel this often (default: 1)\n");
             exit(1);
         }
     }
     
+    if (max_rate < 1 || heartbeat < 1) {
+        usage(argv[0]);
+        exit(1);
+    }
+    
     printf("PDP-11 2.11BSD Panel Client\n");
     printf("Connecting to server at %s:%d via UDP\n", server_ip, SERVER_PORT);
     
@@ -106,8 +139,13 @@ int main(int argc, char *argv[])
         exit(1);
     }
     
-    printf("UDP socket created. Sending panel data to %s:%d at %d Hz...\n", 
-           server_ip, SERVER_PORT, FRAMES_PER_SECOND);
+    if (event_mode) {
+        printf("UDP socket created. Sending panel changes to %s:%d, at most %d Hz...\n",
+               server_ip, SERVER_PORT, max_rate);
+    } else {
+        printf("UDP socket created. Sending panel data to %s:%d at %d Hz...\n", 
+               server_ip, SERVER_PORT, FRAMES_PER_SECOND);
+    }
     printf("Packet size: %d bytes\n", (int)sizeof(struct pdp_panel_packet));
     printf("Note: UDP is connectionless - errors will be reported during transmission\n");
     
@@ -121,40 +159,16 @@ int main(int argc, char *argv[])
 
 int open_kmem_and_find_panel(void **panel_addr)
 {
-    FILE *fp;
-    char line[256];
-    char symbol[64];
-    uintptr_t addr;
-    char type;
+    long addr;
     int kmem_fd;
     
-    /* PDP-11 systems use /unix or /vmunix with octal addresses */
-    fp = popen("nm /unix | grep panel", "r");
-    if (fp == NULL) {
-        fp = popen("nm /vmunix | grep panel", "r");
-        if (fp == NULL) {
-            fprintf(stderr, "Cannot run nm to find panel symbol\n");
-            return -1;
-        }
-    }
-    
-    *panel_addr = NULL;
-    while (fgets(line, sizeof(line), fp)) {
-        /* Try both octal and hex formats */
-        if (sscanf(line, "%lo %c %s", &addr, &type, symbol) == 3 ||
-            sscanf(line, "%lx %c %s", &addr, &type, symbol) == 3) {
-            if (strcmp(symbol, "panel") == 0 || strcmp(symbol, "_panel") == 0) {
-                *panel_addr = (void*)addr;
-                break;
-            }
-        }
-    }
-    pclose(fp);
-    
-    if (*panel_addr == NULL) {
+    /* Read the symbol table of /unix (or /vmunix) directly */
+    addr = ksym_lookup("panel");
+    if (addr < 0) {
         fprintf(stderr, "Panel symbol not found in kernel symbol table\n");
         return -1;
     }
+    *panel_addr = (void*)(uintptr_t)addr;
     
     /* Open /dev/kmem */
     kmem_fd = open("/dev/kmem", O_RDONLY);
@@ -206,7 +220,6 @@ int read_panel_from_kmem(int kmem_fd, void *panel_addr, struct pdp_panel_state *
 void send_frames(int sockfd, struct sockaddr_in *server_addr)
 {
     struct pdp_panel_state panel;
-    struct pdp_panel_packet packet;
     int frame_count = 0;
     static void *panel_addr = NULL;
     static int kmem_fd = -1;
@@ -260,6 +273,11 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
     
     printf("Starting packet transmission loop...\n");
     
+    if (event_mode) {
+        send_changes(sockfd, server_addr, kmem_fd, panel_addr);
+        return;
+    }
+    
     while (1) {
         /* Read panel structure from kernel memory */
         if (read_panel_from_kmem(kmem_fd, panel_addr, &panel) < 0) {
@@ -267,14 +285,9 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
             break;
         }
         
-        /* Populate packet structure */
-        packet.header.pp_byte_count = sizeof(struct pdp_panel_state);
-        packet.header.pp_byte_flags = PANEL_PDP1170;  /* Set panel type flag */
-        packet.panel_state = panel;
-        
         /* Send panel packet via UDP */
-        send_result = sendto(sockfd, &packet, sizeof(packet), 0,
-                            (struct sockaddr *)server_addr, sizeof(*server_addr));
+        send_result = send_panel(sockfd, server_addr, PANEL_PDP1170,
+                                 (char *)&panel, sizeof(panel), 0);
         if (send_result < 0) {
             fprintf(stderr, "sendto failed after %d packets (errno=%d): ", frame_count, errno);
             perror("");
@@ -283,7 +296,76 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
         
         frame_count++;
         
-        /* Wait for next frame time */
-        wait_for_panel();
+        /*
+         * Wait for next frame time.  This used to sleep in
+         * wait_for_panel(), which returned on every clock tick; it now
+         * returns only when the panel changes, which would stall an idle
+         * panel here, so the fixed rate comes from a timer instead.
+         */
+        precise_delay(USEC_PER_FRAME);
+    }
+}
+
+/*
+ * Event-driven transmission.  Sleep in the kernel until the panel
+ * changes, then read and send it.  After each frame, pause for 1/max_rate
+ * of a second; changes during the pause are coalesced into the next read.
+ * A panel identical to the last one sent is skipped, except that one
+ * frame goes out every heartbeat seconds so the server knows we are
+ * alive.  An idle machine costs one wakeup a heartbeat instead of one a
+ * clock tick.
+ */
+void send_changes(int sockfd, struct sockaddr_in *server_addr, int kmem_fd, void *panel_addr)
+{
+    struct pdp_panel_state panel, sent;
+    struct timeval now, last;
+    long gap = 1000000L / max_rate;
+    long idle;
+    long changes = 0, frames = 0, skipped = 0;
+    int seq, next;
+    
+    seq = -1;   /* Never a valid sequence, so the first call returns at once */
+    gettimeofday(&last, NULL);
+    while (1) {
+        next = wait_for_panel(seq, heartbeat);
+        if (next < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("wait_for_panel");
+            break;
+        }
+        if (seq >= 0) {
+            changes += (next - seq) & 077777;
+        }
+        seq = next;
+        
+        if (read_panel_from_kmem(kmem_fd, panel_addr, &panel) < 0) {
+            fprintf(stderr, "Failed to read panel data from kernel\n");
+            break;
+        }
+        gettimeofday(&now, NULL);
+        idle = (now.tv_sec - last.tv_sec) * 1000000L + (now.tv_usec - last.tv_usec);
+        if (frames > 0 && idle < heartbeat * 1000000L &&
+            memcmp((char *)&panel, (char *)&sent, sizeof(panel)) == 0) {
+            skipped++;
+            continue;
+        }
+        
+        if (send_panel(sockfd, server_addr, PANEL_PDP1170,
+                       (char *)&panel, sizeof(panel), 0) < 0) {
+            fprintf(stderr, "sendto failed after %ld packets (errno=%d): ", frames, errno);
+            perror("");
+            break;
+        }
+        sent = panel;
+        last = now;
+        frames++;
+        if (frames % 1000 == 0) {
+            printf("%ld frames sent for %ld panel changes, %ld unchanged reads skipped\n",
+                   frames, changes, skipped);
+        }
+        
+        precise_delay(gap);
     }
 }
@@ -32,15 +32,13 @@ extern int memcmp();
 #define SEEK_END 2
 #endif
 
+#include "ksym.c"
+
 int main()
 {
     int kmem_fd;
     void *counter_addr = (void*)0;
-    FILE *fp;
-    char line[256];
-    char symbol[64];
-    uintptr_t addr;
-    char type;
+    long addr;
     long counter1, counter2;
     
     printf("Clock Test - checking if hardclock is being called\n");
@@ -48,23 +46,10 @@ int main()
     
     /* Find hardclock_counter symbol */
     printf("1. Finding hardclock_counter symbol:\n");
-    fp = popen("nm /unix 2>/dev/null | grep hardclock_counter", "r");
-    if (fp == NULL) {
-        fp = popen("nm /vmunix 2>/dev/null | grep hardclock_counter", "r");
-    }
-    
-    if (fp != NULL) {
-        while (fgets(line, sizeof(line), fp)) {
-            printf("   %s", line);
-            if (sscanf(line, "%lo %c %s", &addr, &type, symbol) == 3 ||
-                sscanf(line, "%lx %c %s", &addr, &type, symbol) == 3) {
-                if (strcmp(symbol, "hardclock_counter") == 0 || strcmp(symbol, "_hardclock_counter") == 0) {
-                    printf("   -> Using: %s at 0x%lx\n", symbol, addr);
-                    counter_addr = (void*)addr;
-                }
-            }
-        }
-        pclose(fp);
+    addr = ksym_lookup("hardclock_counter");
+    if (addr >= 0) {
+        printf("   -> Using: _hardclock_counter at 0x%lx\n", addr);
+        counter_addr = (void*)(uintptr_t)addr;
     }
     
     if (counter_addr == 0) {
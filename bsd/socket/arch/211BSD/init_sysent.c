@@ -176,7 +176,7 @@ struct sysent sysent[] = {
 	0, nosys,			/*  64 = (old getpagesize) */
 	6, pselect,			/*  65 = pselect */
 	0, vfork,			/*  66 = vfork */
-	0, sys_wait_for_panel,          /*  67 */
+	2, sys_wait_for_panel,		/*  67 = wait_for_panel */
 	0, nosys,			/*  68 = unused */
 	1, sbrk,			/*  69 = sbrk */
 	0, nosys,			/*  70 = unused */
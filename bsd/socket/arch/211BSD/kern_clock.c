@@ -16,6 +16,7 @@
 #include "dk.h"
 #include "kernel.h"
 #include "systm.h"
+#include "errno.h"
 
 sys_wait_for_panel();
 
@@ -92,7 +93,13 @@ struct panel_state {
     short ps_mmr3;
 } panel = { 0L, 0 };
 
+/*
+ * panel_seq counts changes to the panel; sys_wait_for_panel() sleeps on
+ * it.  panel_want is set while someone sleeps there, so an unwatched
+ * clock tick does not pay for a wakeup().
+ */
 int panel_seq = 0;
+int panel_want = 0;
 
 /*
  * The hz hardware interval timer.
@@ -114,6 +121,7 @@ hardclock(dev,sp,r1,ov,nps,r0,pc,ps)
 	register struct callout *p1;
 	register struct proc *p;
 	register int needsoft = 0;
+	unsigned long paddr;
 	mapinfo map;
 
 	savemap(map);		/* ensure normal mapping of kernel data */
@@ -219,10 +227,20 @@ hardclock(dev,sp,r1,ov,nps,r0,pc,ps)
 	/*
 	 * Update front panel display with current execution state.
 	 * Keep this simple and safe - just use the pc parameter directly.
+	 * Only a change counts as a panel event.
 	 */
-	panel.ps_address = decode_phys_addr((unsigned short)pc, (unsigned short)ps);
-	panel.ps_data    = (short)(r0 & 0xFFFF);	
-    panel.ps_psw     = (short)(ps & 0xFFFF);
+	paddr = decode_phys_addr((unsigned short)pc, (unsigned short)ps);
+	if (paddr != panel.ps_address || (short)r0 != panel.ps_data ||
+	    (short)ps != panel.ps_psw) {
+		panel.ps_address = paddr;
+		panel.ps_data    = (short)(r0 & 0xFFFF);
+		panel.ps_psw     = (short)(ps & 0xFFFF);
+		panel_seq++;
+		if (panel_want) {
+			panel_want = 0;
+			wakeup((caddr_t)&panel_seq);
+		}
+	}
 
 	/*
 	panel.ps_mser    = *(short *)017777744;
@@ -230,8 +248,6 @@ hardclock(dev,sp,r1,ov,nps,r0,pc,ps)
     panel.ps_mmr0    = *(short *)017777572;
     panel.ps_mmr3    = *(short *)017777516;
 	*/
-    panel_seq++;
-    wakeup((caddr_t)&panel_seq);
 
 	if (needsoft && BASEPRI(ps)) {	/* if ps is high, just return */
 		(void) _splsoftclock();
@@ -240,14 +256,39 @@ hardclock(dev,sp,r1,ov,nps,r0,pc,ps)
 	restormap(map);
 }
 
+/*
+ * wait_for_panel(seq, secs): sleep until the panel has changed since the
+ * caller saw sequence number seq, or for secs seconds if secs > 0.
+ * Returns the current sequence number, kept positive so -1 means error.
+ * Each caller passes its own seq, so several watchers do not steal each
+ * other's wakeups.
+ */
 sys_wait_for_panel()
 {
-	static int last_seq = 0;
-    while (last_seq == panel_seq)
-        tsleep((caddr_t)&panel_seq, PZERO | PCATCH, "waitseq", 0);
+	register struct a {
+		int	seq;
+		int	secs;
+	} *uap = (struct a *)u.u_ap;
+	register int s, error;
+	int timo;
 
-    last_seq = panel_seq;
-    return last_seq;
+	timo = 0;
+	if (uap->secs > 0)
+		timo = uap->secs > 0x7fff / hz ? 0x7fff : uap->secs * hz;
+	s = splclock();
+	while ((panel_seq & 077777) == uap->seq) {
+		panel_want = 1;
+		error = tsleep((caddr_t)&panel_seq, PZERO | PCATCH, timo);
+		if (error == EWOULDBLOCK)
+			break;
+		if (error) {
+			splx(s);
+			u.u_error = error;
+			return;
+		}
+	}
+	splx(s);
+	u.u_r.r_val1 = panel_seq & 077777;
 }
 
 #ifdef UCB_METER
@@ -0,0 +1,432 @@
+/*
+ * ksym.c - Kernel symbol lookup for the 2.11BSD panel tools
+ *
+ * Reads the symbol table of /unix (or /vmunix) directly instead of
+ * running "nm | grep", which forks two processes and takes seconds on a
+ * PDP-11.  The file has the a.out layout obj2bsd writes: an 8 word
+ * header (0407, or 0430/0431 followed by an overlay header), text, data,
+ * overlays, relocation unless a_flag says it was stripped, 8 byte nlist
+ * entries (string offset, type, overlay, value) and then the string
+ * table, whose first long is its size.  Lookups make one sequential pass
+ * over the strings to find the name and one over the symbols to find its
+ * value, so memory use does not grow with the kernel.
+ *
+ * Results are remembered in KSYM_CACHE, keyed by the kernel's inode and
+ * modification time, so normally a tool resolves its symbols from a few
+ * lines of text.  The cache is ignored unless it belongs to the caller
+ * and nobody else can write it.  Included by the tools; K&R C.
+ */
+
+#ifndef KSYM_C
+#define KSYM_C
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <ctype.h>
+#ifndef __pdp11__
+#include <unistd.h>
+#endif
+
+#ifndef KSYM_CACHE
+#define KSYM_CACHE "/tmp/panelsyms"
+#endif
+#define KSYM_NAMELEN 64         /* Longer names are never matched */
+
+#define KSYM_MAGIC1 0407        /* Plain */
+#define KSYM_MAGIC5 0430        /* Overlaid, non-separate I&D */
+#define KSYM_MAGIC6 0431        /* Overlaid, separate I&D */
+#define KSYM_NOVL 15            /* Overlays in the overlay header */
+#define KSYM_N_TYPE 037         /* Type bits of n_type */
+#define KSYM_N_EXT 040          /* External symbol */
+
+/* Kernel to read; NULL tries /unix and then /vmunix */
+char *ksym_kernel = NULL;
+
+/* An open kernel image */
+struct ksym_file {
+    FILE *kf_fp;
+    long kf_symoff;             /* Offset of the first nlist entry */
+    long kf_nsyms;
+    long kf_stroff;             /* Offset of the string table size */
+    long kf_strsize;
+    int kf_lowfirst;            /* Longs are stored low word first */
+    int kf_eof;                 /* A word read ran off the end */
+};
+
+/*
+ * Read an unsigned 16 bit word.  It is built in a long, since words of
+ * 0100000 and up are negative in the PDP-11's int; end of file sets
+ * kf_eof and reads as 0.
+ */
+static long ksym_word(kf)
+struct ksym_file *kf;
+{
+    int lo, hi;
+
+    lo = getc(kf->kf_fp);
+    hi = getc(kf->kf_fp);
+    if (lo == EOF || hi == EOF) {
+        kf->kf_eof = 1;
+        return 0L;
+    }
+    return (long)lo | (long)hi << 8;
+}
+
+static long ksym_long(kf, w1, w2)
+struct ksym_file *kf;
+long w1, w2;
+{
+    if (kf->kf_lowfirst)
+        return w2 << 16 | w1;
+    return w1 << 16 | w2;
+}
+
+/*
+ * Open a kernel image and locate its symbol and string tables.
+ * Returns 0, or -1 if the file is missing or not an a.out we know.
+ */
+int ksym_open(kf, path)
+struct ksym_file *kf;
+char *path;
+{
+    struct stat st;
+    long hdr[8], base, ovl, reloc, w1, w2, size;
+    int i;
+
+    kf->kf_fp = fopen(path, "r");
+    if (kf->kf_fp == NULL)
+        return -1;
+    kf->kf_eof = 0;
+    for (i = 0; i < 8; i++)
+        hdr[i] = ksym_word(kf);
+    if (kf->kf_eof || hdr[4] == 0 ||
+        (hdr[0] != KSYM_MAGIC1 && hdr[0] != KSYM_MAGIC5 && hdr[0] != KSYM_MAGIC6)) {
+        fclose(kf->kf_fp);
+        return -1;
+    }
+
+    /* Header, overlay header and overlays, text and data */
+    ovl = 0;
+    base = 16;
+    if (hdr[0] != KSYM_MAGIC1) {
+        ksym_word(kf);          /* max_ovl */
+        for (i = 0; i < KSYM_NOVL; i++)
+            ovl += ksym_word(kf);
+        if (kf->kf_eof) {
+            fclose(kf->kf_fp);
+            return -1;
+        }
+        base += 2 + 2 * KSYM_NOVL;
+    }
+    size = hdr[1] + hdr[2] + ovl;
+    kf->kf_nsyms = hdr[4] / 8;
+
+    /*
+     * Then relocation, unless a_flag says it was stripped; obj2bsd puts
+     * the relocation sizes in a_unused and a_flag instead.  A native long
+     * is high word first; obj2bsd writes the low word first.  The string
+     * table runs to the end of the file, which tells all of these apart,
+     * so try each layout until one fits.
+     */
+    fstat(fileno(kf->kf_fp), &st);
+    for (i = 0; i < 4; i++) {
+        reloc = (i < 2) == (hdr[7] == 0) ? size : 0;
+        kf->kf_symoff = base + size + reloc;
+        kf->kf_stroff = kf->kf_symoff + hdr[4];
+        kf->kf_lowfirst = i & 1;
+        fseek(kf->kf_fp, kf->kf_stroff, 0);
+        kf->kf_eof = 0;
+        w1 = ksym_word(kf);
+        w2 = ksym_word(kf);
+        kf->kf_strsize = ksym_long(kf, w1, w2);
+        if (!kf->kf_eof && kf->kf_stroff + kf->kf_strsize == (long)st.st_size)
+            return 0;
+    }
+    fclose(kf->kf_fp);
+    return -1;
+}
+
+void ksym_close(kf)
+struct ksym_file *kf;
+{
+    fclose(kf->kf_fp);
+}
+
+/*
+ * Read nlist entry i, which must follow the last one read unless seek
+ * is set.  Returns 0, or -1 at the end of the table.
+ */
+static int ksym_entry(kf, i, seek, strx, type, value)
+struct ksym_file *kf;
+long i;
+int seek;
+long *strx;
+int *type;
+unsigned *value;
+{
+    long w1, w2;
+
+    if (i >= kf->kf_nsyms)
+        return -1;
+    if (seek)
+        fseek(kf->kf_fp, kf->kf_symoff + 8 * i, 0);
+    kf->kf_eof = 0;
+    w1 = ksym_word(kf);
+    w2 = ksym_word(kf);
+    *type = getc(kf->kf_fp);
+    getc(kf->kf_fp);            /* n_ovly */
+    *value = (unsigned)ksym_word(kf);
+    if (*type == EOF || kf->kf_eof)
+        return -1;
+    *strx = ksym_long(kf, w1, w2);
+    return 0;
+}
+
+/*
+ * Read the string at offset strx into name.  Returns 0, or -1 if it is
+ * out of range or too long.
+ */
+static int ksym_string(kf, strx, name)
+struct ksym_file *kf;
+long strx;
+char *name;
+{
+    int c, n;
+
+    if (strx < 4 || strx >= kf->kf_strsize)
+        return -1;
+    fseek(kf->kf_fp, kf->kf_stroff + strx, 0);
+    for (n = 0; n < KSYM_NAMELEN; n++) {
+        c = getc(kf->kf_fp);
+        if (c == EOF)
+            return -1;
+        name[n] = c;
+        if (c == 0)
+            return 0;
+    }
+    return -1;
+}
+
+/*
+ * Find name, or name with the C compiler's leading underscore, in an
+ * open kernel.  Returns its value, or -1 if it is not defined.
+ */
+long ksym_find(kf, name)
+struct ksym_file *kf;
+char *name;
+{
+    char buf[KSYM_NAMELEN + 1];
+    long off, strx, found[2], i;
+    unsigned value;
+    int c, n, type, k;
+
+    /* Pass 1: the string table offsets of "_name" and "name" */
+    found[0] = found[1] = -1;
+    fseek(kf->kf_fp, kf->kf_stroff + 4, 0);
+    off = 4;
+    while (off < kf->kf_strsize) {
+        n = 0;
+        while ((c = getc(kf->kf_fp)) != EOF && c != 0) {
+            if (n < KSYM_NAMELEN)
+                buf[n] = c;
+            n++;
+        }
+        if (c == EOF)
+            break;
+        if (n < KSYM_NAMELEN) {
+            buf[n] = '\0';
+            if (buf[0] == '_' && strcmp(buf + 1, name) == 0)
+                found[0] = off;
+            else if (strcmp(buf, name) == 0)
+                found[1] = off;
+        }
+        off += n + 1;
+    }
+    if (found[0] < 0 && found[1] < 0)
+        return -1L;
+
+    /* Pass 2: the defined symbol using one of them */
+    for (k = 0; k < 2; k++) {
+        if (found[k] < 0)
+            continue;
+        for (i = 0; ksym_entry(kf, i, i == 0, &strx, &type, &value) == 0; i++)
+            if (strx == found[k] && (type & KSYM_N_TYPE) != 0)
+                return (long)value;
+    }
+    return -1L;
+}
+
+/*
+ * Call fn(name, type, value) for every symbol whose name contains part
+ * (every symbol if part is NULL).  Slow: one seek per symbol.
+ */
+void ksym_each(kf, part, fn)
+struct ksym_file *kf;
+char *part;
+void (*fn)();
+{
+    char name[KSYM_NAMELEN];
+    long strx, i;
+    unsigned value;
+    int type;
+
+    for (i = 0; ksym_entry(kf, i, 1, &strx, &type, &value) == 0; i++) {
+        if (ksym_string(kf, strx, name) < 0)
+            continue;
+        if (part == NULL || strstr(name, part) != NULL)
+            (*fn)(name, type, value);
+    }
+}
+
+/* Path of the kernel to use, with its stat; NULL if there is none */
+char *ksym_path(st)
+struct stat *st;
+{
+    if (ksym_kernel != NULL)
+        return stat(ksym_kernel, st) == 0 ? ksym_kernel : NULL;
+    if (stat("/unix", st) == 0)
+        return "/unix";
+    if (stat("/vmunix", st) == 0)
+        return "/vmunix";
+    return NULL;
+}
+
+/* Open the cache if it is ours and describes this kernel */
+static FILE *ksym_cache_open(path, kst)
+char *path;
+struct stat *kst;
+{
+    char kpath[256];
+    unsigned long ino;
+    long mtime;
+    struct stat st;
+    FILE *fp;
+
+    fp = fopen(KSYM_CACHE, "r");
+    if (fp == NULL)
+        return NULL;
+    if (fstat(fileno(fp), &st) < 0 || st.st_uid != geteuid() ||
+        (st.st_mode & 022) != 0 ||
+        fscanf(fp, "%lu %ld %255s", &ino, &mtime, kpath) != 3 ||
+        ino != (unsigned long)kst->st_ino || mtime != (long)kst->st_mtime ||
+        strcmp(kpath, path) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+static long ksym_cache_get(path, kst, name)
+char *path;
+struct stat *kst;
+char *name;
+{
+    char sym[KSYM_NAMELEN + 1];
+    long value;
+    FILE *fp;
+
+    fp = ksym_cache_open(path, kst);
+    if (fp == NULL)
+        return -1L;
+    while (fscanf(fp, "%64s %lo", sym, &value) == 2) {
+        if (strcmp(sym, name) == 0) {
+            fclose(fp);
+            return value;
+        }
+    }
+    fclose(fp);
+    return -1L;
+}
+
+static void ksym_cache_put(path, kst, name, value)
+char *path;
+struct stat *kst;
+char *name;
+long value;
+{
+    FILE *fp;
+    int fd;
+
+    fp = ksym_cache_open(path, kst);
+    if (fp != NULL) {
+        fclose(fp);
+        fp = fopen(KSYM_CACHE, "a");
+    } else {
+        /* Start afresh; O_EXCL so a planted symlink is not followed */
+        unlink(KSYM_CACHE);
+        fd = open(KSYM_CACHE, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        fp = fd < 0 ? NULL : fdopen(fd, "w");
+        if (fp != NULL) {
+            fprintf(fp, "%lu %ld %s\n", (unsigned long)kst->st_ino,
+                    (long)kst->st_mtime, path);
+        }
+    }
+    if (fp == NULL)
+        return;
+    fprintf(fp, "%s %lo\n", name, value);
+    fclose(fp);
+}
+
+/*
+ * Address of kernel symbol name (given without the leading underscore),
+ * or -1 if it cannot be found.
+ */
+long ksym_lookup(name)
+char *name;
+{
+    struct ksym_file kf;
+    struct stat st;
+    char *path;
+    long value;
+
+    path = ksym_path(&st);
+    if (path == NULL)
+        return -1L;
+    value = ksym_cache_get(path, &st, name);
+    if (value >= 0)
+        return value;
+    if (ksym_open(&kf, path) < 0)
+        return -1L;
+    value = ksym_find(&kf, name);
+    ksym_close(&kf);
+    if (value >= 0)
+        ksym_cache_put(path, &st, name, value);
+    return value;
+}
+
+/* ksym_each() callback printing a symbol the way nm does */
+void ksym_print(name, type, value)
+char *name;
+int type;
+unsigned value;
+{
+    static char letters[] = "uatdbcr";
+    int c;
+
+    c = (type & KSYM_N_TYPE) < 7 ? letters[type & KSYM_N_TYPE] : '?';
+    if (type & KSYM_N_EXT)
+        c = toupper(c);
+    printf("   %06o %c %s\n", value, c, name);
+}
+
+/*
+ * Open the kernel and list the symbols whose names contain part.
+ * Returns -1 if there is no readable kernel.
+ */
+int ksym_list(part)
+char *part;
+{
+    struct ksym_file kf;
+    struct stat st;
+    char *path;
+
+    path = ksym_path(&st);
+    if (path == NULL || ksym_open(&kf, path) < 0)
+        return -1;
+    ksym_each(&kf, part, ksym_print);
+    ksym_close(&kf);
+    return 0;
+}
+
+#endif /* KSYM_C */
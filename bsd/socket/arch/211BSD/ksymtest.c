@@ -0,0 +1,192 @@
+/*
+ * ksymtest.c - Check ksym.c against made-up kernel images
+ * Usage: ksymtest [scratch file]   (default /tmp/ksymtest.out)
+ *
+ * Writes a.out images like a real /unix, with more than 32K of text and
+ * symbols whose values and string offsets have the top bit of a word
+ * set, in each layout ksym_open() accepts, and checks what it reads
+ * back.  Run it on the PDP-11, where int is 16 bits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned long uintptr_t;
+
+#include "ksym.c"
+
+#define TEXT_SIZE 0170000L      /* Over 32K */
+#define DATA_SIZE 0104000L
+#define PAD_STRINGS 0100000L    /* Pushes the last name's offset past 32K */
+
+char *image = "/tmp/ksymtest.out";
+int failures = 0;
+
+static void put_word(fp, w)
+FILE *fp;
+long w;
+{
+    putc((int)(w & 0377), fp);
+    putc((int)(w >> 8 & 0377), fp);
+}
+
+static void put_long(fp, l, lowfirst)
+FILE *fp;
+long l;
+int lowfirst;
+{
+    if (lowfirst) {
+        put_word(fp, l & 0177777L);
+        put_word(fp, l >> 16 & 0177777L);
+    } else {
+        put_word(fp, l >> 16 & 0177777L);
+        put_word(fp, l & 0177777L);
+    }
+}
+
+static void put_zeros(fp, n)
+FILE *fp;
+long n;
+{
+    while (n-- > 0)
+        putc(0, fp);
+}
+
+/* Symbols in the image: name, type and value */
+struct sym {
+    char *name;
+    int type;
+    long value;
+};
+
+struct sym syms[] = {
+    { "_panel", 043, 0177776L },       /* Data, external */
+    { "_lbolt", 042, 0100000L },       /* Text, external */
+    { "_wide", 043, 0177777L },
+    { "pad", 0, 0L },                  /* Undefined; long name below */
+    { "_far", 044, 0123456L },         /* Name past PAD_STRINGS */
+};
+#define NSYMS (sizeof(syms) / sizeof(syms[0]))
+
+/*
+ * Write an image.  magic is 0407 or 0431; stripped leaves out the
+ * relocation; lowfirst writes longs low word first, as obj2bsd does.
+ */
+static void write_image(magic, stripped, lowfirst)
+int magic, stripped, lowfirst;
+{
+    FILE *fp;
+    long strx[NSYMS], off, ovl;
+    int i;
+
+    fp = fopen(image, "w");
+    if (fp == NULL) {
+        perror(image);
+        exit(1);
+    }
+
+    /* String offsets: "pad" is followed by PAD_STRINGS bytes of name */
+    off = 4;
+    for (i = 0; i < NSYMS; i++) {
+        strx[i] = off;
+        off += strlen(syms[i].name) + 1;
+        if (strcmp(syms[i].name, "pad") == 0)
+            off += PAD_STRINGS;
+    }
+
+    put_word(fp, (long)magic);
+    put_word(fp, TEXT_SIZE);
+    put_word(fp, DATA_SIZE);
+    put_word(fp, 0L);                   /* bss */
+    put_word(fp, 8L * NSYMS);
+    put_word(fp, 0L);                   /* entry */
+    put_word(fp, 0L);                   /* unused */
+    put_word(fp, stripped ? 1L : 0L);   /* flag */
+    ovl = 0;
+    if (magic != KSYM_MAGIC1) {
+        put_word(fp, 0100000L);         /* max_ovl */
+        for (i = 0; i < KSYM_NOVL; i++) {
+            put_word(fp, i < 2 ? 0100400L : 0L);
+            ovl += i < 2 ? 0100400L : 0L;
+        }
+    }
+    put_zeros(fp, TEXT_SIZE + DATA_SIZE + ovl);
+    if (!stripped)
+        put_zeros(fp, TEXT_SIZE + DATA_SIZE + ovl);
+
+    for (i = 0; i < NSYMS; i++) {
+        put_long(fp, strx[i], lowfirst);
+        putc(syms[i].type, fp);
+        putc(0, fp);                    /* ovly */
+        put_word(fp, syms[i].value);
+    }
+
+    put_long(fp, off, lowfirst);
+    for (i = 0; i < NSYMS; i++) {
+        fputs(syms[i].name, fp);
+        if (strcmp(syms[i].name, "pad") == 0)
+            put_zeros(fp, PAD_STRINGS);  /* Empty names */
+        putc(0, fp);
+    }
+    fclose(fp);
+}
+
+static void check(what, ok)
+char *what;
+int ok;
+{
+    printf("  %-44s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static void check_image(magic, stripped, lowfirst)
+int magic, stripped, lowfirst;
+{
+    struct ksym_file kf;
+    char what[64];
+    int i;
+
+    write_image(magic, stripped, lowfirst);
+    printf("%03o, %s, longs %s word first:\n", magic,
+           stripped ? "stripped" : "relocation", lowfirst ? "low" : "high");
+    if (ksym_open(&kf, image) < 0) {
+        check("ksym_open", 0);
+        return;
+    }
+    check("ksym_open", 1);
+    check("word order", kf.kf_lowfirst == lowfirst);
+    check("symbol count", kf.kf_nsyms == NSYMS);
+    for (i = 0; i < NSYMS; i++) {
+        if (syms[i].type == 0)
+            continue;
+        sprintf(what, "%s = %06lo", syms[i].name + 1, syms[i].value);
+        check(what, ksym_find(&kf, syms[i].name + 1) == syms[i].value);
+    }
+    check("pad undefined", ksym_find(&kf, "pad") == -1L);
+    ksym_close(&kf);
+
+    /* Cut off before the symbols: no layout fits */
+    truncate(image, (off_t)(TEXT_SIZE + DATA_SIZE));
+    check("truncated image rejected", ksym_open(&kf, image) < 0);
+}
+
+int main(argc, argv)
+int argc;
+char *argv[];
+{
+    int stripped, lowfirst;
+
+    if (argc > 1)
+        image = argv[1];
+    for (stripped = 0; stripped < 2; stripped++) {
+        for (lowfirst = 0; lowfirst < 2; lowfirst++) {
+            check_image(KSYM_MAGIC1, stripped, lowfirst);
+            check_image(KSYM_MAGIC6, stripped, lowfirst);
+        }
+    }
+    unlink(image);
+    printf(failures ? "%d FAILED\n" : "All passed\n", failures);
+    return failures ? 1 : 0;
+}
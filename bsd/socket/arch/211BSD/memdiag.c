@@ -32,13 +32,11 @@ extern int memcmp();
 #define SEEK_END 2
 #endif
 
+#include "ksym.c"
+
 int main()
 {
-    FILE *fp;
-    char line[256];
-    char symbol[64];
     uintptr_t addr;
-    char type;
     int kmem_fd;
     long value;
     unsigned char bytes[4];
@@ -49,31 +47,13 @@ int main()
     
     /* Show all relevant symbols */
     printf("1. All panel-related symbols:\n");
-    fp = popen("nm /unix | grep panel", "r");
-    if (fp != NULL) {
-        while (fgets(line, sizeof(line), fp)) {
-            printf("   %s", line);
-        }
-        pclose(fp);
-    }
-    
-    fp = popen("nm /unix | grep hardclock", "r");
-    if (fp != NULL) {
-        printf("   hardclock symbols:\n");
-        while (fgets(line, sizeof(line), fp)) {
-            printf("   %s", line);
-        }
-        pclose(fp);
-    }
-    
-    fp = popen("nm /unix | grep timeout", "r");
-    if (fp != NULL) {
-        printf("   timeout symbols:\n");
-        while (fgets(line, sizeof(line), fp)) {
-            printf("   %s", line);
-        }
-        pclose(fp);
+    if (ksym_list("panel") < 0) {
+        printf("   Cannot read the kernel symbol table\n");
     }
+    printf("   hardclock symbols:\n");
+    ksym_list("hardclock");
+    printf("   timeout symbols:\n");
+    ksym_list("timeout");
     
     /* Open /dev/kmem */
     kmem_fd = open("/dev/kmem", O_RDONLY);
@@ -32,15 +32,13 @@ extern int memcmp();
 #define SEEK_END 2
 #endif
 
+#include "ksym.c"
+
 int main()
 {
     int kmem_fd;
     void *panel_addr = (void*)0;  /* We'll find this dynamically */
-    FILE *fp;
-    char line[256];
-    char symbol[64];
-    uintptr_t addr;
-    char type;
+    long addr;
     unsigned char buffer[32];  /* Read more than we need */
     int i;
     
@@ -49,23 +47,10 @@ int main()
     
     /* Find panel symbol */
     printf("1. Finding panel symbol:\n");
-    fp = popen("nm /unix 2>/dev/null | grep panel", "r");
-    if (fp == NULL) {
-        fp = popen("nm /vmunix 2>/dev/null | grep panel", "r");
-    }
-    
-    if (fp != NULL) {
-        while (fgets(line, sizeof(line), fp)) {
-            printf("   %s", line);
-            if (sscanf(line, "%lo %c %s", &addr, &type, symbol) == 3 ||
-                sscanf(line, "%lx %c %s", &addr, &type, symbol) == 3) {
-                if (strcmp(symbol, "panel") == 0 || strcmp(symbol, "_panel") == 0) {
-                    printf("   -> Using: %s at 0x%lx\n", symbol, addr);
-                    panel_addr = (void*)addr;
-                }
-            }
-        }
-        pclose(fp);
+    addr = ksym_lookup("panel");
+    if (addr >= 0) {
+        printf("   -> Using: _panel at 0x%lx\n", addr);
+        panel_addr = (void*)(uintptr_t)addr;
     }
     
     if (panel_addr == 0) {
@@ -14,6 +14,7 @@
 
 /* Include panel state definitions */
 #include "panel_state.h"
+#include "ksym.c"
 
 /* Declare functions for 211BSD compatibility */
 #ifdef __pdp11__
@@ -49,47 +50,16 @@ typedef unsigned long uintptr_t;
 int find_panel_symbol(panel_addr)
 void **panel_addr;
 {
-    FILE *fp;
-    char line[256];
-    char symbol[64];
-    uintptr_t addr;
-    char type;
-    int found_count = 0;
+    long addr;
     
-    /* PDP-11 systems use /unix or /vmunix */
-    fp = popen("nm /unix | grep panel", "r");
-    if (fp == NULL) {
-        fp = popen("nm /vmunix | grep panel", "r");
-        if (fp == NULL) {
-            fprintf(stderr, "Cannot run nm to find panel symbol\n");
-            return -1;
-        }
-    }
-    
-    *panel_addr = NULL;
     printf("Searching for panel symbol in kernel:\n");
-    while (fgets(line, sizeof(line), fp)) {
-        printf("  nm output: %s", line);
-        if (sscanf(line, "%lo %c %s", &addr, &type, symbol) == 3 ||
-            sscanf(line, "%lx %c %s", &addr, &type, symbol) == 3) {
-            if (strcmp(symbol, "panel") == 0 || strcmp(symbol, "_panel") == 0) {
-                printf("  Found panel symbol: %s at 0x%lx (type %c)\n", symbol, addr, type);
-                *panel_addr = (void*)addr;
-                found_count++;
-            }
-        }
-    }
-    pclose(fp);
-    
-    if (*panel_addr == NULL) {
+    addr = ksym_lookup("panel");
+    if (addr < 0) {
         fprintf(stderr, "Panel symbol not found\n");
         return -1;
     }
-    
-    if (found_count > 1) {
-        printf("WARNING: Found %d panel symbols, using last one\n", found_count);
-    }
-    
+    printf("  Found panel symbol at 0%lo (0x%lx)\n", addr, addr);
+    *panel_addr = (void*)(uintptr_t)addr;
     return 0;
 }
 
@@ -1,5 +1,6 @@
 /*
  * symboltest.c - Simple test to verify panel symbol lookup
+ * Usage: symboltest [kernel]   (default /unix, then /vmunix)
  */
 
 #include <stdio.h>
@@ -8,74 +9,48 @@
 
 typedef unsigned long uintptr_t;
 
-int main()
+#include "ksym.c"
+
+int main(argc, argv)
+int argc;
+char *argv[];
 {
-    FILE *fp;
-    char line[256];
-    char symbol[64];
-    uintptr_t addr;
-    char type;
-    int found_panel = 0;
-    
-    printf("Testing symbol lookup for 'panel':\n\n");
-    
-    /* Try /unix first */
-    printf("Checking /unix:\n");
-    fp = popen("nm /unix 2>/dev/null", "r");
-    if (fp != NULL) {
-        while (fgets(line, sizeof(line), fp)) {
-            if (strstr(line, "panel")) {
-                printf("  %s", line);
-                if (sscanf(line, "%lo %c %s", &addr, &type, symbol) == 3 ||
-                    sscanf(line, "%lx %c %s", &addr, &type, symbol) == 3) {
-                    if (strcmp(symbol, "panel") == 0 || strcmp(symbol, "_panel") == 0) {
-                        printf("    -> Found: %s at 0x%lx (type %c)\n", symbol, addr, type);
-                        found_panel = 1;
-                    }
-                }
-            }
-        }
-        pclose(fp);
-    } else {
-        printf("  Cannot access /unix\n");
+    struct ksym_file kf;
+    struct stat st;
+    char *path;
+    long addr;
+
+    if (argc > 1) {
+        ksym_kernel = argv[1];
     }
-    
-    printf("\nChecking /vmunix:\n");
-    fp = popen("nm /vmunix 2>/dev/null", "r");
-    if (fp != NULL) {
-        while (fgets(line, sizeof(line), fp)) {
-            if (strstr(line, "panel")) {
-                printf("  %s", line);
-                if (sscanf(line, "%lo %c %s", &addr, &type, symbol) == 3 ||
-                    sscanf(line, "%lx %c %s", &addr, &type, symbol) == 3) {
-                    if (strcmp(symbol, "panel") == 0 || strcmp(symbol, "_panel") == 0) {
-                        printf("    -> Found: %s at 0x%lx (type %c)\n", symbol, addr, type);
-                        found_panel = 1;
-                    }
-                }
-            }
-        }
-        pclose(fp);
-    } else {
-        printf("  Cannot access /vmunix\n");
+    path = ksym_path(&st);
+    if (path == NULL) {
+        printf("Cannot access %s\n", ksym_kernel ? ksym_kernel : "/unix or /vmunix");
+        return 1;
     }
-    
-    printf("\nDirect grep test:\n");
-    fp = popen("nm /unix 2>/dev/null | grep panel", "r");
-    if (fp != NULL) {
-        while (fgets(line, sizeof(line), fp)) {
-            printf("  %s", line);
-        }
-        pclose(fp);
+
+    printf("Testing symbol lookup for 'panel' in %s:\n\n", path);
+    if (ksym_open(&kf, path) < 0) {
+        printf("  %s is not an a.out with a symbol table\n", path);
+        return 1;
     }
-    
-    if (!found_panel) {
+    printf("  %ld symbols, %ld bytes of strings, longs stored %s word first\n",
+           kf.kf_nsyms, kf.kf_strsize, kf.kf_lowfirst ? "low" : "high");
+    printf("\nSymbols containing \"panel\":\n");
+    ksym_each(&kf, "panel", ksym_print);
+    ksym_close(&kf);
+
+    printf("\nLookup (cached in %s):\n", KSYM_CACHE);
+    addr = ksym_lookup("panel");
+    if (addr >= 0) {
+        printf("    -> Found: _panel at 0%lo (0x%lx)\n", addr, addr);
+    } else {
         printf("\nWARNING: No panel symbol found!\n");
         printf("This could mean:\n");
         printf("1. The kernel was not compiled with panel support\n");
         printf("2. The symbol table is not available\n");
         printf("3. The symbol has a different name\n");
     }
-    
+
     return 0;
 }
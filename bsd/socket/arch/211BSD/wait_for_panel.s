@@ -1,5 +1,9 @@
-.globl  _wait_for_panel
+.globl  _wait_for_panel, cerror
 
+/ wait_for_panel(seq, secs) - see sys_wait_for_panel() in kern_clock.c
 _wait_for_panel:
                         sys     67.
-                        rts     pc              / return result in r0
+                        bcc     1f
+                        jmp     cerror          / sets errno, returns -1
+1:
+                        rts     pc              / return sequence in r0
@@ -31,6 +31,7 @@ extern int optind, optopt;
 
 /* Include panel state definitions */
 #include "panel_state.h"
+#include "panel_regs.c"
 
 /* Function prototypes */
 int capture_cpu_state(struct linuxx64_panel_state *panel);
@@ -44,14 +45,30 @@ int main(int argc, char *argv[])
     struct sockaddr_in server_addr;
     
     /* Parse command line arguments */
-    while ((c = getopt(argc, argv, "s:h")) != -1) {
+    while ((c = getopt(argc, argv, "s:h12l:r:")) != -1) {
         switch (c) {
         case 's':
             server_ip = optarg;
             break;
+        case '1':
+            panel_protocol = 1;
+            break;
+        case '2':
+            panel_protocol = 2;
+            break;
+        case 'l':
+            if (panel_publish_local(optarg) < 0) {
+                exit(1);
+            }
+            break;
+        case 'r':
+            panel_regs_bin = optarg;
+            break;
         case 'h':
         case '?':
             usage(argv[0]);
+            printf("  -r path        Read registers from path (default: %s)\n",
+                   PANEL_REGS_BIN);
             exit(1);
         }
     }
@@ -76,53 +93,31 @@ int main(int argc, char *argv[])
 
 int capture_cpu_state(struct linuxx64_panel_state *panel)
 {
-    FILE *fp;
-    struct pt_regs *regs = &panel->ps_regs;
-    char buffer[512];
+    static int use_text = 0;
     int ret;
     
-    /* Try to read real register data from kernel module */
-    fp = fopen("/proc/panel_regs", "r");
-    if (fp == NULL) {
-        fprintf(stderr, "Error: Cannot access /proc/panel_regs\n");
-        fprintf(stderr, "Please load the kernel module first: sudo make load\n");
-        exit(1);
+    /* Prefer the binary record; older modules only have the text file */
+    if (!use_text) {
+        ret = read_regs_binary(&panel->ps_regs);
+        if (ret != -2) {
+            return ret;
+        }
+        printf("%s not available, reading %s\n", panel_regs_bin, panel_regs_text);
+        use_text = 1;
     }
     
-    /* Read the first line to check if data is available */
-    if (fgets(buffer, sizeof(buffer), fp) == NULL) {
-        fprintf(stderr, "Error: Could not read from /proc/panel_regs\n");
-        fclose(fp);
+    ret = read_regs_text(&panel->ps_regs);
+    if (ret == -2) {
+        fprintf(stderr, "Error: Cannot access %s\n", panel_regs_text);
+        fprintf(stderr, "Please load the kernel module first: sudo make load\n");
         exit(1);
     }
-    
-    /* Check if no data has been captured yet */
-    if (strncmp(buffer, "No register data captured yet", 29) == 0) {
-        fclose(fp);
-        /* Return error to retry */
-        return -1;
-    }
-    
-    /* Parse all registers from the buffer */
-    ret = sscanf(buffer, "RIP=0x%lx RSP=0x%lx RBP=0x%lx RAX=0x%lx RBX=0x%lx RCX=0x%lx RDX=0x%lx RSI=0x%lx RDI=0x%lx R8=0x%lx R9=0x%lx R10=0x%lx R11=0x%lx R12=0x%lx R13=0x%lx R14=0x%lx R15=0x%lx EFLAGS=0x%lx CS=0x%lx SS=0x%lx ORIG_RAX=0x%lx",
-             &regs->rip, &regs->rsp, &regs->rbp, &regs->rax, &regs->rbx, &regs->rcx, &regs->rdx,
-             &regs->rsi, &regs->rdi, &regs->r8, &regs->r9, &regs->r10, &regs->r11, &regs->r12,
-             &regs->r13, &regs->r14, &regs->r15, &regs->eflags, &regs->cs, &regs->ss, &regs->orig_rax);
-    
-    fclose(fp);
-    
-    if (ret != 21) {
-        fprintf(stderr, "Error: Could not parse register data (got %d fields)\n", ret);
-        return -1;
-    }
-    
-    return 0;
+    return ret;
 }
 
 void send_frames(int sockfd, struct sockaddr_in *server_addr)
 {
     struct linuxx64_panel_state panel;
-    struct linuxx64_panel_packet packet;
     int frame_count = 0;
     
     while (1) {
@@ -133,14 +128,9 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
             continue;
         }
         
-        /* Populate packet structure */
-        packet.header.pp_byte_count = sizeof(struct linuxx64_panel_state);
-        packet.header.pp_byte_flags = PANEL_LINUXX64;
-        packet.panel_state = panel;
-        
         /* Send panel packet via UDP */
-        if (sendto(sockfd, &packet, sizeof(packet), 0,
-                   (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
+        if (send_panel(sockfd, server_addr, PANEL_LINUXX64,
+                       (char *)&panel, sizeof(panel), 0) < 0) {
             perror("sendto");
             break;
         }
@@ -3,13 +3,30 @@
 #include <linux/kprobes.h>
 #include <linux/proc_fs.h>
 #include <linux/uaccess.h>
-#include <linux/mutex.h>
+#include <linux/seqlock.h>
 
-/* Static storage for captured register state */
+/*
+ * Binary record read from /proc/panel_regs_bin.  Must match struct
+ * panel_regs_record in panel_state.h: a count of captures (0 until the
+ * first) followed by the 21 registers in struct pt_regs order.
+ */
+#define PANEL_NREGS 21
+
+struct panel_regs_record {
+    u64 rr_seq;
+    u64 rr_regs[PANEL_NREGS];
+};
+
+/*
+ * Static storage for captured register state.  The kprobe handler runs
+ * with preemption off and only on CPU 0, so there is a single writer and
+ * a seqcount is enough; readers retry if a capture lands mid-copy.
+ */
 static struct pt_regs captured_regs;
-static DEFINE_MUTEX(regs_mutex);
+static u64 captures;
+static seqcount_t regs_seq = SEQCNT_ZERO(regs_seq);
 static struct proc_dir_entry *proc_entry;
-static bool regs_valid = false;
+static struct proc_dir_entry *proc_bin_entry;
 
 static int handler_pre(struct kprobe *p, struct pt_regs *regs)
 {
@@ -19,39 +36,49 @@ static int handler_pre(struct kprobe *p, struct pt_regs *regs)
         return 0;
         
     /* Capture the real register state */
-    mutex_lock(&regs_mutex);
+    raw_write_seqcount_begin(&regs_seq);
     captured_regs = *regs;
-    regs_valid = true;
-    mutex_unlock(&regs_mutex);
+    captures++;
+    raw_write_seqcount_end(&regs_seq);
     
     return 0;
 }
 
+/* Take a consistent copy of the latest capture */
+static u64 snapshot_regs(struct pt_regs *regs)
+{
+    unsigned int start;
+    u64 seq;
+
+    do {
+        start = read_seqcount_begin(&regs_seq);
+        *regs = captured_regs;
+        seq = captures;
+    } while (read_seqcount_retry(&regs_seq, start));
+    return seq;
+}
+
 /* Procfs read function to export register data to userspace */
 static ssize_t proc_read(struct file *file, char __user *buffer, size_t count, loff_t *pos)
 {
     int len;
     char output[512];
+    struct pt_regs r;
     
     if (*pos > 0)
         return 0;
     
-    mutex_lock(&regs_mutex);
-    if (!regs_valid) {
+    if (snapshot_regs(&r) == 0) {
         len = snprintf(output, sizeof(output), "No register data captured yet\n");
     } else {
         len = snprintf(output, sizeof(output),
             "RIP=0x%lx RSP=0x%lx RBP=0x%lx RAX=0x%lx RBX=0x%lx RCX=0x%lx RDX=0x%lx "
             "RSI=0x%lx RDI=0x%lx R8=0x%lx R9=0x%lx R10=0x%lx R11=0x%lx R12=0x%lx "
             "R13=0x%lx R14=0x%lx R15=0x%lx EFLAGS=0x%lx CS=0x%lx SS=0x%lx ORIG_RAX=0x%lx\n",
-            captured_regs.ip, captured_regs.sp, captured_regs.bp, captured_regs.ax,
-            captured_regs.bx, captured_regs.cx, captured_regs.dx, captured_regs.si,
-            captured_regs.di, captured_regs.r8, captured_regs.r9, captured_regs.r10,
-            captured_regs.r11, captured_regs.r12, captured_regs.r13, captured_regs.r14,
-            captured_regs.r15, captured_regs.flags, captured_regs.cs, captured_regs.ss,
-            captured_regs.orig_ax);
+            r.ip, r.sp, r.bp, r.ax, r.bx, r.cx, r.dx, r.si, r.di,
+            r.r8, r.r9, r.r10, r.r11, r.r12, r.r13, r.r14, r.r15,
+            r.flags, r.cs, r.ss, r.orig_ax);
     }
-    mutex_unlock(&regs_mutex);
     
     if (count < len)
         return -EINVAL;
@@ -63,10 +90,40 @@ static ssize_t proc_read(struct file *file, char __user *buffer, size_t count, l
     return len;
 }
 
+/*
+ * Binary read: one struct panel_regs_record at offset 0, so the client
+ * can keep the file open and pread() it every frame.
+ */
+static ssize_t proc_read_bin(struct file *file, char __user *buffer, size_t count, loff_t *pos)
+{
+    struct panel_regs_record rec;
+    struct pt_regs r;
+
+    if (*pos > 0)
+        return 0;
+    if (count < sizeof(rec))
+        return -EINVAL;
+    memset(&rec, 0, sizeof(rec));
+    rec.rr_seq = snapshot_regs(&r);
+    if (rec.rr_seq != 0) {
+        BUILD_BUG_ON(sizeof(rec.rr_regs) > sizeof(r));
+        memcpy(rec.rr_regs, &r, sizeof(rec.rr_regs));
+    }
+    if (copy_to_user(buffer, &rec, sizeof(rec)))
+        return -EFAULT;
+    *pos += sizeof(rec);
+    return sizeof(rec);
+}
+
 static const struct proc_ops proc_fops = {
     .proc_read = proc_read,
 };
 
+static const struct proc_ops proc_bin_fops = {
+    .proc_read = proc_read_bin,
+    .proc_lseek = default_llseek,
+};
+
 static struct kprobe kp = {
     .symbol_name = "schedule", // More frequently called than tick_handle_periodic
     .pre_handler = handler_pre,
@@ -82,11 +139,18 @@ static int __init my_kprobe_init(void)
         printk(KERN_ERR "Failed to create /proc/panel_regs\n");
         return -ENOMEM;
     }
+    proc_bin_entry = proc_create("panel_regs_bin", 0444, NULL, &proc_bin_fops);
+    if (!proc_bin_entry) {
+        printk(KERN_ERR "Failed to create /proc/panel_regs_bin\n");
+        proc_remove(proc_entry);
+        return -ENOMEM;
+    }
     
     /* Register kprobe */
     ret = register_kprobe(&kp);
     if (ret < 0) {
         printk(KERN_ERR "register_kprobe failed, returned %d\n", ret);
+        proc_remove(proc_bin_entry);
         proc_remove(proc_entry);
         return ret;
     }
@@ -98,6 +162,7 @@ static int __init my_kprobe_init(void)
 static void __exit my_kprobe_exit(void)
 {
     unregister_kprobe(&kp);
+    proc_remove(proc_bin_entry);
     proc_remove(proc_entry);
     printk(KERN_INFO "Panel kprobe unregistered\n");
 }
@@ -0,0 +1,90 @@
+/*
+ * panel_regs.c - Read the registers exported by the kprobe module
+ *
+ * The module exports the latest capture two ways.  /proc/panel_regs_bin
+ * holds a fixed struct panel_regs_record, which is kept open and read
+ * with one pread() per frame straight into struct pt_regs.
+ * /proc/panel_regs is the older text form, parsed with sscanf(), and is
+ * only used when the binary file is missing.  Both paths can be pointed
+ * at ordinary files, which is how regstub.c tests them without the
+ * module loaded.
+ * Included by client.c and regstub.c.
+ */
+
+#ifndef PANEL_REGS_C
+#define PANEL_REGS_C
+
+#include <fcntl.h>
+
+char *panel_regs_bin = PANEL_REGS_BIN;
+char *panel_regs_text = PANEL_REGS_TEXT;
+
+static int panel_regs_fd = -1;
+
+/*
+ * Read the binary record.  Returns 0 with regs filled in, -1 if nothing
+ * has been captured yet, or -2 if the binary file cannot be opened.
+ */
+int read_regs_binary(struct pt_regs *regs)
+{
+    struct panel_regs_record rec;
+    ssize_t n;
+
+    if (panel_regs_fd < 0) {
+        panel_regs_fd = open(panel_regs_bin, O_RDONLY);
+        if (panel_regs_fd < 0) {
+            return -2;
+        }
+    }
+    n = pread(panel_regs_fd, &rec, sizeof(rec), 0);
+    if (n != (ssize_t)sizeof(rec)) {
+        if (n < 0) {
+            perror(panel_regs_bin);
+        } else {
+            fprintf(stderr, "%s: short record (%d bytes)\n",
+                    panel_regs_bin, (int)n);
+        }
+        return -1;
+    }
+    if (rec.rr_seq == 0) {
+        return -1;
+    }
+    *regs = rec.rr_regs;
+    return 0;
+}
+
+/* Read and parse the text file; same return values as read_regs_binary() */
+int read_regs_text(struct pt_regs *regs)
+{
+    FILE *fp;
+    char buffer[512];
+    int ret;
+
+    fp = fopen(panel_regs_text, "r");
+    if (fp == NULL) {
+        return -2;
+    }
+    if (fgets(buffer, sizeof(buffer), fp) == NULL) {
+        fprintf(stderr, "Error: Could not read from %s\n", panel_regs_text);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    /* Check if no data has been captured yet */
+    if (strncmp(buffer, "No register data captured yet", 29) == 0) {
+        return -1;
+    }
+
+    ret = sscanf(buffer, "RIP=0x%lx RSP=0x%lx RBP=0x%lx RAX=0x%lx RBX=0x%lx RCX=0x%lx RDX=0x%lx RSI=0x%lx RDI=0x%lx R8=0x%lx R9=0x%lx R10=0x%lx R11=0x%lx R12=0x%lx R13=0x%lx R14=0x%lx R15=0x%lx EFLAGS=0x%lx CS=0x%lx SS=0x%lx ORIG_RAX=0x%lx",
+             &regs->rip, &regs->rsp, &regs->rbp, &regs->rax, &regs->rbx, &regs->rcx, &regs->rdx,
+             &regs->rsi, &regs->rdi, &regs->r8, &regs->r9, &regs->r10, &regs->r11, &regs->r12,
+             &regs->r13, &regs->r14, &regs->r15, &regs->eflags, &regs->cs, &regs->ss, &regs->orig_rax);
+    if (ret != 21) {
+        fprintf(stderr, "Error: Could not parse register data (got %d fields)\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+#endif /* PANEL_REGS_C */
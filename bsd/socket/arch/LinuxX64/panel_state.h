@@ -36,6 +36,18 @@ struct pt_regs {
 	uint64_t ss;		/* stack segment */
 };
 
+/*
+ * Binary record read from /proc/panel_regs_bin (see kprobe.c).  rr_seq
+ * counts captures and stays 0 until the first one.
+ */
+#define PANEL_REGS_BIN "/proc/panel_regs_bin"
+#define PANEL_REGS_TEXT "/proc/panel_regs"
+
+struct panel_regs_record {
+	uint64_t rr_seq;
+	struct pt_regs rr_regs;
+};
+
 /* Linux x64 Panel structure */
 struct linuxx64_panel_state {
     struct pt_regs ps_regs;        /* panel switches - Linux pt_regs structure */
@@ -0,0 +1,180 @@
+/*
+ * regstub.c - Stand-in for the kprobe module's /proc files
+ *
+ * Writes dir/panel_regs and dir/panel_regs_bin in the formats kprobe.c
+ * produces, then either times the client's two read paths against them
+ * or keeps the binary record changing so "client -r dir/panel_regs_bin"
+ * can be run without loading the module.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+
+/* External getopt declarations for compatibility */
+extern char *optarg;
+extern int optind;
+
+#include "panel_state.h"
+#include "panel_regs.c"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+void stub_usage(char *progname)
+{
+    printf("Usage: %s [-n reads] [-u hz] dir\n", progname);
+    printf("  -n reads       Time this many reads of each file (default: 100000)\n");
+    printf("  -u hz          Update the binary record this often until interrupted\n");
+    printf("  -h             Show this help\n");
+}
+
+static double now_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+/* Synthetic registers that change with every capture */
+static void fake_regs(struct pt_regs *r, uint64_t seq)
+{
+    memset(r, 0, sizeof(*r));
+    r->rip = 0xffffffff81000000ULL + (seq * 0x40) % 0x100000;
+    r->rsp = 0xffffc90000000000ULL - (seq % 512) * 8;
+    r->rbp = r->rsp + 0x80;
+    r->rax = seq;
+    r->rbx = seq ^ 0x5555;
+    r->rdi = seq * 3;
+    r->r15 = ~seq;
+    r->eflags = 0x246;
+    r->cs = 0x10;
+    r->ss = 0x18;
+    r->orig_rax = (uint64_t)-1;
+}
+
+static int write_text(const char *path, const struct pt_regs *r)
+{
+    FILE *fp;
+
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        return -1;
+    }
+    fprintf(fp, "RIP=0x%lx RSP=0x%lx RBP=0x%lx RAX=0x%lx RBX=0x%lx RCX=0x%lx RDX=0x%lx "
+            "RSI=0x%lx RDI=0x%lx R8=0x%lx R9=0x%lx R10=0x%lx R11=0x%lx R12=0x%lx "
+            "R13=0x%lx R14=0x%lx R15=0x%lx EFLAGS=0x%lx CS=0x%lx SS=0x%lx ORIG_RAX=0x%lx\n",
+            r->rip, r->rsp, r->rbp, r->rax, r->rbx, r->rcx, r->rdx, r->rsi, r->rdi,
+            r->r8, r->r9, r->r10, r->r11, r->r12, r->r13, r->r14, r->r15,
+            r->eflags, r->cs, r->ss, r->orig_rax);
+    return fclose(fp);
+}
+
+static int write_record(int fd, uint64_t seq)
+{
+    struct panel_regs_record rec;
+
+    rec.rr_seq = seq;
+    fake_regs(&rec.rr_regs, seq);
+    return pwrite(fd, &rec, sizeof(rec), 0) == (ssize_t)sizeof(rec) ? 0 : -1;
+}
+
+/* Time n reads through one path; returns microseconds per read */
+static double time_reads(int (*read_regs)(struct pt_regs *), long n, const char *what)
+{
+    struct pt_regs want, got;
+    double start;
+    long i;
+
+    fake_regs(&want, 1);
+    start = now_usec();
+    for (i = 0; i < n; i++) {
+        if (read_regs(&got) != 0) {
+            fprintf(stderr, "%s read failed\n", what);
+            exit(1);
+        }
+    }
+    start = (now_usec() - start) / n;
+    if (memcmp(&want, &got, sizeof(want)) != 0) {
+        fprintf(stderr, "%s read returned the wrong registers\n", what);
+        exit(1);
+    }
+    return start;
+}
+
+int main(int argc, char *argv[])
+{
+    static char text_path[1024], bin_path[1024];
+    struct pt_regs regs;
+    double text_us, bin_us;
+    long reads = 100000;
+    uint64_t seq = 1;
+    int hz = 0;
+    int c, fd;
+
+    while ((c = getopt(argc, argv, "n:u:h")) != -1) {
+        switch (c) {
+        case 'n':
+            reads = atol(optarg);
+            break;
+        case 'u':
+            hz = atoi(optarg);
+            break;
+        case 'h':
+            stub_usage(argv[0]);
+            exit(0);
+        default:
+            stub_usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (optind != argc - 1 || reads <= 0 || hz < 0) {
+        stub_usage(argv[0]);
+        exit(1);
+    }
+    snprintf(text_path, sizeof(text_path), "%s/panel_regs", argv[optind]);
+    snprintf(bin_path, sizeof(bin_path), "%s/panel_regs_bin", argv[optind]);
+    panel_regs_text = text_path;
+    panel_regs_bin = bin_path;
+
+    fake_regs(&regs, seq);
+    fd = open(bin_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write_text(text_path, &regs) < 0 || write_record(fd, seq) < 0) {
+        perror(argv[optind]);
+        exit(1);
+    }
+
+    if (hz == 0) {
+        text_us = time_reads(read_regs_text, reads, "text");
+        bin_us = time_reads(read_regs_binary, reads, "binary");
+        printf("%ld reads: text %.2f us/read, binary %.2f us/read (%.1fx)\n",
+               reads, text_us, bin_us, bin_us > 0 ? text_us / bin_us : 0.0);
+        close(fd);
+        return 0;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("Updating %s at %d Hz\n", bin_path, hz);
+    while (!stop) {
+        usleep(1000000 / hz);
+        if (write_record(fd, ++seq) < 0) {
+            perror(bin_path);
+            break;
+        }
+    }
+    printf("Wrote %lu records\n", (unsigned long)seq);
+    close(fd);
+    return 0;
+}
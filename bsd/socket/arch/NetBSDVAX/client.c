@@ -52,11 +52,22 @@ int main(int argc, char *argv[])
     int kmem_fd;
     
     /* Parse command line arguments */
-    while ((c = getopt(argc, argv, "s:h")) != -1) {
+    while ((c = getopt(argc, argv, "s:h12l:")) != -1) {
         switch (c) {
         case 's':
             server_ip = optarg;
             break;
+        case '1':
+            panel_protocol = 1;
+            break;
+        case '2':
+            panel_protocol = 2;
+            break;
+        case 'l':
+            if (panel_publish_local(optarg) < 0) {
+                exit(1);
+            }
+            break;
         case 'h':
         case '?':
             usage(argv[0]);
@@ -244,8 +255,8 @@ int read_panel_from_kmem(int kmem_fd, void *panel_addr, struct vax_panel_state *
 void send_frames(int sockfd, struct sockaddr_in *server_addr, int kmem_fd, void *panel_addr)
 {
     struct vax_panel_state panel;
-    struct vax_panel_packet packet;
     int frame_count = 0;
+    int sent;
     
     while (1) {
         /* Read panel structure from kernel memory */
@@ -254,14 +265,10 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr, int kmem_fd, void
             break;
         }
         
-        /* Populate packet structure */
-        packet.header.pp_byte_count = sizeof(struct vax_panel_state);
-        packet.header.pp_byte_flags = PANEL_VAX;  /* Set panel type flag */
-        packet.panel_state = panel;
-        
         /* Send panel packet via UDP with immediate transmission */
-        if (sendto(sockfd, &packet, sizeof(packet), MSG_DONTWAIT,
-                   (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
+        sent = send_panel(sockfd, server_addr, PANEL_VAX,
+                          (char *)&panel, sizeof(panel), MSG_DONTWAIT);
+        if (sent < 0) {
             fprintf(stderr, "sendto failed after %d packets: ", frame_count);
             perror("");
             if (errno == ENETUNREACH) {
@@ -283,7 +290,7 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr, int kmem_fd, void
         
         /* Debug: Print first few sends */
         if (frame_count <= 5) {
-            printf("DEBUG: Sent packet #%d, size=%d bytes\n", frame_count, (int)sizeof(packet));
+            printf("DEBUG: Sent packet #%d, size=%d bytes\n", frame_count, sent);
             if (frame_count == 1) {
                 printf("DEBUG: Panel contents - ps_address=0x%lx, ps_data=0x%x\n", 
                        (unsigned long)panel.ps_address, (unsigned short)panel.ps_data);
@@ -55,11 +55,22 @@ int main(int argc, char *argv[])
     struct sockaddr_in server_addr;
     
     /* Parse command line arguments */
-    while ((c = getopt(argc, argv, "s:h")) != -1) {
+    while ((c = getopt(argc, argv, "s:h12l:")) != -1) {
         switch (c) {
         case 's':
             server_ip = optarg;
             break;
+        case '1':
+            panel_protocol = 1;
+            break;
+        case '2':
+            panel_protocol = 2;
+            break;
+        case 'l':
+            if (panel_publish_local(optarg) < 0) {
+                exit(1);
+            }
+            break;
         case 'h':
         case '?':
             usage(argv[0]);
@@ -159,8 +170,8 @@ int read_panel_from_kvm(struct netbsdx64_panel_state *panel)
 void send_frames(int sockfd, struct sockaddr_in *server_addr)
 {
     struct netbsdx64_panel_state panel;
-    struct netbsdx64_panel_packet packet;
     int frame_count = 0;
+    int sent;
     
     while (1) {
         /* Read panel structure from kernel memory */
@@ -169,14 +180,10 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
             break;
         }
         
-        /* Populate packet structure */
-        packet.header.pp_byte_count = sizeof(struct netbsdx64_panel_state);
-        packet.header.pp_byte_flags = PANEL_NETBSDX64;  /* Set panel type flag */
-        packet.panel_state = panel;
-        
         /* Send panel packet via UDP */
-        if (sendto(sockfd, &packet, sizeof(packet), 0,
-                   (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
+        sent = send_panel(sockfd, server_addr, PANEL_NETBSDX64,
+                          (char *)&panel, sizeof(panel), 0);
+        if (sent < 0) {
             perror("sendto");
             break;
         }
@@ -189,7 +196,7 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
         
         /* Debug: Print first few sends */
         if (frame_count <= 5) {
-            printf("DEBUG: Sent packet #%d, size=%d bytes\n", frame_count, (int)sizeof(packet));
+            printf("DEBUG: Sent packet #%d, size=%d bytes\n", frame_count, sent);
             if (frame_count == 1) {
                 printf("DEBUG: Panel contents - cf_rip=0x%lx, cf_rsp=0x%lx\n", 
                        (unsigned long)panel.ps_frame.cf_rip, (unsigned long)panel.ps_frame.cf_rsp);
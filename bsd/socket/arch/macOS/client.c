@@ -50,11 +50,22 @@ int main(int argc, char *argv[])
     struct sockaddr_in server_addr;
     
     /* Parse command line arguments */
-    while ((c = getopt(argc, argv, "s:h")) != -1) {
+    while ((c = getopt(argc, argv, "s:h12l:")) != -1) {
         switch (c) {
         case 's':
             server_ip = optarg;
             break;
+        case '1':
+            panel_protocol = 1;
+            break;
+        case '2':
+            panel_protocol = 2;
+            break;
+        case 'l':
+            if (panel_publish_local(optarg) < 0) {
+                exit(1);
+            }
+            break;
         case 'h':
         case '?':
             usage(argv[0]);
@@ -213,8 +224,8 @@ int get_system_stats(struct macos_panel_state *panel)
 void send_frames(int sockfd, struct sockaddr_in *server_addr)
 {
     struct macos_panel_state panel;
-    struct macos_panel_packet packet;
     int frame_count = 0;
+    int sent;
     
     while (1) {
         /* Capture current CPU state and system stats */
@@ -227,14 +238,10 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
             fprintf(stderr, "Failed to get system stats\n");
         }
         
-        /* Populate packet structure */
-        packet.header.pp_byte_count = sizeof(struct macos_panel_state);
-        packet.header.pp_byte_flags = PANEL_MACOS;
-        packet.panel_state = panel;
-        
         /* Send panel packet via UDP */
-        if (sendto(sockfd, &packet, sizeof(packet), 0,
-                   (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
+        sent = send_panel(sockfd, server_addr, PANEL_MACOS,
+                          (char *)&panel, sizeof(panel), 0);
+        if (sent < 0) {
             perror("sendto");
             break;
         }
@@ -250,7 +257,7 @@ void send_frames(int sockfd, struct sockaddr_in *server_addr)
         
         /* Debug: Print first few sends */
         if (frame_count <= 5) {
-            printf("DEBUG: Sent packet #%d, size=%d bytes\n", frame_count, (int)sizeof(packet));
+            printf("DEBUG: Sent packet #%d, size=%d bytes\n", frame_count, sent);
             printf("DEBUG: PC=0x%llx, X0=0x%llx, X1=0x%llx, timestamp=0x%x\n", 
                    panel.pc, panel.x0, panel.x1, panel.timestamp);
         }
@@ -23,9 +23,18 @@ extern int close();
 #include <unistd.h>  /* For close() */
 #endif
 
+#include "panel_packet.h"
+
+/* Shared memory transport for clients and viewers on the same host */
+#ifndef __pdp11__
+#define PANEL_SHM
+#include "panel_shm.c"
+#endif
+
 /* Common definitions */
 #define FRAMES_PER_SECOND 60
 #define USEC_PER_FRAME (1000000 / FRAMES_PER_SECOND)
+#define PANEL_V2_KEYEVERY FRAMES_PER_SECOND   /* Frames between keyframes */
 
 /* Panel type enumeration for packet flags */
 typedef enum {
@@ -70,10 +79,203 @@ int create_udp_socket(char *server_ip, struct sockaddr_in *server_addr)
     return sockfd;
 }
 
+/*
+ * Protocol version send_panel() uses.  v1 by default, since a server
+ * that only knows v1 drops v2 packets; clients choose v2 with -2.
+ */
+int panel_protocol = 1;
+
+#ifdef PANEL_SHM
+#define PANEL_LOCAL() (panel_ring_out != NULL)
+/* Ring send_panel() publishes to instead of UDP, set by -l */
+struct panel_ring *panel_ring_out = NULL;
+
+int panel_publish_local(char *name)
+{
+    panel_ring_out = panel_ring_create(name);
+    if (panel_ring_out == NULL) {
+        perror(name);
+        return -1;
+    }
+    return 0;
+}
+#else
+#define PANEL_LOCAL() 0
+#endif
+
+/* v2 sender state: there is one panel stream per client process */
+static unsigned short pv_seq;
+static unsigned short pv_keyseq;
+static int pv_sincekey;
+static int pv_keylen = -1;
+static struct timeval pv_start;
+static unsigned char pv_key[PANEL_V2_MAXSTATE + 1];
+static unsigned char pv_packet[sizeof(struct panel_packet_header) +
+                               PANEL_V2_HDRLEN + PANEL_V2_MAXSTATE / 8 +
+                               PANEL_V2_MAXSTATE + 2];
+
+static void put_word(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0377;
+    p[1] = (v >> 8) & 0377;
+}
+
+/*
+ * Code cur against ref as a word bitmap followed by the XOR of each
+ * changed 16-bit word, the form v2 deltas use.  ref must have a zero
+ * byte after len.  Returns the delta's length, or -1 if it would be no
+ * smaller than len.
+ */
+int panel_delta(unsigned char *out, unsigned char *ref, unsigned char *cur,
+                int len)
+{
+    unsigned char *map, *o;
+    int nwords, maplen, w;
+    int x0, x1;
+
+    nwords = (len + 1) / 2;
+    maplen = (nwords + 7) / 8;
+    map = out;
+    memset(map, 0, maplen);
+    o = out + maplen;
+    for (w = 0; w < nwords; w++) {
+        x0 = cur[2 * w] ^ ref[2 * w];
+        x1 = (2 * w + 1 < len ? cur[2 * w + 1] : 0) ^ ref[2 * w + 1];
+        if (x0 | x1) {
+            map[w >> 3] |= 1 << (w & 7);
+            *o++ = x0;
+            *o++ = x1;
+            if (o - out >= len) {
+                return -1;
+            }
+        }
+    }
+    return o - out;
+}
+
+/*
+ * Rebuild state from ref and a delta made by panel_delta().  state and
+ * ref hold len + 1 bytes.  Returns -1 if the delta is malformed.
+ */
+int panel_undelta(unsigned char *state, unsigned char *ref, int len,
+                  unsigned char *d, int dlen)
+{
+    unsigned char *x, *end;
+    int nwords, maplen, w;
+
+    nwords = (len + 1) / 2;
+    maplen = (nwords + 7) / 8;
+    if (dlen < maplen) {
+        return -1;
+    }
+    end = d + dlen;
+    x = d + maplen;
+    memcpy(state, ref, len + 1);
+    for (w = 0; w < nwords; w++) {
+        if (d[w >> 3] & (1 << (w & 7))) {
+            if (x + 2 > end) {
+                return -1;
+            }
+            state[2 * w] ^= x[0];
+            state[2 * w + 1] ^= x[1];
+            x += 2;
+        }
+    }
+    return x == end ? 0 : -1;
+}
+
+/*
+ * Build one v2 frame for state in pv_packet and return its length.
+ * A delta is sent unless it is time for a keyframe, the state changed
+ * size, or the delta would be no smaller than the state itself.
+ */
+int panel_v2_encode(int type, char *state, int len)
+{
+    struct panel_packet_header header;
+    struct timeval now;
+    unsigned char *p, *out;
+    unsigned long msec;
+    int key, n;
+
+    p = pv_packet + sizeof(header);
+    out = p + PANEL_V2_HDRLEN;
+    key = pv_keylen != len || pv_sincekey >= PANEL_V2_KEYEVERY;
+    if (!key) {
+        n = panel_delta(out, pv_key, (unsigned char *)state, len);
+        if (n < 0) {
+            key = 1;
+        } else {
+            out += n;
+        }
+    }
+    if (key) {
+        if (pv_keylen < 0) {
+            gettimeofday(&pv_start, NULL);
+        }
+        memcpy(pv_key, state, len);
+        pv_key[len] = 0;
+        pv_keylen = len;
+        pv_keyseq = pv_seq;
+        pv_sincekey = 0;
+        memcpy(out, state, len);
+        out += len;
+    }
+
+    gettimeofday(&now, NULL);
+    msec = (unsigned long)(now.tv_sec - pv_start.tv_sec) * 1000L +
+           (now.tv_usec - pv_start.tv_usec) / 1000L;
+    put_word(p, pv_seq);
+    put_word(p + 2, pv_keyseq);
+    put_word(p + 4, (unsigned int)(msec >> 16));
+    put_word(p + 6, (unsigned int)msec);
+    pv_seq++;
+    pv_sincekey++;
+
+    header.pp_byte_count = out - p;
+    header.pp_byte_flags = type | PANEL_V2 | (key ? PANEL_V2_KEY : 0);
+    memcpy(pv_packet, &header, sizeof(header));
+    return out - pv_packet;
+}
+
+/* Send one panel_state using the selected protocol version */
+int send_panel(int sockfd, struct sockaddr_in *server_addr, int type,
+               char *state, int len, int flags)
+{
+    struct panel_packet_header header;
+    int n;
+
+    if (len > PANEL_V2_MAXSTATE) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (panel_protocol == 1 || PANEL_LOCAL()) {
+        header.pp_byte_count = len;
+        header.pp_byte_flags = type;
+        memcpy(pv_packet, &header, sizeof(header));
+        memcpy(pv_packet + sizeof(header), state, len);
+        n = sizeof(header) + len;
+    } else {
+        n = panel_v2_encode(type, state, len);
+    }
+#ifdef PANEL_SHM
+    if (panel_ring_out != NULL) {
+        panel_ring_publish(panel_ring_out, pv_packet, n);
+        return n;
+    }
+#endif
+    return sendto(sockfd, (char *)pv_packet, n, flags,
+                  (struct sockaddr *)server_addr, sizeof(*server_addr));
+}
+
 void usage(char *progname)
 {
-    printf("Usage: %s [-s server_ip]\n", progname);
+    printf("Usage: %s [-s server_ip] [-1 | -2]\n", progname);
     printf("  -s server_ip   IP address of server (default: 127.0.0.1)\n");
+    printf("  -1             Send full v1 frames, for any server (default)\n");
+    printf("  -2             Send v2 delta frames; the server must know v2\n");
+#ifdef PANEL_SHM
+    printf("  -l name        Publish to shared memory ring name, not UDP\n");
+#endif
     printf("  -h             Show this help\n");
 }
 
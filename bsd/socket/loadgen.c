@@ -0,0 +1,474 @@
+/*
+ * loadgen.c - Synthetic panel clients for sizing a server, and a report
+ * of what the server made of them
+ *
+ * Sends valid v2 (or with -1, v1) frames for any mix of panel types from
+ * many sources, each from its own UDP socket, at a fixed rate per source.
+ * Sources are staggered evenly across the frame period the way
+ * independent machines would be.  The first 8 bytes of every panel_state
+ * are a probe: LG_MAGIC, a 16-bit sequence number and the send time in
+ * microseconds, all little-endian, so a recording the server makes with
+ * "-m -w file" carries send and arrival time for every frame it decoded.
+ * "loadgen -R file" reads such a recording back and reports throughput,
+ * frames lost per panel type and latency percentiles.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+
+#define SERVER_PORT 4000
+#include "common.c"
+#include "panel_record.c"
+
+#include "arch/NetBSDx64/panel_state.h"
+#include "arch/NetBSDVAX/panel_state.h"
+#include "arch/macOS/panel_state.h"
+#include "arch/LinuxX64/panel_state.h"
+
+#define LG_MAX_SOURCES 128      /* As many as the server's table tracks */
+#define LG_MAGIC 0x474C         /* "LG" on the wire */
+#define LG_PROBE 8              /* Magic, sequence, send time low 32 bits */
+#define LG_LATE_USEC 1000       /* Sends this far behind schedule are late */
+
+/* Panel types and the size of the panel_state their clients send */
+static struct lg_type {
+    int lt_type;
+    char *lt_name;
+    int lt_len;
+} lg_types[] = {
+    { PANEL_PDP1170,   "pdp",    16 },  /* Two-byte ints, four-byte long */
+    { PANEL_VAX,       "vax",    sizeof(struct vax_panel_state) },
+    { PANEL_NETBSDX64, "netbsd", sizeof(struct netbsdx64_panel_state) },
+    { PANEL_MACOS,     "macos",  sizeof(struct macos_panel_state) },
+    { PANEL_LINUXX64,  "linux",  sizeof(struct linuxx64_panel_state) }
+};
+#define LG_NTYPES (int)(sizeof(lg_types) / sizeof(lg_types[0]))
+
+/* One synthetic client and its v2 sender state */
+struct lg_source {
+    int ls_fd;
+    struct lg_type *ls_type;
+    uint16_t ls_seq;
+    uint16_t ls_keyseq;
+    int ls_sincekey;
+    unsigned char ls_state[PANEL_V2_MAXSTATE + 1];
+    unsigned char ls_key[PANEL_V2_MAXSTATE + 1];
+};
+
+static struct lg_source sources[LG_MAX_SOURCES];
+static unsigned char lg_packet[sizeof(struct panel_packet_header) +
+                               PANEL_V2_HDRLEN + PANEL_V2_MAXSTATE / 8 +
+                               PANEL_V2_MAXSTATE + 2];
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+void loadgen_usage(char *progname)
+{
+    printf("Usage: %s [-s server_ip] [-n sources] [-t types] [-r hz] [-d seconds] [-1]\n",
+           progname);
+    printf("       %s -R recording\n", progname);
+    printf("  -s server_ip   IP address of server (default: 127.0.0.1)\n");
+    printf("  -n sources     Sources per panel type (default: 1)\n");
+    printf("  -t types       Comma separated panel types to send (default: all)\n");
+    printf("                 pdp, vax, netbsd, macos, linux\n");
+    printf("  -r hz          Frames per second per source (default: %d)\n",
+           FRAMES_PER_SECOND);
+    printf("  -d seconds     Stop after this long (default: 10)\n");
+    printf("  -1             Send full v1 frames\n");
+    printf("  -R recording   Report on a \"server -m -w\" recording of a run\n");
+    printf("  -h             Show this help\n");
+}
+
+static uint64_t now_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void put_long(unsigned char *p, uint32_t v)
+{
+    put_word(p, v & 0xFFFF);
+    put_word(p + 2, v >> 16);
+}
+
+static uint32_t get_long(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+           (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Parse -t into a mask of lg_types entries; 0 if a name is unknown */
+static int parse_types(char *list)
+{
+    char *name;
+    int mask, i;
+
+    mask = 0;
+    for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        for (i = 0; i < LG_NTYPES; i++) {
+            if (strcmp(name, lg_types[i].lt_name) == 0) {
+                break;
+            }
+        }
+        if (i == LG_NTYPES) {
+            fprintf(stderr, "Unknown panel type: %s\n", name);
+            return 0;
+        }
+        mask |= 1 << i;
+    }
+    return mask;
+}
+
+/*
+ * Build source s's next frame in lg_packet and return its length.  The
+ * v2 coding is panel_v2_encode()'s, kept per source rather than per
+ * process.
+ */
+static int lg_encode(struct lg_source *s, int protocol, uint64_t t0)
+{
+    struct panel_packet_header header;
+    unsigned char *p, *out;
+    unsigned long msec;
+    int len, key, n;
+
+    len = s->ls_type->lt_len;
+    p = lg_packet + sizeof(header);
+    if (protocol == 1) {
+        memcpy(p, s->ls_state, len);
+        header.pp_byte_count = len;
+        header.pp_byte_flags = s->ls_type->lt_type;
+        memcpy(lg_packet, &header, sizeof(header));
+        return sizeof(header) + len;
+    }
+
+    out = p + PANEL_V2_HDRLEN;
+    key = s->ls_sincekey >= PANEL_V2_KEYEVERY;
+    if (!key) {
+        n = panel_delta(out, s->ls_key, s->ls_state, len);
+        if (n < 0) {
+            key = 1;
+        } else {
+            out += n;
+        }
+    }
+    if (key) {
+        memcpy(s->ls_key, s->ls_state, len);
+        s->ls_key[len] = 0;
+        s->ls_keyseq = s->ls_seq;
+        s->ls_sincekey = 0;
+        memcpy(out, s->ls_state, len);
+        out += len;
+    }
+    msec = (unsigned long)((now_usec() - t0) / 1000);
+    put_word(p, s->ls_seq);
+    put_word(p + 2, s->ls_keyseq);
+    put_word(p + 4, (unsigned int)(msec >> 16));
+    put_word(p + 6, (unsigned int)msec);
+    s->ls_sincekey++;
+
+    header.pp_byte_count = out - p;
+    header.pp_byte_flags = s->ls_type->lt_type | PANEL_V2 |
+                           (key ? PANEL_V2_KEY : 0);
+    memcpy(lg_packet, &header, sizeof(header));
+    return out - lg_packet;
+}
+
+static int run_load(char *server_ip, int per_type, int types, int hz,
+                    double seconds, int protocol)
+{
+    struct sockaddr_in server_addr;
+    struct lg_source *s;
+    uint64_t t0, due, now, end, k;
+    unsigned long sent = 0, late = 0, errors = 0;
+    double gap;
+    int nsources, fd, i, j, n;
+
+    fd = create_udp_socket(server_ip, &server_addr);
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+
+    nsources = 0;
+    for (i = 0; i < LG_NTYPES; i++) {
+        if (!(types & (1 << i))) {
+            continue;
+        }
+        for (j = 0; j < per_type; j++) {
+            s = &sources[nsources];
+            memset(s, 0, sizeof(*s));
+            s->ls_type = &lg_types[i];
+            s->ls_sincekey = PANEL_V2_KEYEVERY;     /* Key first */
+            s->ls_fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (s->ls_fd < 0) {
+                perror("socket");
+                return 1;
+            }
+            /* Something for the server to decode besides the probe */
+            for (n = LG_PROBE; n < s->ls_type->lt_len; n++) {
+                s->ls_state[n] = (nsources * 31 + n * 7) & 0377;
+            }
+            nsources++;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("Sending %d sources at %d Hz for %.0f s to %s\n",
+           nsources, hz, seconds, server_ip);
+    gap = 1e6 / hz / nsources;
+    t0 = now_usec();
+    end = t0 + (uint64_t)(seconds * 1e6);
+    for (k = 0; !stop; k++) {
+        due = t0 + (uint64_t)(k * gap);
+        if (due >= end) {
+            break;
+        }
+        now = now_usec();
+        if (due > now) {
+            precise_delay((long)(due - now));
+            now = now_usec();
+        } else if (now > due + LG_LATE_USEC) {
+            late++;
+        }
+        s = &sources[k % nsources];
+        put_word(s->ls_state, LG_MAGIC);
+        put_word(s->ls_state + 2, s->ls_seq);
+        put_long(s->ls_state + 4, (uint32_t)now);
+        n = lg_encode(s, protocol, t0);
+        if (sendto(s->ls_fd, (char *)lg_packet, n, 0,
+                   (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+            errors++;
+        }
+        s->ls_seq++;
+        sent++;
+    }
+
+    now = now_usec();
+    printf("Sent %lu frames in %.3f s, %.0f frames/s", sent,
+           (now - t0) / 1e6, sent / ((now - t0) / 1e6));
+    if (late) {
+        printf(", %lu over %d ms late", late, LG_LATE_USEC / 1000);
+    }
+    if (errors) {
+        printf(", %lu send errors", errors);
+    }
+    printf("\n");
+    for (i = 0; i < nsources; i++) {
+        close(sources[i].ls_fd);
+    }
+    return 0;
+}
+
+static int cmp_latency(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Read a recording of a load run.  Frames without the probe are
+ * skipped, so other clients may share the server during a run.
+ */
+static int report(char *path)
+{
+    struct lg_stats {
+        int st_known;
+        uint16_t st_lastseq;
+        uint64_t st_span;       /* Sequence numbers from first to last */
+        unsigned long st_frames;
+    } src[PREC_MAX_SOURCES];
+    struct {
+        int tt_sources;
+        unsigned long tt_frames;
+        uint64_t tt_expected;
+    } per_type[LG_NTYPES];
+    struct panel_reader reader;
+    struct prec_frame frame;
+    struct lg_stats *st;
+    int32_t *lat = NULL;
+    unsigned char *state;
+    uint64_t first = 0, last = 0, recv;
+    unsigned long nlat = 0, maxlat = 0, other = 0, negative = 0;
+    int16_t step;
+    int r, i, j;
+
+    if (prec_open(&reader, path) < 0) {
+        perror(path);
+        return 1;
+    }
+    memset(src, 0, sizeof(src));
+    memset(per_type, 0, sizeof(per_type));
+    while ((r = prec_read(&reader, &frame)) > 0) {
+        state = frame.pf_src->pr_state;
+        if (frame.pf_src->pr_len < LG_PROBE ||
+            (state[0] | state[1] << 8) != LG_MAGIC) {
+            other++;
+            continue;
+        }
+        st = &src[frame.pf_id];
+        if (!st->st_known) {
+            st->st_known = 1;
+            st->st_span = 1;
+        } else {
+            step = (int16_t)((state[2] | state[3] << 8) - st->st_lastseq);
+            if (step > 0) {
+                st->st_span += step;
+            }
+        }
+        st->st_lastseq = state[2] | state[3] << 8;
+        st->st_frames++;
+
+        if (nlat == maxlat) {
+            maxlat = maxlat ? 2 * maxlat : 65536;
+            lat = realloc(lat, maxlat * sizeof(*lat));
+            if (lat == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+        recv = reader.pr_start * 1000 + frame.pf_time;
+        lat[nlat] = (int32_t)((uint32_t)recv - get_long(state + 4));
+        if (lat[nlat] < 0) {
+            negative++;
+        }
+        nlat++;
+        if (nlat == 1) {
+            first = frame.pf_time;
+        }
+        last = frame.pf_time;
+    }
+    if (r < 0) {
+        fprintf(stderr, "%s: recording is damaged after %lu frames\n",
+                path, nlat + other);
+    }
+    if (nlat == 0) {
+        printf("%s: no load generator frames\n", path);
+        prec_rclose(&reader);
+        return 1;
+    }
+
+    for (i = 0; i < PREC_MAX_SOURCES; i++) {
+        if (!src[i].st_known) {
+            continue;
+        }
+        for (j = 0; j < LG_NTYPES; j++) {
+            if ((int)reader.pr_src[i].pr_type == lg_types[j].lt_type) {
+                per_type[j].tt_sources++;
+                per_type[j].tt_frames += src[i].st_frames;
+                per_type[j].tt_expected += src[i].st_span;
+            }
+        }
+    }
+    printf("%lu frames over %.3f s: %.0f frames/s decoded\n", nlat,
+           (last - first) / 1e6,
+           last > first ? nlat / ((last - first) / 1e6) : 0.0);
+    if (other) {
+        printf("%lu frames from other clients skipped\n", other);
+    }
+    printf("\n%-8s %7s %10s %10s %8s\n", "type", "sources", "received",
+           "lost", "drop");
+    for (j = 0; j < LG_NTYPES; j++) {
+        if (per_type[j].tt_sources == 0) {
+            continue;
+        }
+        printf("%-8s %7d %10lu %10llu %7.3f%%\n", lg_types[j].lt_name,
+               per_type[j].tt_sources, per_type[j].tt_frames,
+               (unsigned long long)(per_type[j].tt_expected -
+                                    per_type[j].tt_frames),
+               100.0 * (per_type[j].tt_expected - per_type[j].tt_frames) /
+               per_type[j].tt_expected);
+    }
+
+    qsort(lat, nlat, sizeof(*lat), cmp_latency);
+    printf("\nLatency, send to decode (usec):\n");
+    printf("  min %ld  p50 %ld  p90 %ld  p99 %ld  p99.9 %ld  max %ld\n",
+           (long)lat[0], (long)lat[nlat / 2], (long)lat[nlat * 90 / 100],
+           (long)lat[nlat * 99 / 100], (long)lat[nlat * 999 / 1000],
+           (long)lat[nlat - 1]);
+    if (negative) {
+        printf("  %lu frames decoded before they were sent: "
+               "clocks not in step?\n", negative);
+    }
+    free(lat);
+    prec_rclose(&reader);
+    return r < 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char *server_ip = "127.0.0.1";
+    char *recording = NULL;
+    double seconds = 10.0;
+    int per_type = 1, types = (1 << LG_NTYPES) - 1;
+    int hz = FRAMES_PER_SECOND, protocol = 2;
+    int opt, n;
+
+    while ((opt = getopt(argc, argv, "s:n:t:r:d:1R:h")) != -1) {
+        switch (opt) {
+            case 's':
+                server_ip = optarg;
+                break;
+            case 'n':
+                per_type = atoi(optarg);
+                break;
+            case 't':
+                types = parse_types(optarg);
+                if (types == 0) {
+                    exit(1);
+                }
+                break;
+            case 'r':
+                hz = atoi(optarg);
+                break;
+            case 'd':
+                seconds = atof(optarg);
+                break;
+            case '1':
+                protocol = 1;
+                break;
+            case 'R':
+                recording = optarg;
+                break;
+            case 'h':
+                loadgen_usage(argv[0]);
+                exit(0);
+            default:
+                loadgen_usage(argv[0]);
+                exit(1);
+        }
+    }
+    if (optind != argc || per_type <= 0 || hz <= 0 || seconds <= 0) {
+        loadgen_usage(argv[0]);
+        exit(1);
+    }
+    if (recording != NULL) {
+        return report(recording);
+    }
+    for (n = 0, opt = types; opt; opt >>= 1) {
+        n += opt & 1;
+    }
+    if (n * per_type > LG_MAX_SOURCES) {
+        fprintf(stderr, "At most %d sources in all\n", LG_MAX_SOURCES);
+        exit(1);
+    }
+    return run_load(server_ip, per_type, types, hz, seconds, protocol);
+}
@@ -0,0 +1,407 @@
+/*
+ * panel_metrics.c - Rolling statistics per panel source for scraping
+ *
+ * Every decoded frame is classified by processor mode (PDP-11 PSW
+ * current mode, x86-64 CS privilege level), by whether the CPU looks idle
+ * (its address has not moved since the previous frame), and for the
+ * PDP-11 by the 8 KB MMU page of physical memory the address falls in.
+ * Counts go into one bucket per second and one per minute, each kept in
+ * a ring, so the last full second, minute and hour can be reported from
+ * fixed memory: about 2.5 KB per source, plus 190 KB for a PDP-11's page
+ * histogram.  pmet_render() writes them in the Prometheus text format,
+ * which server.c serves over HTTP with -M.  Included by server.c after
+ * panel_table.c.
+ */
+
+#ifndef PANEL_METRICS_C
+#define PANEL_METRICS_C
+
+#include <stdarg.h>
+
+#define PMET_PAGES 512          /* 8 KB pages in the PDP-11's 22-bit space */
+#define PMET_SECONDS 61         /* Last full minute plus the current second */
+#define PMET_MINUTES 61         /* Last full hour plus the current minute */
+
+enum { PMET_KERNEL, PMET_SUPER, PMET_USER, PMET_MODES };
+enum { PMET_1S, PMET_1M, PMET_1H, PMET_WINDOWS };
+
+static const char *pmet_mode_name[PMET_MODES] = { "kernel", "supervisor", "user" };
+static const char *pmet_window_name[PMET_WINDOWS] = { "1s", "1m", "1h" };
+
+struct pmet_count {
+    uint32_t pc_frames;
+    uint32_t pc_mode[PMET_MODES];   /* Frames in each mode, where known */
+    uint32_t pc_idle;               /* Frames whose address had not moved */
+};
+
+/* Address histogram, PDP-11 only */
+struct pmet_pages {
+    uint16_t pp_sec[PMET_SECONDS][PMET_PAGES];
+    uint32_t pp_min[PMET_MINUTES][PMET_PAGES];
+};
+
+struct pmet_source {
+    struct pmet_count ms_sec[PMET_SECONDS];
+    struct pmet_count ms_min[PMET_MINUTES];
+    struct pmet_pages *ms_pages;    /* Allocated on the first PDP-11 frame */
+    long ms_now;                    /* Second of the current bucket */
+    uint64_t ms_addr;               /* Address in the previous frame */
+    int ms_started;                 /* ms_addr is valid */
+};
+
+struct panel_metrics {
+    struct pmet_source *pm_src[PTAB_MAX_SOURCES];  /* Parallel to pt_src */
+    unsigned long pm_scrapes;
+};
+
+/* Growable text buffer for pmet_render() */
+struct pmet_buf {
+    char *pb_text;
+    size_t pb_len;
+    size_t pb_size;
+};
+
+void pmet_init(struct panel_metrics *pm)
+{
+    memset(pm, 0, sizeof(*pm));
+}
+
+/* Move the current bucket up to second sec, clearing the ones skipped */
+static void pmet_advance(struct pmet_source *m, long sec)
+{
+    int i;
+
+    if (sec <= m->ms_now)
+        return;
+    if (sec - m->ms_now > 60L * PMET_MINUTES) {
+        memset(m->ms_sec, 0, sizeof(m->ms_sec));
+        memset(m->ms_min, 0, sizeof(m->ms_min));
+        if (m->ms_pages != NULL)
+            memset(m->ms_pages, 0, sizeof(*m->ms_pages));
+        m->ms_now = sec;
+        return;
+    }
+    while (m->ms_now < sec) {
+        m->ms_now++;
+        i = m->ms_now % PMET_SECONDS;
+        memset(&m->ms_sec[i], 0, sizeof(m->ms_sec[i]));
+        if (m->ms_pages != NULL)
+            memset(m->ms_pages->pp_sec[i], 0, sizeof(m->ms_pages->pp_sec[i]));
+        if (m->ms_now % 60 == 0) {
+            i = (m->ms_now / 60) % PMET_MINUTES;
+            memset(&m->ms_min[i], 0, sizeof(m->ms_min[i]));
+            if (m->ms_pages != NULL)
+                memset(m->ms_pages->pp_min[i], 0, sizeof(m->ms_pages->pp_min[i]));
+        }
+    }
+}
+
+/*
+ * Pull the address, mode (or -1) and PDP-11 page (or -1) out of a
+ * source's state.  Returns 0 if the panel type carries no address.
+ */
+static int pmet_classify(struct panel_source *s, uint64_t *addr, int *mode,
+                         int *page)
+{
+    const unsigned char *p = s->ps_state;
+    uint64_t cs;
+    unsigned psw;
+
+    *mode = -1;
+    *page = -1;
+    switch (s->ps_type) {
+    case PANEL_PDP1170:
+        if (s->ps_len < 8)
+            return 0;
+        *addr = ((uint64_t)get_word(p) << 16 | get_word(p + 2)) & 017777777;
+        *page = (int)(*addr >> 13);
+        psw = get_word(p + 6);
+        switch (psw >> 14) {
+        case 0:
+            *mode = PMET_KERNEL;
+            break;
+        case 1:
+            *mode = PMET_SUPER;
+            break;
+        case 3:
+            *mode = PMET_USER;
+            break;
+        }
+        return 1;
+    case PANEL_VAX:
+        if (s->ps_len < 4)
+            return 0;
+        *addr = get_word(p) | (uint64_t)get_word(p + 2) << 16;
+        return 1;
+    case PANEL_NETBSDX64:
+        if (s->ps_len < sizeof(struct clockframe))
+            return 0;
+        *addr = le64(p + offsetof(struct clockframe, cf_rip));
+        cs = le64(p + offsetof(struct clockframe, cf_cs));
+        *mode = (cs & 3) == 0 ? PMET_KERNEL : (cs & 3) == 3 ? PMET_USER : -1;
+        return 1;
+    case PANEL_MACOS:
+        if (s->ps_len < sizeof(struct macos_panel_state))
+            return 0;
+        *addr = le64(p + offsetof(struct macos_panel_state, pc));
+        return 1;
+    case PANEL_LINUXX64:
+        if (s->ps_len < sizeof(struct pt_regs))
+            return 0;
+        *addr = le64(p + offsetof(struct pt_regs, rip));
+        cs = le64(p + offsetof(struct pt_regs, cs));
+        *mode = (cs & 3) == 0 ? PMET_KERNEL : (cs & 3) == 3 ? PMET_USER : -1;
+        return 1;
+    }
+    return 0;
+}
+
+/* Fold a newly decoded frame from source s into its buckets */
+void pmet_frame(struct panel_metrics *pm, struct panel_table *t,
+                struct panel_source *s, const struct timeval *now)
+{
+    struct pmet_source *m;
+    struct pmet_count *sec, *min;
+    uint64_t addr;
+    int idx, mode, page, i, j;
+
+    idx = s - t->pt_src;
+    m = pm->pm_src[idx];
+    if (m == NULL) {
+        m = calloc(1, sizeof(*m));
+        if (m == NULL)
+            return;
+        m->ms_now = now->tv_sec;
+        pm->pm_src[idx] = m;
+    }
+    pmet_advance(m, now->tv_sec);
+    i = m->ms_now % PMET_SECONDS;
+    j = (m->ms_now / 60) % PMET_MINUTES;
+    sec = &m->ms_sec[i];
+    min = &m->ms_min[j];
+    sec->pc_frames++;
+    min->pc_frames++;
+    if (!pmet_classify(s, &addr, &mode, &page))
+        return;
+    if (mode >= 0) {
+        sec->pc_mode[mode]++;
+        min->pc_mode[mode]++;
+    }
+    if (m->ms_started && addr == m->ms_addr) {
+        sec->pc_idle++;
+        min->pc_idle++;
+    }
+    m->ms_addr = addr;
+    m->ms_started = 1;
+    if (page >= 0 && page < PMET_PAGES) {
+        if (m->ms_pages == NULL)
+            m->ms_pages = calloc(1, sizeof(*m->ms_pages));
+        if (m->ms_pages == NULL)
+            return;
+        if (m->ms_pages->pp_sec[i][page] < 0xFFFF)
+            m->ms_pages->pp_sec[i][page]++;
+        m->ms_pages->pp_min[j][page]++;
+    }
+}
+
+/*
+ * Sum the buckets of one window: the last full second, the 60 seconds
+ * before the current one, or the 60 minutes before the current one.
+ * pages, if not NULL, receives the page histogram.
+ */
+static void pmet_window(struct pmet_source *m, int w, struct pmet_count *c,
+                        uint32_t *pages)
+{
+    struct pmet_count *b;
+    int k, n, i, p;
+
+    memset(c, 0, sizeof(*c));
+    if (pages != NULL)
+        memset(pages, 0, PMET_PAGES * sizeof(*pages));
+    n = w == PMET_1S ? 1 : 60;
+    for (k = 1; k <= n; k++) {
+        if (w == PMET_1H) {
+            i = (m->ms_now / 60 - k) % PMET_MINUTES;
+            b = &m->ms_min[i];
+        } else {
+            i = (m->ms_now - k) % PMET_SECONDS;
+            b = &m->ms_sec[i];
+        }
+        c->pc_frames += b->pc_frames;
+        c->pc_idle += b->pc_idle;
+        for (p = 0; p < PMET_MODES; p++)
+            c->pc_mode[p] += b->pc_mode[p];
+        if (pages == NULL || m->ms_pages == NULL)
+            continue;
+        for (p = 0; p < PMET_PAGES; p++)
+            pages[p] += w == PMET_1H ? m->ms_pages->pp_min[i][p] :
+                                       m->ms_pages->pp_sec[i][p];
+    }
+}
+
+static void pmet_printf(struct pmet_buf *b, const char *fmt, ...)
+{
+    va_list ap;
+    char *grown;
+    int n;
+
+    for (;;) {
+        va_start(ap, fmt);
+        n = vsnprintf(b->pb_text + b->pb_len, b->pb_size - b->pb_len, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return;
+        if (b->pb_len + n < b->pb_size) {
+            b->pb_len += n;
+            return;
+        }
+        grown = realloc(b->pb_text, b->pb_size * 2 + n);
+        if (grown == NULL)
+            return;
+        b->pb_text = grown;
+        b->pb_size = b->pb_size * 2 + n;
+    }
+}
+
+/* Prometheus labels naming source i */
+static void pmet_labels(struct panel_table *t, int i, char *buf, size_t size)
+{
+    struct panel_source *s = &t->pt_src[i];
+    struct in_addr in;
+
+    in.s_addr = s->ps_ip;
+    if (s->ps_label[0] != '\0')
+        snprintf(buf, size, "source=\"%s\",type=\"%s\"", s->ps_label,
+                 get_panel_type_name(s->ps_type));
+    else
+        snprintf(buf, size, "source=\"%s:%u\",type=\"%s\"", inet_ntoa(in),
+                 (unsigned)ntohs(s->ps_port), get_panel_type_name(s->ps_type));
+}
+
+static void pmet_help(struct pmet_buf *b, const char *name, const char *type,
+                      const char *help)
+{
+    pmet_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*
+ * Write every source's windows and link counters into b as Prometheus
+ * text.  Each metric family is written once, with a sample per source
+ * and window.
+ */
+void pmet_render(struct panel_metrics *pm, struct panel_table *t,
+                 const struct timeval *now, struct pmet_buf *b)
+{
+    static uint32_t pages[PMET_PAGES];
+    struct pmet_count c;
+    struct pmet_source *m;
+    char labels[96];
+    int i, w, k;
+
+    pm->pm_scrapes++;
+    b->pb_len = 0;
+    if (b->pb_text == NULL) {
+        b->pb_size = 65536;
+        b->pb_text = malloc(b->pb_size);
+        if (b->pb_text == NULL)
+            return;
+    }
+    b->pb_text[0] = '\0';
+    for (i = 0; i < t->pt_count; i++)
+        if (pm->pm_src[i] != NULL)
+            pmet_advance(pm->pm_src[i], now->tv_sec);
+
+    pmet_help(b, "panel_datagrams_total", "counter", "Datagrams read by the server");
+    pmet_printf(b, "panel_datagrams_total %lu\n", t->pt_datagrams);
+    pmet_help(b, "panel_kernel_drops_total", "counter",
+              "Datagrams the kernel dropped, where the socket reports it");
+    pmet_printf(b, "panel_kernel_drops_total %lu\n", t->pt_kdrops);
+    pmet_help(b, "panel_table_overflow_total", "counter",
+              "Frames from sources beyond the table");
+    pmet_printf(b, "panel_table_overflow_total %lu\n", t->pt_overflow);
+
+    pmet_help(b, "panel_frames_total", "counter", "Frames decoded since the server started");
+    for (i = 0; i < t->pt_count; i++) {
+        pmet_labels(t, i, labels, sizeof(labels));
+        pmet_printf(b, "panel_frames_total{%s} %lu\n", labels, t->pt_src[i].ps_frames);
+    }
+    pmet_help(b, "panel_bad_total", "counter", "Malformed frames");
+    for (i = 0; i < t->pt_count; i++) {
+        pmet_labels(t, i, labels, sizeof(labels));
+        pmet_printf(b, "panel_bad_total{%s} %lu\n", labels, t->pt_src[i].ps_bad);
+    }
+    pmet_help(b, "panel_lost_total", "counter", "v2 frames never received");
+    for (i = 0; i < t->pt_count; i++) {
+        pmet_labels(t, i, labels, sizeof(labels));
+        pmet_printf(b, "panel_lost_total{%s} %lu\n", labels, t->pt_src[i].ps_lost);
+    }
+
+    pmet_help(b, "panel_frames", "gauge", "Frames decoded in the window");
+    for (i = 0; i < t->pt_count; i++) {
+        if ((m = pm->pm_src[i]) == NULL)
+            continue;
+        pmet_labels(t, i, labels, sizeof(labels));
+        for (w = 0; w < PMET_WINDOWS; w++) {
+            pmet_window(m, w, &c, NULL);
+            pmet_printf(b, "panel_frames{%s,window=\"%s\"} %lu\n", labels,
+                        pmet_window_name[w], (unsigned long)c.pc_frames);
+        }
+    }
+    pmet_help(b, "panel_mode_frames", "gauge",
+              "Frames in the window by processor mode, where the panel shows it");
+    for (i = 0; i < t->pt_count; i++) {
+        if ((m = pm->pm_src[i]) == NULL)
+            continue;
+        pmet_labels(t, i, labels, sizeof(labels));
+        for (w = 0; w < PMET_WINDOWS; w++) {
+            pmet_window(m, w, &c, NULL);
+            for (k = 0; k < PMET_MODES; k++)
+                pmet_printf(b, "panel_mode_frames{%s,window=\"%s\",mode=\"%s\"} %lu\n",
+                            labels, pmet_window_name[w], pmet_mode_name[k],
+                            (unsigned long)c.pc_mode[k]);
+        }
+    }
+    pmet_help(b, "panel_idle_frames", "gauge",
+              "Frames in the window whose address had not moved since the previous frame");
+    for (i = 0; i < t->pt_count; i++) {
+        if ((m = pm->pm_src[i]) == NULL)
+            continue;
+        pmet_labels(t, i, labels, sizeof(labels));
+        for (w = 0; w < PMET_WINDOWS; w++) {
+            pmet_window(m, w, &c, NULL);
+            pmet_printf(b, "panel_idle_frames{%s,window=\"%s\"} %lu\n", labels,
+                        pmet_window_name[w], (unsigned long)c.pc_idle);
+        }
+    }
+    pmet_help(b, "panel_busy_ratio", "gauge",
+              "Estimated fraction of the window the CPU was busy (non-idle frames / frames)");
+    for (i = 0; i < t->pt_count; i++) {
+        if ((m = pm->pm_src[i]) == NULL)
+            continue;
+        pmet_labels(t, i, labels, sizeof(labels));
+        for (w = 0; w < PMET_WINDOWS; w++) {
+            pmet_window(m, w, &c, NULL);
+            if (c.pc_frames > 0)
+                pmet_printf(b, "panel_busy_ratio{%s,window=\"%s\"} %.3f\n", labels,
+                            pmet_window_name[w],
+                            1.0 - (double)c.pc_idle / c.pc_frames);
+        }
+    }
+    pmet_help(b, "panel_page_frames", "gauge",
+              "PDP-11 frames in the window by 8 KB physical page (address >> 13)");
+    for (i = 0; i < t->pt_count; i++) {
+        if ((m = pm->pm_src[i]) == NULL || m->ms_pages == NULL)
+            continue;
+        pmet_labels(t, i, labels, sizeof(labels));
+        for (w = 0; w < PMET_WINDOWS; w++) {
+            pmet_window(m, w, &c, pages);
+            for (k = 0; k < PMET_PAGES; k++)
+                if (pages[k] > 0)
+                    pmet_printf(b, "panel_page_frames{%s,window=\"%s\",page=\"%d\"} %lu\n",
+                                labels, pmet_window_name[w], k,
+                                (unsigned long)pages[k]);
+        }
+    }
+}
+
+#endif /* PANEL_METRICS_C */
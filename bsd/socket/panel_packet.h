@@ -15,4 +15,22 @@ struct panel_packet_header {
     uint32_t pp_byte_flags;    /* Panel type flags (PANEL_PDP1170, PANEL_VAX, etc.) */
 };
 #pragma pack(pop)
+
+/*
+ * Protocol v2 sets PANEL_V2 in pp_byte_flags alongside the panel type.
+ * pp_byte_count then covers four little-endian 16-bit words (sequence
+ * number, sequence number of the keyframe the frame is coded against,
+ * and a millisecond source timestamp, high word first) followed by either
+ * the full panel_state (a keyframe, PANEL_V2_KEY) or a delta: a bitmap
+ * with one bit per 16-bit word of panel_state, low bit first, then the
+ * XOR against the keyframe of each word whose bit is set.  Deltas are
+ * always against the last keyframe, so a lost delta costs one frame and
+ * a lost keyframe at most one keyframe interval.
+ */
+#define PANEL_TYPE_MASK   0x00FF  /* Panel type bits of pp_byte_flags */
+#define PANEL_V2          0x0100  /* Sequenced v2 packet */
+#define PANEL_V2_KEY      0x0200  /* v2 keyframe: full panel_state */
+#define PANEL_V2_HDRLEN   8       /* seq, keyseq, time high, time low */
+#define PANEL_V2_MAXSTATE 512     /* Largest panel_state a v2 frame carries */
+
 #endif /* PANEL_PACKET_H */
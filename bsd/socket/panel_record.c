@@ -0,0 +1,397 @@
+/*
+ * panel_record.c - Panel frame recordings: writer for the server, reader
+ * for replay
+ *
+ * A recording is an append-only stream of records after a 16-byte file
+ * header: "PANELREC" and a little-endian 64-bit word holding the format
+ * version in its low 16 bits and the start time, in msec since the
+ * epoch, above them.  Every record starts with a tag byte; numbers are
+ * unsigned LEB128 varints unless noted:
+ *
+ *   'S' id ip[4] port[2] type     a source (ip and port in network order)
+ *   'K' id dt len state[len]      full panel_state
+ *   'D' id dt len delta[len]      panel_delta() against the source's
+ *                                 previous state
+ *   'C' id dt len state[len]      a source's current state at a sync
+ *                                 point, not a new frame
+ *
+ * dt is microseconds since the previous record, or since the start for
+ * the first.  Once a second the recorder writes a sync point: an 'S' and
+ * a 'C' for every source seen so far, so reading can start there.  The
+ * offset and time of each sync point go in <file>.idx as two
+ * little-endian 64-bit numbers.
+ * Needs common.c for panel_delta() and panel_undelta().
+ */
+
+#ifndef PANEL_RECORD_C
+#define PANEL_RECORD_C
+
+#define PREC_MAGIC "PANELREC"
+#define PREC_VERSION 1
+#define PREC_HDRLEN 16
+#define PREC_MAX_SOURCES 128    /* Source ids are 0..PREC_MAX_SOURCES-1 */
+#define PREC_MAX_STATE PANEL_V2_MAXSTATE
+#define PREC_SYNC_USEC 1000000L /* Sync point interval */
+#define PREC_MAX_RECORD (16 + PREC_MAX_STATE + PREC_MAX_STATE / 16)
+
+struct prec_source {
+    int pr_known;               /* 'S' record written or read */
+    uint32_t pr_ip;             /* Network order */
+    uint16_t pr_port;           /* Network order */
+    uint32_t pr_type;
+    int pr_len;                 /* Bytes in pr_state, 0 before a 'K' */
+    unsigned char pr_state[PREC_MAX_STATE + 1];
+};
+
+struct panel_recorder {
+    FILE *pr_fp;
+    FILE *pr_idx;
+    struct timeval pr_start;
+    uint64_t pr_last;           /* Time of the last record, usec */
+    uint64_t pr_nextsync;
+    unsigned long pr_frames;
+    struct prec_source pr_src[PREC_MAX_SOURCES];
+};
+
+struct panel_reader {
+    FILE *pr_fp;
+    char *pr_path;
+    uint64_t pr_time;           /* Time of the last record, usec */
+    int pr_seeking;             /* Reading the sync point seeked to */
+    int pr_skipdt;              /* Next dt is already in pr_time */
+    uint64_t pr_start;          /* Recording start, msec since the epoch */
+    struct prec_source pr_src[PREC_MAX_SOURCES];
+};
+
+/* One frame returned by prec_read() */
+struct prec_frame {
+    int pf_id;
+    uint64_t pf_time;           /* usec since the recording started */
+    struct prec_source *pf_src;
+};
+
+static unsigned char *prec_putvar(unsigned char *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static int prec_getvar(FILE *fp, uint64_t *v)
+{
+    int c, shift;
+
+    *v = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+        if ((c = getc(fp)) == EOF)
+            return -1;
+        *v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return 0;
+    }
+    return -1;
+}
+
+static void prec_put64(unsigned char *p, uint64_t v)
+{
+    int i;
+
+    for (i = 0; i < 8; i++, v >>= 8)
+        p[i] = v & 0xFF;
+}
+
+static uint64_t prec_get64(const unsigned char *p)
+{
+    uint64_t v;
+    int i;
+
+    v = 0;
+    for (i = 7; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+static unsigned char *prec_source_record(unsigned char *p, int id,
+                                         struct prec_source *s)
+{
+    *p++ = 'S';
+    p = prec_putvar(p, id);
+    memcpy(p, &s->pr_ip, 4);
+    memcpy(p + 4, &s->pr_port, 2);
+    return prec_putvar(p + 6, s->pr_type);
+}
+
+static unsigned char *prec_key_record(unsigned char *p, int tag, int id,
+                                      uint64_t dt, struct prec_source *s)
+{
+    *p++ = tag;
+    p = prec_putvar(p, id);
+    p = prec_putvar(p, dt);
+    p = prec_putvar(p, s->pr_len);
+    memcpy(p, s->pr_state, s->pr_len);
+    return p + s->pr_len;
+}
+
+void prec_close(struct panel_recorder *r)
+{
+    if (r->pr_fp != NULL)
+        fclose(r->pr_fp);
+    if (r->pr_idx != NULL)
+        fclose(r->pr_idx);
+    r->pr_fp = r->pr_idx = NULL;
+}
+
+/* Create a recording and its index; -1 with errno set on failure */
+int prec_create(struct panel_recorder *r, const char *path)
+{
+    unsigned char hdr[PREC_HDRLEN];
+    char idxpath[1024];
+    uint64_t ms;
+
+    memset(r, 0, sizeof(*r));
+    snprintf(idxpath, sizeof(idxpath), "%s.idx", path);
+    if ((r->pr_fp = fopen(path, "wb")) == NULL)
+        return -1;
+    if ((r->pr_idx = fopen(idxpath, "wb")) == NULL) {
+        fclose(r->pr_fp);
+        r->pr_fp = NULL;
+        return -1;
+    }
+    /* Start on a whole msec so frame times are exact against the header */
+    gettimeofday(&r->pr_start, NULL);
+    r->pr_start.tv_usec -= r->pr_start.tv_usec % 1000;
+    ms = (uint64_t)r->pr_start.tv_sec * 1000 + r->pr_start.tv_usec / 1000;
+    memcpy(hdr, PREC_MAGIC, 8);
+    prec_put64(hdr + 8, ms << 16 | PREC_VERSION);
+    if (fwrite(hdr, 1, sizeof(hdr), r->pr_fp) != sizeof(hdr)) {
+        prec_close(r);
+        return -1;
+    }
+    return 0;
+}
+
+/* Write a sync point: every known source in full, and an index entry */
+static void prec_sync(struct panel_recorder *r, uint64_t t)
+{
+    unsigned char buf[PREC_MAX_RECORD], ent[16];
+    struct prec_source *s;
+    uint64_t dt;
+    int id;
+
+    prec_put64(ent, t);
+    prec_put64(ent + 8, (uint64_t)ftell(r->pr_fp));
+    fwrite(ent, 1, sizeof(ent), r->pr_idx);
+    fflush(r->pr_idx);
+    dt = t - r->pr_last;
+    for (id = 0; id < PREC_MAX_SOURCES; id++) {
+        s = &r->pr_src[id];
+        if (!s->pr_known)
+            continue;
+        fwrite(buf, 1, prec_source_record(buf, id, s) - buf, r->pr_fp);
+        if (s->pr_len > 0) {
+            fwrite(buf, 1, prec_key_record(buf, 'C', id, dt, s) - buf, r->pr_fp);
+            dt = 0;
+        }
+    }
+    /*
+     * With no source to write yet (the first sync point), leave pr_last
+     * alone so the next frame's dt still counts from the last record.
+     */
+    if (dt == 0)
+        r->pr_last = t;
+    r->pr_nextsync = t + PREC_SYNC_USEC;
+}
+
+/*
+ * Append one frame for source id.  The first frame from a source is
+ * written in full, later ones as a delta against the previous frame.
+ */
+int prec_write(struct panel_recorder *r, int id, uint32_t ip, uint16_t port,
+               uint32_t type, const unsigned char *state, int len,
+               const struct timeval *now)
+{
+    unsigned char buf[PREC_MAX_RECORD], delta[PREC_MAX_STATE + 2];
+    struct prec_source *s;
+    unsigned char *p;
+    uint64_t t, dt;
+    int n;
+
+    if (r->pr_fp == NULL || id < 0 || id >= PREC_MAX_SOURCES ||
+        len <= 0 || len > PREC_MAX_STATE)
+        return -1;
+    t = (uint64_t)(now->tv_sec - r->pr_start.tv_sec) * 1000000 +
+        now->tv_usec - r->pr_start.tv_usec;
+    if ((int64_t)t < (int64_t)r->pr_last)
+        t = r->pr_last;         /* Clock stepped back */
+    if (t >= r->pr_nextsync)
+        prec_sync(r, t);
+
+    s = &r->pr_src[id];
+    p = buf;
+    if (!s->pr_known) {
+        s->pr_known = 1;
+        s->pr_ip = ip;
+        s->pr_port = port;
+        s->pr_type = type;
+        p = prec_source_record(p, id, s);
+    }
+    dt = t - r->pr_last;
+    n = -1;
+    if (s->pr_len == len)
+        n = panel_delta(delta, s->pr_state, (unsigned char *)state, len);
+    memcpy(s->pr_state, state, len);
+    s->pr_state[len] = 0;
+    s->pr_len = len;
+    if (n >= 0) {
+        *p++ = 'D';
+        p = prec_putvar(p, id);
+        p = prec_putvar(p, dt);
+        p = prec_putvar(p, n);
+        memcpy(p, delta, n);
+        p += n;
+    } else {
+        p = prec_key_record(p, 'K', id, dt, s);
+    }
+    r->pr_last = t;
+    r->pr_frames++;
+    return fwrite(buf, 1, p - buf, r->pr_fp) == (size_t)(p - buf) ? 0 : -1;
+}
+
+/* Open a recording for reading; -1 if it can't be read */
+int prec_open(struct panel_reader *r, char *path)
+{
+    unsigned char hdr[PREC_HDRLEN];
+    uint64_t w;
+
+    memset(r, 0, sizeof(*r));
+    r->pr_path = path;
+    if ((r->pr_fp = fopen(path, "rb")) == NULL)
+        return -1;
+    if (fread(hdr, 1, sizeof(hdr), r->pr_fp) != sizeof(hdr) ||
+        memcmp(hdr, PREC_MAGIC, 8) != 0) {
+        fclose(r->pr_fp);
+        r->pr_fp = NULL;
+        errno = EINVAL;
+        return -1;
+    }
+    w = prec_get64(hdr + 8);
+    if ((w & 0xFFFF) != PREC_VERSION) {
+        fclose(r->pr_fp);
+        r->pr_fp = NULL;
+        errno = EINVAL;
+        return -1;
+    }
+    r->pr_start = w >> 16;
+    return 0;
+}
+
+/*
+ * Position the reader at the last sync point at or before usec into the
+ * recording, using the index.  Returns the time of that sync point.
+ */
+uint64_t prec_seek(struct panel_reader *r, uint64_t usec)
+{
+    unsigned char ent[16];
+    char idxpath[1024];
+    uint64_t t, off, best_t, best_off;
+    int found;
+    FILE *idx;
+
+    best_t = 0;
+    best_off = PREC_HDRLEN;
+    found = 0;
+    snprintf(idxpath, sizeof(idxpath), "%s.idx", r->pr_path);
+    if ((idx = fopen(idxpath, "rb")) != NULL) {
+        while (fread(ent, 1, sizeof(ent), idx) == sizeof(ent)) {
+            t = prec_get64(ent);
+            off = prec_get64(ent + 8);
+            if (t > usec)
+                break;
+            best_t = t;
+            best_off = off;
+            found = 1;
+        }
+        fclose(idx);
+    }
+    memset(r->pr_src, 0, sizeof(r->pr_src));
+    fseek(r->pr_fp, (long)best_off, SEEK_SET);
+    /*
+     * The first record after a sync point's index entry carries dt from
+     * the record before it, which best_t already covers.  That holds for
+     * the first sync point too: it has no sources, so the first frame
+     * carries the lead-in from the start of the recording.
+     */
+    r->pr_time = best_t;
+    r->pr_seeking = r->pr_skipdt = found;
+    return best_t;
+}
+
+/*
+ * Read up to and including the next frame.  Returns 1 with f filled in,
+ * 0 at the end of the recording, -1 if the recording is damaged.
+ */
+int prec_read(struct panel_reader *r, struct prec_frame *f)
+{
+    unsigned char buf[PREC_MAX_STATE + 2], cur[PREC_MAX_STATE + 1];
+    struct prec_source *s;
+    uint64_t id, dt, len, v;
+    int tag;
+
+    while ((tag = getc(r->pr_fp)) != EOF) {
+        if (prec_getvar(r->pr_fp, &id) < 0 || id >= PREC_MAX_SOURCES)
+            return -1;
+        s = &r->pr_src[id];
+        if (tag == 'S') {
+            if (fread(buf, 1, 6, r->pr_fp) != 6 ||
+                prec_getvar(r->pr_fp, &v) < 0)
+                return -1;
+            memcpy(&s->pr_ip, buf, 4);
+            memcpy(&s->pr_port, buf + 4, 2);
+            s->pr_type = v;
+            s->pr_known = 1;
+            continue;
+        }
+        if ((tag != 'K' && tag != 'D' && tag != 'C') || !s->pr_known ||
+            prec_getvar(r->pr_fp, &dt) < 0 ||
+            prec_getvar(r->pr_fp, &len) < 0 || len > PREC_MAX_STATE + 1 ||
+            fread(buf, 1, len, r->pr_fp) != len)
+            return -1;
+        if (r->pr_skipdt)
+            r->pr_skipdt = 0;
+        else
+            r->pr_time += dt;
+        if (tag != 'C')
+            r->pr_seeking = 0;
+        if (tag != 'D') {
+            if (len == 0 || len > PREC_MAX_STATE)
+                return -1;
+            memcpy(s->pr_state, buf, len);
+            s->pr_state[len] = 0;
+            s->pr_len = len;
+        } else {
+            if (s->pr_len == 0 ||
+                panel_undelta(cur, s->pr_state, s->pr_len, buf, len) < 0)
+                return -1;
+            memcpy(s->pr_state, cur, s->pr_len + 1);
+        }
+        if (tag == 'C' && !r->pr_seeking)
+            continue;           /* Only a starting point for readers */
+        f->pf_id = id;
+        f->pf_time = r->pr_time;
+        f->pf_src = s;
+        return 1;
+    }
+    return 0;
+}
+
+void prec_rclose(struct panel_reader *r)
+{
+    if (r->pr_fp != NULL)
+        fclose(r->pr_fp);
+    r->pr_fp = NULL;
+}
+
+#endif /* PANEL_RECORD_C */
@@ -0,0 +1,186 @@
+/*
+ * panel_shm.c - Shared memory ring for panel frames on the same host
+ *
+ * A client publishes into a POSIX shared memory object (shm_open name,
+ * e.g. "/panel0") instead of sending UDP.  The ring has one producer and
+ * any number of readers; readers only map it read-only, so neither side
+ * makes a system call per frame.  Each slot holds one packet in the
+ * usual panel_packet.h framing and is guarded by its own sequence word,
+ * a seqlock: 2n+1 while frame n is being written, 2n+2 once it is
+ * complete.  A reader copies the slot and keeps it only if the word read
+ * before and after the copy is 2n+2.  A reader that falls more than a
+ * ring behind skips ahead to half a ring behind the producer and counts
+ * the frames it missed.
+ * Included by common.c on hosts other than the PDP-11.
+ */
+
+#ifndef PANEL_SHM_C
+#define PANEL_SHM_C
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+#define PANEL_RING_MAGIC 0x50524E47     /* "PRNG" */
+#define PANEL_RING_SLOTS 256            /* Four seconds at 60 Hz */
+#define PANEL_RING_DATA 528             /* Header + PANEL_V2_MAXSTATE, rounded */
+
+struct panel_ring_slot {
+    uint64_t rs_seq;            /* Seqlock word, see above */
+    uint32_t rs_len;            /* Bytes in rs_data */
+    uint32_t rs_pad;
+    unsigned char rs_data[PANEL_RING_DATA];
+};
+
+struct panel_ring {
+    uint32_t pr_magic;          /* Set once the ring is initialized */
+    uint32_t pr_slots;
+    uint32_t pr_slotsize;
+    uint32_t pr_pid;            /* Producer */
+    uint64_t pr_head;           /* Frames published so far */
+    unsigned char pr_pad[40];   /* Keep the head on its own cache line */
+    struct panel_ring_slot pr_slot[PANEL_RING_SLOTS];
+};
+
+/* A reader's position in one ring */
+struct panel_ring_reader {
+    struct panel_ring *rr_ring;
+    uint64_t rr_next;           /* Next frame to read */
+    unsigned long rr_lost;      /* Frames overwritten before being read */
+    char rr_name[64];
+};
+
+static int panel_ring_ok(struct panel_ring *ring)
+{
+    return ring->pr_magic == PANEL_RING_MAGIC &&
+           ring->pr_slots == PANEL_RING_SLOTS &&
+           ring->pr_slotsize == sizeof(struct panel_ring_slot);
+}
+
+/*
+ * Create or reopen the ring called name for publishing.  A ring left by
+ * an earlier run with the same layout keeps its frame count, so attached
+ * readers carry on.  Returns NULL with errno set on failure.
+ */
+struct panel_ring *panel_ring_create(const char *name)
+{
+    struct panel_ring *ring;
+    struct stat st;
+    int fd;
+
+    fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 ||
+        (st.st_size != sizeof(*ring) && ftruncate(fd, sizeof(*ring)) < 0)) {
+        close(fd);
+        return NULL;
+    }
+    ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return NULL;
+    }
+    if (!panel_ring_ok(ring)) {
+        memset(ring, 0, sizeof(*ring));
+        ring->pr_slots = PANEL_RING_SLOTS;
+        ring->pr_slotsize = sizeof(struct panel_ring_slot);
+        __atomic_store_n(&ring->pr_magic, PANEL_RING_MAGIC, __ATOMIC_RELEASE);
+    }
+    ring->pr_pid = getpid();
+    return ring;
+}
+
+/* Publish one framed packet; the producer never waits for readers */
+void panel_ring_publish(struct panel_ring *ring, const void *packet, int len)
+{
+    struct panel_ring_slot *slot;
+    uint64_t n;
+
+    if (len > PANEL_RING_DATA) {
+        return;
+    }
+    n = ring->pr_head;
+    slot = &ring->pr_slot[n % PANEL_RING_SLOTS];
+    __atomic_store_n(&slot->rs_seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(slot->rs_data, packet, len);
+    slot->rs_len = len;
+    __atomic_store_n(&slot->rs_seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->pr_head, n + 1, __ATOMIC_RELEASE);
+}
+
+/* Map the ring called name for reading, starting at its newest frame */
+int panel_ring_attach(struct panel_ring_reader *r, const char *name)
+{
+    struct panel_ring *ring;
+    uint64_t head;
+    int fd;
+
+    memset(r, 0, sizeof(*r));
+    snprintf(r->rr_name, sizeof(r->rr_name), "%s", name);
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    ring = mmap(NULL, sizeof(*ring), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return -1;
+    }
+    if (__atomic_load_n(&ring->pr_magic, __ATOMIC_ACQUIRE) != PANEL_RING_MAGIC ||
+        !panel_ring_ok(ring)) {
+        munmap(ring, sizeof(*ring));
+        errno = EINVAL;
+        return -1;
+    }
+    r->rr_ring = ring;
+    head = __atomic_load_n(&ring->pr_head, __ATOMIC_ACQUIRE);
+    r->rr_next = head > 0 ? head - 1 : 0;
+    return 0;
+}
+
+/*
+ * Copy the next frame into buf.  Returns its length, or 0 if the reader
+ * has caught up with the producer.
+ */
+int panel_ring_read(struct panel_ring_reader *r, void *buf, int size)
+{
+    struct panel_ring *ring = r->rr_ring;
+    struct panel_ring_slot *slot;
+    uint64_t head, seq, want;
+    uint32_t len;
+
+    for (;;) {
+        head = __atomic_load_n(&ring->pr_head, __ATOMIC_ACQUIRE);
+        if (head < r->rr_next) {
+            r->rr_next = head;  /* Producer recreated the ring */
+        }
+        if (r->rr_next == head) {
+            return 0;
+        }
+        if (head - r->rr_next > PANEL_RING_SLOTS) {
+            /* Lapped: resume half a ring back, clear of the producer */
+            r->rr_lost += head - r->rr_next - PANEL_RING_SLOTS / 2;
+            r->rr_next = head - PANEL_RING_SLOTS / 2;
+        }
+        slot = &ring->pr_slot[r->rr_next % PANEL_RING_SLOTS];
+        want = 2 * r->rr_next + 2;
+        seq = __atomic_load_n(&slot->rs_seq, __ATOMIC_ACQUIRE);
+        len = slot->rs_len;
+        if (seq == want && len <= (uint32_t)size) {
+            memcpy(buf, slot->rs_data, len);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->rs_seq, __ATOMIC_RELAXED) == want) {
+                r->rr_next++;
+                return len;
+            }
+        }
+        r->rr_lost++;           /* Overwritten while we looked */
+        r->rr_next++;
+    }
+}
+
+#endif /* PANEL_SHM_C */
@@ -0,0 +1,448 @@
+/*
+ * panel_table.c - Latest panel state per source for the server's
+ * high-rate ingest mode
+ *
+ * Each (address, port, panel type) gets one slot holding the newest
+ * panel_state payload and the counters shown on the status screen.
+ * Frames that arrive faster than the screen refreshes simply replace
+ * the stored payload; they are counted as coalesced, not displayed.
+ * v2 frames are decoded here against the source's last keyframe, and
+ * their sequence numbers and timestamps give loss, reordering,
+ * duplication and jitter per source.  Included by server.c after the
+ * arch panel_state.h headers.
+ */
+
+#ifndef PANEL_TABLE_C
+#define PANEL_TABLE_C
+
+#define PTAB_MAX_SOURCES 128    /* Sources tracked; more count as overflow */
+#define PTAB_SLOTS 256          /* Hash slots, power of two, > sources */
+#define PTAB_MAX_STATE PANEL_V2_MAXSTATE  /* Largest panel_state kept */
+#define PTAB_RESTART 1024       /* Step back taken as a client restart */
+#define PTAB_SEEN 32            /* Numbers remembered for late frames */
+
+const char *get_panel_type_name(uint32_t flags);
+
+struct panel_source {
+    char ps_label[32];          /* Shown instead of the address if set */
+    uint32_t ps_ip;             /* Source address, network order */
+    uint16_t ps_port;           /* Source port, network order */
+    uint32_t ps_type;           /* PANEL_* value */
+    uint16_t ps_len;            /* Bytes in ps_state */
+    unsigned char ps_state[PTAB_MAX_STATE + 1];
+    unsigned long ps_frames;    /* Good frames ingested */
+    unsigned long ps_pending;   /* Frames since the last refresh */
+    unsigned long ps_coalesced; /* Frames replaced before being shown */
+    unsigned long ps_bad;       /* Malformed frames */
+    unsigned long ps_bytes;     /* Datagram bytes received */
+    int ps_version;             /* Protocol version last seen */
+    /* v2 only */
+    unsigned char ps_key[PTAB_MAX_STATE + 1];  /* Last keyframe */
+    uint16_t ps_keylen;         /* 0 until a keyframe arrives */
+    uint16_t ps_keyseq;         /* Sequence number of ps_key */
+    uint16_t ps_nextseq;        /* Sequence number expected next */
+    int ps_seqvalid;            /* ps_nextseq has been set */
+    uint32_t ps_seen;           /* Bit i: ps_nextseq - 1 - i was received */
+    int ps_history;             /* Bits of ps_seen that mean anything */
+    unsigned long ps_lost;      /* Sequence numbers never received */
+    unsigned long ps_reordered; /* Frames that arrived late */
+    unsigned long ps_duplicate; /* Frames received more than once */
+    unsigned long ps_nokey;     /* Deltas without their keyframe */
+    long ps_transit;            /* Arrival minus source time, msec */
+    double ps_jitter;           /* Smoothed transit variation, msec */
+    unsigned long ps_rate_base; /* ps_frames at the last rate sample */
+    double ps_rate;             /* Frames per second */
+    struct timeval ps_last;     /* Arrival of the newest frame */
+};
+
+struct panel_table {
+    struct panel_source pt_src[PTAB_MAX_SOURCES];
+    short pt_slot[PTAB_SLOTS];  /* Index + 1 into pt_src, 0 if empty */
+    int pt_count;
+    unsigned long pt_datagrams; /* Datagrams read */
+    unsigned long pt_batches;   /* Receive calls that returned data */
+    unsigned long pt_overflow;  /* Frames from sources past the table */
+    unsigned long pt_kdrops;    /* Datagrams the kernel dropped, if known */
+    int pt_rings;               /* Shared memory rings attached */
+    unsigned long pt_shmlost;   /* Frames the rings overwrote unread */
+    struct timeval pt_rate_at;  /* Time of the last rate sample */
+};
+
+void ptab_init(struct panel_table *t)
+{
+    memset(t, 0, sizeof(*t));
+    gettimeofday(&t->pt_rate_at, NULL);
+}
+
+static unsigned ptab_hash(uint32_t ip, uint16_t port, uint32_t type)
+{
+    uint32_t h;
+
+    h = ip * 2654435761u;
+    h ^= ((uint32_t)port << 16 | type) * 2246822519u;
+    return (h >> 16) & (PTAB_SLOTS - 1);
+}
+
+/* Find or add the slot for a source; NULL once the table is full */
+struct panel_source *ptab_lookup(struct panel_table *t,
+                                 const struct sockaddr_in *from, uint32_t type)
+{
+    struct panel_source *s;
+    unsigned h;
+    int i;
+
+    h = ptab_hash(from->sin_addr.s_addr, from->sin_port, type);
+    while ((i = t->pt_slot[h]) != 0) {
+        s = &t->pt_src[i - 1];
+        if (s->ps_ip == from->sin_addr.s_addr &&
+            s->ps_port == from->sin_port && s->ps_type == type)
+            return s;
+        h = (h + 1) & (PTAB_SLOTS - 1);
+    }
+    if (t->pt_count >= PTAB_MAX_SOURCES) {
+        t->pt_overflow++;
+        return NULL;
+    }
+    s = &t->pt_src[t->pt_count++];
+    s->ps_ip = from->sin_addr.s_addr;
+    s->ps_port = from->sin_port;
+    s->ps_type = type;
+    t->pt_slot[h] = t->pt_count;
+    return s;
+}
+
+/* Keep a frame's payload as the source's current state */
+void ptab_store(struct panel_source *s, const void *state, int len,
+                const struct timeval *now)
+{
+    if (len > PTAB_MAX_STATE)
+        len = PTAB_MAX_STATE;
+    memcpy(s->ps_state, state, len);
+    s->ps_len = len;
+    s->ps_frames++;
+    s->ps_pending++;
+    s->ps_last = *now;
+}
+
+static unsigned get_word(const unsigned char *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/*
+ * Account for a v2 sequence number.  Returns 0 if the frame is older
+ * than one already seen and so should not replace the current state.
+ *
+ * Sequence numbers skipped over are counted lost.  ps_seen remembers
+ * which of the last PTAB_SEEN arrived, so a late frame is only taken
+ * off the lost count if it was one of those skipped, and a repeat is
+ * counted as a duplicate.  Anything older, or from before the first
+ * frame, is counted late and leaves the lost count alone.
+ */
+static int ptab_sequence(struct panel_source *s, uint16_t seq)
+{
+    int16_t gap;
+    uint32_t bit;
+
+    gap = (int16_t)(seq - s->ps_nextseq);
+    if (!s->ps_seqvalid || gap < -PTAB_RESTART) {
+        if (s->ps_seqvalid)
+            s->ps_keylen = 0;
+        s->ps_seqvalid = 1;
+        s->ps_nextseq = seq + 1;
+        s->ps_seen = 1;
+        s->ps_history = 1;
+        return 1;
+    }
+    if (gap < 0) {
+        if (-gap > s->ps_history) {
+            s->ps_reordered++;
+            return 0;
+        }
+        bit = (uint32_t)1 << (-gap - 1);
+        if (s->ps_seen & bit) {
+            s->ps_duplicate++;
+            return 0;
+        }
+        s->ps_seen |= bit;
+        s->ps_reordered++;
+        s->ps_lost--;           /* Counted missing when we skipped it */
+        return 0;
+    }
+    s->ps_lost += gap;
+    s->ps_seen = gap + 1 < PTAB_SEEN ? s->ps_seen << (gap + 1) | 1 : 1;
+    s->ps_history = s->ps_history + gap + 1 < PTAB_SEEN ?
+                    s->ps_history + gap + 1 : PTAB_SEEN;
+    s->ps_nextseq = seq + 1;
+    return 1;
+}
+
+/* RFC 3550 style interarrival jitter from the source timestamp */
+static void ptab_jitter(struct panel_source *s, unsigned long msec,
+                        const struct timeval *now)
+{
+    long arrival, transit, d;
+
+    arrival = (long)(now->tv_sec * 1000L + now->tv_usec / 1000L);
+    transit = arrival - (long)msec;
+    if (s->ps_frames > 0 && s->ps_version == 2) {
+        d = transit - s->ps_transit;
+        if (d < 0)
+            d = -d;
+        s->ps_jitter += (d - s->ps_jitter) / 16.0;
+    }
+    s->ps_transit = transit;
+}
+
+/* Rebuild a v2 frame's panel_state into ps_state; 0 if it can't be */
+static int ptab_decode_v2(struct panel_source *s, uint32_t flags,
+                          const unsigned char *p, int len)
+{
+    uint16_t keyseq;
+
+    keyseq = get_word(p + 2);
+    p += PANEL_V2_HDRLEN;
+    len -= PANEL_V2_HDRLEN;
+    if (flags & PANEL_V2_KEY) {
+        if (len <= 0 || len > PTAB_MAX_STATE)
+            return -1;
+        memcpy(s->ps_key, p, len);
+        s->ps_key[len] = 0;
+        s->ps_keylen = len;
+        s->ps_keyseq = keyseq;
+        memcpy(s->ps_state, p, len);
+        s->ps_len = len;
+        return 1;
+    }
+    if (s->ps_keylen == 0 || keyseq != s->ps_keyseq) {
+        s->ps_nokey++;
+        return 0;
+    }
+    if (panel_undelta(s->ps_state, s->ps_key, s->ps_keylen,
+                      (unsigned char *)p, len) < 0)
+        return -1;
+    s->ps_len = s->ps_keylen;
+    return 1;
+}
+
+/*
+ * The PDP-11 stores a long high word first, each word low byte first,
+ * so its uint32_t header flags arrive word swapped.
+ */
+uint32_t panel_flags(uint32_t raw)
+{
+    if ((raw & 0xFFFF) == 0 && (raw >> 16) != 0)
+        return raw >> 16;
+    return raw;
+}
+
+/*
+ * Validate one v1 or v2 datagram and update its source.  Returns the
+ * source if it now holds a new panel_state, otherwise NULL.
+ */
+struct panel_source *ptab_ingest(struct panel_table *t,
+                                 const unsigned char *buf, int len,
+                                 const struct sockaddr_in *from,
+                                 const struct timeval *now)
+{
+    struct panel_packet_header header;
+    struct panel_source *s;
+    const unsigned char *p;
+    unsigned long msec;
+    uint32_t flags;
+    int count, r;
+
+    t->pt_datagrams++;
+    if (len < (int)sizeof(header)) {
+        s = ptab_lookup(t, from, 0);
+        if (s != NULL)
+            s->ps_bad++;
+        return NULL;
+    }
+    memcpy(&header, buf, sizeof(header));
+    flags = panel_flags(header.pp_byte_flags);
+    s = ptab_lookup(t, from, flags & PANEL_TYPE_MASK);
+    if (s == NULL)
+        return NULL;
+    count = header.pp_byte_count;
+    p = buf + sizeof(header);
+    if (len != (int)sizeof(header) + count) {
+        s->ps_bad++;
+        return NULL;
+    }
+    s->ps_bytes += len;
+    if (!(flags & PANEL_V2)) {
+        if (count > PTAB_MAX_STATE) {
+            s->ps_bad++;
+            return NULL;
+        }
+        s->ps_version = 1;
+        ptab_store(s, p, count, now);
+        return s;
+    }
+
+    if (count < PANEL_V2_HDRLEN) {
+        s->ps_bad++;
+        return NULL;
+    }
+    msec = (unsigned long)get_word(p + 4) << 16 | get_word(p + 6);
+    ptab_jitter(s, msec, now);
+    s->ps_version = 2;
+    if (!ptab_sequence(s, get_word(p)))
+        return NULL;
+    r = ptab_decode_v2(s, flags, p, count);
+    if (r < 0) {
+        s->ps_bad++;
+        return NULL;
+    }
+    if (r == 0)
+        return NULL;
+    s->ps_frames++;
+    s->ps_pending++;
+    s->ps_last = *now;
+    return s;
+}
+
+static uint64_t le64(const unsigned char *p)
+{
+    uint64_t v;
+    int i;
+
+    v = 0;
+    for (i = 7; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+/* One line summary of a panel_state payload */
+static void ptab_summary(struct panel_source *s, char *buf, size_t size)
+{
+    const unsigned char *p = s->ps_state;
+    unsigned long addr;
+
+    switch (s->ps_type) {
+    case PANEL_PDP1170:
+        if (s->ps_len < 16)
+            break;
+        addr = (unsigned long)get_word(p) << 16 | get_word(p + 2);
+        snprintf(buf, size, "ADDR %08lo DATA %06o PSW %06o MMR0 %06o",
+                 addr & 017777777, get_word(p + 4), get_word(p + 6),
+                 get_word(p + 12));
+        return;
+    case PANEL_VAX:
+        if (s->ps_len < sizeof(struct vax_panel_state))
+            break;
+        {
+            struct vax_panel_state v;
+
+            memcpy(&v, p, sizeof(v));
+            snprintf(buf, size, "ADDR %08lx DATA %04lx",
+                     (unsigned long)v.ps_address,
+                     (unsigned long)v.ps_data & 0xFFFF);
+        }
+        return;
+    case PANEL_NETBSDX64:
+        if (s->ps_len < sizeof(struct clockframe))
+            break;
+        snprintf(buf, size, "RIP %016llx RSP %016llx",
+                 (unsigned long long)
+                 le64(p + offsetof(struct clockframe, cf_rip)),
+                 (unsigned long long)
+                 le64(p + offsetof(struct clockframe, cf_rsp)));
+        return;
+    case PANEL_MACOS:
+        if (s->ps_len < sizeof(struct macos_panel_state))
+            break;
+        {
+            struct macos_panel_state m;
+
+            memcpy(&m, p, sizeof(m));
+            snprintf(buf, size, "PC %016llx CPU %3u%% MEM %3u%%",
+                     (unsigned long long)m.pc, (unsigned)m.cpu_usage,
+                     (unsigned)m.memory_usage);
+        }
+        return;
+    case PANEL_LINUXX64:
+        if (s->ps_len < sizeof(struct pt_regs))
+            break;
+        snprintf(buf, size, "RIP %016llx RSP %016llx",
+                 (unsigned long long)le64(p + offsetof(struct pt_regs, rip)),
+                 (unsigned long long)le64(p + offsetof(struct pt_regs, rsp)));
+        return;
+    }
+    snprintf(buf, size, "%u bytes", (unsigned)s->ps_len);
+}
+
+/*
+ * Draw every source into buf as one screen, homing the cursor rather
+ * than clearing so the display does not flicker.  Returns the length.
+ */
+int ptab_render(struct panel_table *t, const struct timeval *now,
+                char *buf, size_t size)
+{
+    struct panel_source *s;
+    struct in_addr in;
+    char who[32], when[16], link[40], summary[80], rings[64];
+    double dt, age;
+    size_t n;
+    int i;
+
+    rings[0] = '\0';
+    if (t->pt_rings > 0)
+        snprintf(rings, sizeof(rings), ", %d shm rings overran %lu",
+                 t->pt_rings, t->pt_shmlost);
+    dt = (now->tv_sec - t->pt_rate_at.tv_sec) +
+         (now->tv_usec - t->pt_rate_at.tv_usec) / 1e6;
+    n = snprintf(buf, size,
+                 "\033[H%d sources, %lu datagrams in %lu batches, "
+                 "kernel drops %lu, table overflow %lu%s\033[K\n"
+                 "%-21s %-11s %9s %6s %5s %9s %5s %-21s %5s  %s\033[K\n",
+                 t->pt_count, t->pt_datagrams, t->pt_batches,
+                 t->pt_kdrops, t->pt_overflow, rings,
+                 "SOURCE", "TYPE", "FRAMES", "RATE", "B/FR", "COALESCED",
+                 "BAD", "V2 LOST/LATE/DUP/JIT", "AGE", "STATE");
+    for (i = 0; i < t->pt_count && n < size; i++) {
+        s = &t->pt_src[i];
+        if (dt >= 1.0) {
+            s->ps_rate = (s->ps_frames - s->ps_rate_base) / dt;
+            s->ps_rate_base = s->ps_frames;
+        }
+        if (s->ps_pending > 1)
+            s->ps_coalesced += s->ps_pending - 1;
+        s->ps_pending = 0;
+        in.s_addr = s->ps_ip;
+        if (s->ps_label[0] != '\0')
+            snprintf(who, sizeof(who), "%s", s->ps_label);
+        else
+            snprintf(who, sizeof(who), "%s:%u", inet_ntoa(in),
+                     (unsigned)ntohs(s->ps_port));
+        if (s->ps_frames > 0) {
+            age = (now->tv_sec - s->ps_last.tv_sec) +
+                  (now->tv_usec - s->ps_last.tv_usec) / 1e6;
+            snprintf(when, sizeof(when), "%.1fs", age);
+            ptab_summary(s, summary, sizeof(summary));
+        } else {
+            strcpy(when, "-");
+            strcpy(summary, "no valid frames");
+        }
+        if (s->ps_version == 2)
+            snprintf(link, sizeof(link), "%lu/%lu/%lu/%.1fms",
+                     s->ps_lost, s->ps_reordered, s->ps_duplicate,
+                     s->ps_jitter);
+        else
+            strcpy(link, "-");
+        n += snprintf(buf + n, size - n,
+                      "%-21s %-11s %9lu %6.1f %5lu %9lu %5lu %-21s %5s  "
+                      "%s\033[K\n",
+                      who, get_panel_type_name(s->ps_type), s->ps_frames,
+                      s->ps_rate, s->ps_frames ? s->ps_bytes / s->ps_frames : 0,
+                      s->ps_coalesced, s->ps_bad, link, when, summary);
+    }
+    if (dt >= 1.0)
+        t->pt_rate_at = *now;
+    if (n < size)
+        n += snprintf(buf + n, size - n, "\033[J");
+    return n < size ? (int)n : (int)size - 1;
+}
+
+#endif /* PANEL_TABLE_C */
@@ -0,0 +1,161 @@
+/*
+ * prectest.c - Check that panel recordings read back at the times they
+ * were written
+ * Usage: prectest [scratch file]   (default /tmp/prectest.rec)
+ *
+ * Records two sources with made-up clocks, the first frame well after
+ * the recording starts, then reads the recording from the start and
+ * after seeks to several points, the way replay does.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+#define SERVER_PORT 4000
+#include "common.c"
+#include "panel_record.c"
+
+#define PT_LEN 24               /* Bytes of panel_state per frame */
+#define PT_FIRST 5000000L       /* First frame, usec into the recording */
+#define PT_STEP 100003L         /* Between source 0's frames */
+#define PT_FRAMES 200
+
+/* Frames as written */
+struct pt_frame {
+    int id;
+    uint64_t t;
+    unsigned char state[PT_LEN];
+};
+
+char *path = "/tmp/prectest.rec";
+struct pt_frame written[2 * PT_FRAMES];
+int nwritten = 0;
+int failures = 0;
+
+static void check(const char *what, int ok)
+{
+    printf("  %-44s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static void add_frame(struct panel_recorder *r, int id, uint64_t t)
+{
+    struct pt_frame *f;
+    struct timeval now;
+    int i;
+
+    f = &written[nwritten++];
+    f->id = id;
+    f->t = t;
+    for (i = 0; i < PT_LEN; i++)
+        f->state[i] = i < 4 ? nwritten >> (i * 8) : (id * 31 + i) & 0xFF;
+    now.tv_sec = r->pr_start.tv_sec + (r->pr_start.tv_usec + t) / 1000000;
+    now.tv_usec = (r->pr_start.tv_usec + t) % 1000000;
+    if (prec_write(r, id, htonl(0x7F000001), htons(4001 + id), 0x5,
+                   f->state, PT_LEN, &now) < 0) {
+        perror(path);
+        exit(1);
+    }
+}
+
+/* Source 0 from PT_FIRST, source 1 joining part way and stopping early */
+static void write_recording(void)
+{
+    struct panel_recorder r;
+    uint64_t t;
+    int k;
+
+    if (prec_create(&r, path) < 0) {
+        perror(path);
+        exit(1);
+    }
+    for (k = 0; k < PT_FRAMES; k++) {
+        t = PT_FIRST + (uint64_t)k * PT_STEP;
+        add_frame(&r, 0, t);
+        if (k >= 23 && k < PT_FRAMES - 40)
+            add_frame(&r, 1, t + 41017);
+    }
+    prec_close(&r);
+}
+
+/*
+ * Seek to usec, skip what comes before it as replay does, and compare
+ * the rest with the frames written from there on.
+ */
+static void check_from(uint64_t usec)
+{
+    struct panel_reader reader;
+    struct prec_frame f;
+    struct pt_frame *w;
+    char what[64];
+    int i, r, ok;
+
+    if (prec_open(&reader, path) < 0) {
+        perror(path);
+        exit(1);
+    }
+    prec_seek(&reader, usec);
+    for (i = 0; i < nwritten && written[i].t < usec; i++)
+        ;
+    ok = 1;
+    while ((r = prec_read(&reader, &f)) > 0) {
+        if (f.pf_time < usec)
+            continue;
+        if (i >= nwritten) {
+            ok = 0;
+            break;
+        }
+        w = &written[i++];
+        if (f.pf_id != w->id || f.pf_time != w->t ||
+            f.pf_src->pr_len != PT_LEN ||
+            memcmp(f.pf_src->pr_state, w->state, PT_LEN) != 0) {
+            ok = 0;
+            break;
+        }
+    }
+    sprintf(what, "from %llu.%06llu s", (unsigned long long)(usec / 1000000),
+            (unsigned long long)(usec % 1000000));
+    check(what, ok && r == 0 && i == nwritten);
+    prec_rclose(&reader);
+}
+
+int main(int argc, char *argv[])
+{
+    struct panel_reader reader;
+    struct prec_frame f;
+    char idxpath[1024];
+
+    if (argc > 1)
+        path = argv[1];
+    snprintf(idxpath, sizeof(idxpath), "%s.idx", path);
+    write_recording();
+
+    printf("%d frames, first at %ld usec:\n", nwritten, PT_FIRST);
+    if (prec_open(&reader, path) < 0) {
+        perror(path);
+        exit(1);
+    }
+    check("first frame keeps its lead-in",
+          prec_read(&reader, &f) == 1 && f.pf_time == PT_FIRST);
+    prec_rclose(&reader);
+
+    check_from(0);
+    check_from(2500000L);              /* Before the first sync point */
+    check_from(PT_FIRST + 500000L);    /* Inside the first interval */
+    check_from(7250000L);
+    check_from(PT_FIRST + 100L * PT_STEP + 500);
+    check_from(PT_FIRST + (uint64_t)(PT_FRAMES - 1) * PT_STEP);
+    check_from(60000000L);             /* Past the end: nothing */
+
+    unlink(path);
+    unlink(idxpath);
+    printf(failures ? "%d FAILED\n" : "All passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * replay.c - Send a panel recording made with "server -w" back to a server
+ *
+ * Each recorded source is replayed from its own UDP socket, so the
+ * server sees as many clients as were recorded.  Frames go out as full
+ * v1 packets at the recorded pace, scaled by -x, or as fast as possible
+ * with -x 0.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+#define SERVER_PORT 4000
+#include "common.c"
+#include "panel_record.c"
+
+void replay_usage(char *progname)
+{
+    printf("Usage: %s [-s server_ip] [-x speed] [-o seconds] [-t seconds] file\n",
+           progname);
+    printf("  -s server_ip   IP address of server (default: 127.0.0.1)\n");
+    printf("  -x speed       Playback speed, 0 for as fast as possible (default: 1)\n");
+    printf("  -o seconds     Start this far into the recording\n");
+    printf("  -t seconds     Stop after this much recorded time\n");
+    printf("  -h             Show this help\n");
+}
+
+static double elapsed(const struct timeval *since)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - since->tv_sec) + (now.tv_usec - since->tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    static int sockets[PREC_MAX_SOURCES];
+    unsigned char packet[sizeof(struct panel_packet_header) + PREC_MAX_STATE];
+    struct panel_packet_header header;
+    struct panel_reader reader;
+    struct sockaddr_in server_addr;
+    struct prec_frame frame;
+    struct timeval start;
+    char *server_ip = "127.0.0.1";
+    double speed = 1.0, offset = 0.0, span = 0.0, ahead;
+    uint64_t first, last, stop;
+    unsigned long frames = 0, errors = 0;
+    int nsources = 0;
+    int opt, r, i, fd;
+
+    while ((opt = getopt(argc, argv, "s:x:o:t:h")) != -1) {
+        switch (opt) {
+            case 's':
+                server_ip = optarg;
+                break;
+            case 'x':
+                speed = atof(optarg);
+                break;
+            case 'o':
+                offset = atof(optarg);
+                break;
+            case 't':
+                span = atof(optarg);
+                break;
+            case 'h':
+                replay_usage(argv[0]);
+                exit(0);
+            default:
+                replay_usage(argv[0]);
+                exit(1);
+        }
+    }
+    if (optind != argc - 1 || speed < 0 || offset < 0 || span < 0) {
+        replay_usage(argv[0]);
+        exit(1);
+    }
+    if (prec_open(&reader, argv[optind]) < 0) {
+        perror(argv[optind]);
+        exit(1);
+    }
+    fd = create_udp_socket(server_ip, &server_addr);
+    if (fd < 0) {
+        exit(1);
+    }
+    close(fd);
+    for (i = 0; i < PREC_MAX_SOURCES; i++) {
+        sockets[i] = -1;
+    }
+
+    last = 0;
+    first = prec_seek(&reader, (uint64_t)(offset * 1e6));
+    stop = span > 0 ? (uint64_t)(offset * 1e6) + (uint64_t)(span * 1e6) : 0;
+    gettimeofday(&start, NULL);
+    while ((r = prec_read(&reader, &frame)) > 0) {
+        if (frame.pf_time < (uint64_t)(offset * 1e6)) {
+            continue;           /* Catching up from the sync point */
+        }
+        if (stop && frame.pf_time > stop) {
+            break;
+        }
+        last = frame.pf_time;
+        if (frames == 0) {
+            first = frame.pf_time;
+            gettimeofday(&start, NULL);
+        }
+        if (speed > 0) {
+            ahead = (frame.pf_time - first) / 1e6 / speed - elapsed(&start);
+            if (ahead > 0.001) {
+                precise_delay((long)(ahead * 1e6));
+            }
+        }
+        if (sockets[frame.pf_id] < 0) {
+            sockets[frame.pf_id] = socket(AF_INET, SOCK_DGRAM, 0);
+            if (sockets[frame.pf_id] < 0) {
+                perror("socket");
+                exit(1);
+            }
+            nsources++;
+        }
+        header.pp_byte_count = frame.pf_src->pr_len;
+        header.pp_byte_flags = frame.pf_src->pr_type;
+        memcpy(packet, &header, sizeof(header));
+        memcpy(packet + sizeof(header), frame.pf_src->pr_state,
+               frame.pf_src->pr_len);
+        if (sendto(sockets[frame.pf_id], packet,
+                   sizeof(header) + frame.pf_src->pr_len, 0,
+                   (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+            errors++;
+        }
+        frames++;
+    }
+    if (r < 0) {
+        fprintf(stderr, "%s: recording is damaged after %lu frames\n",
+                argv[optind], frames);
+    }
+    printf("Replayed %lu frames from %d sources: %.3f s recorded in %.3f s",
+           frames, nsources, frames ? (last - first) / 1e6 : 0.0,
+           elapsed(&start));
+    printf(", %.0f frames/s", frames / (elapsed(&start) > 0 ? elapsed(&start) : 1));
+    if (errors) {
+        printf(", %lu send errors", errors);
+    }
+    printf("\n");
+    prec_rclose(&reader);
+    return r < 0;
+}
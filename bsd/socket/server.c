@@ -2,10 +2,19 @@
  * server.c - Cross-platform socket server for panel data
  * Receives panel data from PDP-11, NetBSD x64, and NetBSD VAX clients
  * Uses common packet header to distinguish client types
+ *
+ * With -m the server runs in ingest mode for many clients at once:
+ * datagrams are drained in batches, the newest frame from each source
+ * is kept in a table, and the screen is redrawn at a fixed rate.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE         /* recvmmsg() */
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <stdio.h>
@@ -15,6 +24,11 @@
 #include <errno.h>
 #include <signal.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#define SERVER_PORT 4000
 
 /* Include common packet header and panel type definitions */
 #include "panel_packet.h"
@@ -27,14 +41,58 @@
 #include "arch/macOS/panel_state.h"
 #include "arch/LinuxX64/panel_state.h"
 
-#define SERVER_PORT 4000
+#include "panel_table.c"
+#include "panel_record.c"
+#include "panel_metrics.c"
+
+#define INGEST_BATCH 64         /* Datagrams per receive call */
+#define INGEST_RCVBUF (4 * 1024 * 1024)
+#define INGEST_MAXPKT 1024      /* Largest datagram accepted */
+#define DEFAULT_REFRESH_HZ 10
+#define MAX_RINGS 16            /* Shared memory rings read with -l */
+#define METRICS_MAXREQ 2048     /* Largest HTTP request read with -M */
 
 /* Global variables for signal handling */
 static int server_sockfd = -1;
 
+/* Shared memory rings of local clients, from -l */
+static struct panel_ring_reader rings[MAX_RINGS];
+static int nrings = 0;
+
+/* Recording of received frames, if -w was given */
+static struct panel_recorder recorder;
+static int recording = 0;
+
+/* Rolling statistics served over HTTP, if -M was given */
+static struct panel_metrics metrics;
+static int metrics_fd = -1;
+
+/* Pass a newly decoded frame to the metrics and the recording */
+static void record_frame(struct panel_table *t, struct panel_source *s,
+                         const struct timeval *now)
+{
+    if (s == NULL) {
+        return;
+    }
+    if (metrics_fd >= 0) {
+        pmet_frame(&metrics, t, s, now);
+    }
+    if (!recording) {
+        return;
+    }
+    if (prec_write(&recorder, s - t->pt_src, s->ps_ip, s->ps_port,
+                   s->ps_type, s->ps_state, s->ps_len, now) < 0) {
+        perror("recording");
+        prec_close(&recorder);
+        recording = 0;
+    }
+}
+
 /* Function prototypes */
 int create_udp_server_socket(void);
+int create_metrics_socket(int port);
 void handle_udp_clients(int sockfd);
+void handle_ingest(int sockfd, int refresh_hz);
 void signal_handler(int sig);
 void setup_signal_handlers(void);
 void format_binary(uint32_t value, int bits, char *buffer);
@@ -189,17 +247,13 @@ void display_linuxx64_panel(struct linuxx64_panel_state *panel)
 /* Display NetBSD VAX panel data */
 void display_vax_panel(struct vax_panel_state *panel)
 {
-    char addr_bin[33], data_bin[17], psw_bin[17], mmr0_bin[17], mmr3_bin[17];
+    char addr_bin[33], data_bin[17];
     
     /* Format each field as binary */
     format_binary(panel->ps_address, 32, addr_bin);  /* 32-bit address */
     format_binary(panel->ps_data, 16, data_bin);
-    format_binary(panel->ps_psw, 16, psw_bin);
-    format_binary(panel->ps_mmr0, 16, mmr0_bin);
-    format_binary(panel->ps_mmr3, 16, mmr3_bin);
     
-    printf("VAX: ADDR: %s, DATA: %s, PSW: %s, MMR0: %s, MMR3: %s\n",
-           addr_bin, data_bin, psw_bin, mmr0_bin, mmr3_bin);
+    printf("VAX: ADDR: %s, DATA: %s\n", addr_bin, data_bin);
 }
 
 /* Display macOS panel data */
@@ -218,8 +272,74 @@ void display_macos_panel(struct macos_panel_state *panel)
            panel->load_average / 100.0, panel->thread_count);
 }
 
+void server_usage(char *progname)
+{
+    printf("Usage: %s [-m] [-r hz] [-w file] [-M port] [-l name]...\n", progname);
+    printf("  -m             Ingest mode: batch receive, one line per source\n");
+    printf("  -r hz          Ingest mode screen refresh rate (default: %d)\n",
+           DEFAULT_REFRESH_HZ);
+    printf("  -w file        Record every frame to file (see replay)\n");
+    printf("  -M port        Serve rolling metrics over HTTP on 127.0.0.1:port\n");
+    printf("                 (implies -m)\n");
+    printf("  -l name        Also read a local client's shared memory ring\n");
+    printf("                 (may be repeated; implies -m)\n");
+    printf("  -h             Show this help\n");
+}
+
 int main(int argc, char *argv[])
 {
+    int ingest = 0;
+    int refresh_hz = DEFAULT_REFRESH_HZ;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "mr:w:M:l:h")) != -1) {
+        switch (opt) {
+            case 'm':
+                ingest = 1;
+                break;
+            case 'r':
+                refresh_hz = atoi(optarg);
+                if (refresh_hz < 1 || refresh_hz > 1000) {
+                    fprintf(stderr, "Refresh rate must be 1..1000 Hz\n");
+                    exit(1);
+                }
+                break;
+            case 'w':
+                if (prec_create(&recorder, optarg) < 0) {
+                    perror(optarg);
+                    exit(1);
+                }
+                recording = 1;
+                break;
+            case 'M':
+                metrics_fd = create_metrics_socket(atoi(optarg));
+                if (metrics_fd < 0) {
+                    exit(1);
+                }
+                pmet_init(&metrics);
+                ingest = 1;
+                break;
+            case 'l':
+                if (nrings >= MAX_RINGS) {
+                    fprintf(stderr, "At most %d rings\n", MAX_RINGS);
+                    exit(1);
+                }
+                if (panel_ring_attach(&rings[nrings], optarg) < 0) {
+                    perror(optarg);
+                    exit(1);
+                }
+                nrings++;
+                ingest = 1;
+                break;
+            case 'h':
+                server_usage(argv[0]);
+                exit(0);
+            default:
+                server_usage(argv[0]);
+                exit(1);
+        }
+    }
+
     printf("Starting UDP server on port %d...\n", SERVER_PORT);
     
     /* Set up signal handlers for clean shutdown */
@@ -236,7 +356,11 @@ int main(int argc, char *argv[])
     printf("Waiting for frames...\n");
     
     /* Handle incoming UDP packets */
-    handle_udp_clients(server_sockfd);
+    if (ingest) {
+        handle_ingest(server_sockfd, refresh_hz);
+    } else {
+        handle_udp_clients(server_sockfd);
+    }
     
     if (server_sockfd >= 0) {
         close(server_sockfd);
@@ -284,9 +408,49 @@ int create_udp_server_socket(void)
     return sockfd;
 }
 
+/* Listen for metrics scrapes on the loopback interface only */
+int create_metrics_socket(int port)
+{
+    struct sockaddr_in addr;
+    int fd, reuse = 1;
+
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "Metrics port must be 1..65535\n");
+        return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 8) < 0) {
+        perror("metrics socket");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
 void handle_udp_clients(int sockfd)
 {
+    static struct panel_table table;
     struct panel_packet_header header;
+    struct panel_source *source;
+    union {
+        struct pdp_panel_state pdp;
+        struct vax_panel_state vax;
+        struct netbsdx64_panel_state netbsdx64;
+        struct macos_panel_state macos;
+        struct linuxx64_panel_state linuxx64;
+    } panel;
+    struct timeval now;
     char buffer[1024];  /* Buffer for panel data */
     int bytes_received;
     int frame_count = 0;
@@ -300,6 +464,7 @@ void handle_udp_clients(int sockfd)
            PANEL_PDP1170, PANEL_VAX, PANEL_NETBSDX64, PANEL_MACOS, PANEL_LINUXX64);
     printf("Binary format: O=1, .=0\n\n");
     
+    ptab_init(&table);
     while (1) {
         /* Receive the complete packet */
         client_addr_len = sizeof(client_addr);
@@ -333,42 +498,44 @@ void handle_udp_clients(int sockfd)
             continue;
         }
         
+        /* Decode v1 or v2; v2 deltas need their keyframe first */
+        gettimeofday(&now, NULL);
+        source = ptab_ingest(&table, (unsigned char *)buffer, bytes_received,
+                             &client_addr, &now);
+        if (source == NULL) {
+            continue;
+        }
+        record_frame(&table, source, &now);
+        memset(&panel, 0, sizeof(panel));
+        memcpy(&panel, source->ps_state,
+               source->ps_len < sizeof(panel) ? source->ps_len : sizeof(panel));
+        
         /* Process based on panel type */
-        switch (header.pp_byte_flags) {
-            case PANEL_PDP1170: {
-                struct pdp_panel_packet *packet = (struct pdp_panel_packet *)buffer;
-                printf("[%s] ", get_panel_type_name(header.pp_byte_flags));
-                display_pdp_panel(&packet->panel_state);
+        switch (source->ps_type) {
+            case PANEL_PDP1170:
+                printf("[%s] ", get_panel_type_name(source->ps_type));
+                display_pdp_panel(&panel.pdp);
                 break;
-            }
             
-            case PANEL_VAX: {
-                struct vax_panel_packet *packet = (struct vax_panel_packet *)buffer;
-                printf("[%s] ", get_panel_type_name(header.pp_byte_flags));
-                display_vax_panel(&packet->panel_state);
+            case PANEL_VAX:
+                printf("[%s] ", get_panel_type_name(source->ps_type));
+                display_vax_panel(&panel.vax);
                 break;
-            }
             
-            case PANEL_NETBSDX64: {
-                struct netbsdx64_panel_packet *packet = (struct netbsdx64_panel_packet *)buffer;
-                printf("[%s] ", get_panel_type_name(header.pp_byte_flags));
-                display_netbsdx64_panel(&packet->panel_state);
+            case PANEL_NETBSDX64:
+                printf("[%s] ", get_panel_type_name(source->ps_type));
+                display_netbsdx64_panel(&panel.netbsdx64);
                 break;
-            }
             
-            case PANEL_MACOS: {
-                struct macos_panel_packet *packet = (struct macos_panel_packet *)buffer;
-                printf("[%s] ", get_panel_type_name(header.pp_byte_flags));
-                display_macos_panel(&packet->panel_state);
+            case PANEL_MACOS:
+                printf("[%s] ", get_panel_type_name(source->ps_type));
+                display_macos_panel(&panel.macos);
                 break;
-            }
             
-            case PANEL_LINUXX64: {
-                struct linuxx64_panel_packet *packet = (struct linuxx64_panel_packet *)buffer;
-                printf("[%s] ", get_panel_type_name(header.pp_byte_flags));
-                display_linuxx64_panel(&packet->panel_state);
+            case PANEL_LINUXX64:
+                printf("[%s] ", get_panel_type_name(source->ps_type));
+                display_linuxx64_panel(&panel.linuxx64);
                 break;
-            }
             
             default:
                 printf("[Unknown panel type: 0x%08lx, %d bytes from %s:%d]\n",
@@ -380,6 +547,13 @@ void handle_udp_clients(int sockfd)
         frame_count++;
         if (frame_count % 30 == 0) {  /* Every second at 30 Hz */
             printf("--- Received %d frames ---\n", frame_count);
+            if (source->ps_version == 2) {
+                printf("--- %s:%d v2: lost %lu, reordered %lu, duplicated %lu, "
+                       "jitter %.1f ms ---\n",
+                       inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
+                       source->ps_lost, source->ps_reordered,
+                       source->ps_duplicate, source->ps_jitter);
+            }
         }
         
         fflush(stdout);
@@ -388,6 +562,273 @@ void handle_udp_clients(int sockfd)
     printf("\nTotal panel updates received: %d\n", frame_count);
 }
 
+/* Ask for a large receive buffer and, where supported, drop counts */
+static void setup_ingest_socket(int sockfd)
+{
+    int size = INGEST_RCVBUF;
+    int on = 1;
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+        perror("setsockopt SO_RCVBUF");
+    }
+#ifdef SO_RXQ_OVFL
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+        perror("setsockopt SO_RXQ_OVFL");
+    }
+#else
+    (void)on;
+#endif
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+}
+
+#ifdef SO_RXQ_OVFL
+/* The kernel reports its running drop total on each datagram */
+static void ingest_drops(struct panel_table *t, struct msghdr *msg)
+{
+    struct cmsghdr *cm;
+    uint32_t drops;
+
+    for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&drops, CMSG_DATA(cm), sizeof(drops));
+            t->pt_kdrops = drops;
+        }
+    }
+}
+#endif
+
+/*
+ * Read everything queued on the socket, up to INGEST_BATCH datagrams
+ * per system call where recvmmsg() exists.  Returns -1 on a real error.
+ */
+static int ingest_drain(int sockfd, struct panel_table *t)
+{
+    static unsigned char bufs[INGEST_BATCH][INGEST_MAXPKT];
+    static struct sockaddr_in from[INGEST_BATCH];
+#ifdef SO_RXQ_OVFL
+    static char ctl[INGEST_BATCH][CMSG_SPACE(sizeof(uint32_t))];
+#endif
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+    static struct mmsghdr msgs[INGEST_BATCH];
+    static struct iovec iov[INGEST_BATCH];
+#endif
+    struct timeval now;
+    int n, i;
+
+    for (;;) {
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+        for (i = 0; i < INGEST_BATCH; i++) {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = INGEST_MAXPKT;
+            memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef SO_RXQ_OVFL
+            msgs[i].msg_hdr.msg_control = ctl[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(ctl[i]);
+#endif
+        }
+        n = recvmmsg(sockfd, msgs, INGEST_BATCH, MSG_DONTWAIT, NULL);
+        if (n == 0) {
+            return 0;
+        }
+        if (n < 0) {
+            break;
+        }
+        gettimeofday(&now, NULL);
+        t->pt_batches++;
+        for (i = 0; i < n; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                msgs[i].msg_len = 0;    /* Counted as bad below */
+            }
+            record_frame(t, ptab_ingest(t, bufs[i], msgs[i].msg_len,
+                                        &from[i], &now), &now);
+#ifdef SO_RXQ_OVFL
+            ingest_drops(t, &msgs[i].msg_hdr);
+#endif
+        }
+        if (n < INGEST_BATCH) {
+            return 0;
+        }
+#else
+        socklen_t fromlen;
+
+        for (i = 0; i < INGEST_BATCH; i++) {
+            fromlen = sizeof(from[i]);
+            n = recvfrom(sockfd, bufs[i], INGEST_MAXPKT, 0,
+                         (struct sockaddr *)&from[i], &fromlen);
+            if (n < 0) {
+                break;
+            }
+            gettimeofday(&now, NULL);
+            record_frame(t, ptab_ingest(t, bufs[i], n, &from[i], &now), &now);
+        }
+        if (i > 0) {
+            t->pt_batches++;
+        }
+        if (i < INGEST_BATCH) {
+            break;
+        }
+#endif
+    }
+    /* Only a failed receive call leaves the loop */
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+    }
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+    perror("recvmmsg");
+#else
+    perror("recvfrom");
+#endif
+    return -1;
+}
+
+/*
+ * Read every frame published to the shared memory rings since the last
+ * call.  Each ring appears in the table as its own source.
+ */
+static void ingest_rings(struct panel_table *t)
+{
+    unsigned char buf[PANEL_RING_DATA];
+    struct sockaddr_in from;
+    struct panel_source *s;
+    struct timeval now;
+    int i, n;
+
+    gettimeofday(&now, NULL);
+    t->pt_shmlost = 0;
+    for (i = 0; i < nrings; i++) {
+        memset(&from, 0, sizeof(from));
+        from.sin_family = AF_INET;
+        from.sin_port = htons(i + 1);
+        while ((n = panel_ring_read(&rings[i], buf, sizeof(buf))) > 0) {
+            s = ptab_ingest(t, buf, n, &from, &now);
+            if (s != NULL && s->ps_label[0] == '\0') {
+                snprintf(s->ps_label, sizeof(s->ps_label), "shm:%s",
+                         rings[i].rr_name);
+            }
+            record_frame(t, s, &now);
+        }
+        t->pt_shmlost += rings[i].rr_lost;
+    }
+}
+
+/*
+ * Answer every pending metrics connection: read one request, write the
+ * metrics and close.  A scraper gets a second to send its request and
+ * take the reply, so a stuck one cannot hold up ingest for long.
+ */
+static void serve_metrics(struct panel_table *t)
+{
+    static struct pmet_buf body;
+    char req[METRICS_MAXREQ], head[256];
+    struct timeval now, timeout;
+    const char *status, *p;
+    int fd, n, len, off;
+
+    while ((fd = accept(metrics_fd, NULL, NULL)) >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        n = recv(fd, req, sizeof(req) - 1, 0);
+        if (n <= 0) {
+            close(fd);
+            continue;
+        }
+        req[n] = '\0';
+        if (strncmp(req, "GET ", 4) != 0) {
+            status = "405 Method Not Allowed";
+        } else if (strncmp(req + 4, "/ ", 2) == 0 ||
+                   strncmp(req + 4, "/metrics", 8) == 0) {
+            status = "200 OK";
+        } else {
+            status = "404 Not Found";
+        }
+        if (status[0] == '2') {
+            gettimeofday(&now, NULL);
+            pmet_render(&metrics, t, &now, &body);
+            p = body.pb_text;
+            len = body.pb_len;
+        } else {
+            p = "";
+            len = 0;
+        }
+        n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 %s\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %d\r\n"
+                     "Connection: close\r\n\r\n", status, len);
+        if (send(fd, head, n, 0) == n) {
+            for (off = 0; off < len; off += n) {
+                n = send(fd, p + off, len - off, 0);
+                if (n <= 0) {
+                    break;
+                }
+            }
+        }
+        close(fd);
+    }
+}
+
+void handle_ingest(int sockfd, int refresh_hz)
+{
+    static struct panel_table table;
+    static char screen[PTAB_MAX_SOURCES * 200 + 1024];
+    struct timeval now, next;
+    struct pollfd pfd[2];
+    long period, wait;
+    int len, nfds;
+
+    setup_ingest_socket(sockfd);
+    ptab_init(&table);
+    table.pt_rings = nrings;
+    period = 1000000L / refresh_hz;
+    gettimeofday(&next, NULL);
+    printf("\033[2J");
+    fflush(stdout);
+
+    pfd[0].fd = sockfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = metrics_fd;
+    pfd[1].events = POLLIN;
+    nfds = metrics_fd >= 0 ? 2 : 1;
+    while (1) {
+        pfd[1].revents = 0;
+        gettimeofday(&now, NULL);
+        wait = (next.tv_sec - now.tv_sec) * 1000L +
+               (next.tv_usec - now.tv_usec) / 1000L;
+        if (wait > 0 && poll(pfd, nfds, (int)wait) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (ingest_drain(sockfd, &table) < 0) {
+            break;
+        }
+        if (pfd[1].revents & POLLIN) {
+            serve_metrics(&table);
+        }
+
+        gettimeofday(&now, NULL);
+        if (now.tv_sec > next.tv_sec ||
+            (now.tv_sec == next.tv_sec && now.tv_usec >= next.tv_usec)) {
+            ingest_rings(&table);
+            len = ptab_render(&table, &now, screen, sizeof(screen));
+            fwrite(screen, 1, len, stdout);
+            fflush(stdout);
+            next.tv_usec += period;
+            next.tv_sec += next.tv_usec / 1000000L;
+            next.tv_usec %= 1000000L;
+            if (next.tv_sec < now.tv_sec - 1) {
+                next = now;     /* Fell far behind; don't try to catch up */
+            }
+        }
+    }
+}
+
 void signal_handler(int sig)
 {
     printf("\nReceived signal %d, shutting down...\n", sig);
@@ -395,6 +836,9 @@ void signal_handler(int sig)
     if (server_sockfd >= 0) {
         close(server_sockfd);
     }
+    if (recording) {
+        prec_close(&recorder);
+    }
     
     exit(0);
 }
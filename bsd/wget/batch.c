@@ -0,0 +1,666 @@
+/*
+ * batch.c - Fetch a list of URLs, several at a time
+ *
+ * "wget -i list" reads one URL per line, http://host[:port]/path,
+ * optionally followed by the file to save it as (otherwise the last
+ * part of the path, or index.html).  Up to -j fetches run at once on
+ * non-blocking sockets under select().  A connection that finishes a
+ * fetch takes the next URL for the same host if there is one, so a
+ * mirror of many files from one server costs a few TCP handshakes, not
+ * one per file.  Bodies are written straight from the read buffer to
+ * their files.  A body ends at its Content-Length, at the last chunk of
+ * a chunked one, or when the server closes the connection.  With -c a
+ * file that already exists is resumed with a Range request; a 206 is
+ * appended to it, a 200 replaces it and a 416 means it was already
+ * complete.  A URL whose keep-alive connection was closed by the server
+ * before the response is tried once more on a new connection.
+ * Included by wget.c.
+ */
+
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__linux__) || defined(__APPLE__)
+#include <errno.h>
+#define MAX_JOBS 32             /* Fetches at once */
+#define READ_SIZE 16384
+#else
+#include <sys/errno.h>
+#define MAX_JOBS 8              /* 2.11BSD allows 30 open files */
+#define READ_SIZE BUFSIZE
+#endif
+
+#ifndef O_NONBLOCK
+#define O_NONBLOCK FNDELAY
+#endif
+#ifndef EWOULDBLOCK
+#define EWOULDBLOCK EAGAIN
+#endif
+
+#define HEAD_SIZE 2048          /* Response status line and headers */
+#define DEFAULT_JOBS 4
+
+/* A URL from the list */
+struct url {
+    char *u_host;
+    int u_port;
+    char *u_path;
+    char *u_file;               /* Where the body goes */
+    int u_state;                /* U_PENDING, U_ACTIVE, U_DONE, U_FAILED */
+    int u_retried;              /* Already retried on a new connection */
+};
+
+#define U_PENDING 0
+#define U_ACTIVE 1
+#define U_DONE 2
+#define U_FAILED 3
+
+/* What a fetch slot's connection is doing */
+#define F_IDLE 0                /* Not connected */
+#define F_CONNECT 1             /* Connect in progress */
+#define F_SEND 2                /* Request being written */
+#define F_HEAD 3                /* Response headers being read */
+#define F_BODY 4                /* Response body being read */
+#define F_READY 5               /* Connected, between requests */
+
+/* Where a chunked body is */
+#define CH_NONE 0               /* Not chunked */
+#define CH_SIZE 1               /* Reading a chunk size line */
+#define CH_DATA 2               /* Inside a chunk */
+#define CH_END 3                /* Reading the CRLF after a chunk */
+#define CH_TRAILER 4            /* After the last chunk, up to a blank line */
+
+struct fetch {
+    int f_fd;
+    int f_state;
+    char *f_host;               /* Host and port connected to */
+    int f_port;
+    int f_reused;               /* Request went out on a kept connection */
+    struct url *f_url;          /* URL being fetched, or NULL */
+    int f_out;                  /* File the body goes to, or -1 to discard */
+    long f_offset;              /* Bytes of the file already there */
+    long f_got;                 /* Body bytes received */
+    int f_status;
+    int f_close;                /* Connection ends with this response */
+    int f_chunk;
+    long f_left;                /* Body or chunk bytes to come, -1 to close */
+    int f_reqpos, f_reqlen;     /* Unwritten part of f_req */
+    int f_inlen;                /* Header or chunk line bytes in f_in */
+    char f_req[512];
+    char f_in[HEAD_SIZE];
+};
+
+static struct url *urls;
+static int nurls;
+static struct fetch fetches[MAX_JOBS];
+static int njobs = DEFAULT_JOBS;
+static int resume;
+static char *prefix;
+static char readbuf[READ_SIZE];
+static long total_bytes, connects, reuses;
+
+/* Last part of path without any query, or index.html */
+static char *file_name(path)
+char *path;
+{
+    static char name[256];
+    char *p;
+    int n;
+
+    p = rindex(path, '/');
+    p = p ? p + 1 : path;
+    n = strcspn(p, "?#");
+    if (n == 0 || n >= sizeof(name))
+        return "index.html";
+    strncpy(name, p, n);
+    name[n] = '\0';
+    return name;
+}
+
+/* Read the URL list; returns the number of URLs or -1 */
+static int read_list(list)
+char *list;
+{
+    FILE *fp;
+    char line[1024], *p, *host, *path, *file, *name;
+    int max, port, n;
+
+    fp = strcmp(list, "-") ? fopen(list, "r") : stdin;
+    if (!fp) {
+        perror(list);
+        return -1;
+    }
+    max = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        p = line + strspn(line, " \t");
+        p[strcspn(p, "\r\n")] = '\0';
+        if (*p == '\0' || *p == '#')
+            continue;
+        if (strncmp(p, "http://", 7) != 0) {
+            fprintf(stderr, "Not an http:// URL: %s\n", p);
+            continue;
+        }
+
+        /* Split off the file name, then host, port and path, in a copy */
+        p = strdup(p + 7);
+        file = p + strcspn(p, " \t");
+        if (*file) {
+            *file++ = '\0';
+            file += strspn(file, " \t");
+        }
+        host = p;
+        n = strcspn(host, ":/");
+        port = host[n] == ':' ? atoi(host + n + 1) : 80;
+        path = host + n + strcspn(host + n, "/");
+        path = *path ? strdup(path) : "/";
+        host[n] = '\0';
+        if (!*file)
+            file = file_name(path);
+        if (prefix) {
+            name = malloc(strlen(prefix) + strlen(file) + 2);
+            sprintf(name, "%s/%s", prefix, file);
+        } else
+            name = strdup(file);
+
+        if (nurls == max) {
+            max = max ? max * 2 : 32;
+            urls = (struct url *)(urls ? realloc((char *)urls,
+                                                 max * sizeof(*urls))
+                                       : malloc(max * sizeof(*urls)));
+            if (!urls) {
+                fprintf(stderr, "Out of memory\n");
+                return -1;
+            }
+        }
+        urls[nurls].u_host = host;
+        urls[nurls].u_port = port;
+        urls[nurls].u_path = path;
+        urls[nurls].u_file = name;
+        urls[nurls].u_state = U_PENDING;
+        urls[nurls].u_retried = 0;
+        nurls++;
+    }
+    if (fp != stdin)
+        fclose(fp);
+    return nurls;
+}
+
+static void hangup(f)
+struct fetch *f;
+{
+    if (f->f_fd >= 0)
+        close(f->f_fd);
+    f->f_fd = -1;
+    f->f_state = F_IDLE;
+}
+
+/* The fetch of f's URL is over, one way or the other */
+static void end_url(f, state)
+struct fetch *f;
+int state;
+{
+    if (f->f_out >= 0)
+        close(f->f_out);
+    f->f_out = -1;
+    f->f_url->u_state = state;
+    f->f_url = NULL;
+}
+
+static void fail(f, why)
+struct fetch *f;
+char *why;
+{
+    fprintf(stderr, "%s: %s\n", f->f_url->u_file, why);
+    end_url(f, U_FAILED);
+    hangup(f);
+}
+
+/* Send u's request on f, connecting first unless f is connected to its host */
+static void begin(f, u)
+struct fetch *f;
+struct url *u;
+{
+    struct sockaddr_in sa;
+    struct hostent *he;
+    struct stat st;
+
+    f->f_url = u;
+    u->u_state = U_ACTIVE;
+    f->f_out = -1;
+    f->f_offset = 0;
+    if (resume && stat(u->u_file, &st) == 0 && st.st_size > 0)
+        f->f_offset = st.st_size;
+
+    if (strlen(u->u_path) + strlen(u->u_host) + 128 > sizeof(f->f_req)) {
+        fail(f, "URL too long");
+        return;
+    }
+    sprintf(f->f_req, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: minimal-wget/0.1 (K&R)\r\n",
+            u->u_path, u->u_host);
+    if (f->f_offset > 0)
+        sprintf(f->f_req + strlen(f->f_req), "Range: bytes=%ld-\r\n",
+                f->f_offset);
+    strcat(f->f_req, "\r\n");
+    f->f_reqpos = 0;
+    f->f_reqlen = strlen(f->f_req);
+    f->f_inlen = 0;
+
+    if (f->f_state == F_READY && f->f_port == u->u_port &&
+        strcmp(f->f_host, u->u_host) == 0) {
+        f->f_reused = 1;
+        f->f_state = F_SEND;
+        reuses++;
+        return;
+    }
+    hangup(f);
+    f->f_reused = 0;
+    f->f_host = u->u_host;
+    f->f_port = u->u_port;
+
+    he = gethostbyname(u->u_host);
+    if (he == (struct hostent *)0) {
+        fail(f, "gethostbyname failed");
+        return;
+    }
+    memset((char *)&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    memcpy((char *)&sa.sin_addr, (char *)he->h_addr, he->h_length);
+    sa.sin_port = htons((unsigned short)u->u_port);
+    f->f_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (f->f_fd < 0) {
+        fail(f, "socket creation failed");
+        return;
+    }
+    fcntl(f->f_fd, F_SETFL, fcntl(f->f_fd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(f->f_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 &&
+        errno != EINPROGRESS) {
+        fail(f, "connect failed");
+        return;
+    }
+    f->f_state = F_CONNECT;
+    connects++;
+}
+
+/*
+ * Give an idle fetch slot the next URL, the same host's first if any.
+ * Returns 0 if there are none left.
+ */
+static int assign(f)
+struct fetch *f;
+{
+    struct url *u, *next;
+    int i;
+
+    next = NULL;
+    for (i = 0; i < nurls; i++) {
+        u = &urls[i];
+        if (u->u_state != U_PENDING)
+            continue;
+        if (f->f_state == F_READY && u->u_port == f->f_port &&
+            strcmp(u->u_host, f->f_host) == 0) {
+            next = u;
+            break;
+        }
+        if (!next)
+            next = u;
+    }
+    if (next) {
+        begin(f, next);
+        return 1;
+    }
+    if (f->f_state == F_READY)
+        hangup(f);
+    return 0;
+}
+
+/* Find header name in the block from p to end; returns its value or NULL */
+static char *find_header(p, end, name)
+char *p, *end, *name;
+{
+    int n;
+
+    n = strlen(name);
+    for (; p + n < end; p++)
+        if (p[-1] == '\n' && strncasecmp(p, name, n) == 0) {
+            p += n;
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            return p;
+        }
+    return NULL;
+}
+
+/* The response headers fill f_in up to len: open the file, frame the body */
+static int got_headers(f, len)
+struct fetch *f;
+int len;
+{
+    struct url *u = f->f_url;
+    char *end, *v;
+    long from;
+
+    end = f->f_in + len;
+    f->f_in[len - 1] = '\0';
+    f->f_status = 0;
+    sscanf(f->f_in, "HTTP/%*s %d", &f->f_status);
+
+    v = find_header(f->f_in + 1, end, "transfer-encoding:");
+    f->f_chunk = v && strncasecmp(v, "chunked", 7) == 0 ? CH_SIZE : CH_NONE;
+    v = find_header(f->f_in + 1, end, "content-length:");
+    f->f_left = f->f_chunk == CH_NONE && v ? atol(v) : -1;
+    if (f->f_status == 304 || f->f_status == 204)
+        f->f_left = 0;
+    v = find_header(f->f_in + 1, end, "connection:");
+    f->f_close = (f->f_chunk == CH_NONE && f->f_left < 0) ||
+                 (v && strncasecmp(v, "close", 5) == 0) ||
+                 (strncmp(f->f_in, "HTTP/1.0", 8) == 0 &&
+                  !(v && strncasecmp(v, "keep-alive", 10) == 0));
+    f->f_got = 0;
+
+    switch (f->f_status) {
+    case 206:
+        from = -1;
+        v = find_header(f->f_in + 1, end, "content-range:");
+        if (v)
+            sscanf(v, "bytes %ld-", &from);
+        if (from != f->f_offset) {
+            fprintf(stderr, "%s: server resumed at %ld, not %ld\n",
+                    u->u_file, from, f->f_offset);
+            return -1;
+        }
+        f->f_out = open(u->u_file, O_WRONLY | O_APPEND);
+        break;
+    case 200:
+        f->f_offset = 0;
+        f->f_out = open(u->u_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        break;
+    case 416:
+        /* Nothing past the end we have: already complete */
+        if (f->f_offset > 0)
+            return 0;
+        /* FALLTHROUGH */
+    default:
+        fprintf(stderr, "%s: %.*s\n", u->u_file,
+                (int)strcspn(f->f_in, "\r\n"), f->f_in);
+        return 0;
+    }
+    if (f->f_out < 0) {
+        perror(u->u_file);
+        return -1;
+    }
+    return 0;
+}
+
+/* Write body bytes to the file, if there is one */
+static int put(f, p, n)
+struct fetch *f;
+char *p;
+int n;
+{
+    f->f_got += n;
+    total_bytes += n;
+    if (f->f_out >= 0 && write(f->f_out, p, n) != n) {
+        perror(f->f_url->u_file);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Take n bytes of body, undoing chunked encoding.  Returns 1 when the
+ * body is complete, 0 for more, -1 on error.
+ */
+static int take_body(f, p, n)
+struct fetch *f;
+char *p;
+int n;
+{
+    int k;
+    char c;
+
+    while (n > 0) {
+        if (f->f_chunk == CH_NONE || f->f_chunk == CH_DATA) {
+            k = n;
+            if (f->f_left >= 0 && k > f->f_left)
+                k = f->f_left;
+            if (put(f, p, k) < 0)
+                return -1;
+            p += k;
+            n -= k;
+            if (f->f_left >= 0 && (f->f_left -= k) == 0) {
+                if (f->f_chunk == CH_NONE)
+                    return 1;
+                f->f_chunk = CH_END;
+            }
+            continue;
+        }
+
+        /* Sizes, chunk ends and trailers are lines, gathered in f_in */
+        c = *p++;
+        n--;
+        if (c != '\n') {
+            if (c != '\r' && f->f_inlen < sizeof(f->f_in) - 1)
+                f->f_in[f->f_inlen++] = c;
+            continue;
+        }
+        f->f_in[f->f_inlen] = '\0';
+        k = f->f_inlen;
+        f->f_inlen = 0;
+        if (f->f_chunk == CH_END)
+            f->f_chunk = CH_SIZE;
+        else if (f->f_chunk == CH_TRAILER) {
+            if (k == 0)
+                return 1;
+        } else {
+            f->f_left = -1;
+            sscanf(f->f_in, "%lx", &f->f_left);
+            if (f->f_left < 0)
+                return -1;
+            f->f_chunk = f->f_left ? CH_DATA : CH_TRAILER;
+        }
+    }
+    return f->f_chunk == CH_NONE && f->f_left == 0;
+}
+
+/* The response is complete */
+static void done(f)
+struct fetch *f;
+{
+    struct url *u = f->f_url;
+
+    if (f->f_status == 416 && f->f_offset > 0) {
+        printf("%s: already complete\n", u->u_file);
+        end_url(f, U_DONE);
+    } else if (f->f_status == 200 || f->f_status == 206) {
+        if (f->f_offset > 0)
+            printf("%s: %ld bytes, resumed at %ld\n", u->u_file, f->f_got,
+                   f->f_offset);
+        else
+            printf("%s: %ld bytes\n", u->u_file, f->f_got);
+        end_url(f, U_DONE);
+    } else
+        end_url(f, U_FAILED);
+    if (f->f_close)
+        hangup(f);
+    else
+        f->f_state = F_READY;
+}
+
+/* Read what has arrived for f */
+static void input(f)
+struct fetch *f;
+{
+    char *p;
+    int n, i, len, r;
+
+    for (;;) {
+        if (f->f_state == F_HEAD)
+            n = read(f->f_fd, f->f_in + f->f_inlen,
+                     sizeof(f->f_in) - f->f_inlen);
+        else
+            n = read(f->f_fd, readbuf, sizeof(readbuf));
+        if (n < 0) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR)
+                return;
+            fail(f, strerror(errno));
+            return;
+        }
+        if (n == 0) {
+            if (f->f_state == F_BODY && f->f_chunk == CH_NONE &&
+                f->f_left < 0) {
+                /* The body ran to the close */
+                done(f);
+            } else if (f->f_state == F_HEAD && f->f_inlen == 0 &&
+                       f->f_reused && !f->f_url->u_retried) {
+                /* Kept connection closed first: try a new one */
+                f->f_url->u_retried = 1;
+                f->f_url->u_state = U_PENDING;
+                f->f_url = NULL;
+                hangup(f);
+            } else
+                fail(f, "connection closed early");
+            return;
+        }
+
+        if (f->f_state == F_HEAD) {
+            f->f_inlen += n;
+            len = 0;
+            p = f->f_in;
+            for (i = 1; i < f->f_inlen && !len; i++)
+                if (p[i] == '\n' && (p[i - 1] == '\n' ||
+                                     (i > 1 && p[i - 1] == '\r' &&
+                                      p[i - 2] == '\n')))
+                    len = i + 1;
+            if (!len) {
+                if (f->f_inlen == sizeof(f->f_in)) {
+                    fail(f, "response headers too long");
+                    return;
+                }
+                continue;
+            }
+            if (got_headers(f, len) < 0) {
+                end_url(f, U_FAILED);
+                hangup(f);
+                return;
+            }
+            f->f_state = F_BODY;
+            /* What came in behind the headers is body */
+            n = f->f_inlen - len;
+            bcopy(f->f_in + len, readbuf, n);
+            f->f_inlen = 0;
+            if (n == 0 && f->f_chunk == CH_NONE && f->f_left == 0) {
+                done(f);
+                return;
+            }
+        }
+        r = take_body(f, readbuf, n);
+        if (r < 0) {
+            fail(f, "bad response body");
+            return;
+        }
+        if (r > 0) {
+            done(f);
+            return;
+        }
+    }
+}
+
+/* Finish connecting, and write what the socket will take of the request */
+static void output(f)
+struct fetch *f;
+{
+    int n, err, len;
+
+    if (f->f_state == F_CONNECT) {
+        len = sizeof(err);
+        err = 0;
+        if (getsockopt(f->f_fd, SOL_SOCKET, SO_ERROR, (char *)&err, &len) < 0 ||
+            err != 0) {
+            fail(f, "connect failed");
+            return;
+        }
+        f->f_state = F_SEND;
+    }
+    n = write(f->f_fd, f->f_req + f->f_reqpos, f->f_reqlen - f->f_reqpos);
+    if (n < 0) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)
+            fail(f, strerror(errno));
+        return;
+    }
+    f->f_reqpos += n;
+    if (f->f_reqpos == f->f_reqlen)
+        f->f_state = F_HEAD;
+}
+
+int batch(list)
+char *list;
+{
+    struct timeval t0, t1;
+    struct fetch *f;
+    fd_set rfds, wfds;
+    long ms;
+    int i, maxfd, failed, ok;
+
+    if (read_list(list) < 0)
+        return 1;
+    if (njobs > MAX_JOBS)
+        njobs = MAX_JOBS;
+    signal(SIGPIPE, SIG_IGN);
+    for (i = 0; i < njobs; i++) {
+        fetches[i].f_fd = fetches[i].f_out = -1;
+        fetches[i].f_state = F_IDLE;
+    }
+    gettimeofday(&t0, (struct timezone *)0);
+
+    for (;;) {
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        maxfd = -1;
+        for (i = 0; i < njobs; i++) {
+            f = &fetches[i];
+            /* A URL can fail at once, before any select() */
+            while (!f->f_url && assign(f))
+                ;
+            if (!f->f_url)
+                continue;
+            if (f->f_state == F_CONNECT || f->f_state == F_SEND)
+                FD_SET(f->f_fd, &wfds);
+            else
+                FD_SET(f->f_fd, &rfds);
+            if (f->f_fd > maxfd)
+                maxfd = f->f_fd;
+        }
+        if (maxfd < 0)
+            break;
+
+        if (select(maxfd + 1, &rfds, &wfds, (fd_set *)0,
+                   (struct timeval *)0) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("select");
+            return 1;
+        }
+        for (i = 0; i < njobs; i++) {
+            f = &fetches[i];
+            if (!f->f_url || f->f_fd < 0)
+                continue;
+            if (FD_ISSET(f->f_fd, &wfds))
+                output(f);
+            else if (FD_ISSET(f->f_fd, &rfds))
+                input(f);
+        }
+    }
+
+    gettimeofday(&t1, (struct timezone *)0);
+    ms = (t1.tv_sec - t0.tv_sec) * 1000L + (t1.tv_usec - t0.tv_usec) / 1000;
+    ok = failed = 0;
+    for (i = 0; i < nurls; i++)
+        if (urls[i].u_state == U_DONE)
+            ok++;
+        else
+            failed++;
+    printf("%d fetched, %d failed, %ld bytes in %ld.%03ld s over %ld connections (%ld reused)\n",
+           ok, failed, total_bytes, ms / 1000, ms % 1000, connects, reuses);
+    return failed > 0;
+}
@@ -0,0 +1,535 @@
+/*
+ * httpbench.c
+ *
+ * A load generator for httpd.  Keeps N connections busy issuing GETs,
+ * either one request per connection (HTTP/1.0, the way every request
+ * reaches httpd under inetd) or with -k many requests per keep-alive
+ * connection, and reports requests and bytes per second and latency
+ * percentiles.
+ *
+ * Example usage:
+ *    httpbench -c 8 -d 10 localhost 80 /index.html
+ *    httpbench -k -c 8 -n 2000 localhost 8080 /index.html /pdp1183.jpg
+ *
+ * Several paths are requested in turn.  A request's latency runs from
+ * the moment it is started, which for a new connection is the connect(),
+ * to the last byte of its response.  A response ends at its
+ * Content-Length, or where the server closes the connection if it sent
+ * none (httpd's CGI output).  If a keep-alive connection is closed by
+ * the server it is reconnected and the count of reconnects reported.
+ * Latencies go into a histogram of 16 steps per power of two, so
+ * percentiles are good to about 6% and memory doesn't grow with -n.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__linux__) || defined(__APPLE__)
+#include <errno.h>
+#define MAX_CONNS 512
+#else
+#include <sys/errno.h>
+#define MAX_CONNS 16            /* 2.11BSD allows 30 open files */
+#endif
+
+#ifndef O_NONBLOCK
+#define O_NONBLOCK FNDELAY
+#endif
+#ifndef EWOULDBLOCK
+#define EWOULDBLOCK EAGAIN
+#endif
+
+#define BUFSIZE 4096            /* Request, and response headers */
+#define MAX_PATHS 16
+#define SUB_BITS 4              /* Histogram steps per power of two */
+#define NBUCKETS (32 << SUB_BITS)
+
+/* What a connection is waiting for */
+#define C_IDLE 0                /* Not connected */
+#define C_CONNECT 1             /* Connect in progress */
+#define C_SEND 2                /* Request being written */
+#define C_HEAD 3                /* Response headers being read */
+#define C_BODY 4                /* Response body being read */
+#define C_READY 5               /* Connected, between requests */
+
+struct bconn {
+    int b_fd;
+    int b_state;
+    long b_start;               /* usec the current request began */
+    int b_path;                 /* Index into paths */
+    int b_reqpos, b_reqlen;     /* Unwritten part of b_req */
+    int b_inlen;                /* Header bytes in b_in */
+    long b_left;                /* Body bytes to come, -1 until close */
+    int b_close;                /* Server will close after this response */
+    char b_req[256];
+    char b_in[BUFSIZE];
+};
+
+static struct bconn *conns;
+static struct sockaddr_in server;
+static char *host;
+static char *paths[MAX_PATHS];
+static int npaths;
+static int keepalive;
+static long hist[NBUCKETS];
+static struct timeval tv0;
+static int stopping;
+
+/* Totals */
+static long started, done, failed, reconnects, bytes;
+static long status_ok, status_other;
+static long lat_min = -1, lat_max;
+static double lat_sum;
+
+static void on_stop(sig)
+int sig;
+{
+    stopping = 1;
+}
+
+/* Microseconds since the run began */
+static long now_usec()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, (struct timezone *)0);
+    return (tv.tv_sec - tv0.tv_sec) * 1000000L + (tv.tv_usec - tv0.tv_usec);
+}
+
+/* Histogram bucket for v: power of two, then SUB_BITS bits below it */
+static int bucket(v)
+long v;
+{
+    int b;
+
+    if (v < (1L << SUB_BITS))
+        return (int)v;
+    for (b = SUB_BITS; b < 31 && (v >> (b + 1)) != 0; b++)
+        ;
+    return ((b - SUB_BITS + 1) << SUB_BITS) +
+           (int)((v >> (b - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+}
+
+/* Middle of the range of values that fall in bucket i */
+static long bucket_value(i)
+int i;
+{
+    int band, shift;
+
+    band = i >> SUB_BITS;
+    if (band == 0)
+        return i;
+    shift = band - 1;
+    return ((long)((1 << SUB_BITS) + (i & ((1 << SUB_BITS) - 1))) << shift) +
+           ((1L << shift) >> 1);
+}
+
+/*
+ * Value at fraction p of the samples: the middle of its bucket, kept
+ * within the smallest and largest latency seen so the summary stays in
+ * order when the extremes share a bucket with the percentile.
+ */
+static long percentile(p)
+double p;
+{
+    long want, seen, v;
+    int i;
+
+    want = (long)(p * done + 0.5);
+    if (want < 1)
+        want = 1;
+    seen = 0;
+    for (i = 0; i < NBUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= want) {
+            v = bucket_value(i);
+            if (v < lat_min)
+                v = lat_min;
+            if (v > lat_max)
+                v = lat_max;
+            return v;
+        }
+    }
+    return lat_max;
+}
+
+static void record(lat)
+long lat;
+{
+    if (lat < 0)
+        lat = 0;
+    hist[bucket(lat)]++;
+    lat_sum += lat;
+    if (lat_min < 0 || lat < lat_min)
+        lat_min = lat;
+    if (lat > lat_max)
+        lat_max = lat;
+    done++;
+}
+
+static void drop(b)
+struct bconn *b;
+{
+    if (b->b_fd >= 0)
+        close(b->b_fd);
+    b->b_fd = -1;
+    b->b_state = C_IDLE;
+}
+
+/* Begin a request on b, connecting first if need be */
+static void start(b, now)
+struct bconn *b;
+long now;
+{
+    if (b->b_state == C_IDLE) {
+        b->b_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (b->b_fd < 0) {
+            perror("socket");
+            exit(1);
+        }
+        fcntl(b->b_fd, F_SETFL, fcntl(b->b_fd, F_GETFL, 0) | O_NONBLOCK);
+        if (connect(b->b_fd, (struct sockaddr *)&server, sizeof(server)) < 0 &&
+            errno != EINPROGRESS) {
+            failed++;
+            drop(b);
+            return;
+        }
+        b->b_state = C_CONNECT;
+    } else
+        b->b_state = C_SEND;
+
+    b->b_path = started++ % npaths;
+    if (keepalive)
+        sprintf(b->b_req, "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n",
+                paths[b->b_path], host);
+    else
+        sprintf(b->b_req, "GET %s HTTP/1.0\r\n\r\n", paths[b->b_path]);
+    b->b_reqpos = 0;
+    b->b_reqlen = strlen(b->b_req);
+    b->b_inlen = 0;
+    b->b_start = now;
+}
+
+/* Find header name in the block from p to end; returns its value or NULL */
+static char *find_header(p, end, name)
+char *p, *end, *name;
+{
+    int n;
+
+    n = strlen(name);
+    for (; p + n < end; p++)
+        if (p[-1] == '\n' && strncasecmp(p, name, n) == 0) {
+            p += n;
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            return p;
+        }
+    return NULL;
+}
+
+/* The response headers are in b_in up to len; decide how the body ends */
+static void got_headers(b, len)
+struct bconn *b;
+int len;
+{
+    char *end, *v;
+    int code;
+
+    end = b->b_in + len;
+    b->b_in[len - 1] = '\0';
+    code = 0;
+    sscanf(b->b_in, "HTTP/%*s %d", &code);
+    if (code == 200 || code == 304)
+        status_ok++;
+    else
+        status_other++;
+
+    v = find_header(b->b_in + 1, end, "content-length:");
+    b->b_left = v ? atol(v) : -1;
+    if (code == 304)
+        b->b_left = 0;
+    v = find_header(b->b_in + 1, end, "connection:");
+    b->b_close = !keepalive || b->b_left < 0 ||
+                 (v && strncasecmp(v, "close", 5) == 0) ||
+                 (strncmp(b->b_in, "HTTP/1.0", 8) == 0 &&
+                  !(v && strncasecmp(v, "keep-alive", 10) == 0));
+    bytes += len;
+}
+
+/* A response is complete: record it and start the next request */
+static void finish(b, now)
+struct bconn *b;
+long now;
+{
+    record(now - b->b_start);
+    if (b->b_close) {
+        drop(b);
+        if (keepalive)
+            reconnects++;
+    } else
+        b->b_state = C_READY;
+}
+
+/* Read what has arrived on b */
+static void input(b, now)
+struct bconn *b;
+long now;
+{
+    static char sink[16384];
+    char *p;
+    int n, i, len;
+
+    for (;;) {
+        if (b->b_state == C_HEAD)
+            n = read(b->b_fd, b->b_in + b->b_inlen,
+                     sizeof(b->b_in) - b->b_inlen);
+        else
+            n = read(b->b_fd, sink,
+                     b->b_left >= 0 && b->b_left < sizeof(sink) ?
+                     (int)b->b_left : sizeof(sink));
+        if (n < 0) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR)
+                return;
+            failed++;
+            drop(b);
+            return;
+        }
+        if (n == 0) {
+            /* Closed: the end of a body without Content-Length */
+            if (b->b_state == C_BODY && b->b_left < 0) {
+                b->b_close = 1;
+                finish(b, now);
+            } else if (b->b_state == C_HEAD && b->b_inlen == 0 &&
+                       keepalive) {
+                /* Closed while idle: ask again on a new connection */
+                reconnects++;
+                started--;
+                drop(b);
+            } else {
+                failed++;
+                drop(b);
+            }
+            return;
+        }
+
+        if (b->b_state == C_HEAD) {
+            b->b_inlen += n;
+            len = 0;
+            p = b->b_in;
+            /* Headers end with an empty line, CRLF or bare LF */
+            for (i = 1; i < b->b_inlen && !len; i++)
+                if (p[i] == '\n' && (p[i - 1] == '\n' ||
+                                     (i > 1 && p[i - 1] == '\r' &&
+                                      p[i - 2] == '\n')))
+                    len = i + 1;
+            if (!len) {
+                if (b->b_inlen == sizeof(b->b_in)) {
+                    failed++;
+                    drop(b);
+                    return;
+                }
+                continue;
+            }
+            got_headers(b, len);
+            b->b_state = C_BODY;
+            /* Whatever came in behind the headers is body */
+            n = b->b_inlen - len;
+            if (b->b_left >= 0 && n > b->b_left)
+                n = b->b_left;
+        }
+        bytes += n;
+        if (b->b_left >= 0) {
+            b->b_left -= n;
+            if (b->b_left == 0) {
+                finish(b, now);
+                return;
+            }
+        }
+    }
+}
+
+/* Write what the socket will take of the request */
+static void output(b)
+struct bconn *b;
+{
+    int n, err, len;
+
+    if (b->b_state == C_CONNECT) {
+        len = sizeof(err);
+        err = 0;
+        if (getsockopt(b->b_fd, SOL_SOCKET, SO_ERROR, (char *)&err, &len) < 0 ||
+            err != 0) {
+            failed++;
+            drop(b);
+            return;
+        }
+        b->b_state = C_SEND;
+    }
+    n = write(b->b_fd, b->b_req + b->b_reqpos, b->b_reqlen - b->b_reqpos);
+    if (n < 0) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR) {
+            failed++;
+            drop(b);
+        }
+        return;
+    }
+    b->b_reqpos += n;
+    if (b->b_reqpos == b->b_reqlen)
+        b->b_state = C_HEAD;
+}
+
+static void usage(prog)
+char *prog;
+{
+    fprintf(stderr,
+            "Usage: %s [-k] [-c conns] [-n requests] [-d seconds] host port path...\n",
+            prog);
+    exit(1);
+}
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+    struct hostent *he;
+    struct timeval tv;
+    struct bconn *b;
+    fd_set rfds, wfds;
+    long limit, secs, now, elapsed;
+    int nconns, opt, i, maxfd, active;
+    extern char *optarg;
+    extern int optind;
+
+    nconns = 1;
+    limit = 0;
+    secs = 0;
+    while ((opt = getopt(argc, argv, "kc:n:d:")) != EOF) {
+        switch (opt) {
+        case 'k':
+            keepalive = 1;
+            break;
+        case 'c':
+            nconns = atoi(optarg);
+            break;
+        case 'n':
+            limit = atol(optarg);
+            break;
+        case 'd':
+            secs = atol(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind < 3 || nconns < 1)
+        usage(argv[0]);
+    if (nconns > MAX_CONNS) {
+        fprintf(stderr, "At most %d connections\n", MAX_CONNS);
+        exit(1);
+    }
+    if (limit == 0 && secs == 0)
+        secs = 10;
+
+    host = argv[optind];
+    he = gethostbyname(host);
+    if (he == (struct hostent *)0) {
+        fprintf(stderr, "Error: gethostbyname failed for %s\n", host);
+        exit(1);
+    }
+    memset((char *)&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    memcpy((char *)&server.sin_addr, (char *)he->h_addr, he->h_length);
+    server.sin_port = htons((unsigned short)atoi(argv[optind + 1]));
+    for (i = optind + 2; i < argc && npaths < MAX_PATHS; i++)
+        paths[npaths++] = argv[i];
+
+    conns = (struct bconn *)calloc(nconns, sizeof(struct bconn));
+    if (!conns) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < nconns; i++) {
+        conns[i].b_fd = -1;
+        conns[i].b_state = C_IDLE;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_stop);
+    gettimeofday(&tv0, (struct timezone *)0);
+
+    now = 0;
+    for (;;) {
+        /* Start requests on idle connections while there are any to make */
+        for (i = 0; i < nconns; i++) {
+            b = &conns[i];
+            if (stopping || (limit > 0 && started >= limit) ||
+                (secs > 0 && now >= secs * 1000000L))
+                break;
+            if (b->b_state == C_IDLE || b->b_state == C_READY)
+                start(b, now);
+        }
+
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        maxfd = -1;
+        active = 0;
+        for (i = 0; i < nconns; i++) {
+            b = &conns[i];
+            if (b->b_state == C_CONNECT || b->b_state == C_SEND)
+                FD_SET(b->b_fd, &wfds);
+            else if (b->b_state == C_HEAD || b->b_state == C_BODY)
+                FD_SET(b->b_fd, &rfds);
+            else
+                continue;
+            active++;
+            if (b->b_fd > maxfd)
+                maxfd = b->b_fd;
+        }
+        if (active == 0)
+            break;
+
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        if (select(maxfd + 1, &rfds, &wfds, (fd_set *)0, &tv) < 0 &&
+            errno != EINTR) {
+            perror("select");
+            break;
+        }
+        now = now_usec();
+        for (i = 0; i < nconns; i++) {
+            b = &conns[i];
+            if (b->b_fd < 0)
+                continue;
+            if (FD_ISSET(b->b_fd, &wfds))
+                output(b);
+            else if (FD_ISSET(b->b_fd, &rfds))
+                input(b, now);
+        }
+    }
+    elapsed = now_usec();
+    for (i = 0; i < nconns; i++)
+        drop(&conns[i]);
+
+    if (elapsed <= 0)
+        elapsed = 1;
+    printf("%ld requests in %ld.%03ld s over %d %s connections\n",
+           done, elapsed / 1000000L, elapsed / 1000L % 1000L, nconns,
+           keepalive ? "keep-alive" : "one-shot");
+    printf("%ld ok, %ld other status, %ld failed, %ld reconnects\n",
+           status_ok, status_other, failed, reconnects);
+    printf("%.1f requests/s, %.1f KB/s\n", done * 1e6 / elapsed,
+           bytes * 1e6 / 1024 / elapsed);
+    if (done > 0)
+        printf("Latency usec: min %ld mean %ld p50 %ld p99 %ld p99.9 %ld max %ld\n",
+               lat_min, (long)(lat_sum / done), percentile(0.50),
+               percentile(0.99), percentile(0.999), lat_max);
+    return failed > 0;
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+#
+# httpbench.sh - Compare httpd run from inetd with "httpd -p"
+#
+# Builds httpd and httpbench into a scratch directory, serves a copy of
+# www/ plus a small CGI script both ways on local ports, and runs
+# httpbench against each for a static page, the large image and the CGI
+# script, one-shot and keep-alive.  Set INETD_PORT to measure an httpd
+# the system's inetd already runs (its root needs the same files and a
+# cgi-bin/hello); otherwise a few lines of Python stand in for inetd,
+# starting httpd for every connection with the socket as its stdin and
+# stdout.  CONNS and SECS set the connections and seconds per run.
+
+set -euo pipefail
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+REPO_DIR=$(cd "$SCRIPT_DIR/../.." && pwd)
+CC=${CC:-cc}
+CONNS=${CONNS:-8}
+SECS=${SECS:-5}
+STANDALONE_PORT=${STANDALONE_PORT:-18080}
+LOCAL_INETD_PORT=${LOCAL_INETD_PORT:-18081}
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/httpbench.XXXXXX")
+pids=()
+cleanup() {
+	for pid in "${pids[@]}"; do
+		kill "$pid" 2>/dev/null || true
+	done
+	wait 2>/dev/null || true
+	rm -rf "$work"
+}
+trap cleanup EXIT
+
+echo "Building in $work"
+"$CC" -O -w -o "$work/httpd" "$REPO_DIR/bsd/httpd/httpd.c"
+"$CC" -O -w -o "$work/httpbench" "$SCRIPT_DIR/httpbench.c"
+
+root=$work/www
+mkdir -p "$root/cgi-bin"
+cp "$REPO_DIR"/www/*.html "$REPO_DIR"/www/*.jpg "$root/"
+cat > "$root/cgi-bin/hello" <<'EOF'
+#!/bin/sh
+echo "HTTP/1.1 200 OK"
+echo "Content-Type: text/plain"
+echo ""
+echo "Hello from CGI"
+EOF
+chmod 755 "$root/cgi-bin/hello"
+
+"$work/httpd" -p "$STANDALONE_PORT" -d "$root/" -l "$work/standalone.log" &
+pids+=($!)
+
+if [[ -z ${INETD_PORT:-} ]]; then
+	if ! command -v python3 >/dev/null 2>&1; then
+		echo "Set INETD_PORT, or install python3 to stand in for inetd" >&2
+		exit 1
+	fi
+	INETD_PORT=$LOCAL_INETD_PORT
+	python3 - "$INETD_PORT" "$work/httpd" "$root/" "$work/inetd.log" <<'EOF' &
+import os, signal, socket, sys
+port, httpd, root, log = sys.argv[1:]
+signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+s = socket.socket()
+s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+s.bind(("127.0.0.1", int(port)))
+s.listen(128)
+while True:
+    c, _ = s.accept()
+    if os.fork() == 0:
+        os.dup2(c.fileno(), 0)
+        os.dup2(c.fileno(), 1)
+        os.execv(httpd, [httpd, "-d", root, "-l", log])
+    c.close()
+EOF
+	pids+=($!)
+fi
+sleep 1
+
+run() {
+	local mode=$1 port=$2 path=$3 flags=$4
+	echo
+	echo "== $mode $path ${flags:-one-shot}"
+	"$work/httpbench" $flags -c "$CONNS" -d "$SECS" 127.0.0.1 "$port" "$path" || true
+}
+
+for path in /index.html /pdp1183.jpg /cgi-bin/hello; do
+	run inetd "$INETD_PORT" "$path" ""
+	run standalone "$STANDALONE_PORT" "$path" ""
+	run standalone "$STANDALONE_PORT" "$path" -k
+done
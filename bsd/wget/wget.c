@@ -31,6 +31,8 @@
 /* Buffer size for read/write operations */
 #define BUFSIZE 1024
 
+#include "batch.c"
+
 /* Function to connect to a given host+port; returns socket fd or -1 on error. */
 int connect_to_host(host, port)
 char *host;
@@ -75,8 +77,10 @@ int port;
 /* 
  * Minimal main: usage:
  *   minimal_wget <host> <port> <path>
+ *   minimal_wget -i <list> [-j jobs] [-c] [-P dir]
  * Example:
  *   minimal_wget example.com 80 /index.html
+ *   minimal_wget -i urls.txt -j 4 -c -P mirror
  */
 int main(argc, argv)
 int argc;
@@ -88,9 +92,36 @@ char **argv;
     char *host;
     int port;
     char *path;
+    char *list = NULL;
+    int opt;
+    extern char *optarg;
+    extern int optind;
+
+    /* Options select batch mode; see batch.c */
+    while ((opt = getopt(argc, argv, "i:j:cP:")) != EOF) {
+        switch (opt) {
+        case 'i':
+            list = optarg;
+            break;
+        case 'j':
+            njobs = atoi(optarg);
+            break;
+        case 'c':
+            resume = 1;
+            break;
+        case 'P':
+            prefix = optarg;
+            break;
+        default:
+            argc = 0;
+        }
+    }
+    if (list && argc > 0 && optind == argc && njobs >= 1)
+        return batch(list);
 
-    if (argc != 4) {
+    if (argc != 4 || optind != 1 || njobs < 1) {
         fprintf(stderr, "Usage: %s <host> <port> <path>\n", argv[0]);
+        fprintf(stderr, "       %s -i <list> [-j jobs] [-c] [-P dir]\n", argv[0]);
         exit(1);
     }
 